@@ -0,0 +1,366 @@
+#include <string.h>
+
+#include "block.h"
+
+/* Members stored as plain deltas; the decode side casts back with the type. */
+#define BLOCK_INT_COLUMNS(X) \
+    X(fields, uint32_t) \
+    X(signal_dbm, int8_t) \
+    X(noise_dbm, int8_t) \
+    X(signal_avg_dbm, int8_t) \
+    X(chains, uint8_t) \
+    X(chain_signal_dbm[0], int8_t) \
+    X(chain_signal_dbm[1], int8_t) \
+    X(chain_signal_dbm[2], int8_t) \
+    X(chain_signal_dbm[3], int8_t) \
+    X(rx_bitrate_kbps, uint32_t) \
+    X(tx_bitrate_kbps, uint32_t) \
+    X(tx_packets, uint32_t) \
+    X(tx_retries, uint32_t) \
+    X(tx_failed, uint32_t) \
+    X(beacon_loss, uint32_t)
+
+#define BLOCK_FLOAT_COLUMNS(X) \
+    X(rx_bytes_per_s) \
+    X(tx_bytes_per_s) \
+    X(rx_packets_per_s) \
+    X(tx_packets_per_s) \
+    X(rx_errors_per_s) \
+    X(tx_errors_per_s) \
+    X(health)
+
+/* Intern IDs, after the floats: blocks written before them end early and decode as 0. */
+#define BLOCK_ID_COLUMNS(X) \
+    X(ssid_id, uint32_t) \
+    X(ifname_id, uint32_t)
+
+#define BLOCK_COLUMNS (2 + 15 + 7 + 2)  /* timestamp, bssid, ints, floats, IDs */
+
+static uint8_t *put_uvarint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint8_t *put_svarint(uint8_t *p, int64_t v)
+{
+    return put_uvarint(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static const uint8_t *get_uvarint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+    uint64_t r = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *get_svarint(const uint8_t *p, const uint8_t *end, int64_t *v)
+{
+    uint64_t u;
+    if (!(p = get_uvarint(p, end, &u))) return NULL;
+    *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return p;
+}
+
+uint64_t block_pack_bssid(const uint8_t b[6])
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 6; i++) v = v << 8 | b[i];
+    return v;
+}
+
+size_t block_bound(size_t n)
+{
+    return 10 + n * BLOCK_COLUMNS * 10;
+}
+
+size_t block_encode(const struct wifi_sample *s, size_t n, uint8_t *out)
+{
+    uint8_t *p = put_uvarint(out, n);
+
+    uint64_t prev_ts = 0;
+    int64_t prev_delta = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t delta = (int64_t)(s[i].ts_ns - prev_ts);
+        p = put_svarint(p, delta - prev_delta);
+        prev_ts = s[i].ts_ns;
+        prev_delta = delta;
+    }
+
+    int64_t prev_bssid = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t v = (int64_t)block_pack_bssid(s[i].bssid);
+        p = put_svarint(p, v - prev_bssid);
+        prev_bssid = v;
+    }
+
+#define ENCODE_INT(m, type) \
+    { \
+        int64_t prev = 0; \
+        for (size_t i = 0; i < n; i++) { \
+            int64_t v = (int64_t)s[i].m; \
+            p = put_svarint(p, v - prev); \
+            prev = v; \
+        } \
+    }
+    BLOCK_INT_COLUMNS(ENCODE_INT)
+
+#define ENCODE_FLOAT(m) \
+    { \
+        uint32_t prev = 0; \
+        for (size_t i = 0; i < n; i++) { \
+            uint32_t bits; \
+            memcpy(&bits, &s[i].m, sizeof(bits)); \
+            p = put_uvarint(p, bits ^ prev); \
+            prev = bits; \
+        } \
+    }
+    BLOCK_FLOAT_COLUMNS(ENCODE_FLOAT)
+#undef ENCODE_FLOAT
+    BLOCK_ID_COLUMNS(ENCODE_INT)
+#undef ENCODE_INT
+
+    return (size_t)(p - out);
+}
+
+long block_count(const uint8_t *in, size_t len)
+{
+    uint64_t n;
+    if (!get_uvarint(in, in + len, &n) || n > BLOCK_MAX_SAMPLES) return -1;
+    return (long)n;
+}
+
+long block_decode(const uint8_t *in, size_t len, struct wifi_sample *out, size_t cap)
+{
+    const uint8_t *p = in, *end = in + len;
+    uint64_t n;
+    if (!(p = get_uvarint(p, end, &n)) || n > BLOCK_MAX_SAMPLES || n > cap) return -1;
+
+    uint64_t ts = 0;
+    int64_t delta = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t dd;
+        if (!(p = get_svarint(p, end, &dd))) return -1;
+        delta += dd;
+        ts += (uint64_t)delta;
+        memset(&out[i], 0, sizeof(out[i]));
+        out[i].ts_ns = ts;
+    }
+
+    int64_t bssid = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t d;
+        if (!(p = get_svarint(p, end, &d))) return -1;
+        bssid += d;
+        for (int b = 0; b < 6; b++) out[i].bssid[b] = (uint8_t)((uint64_t)bssid >> (40 - 8 * b));
+    }
+
+#define DECODE_INT(m, type) \
+    { \
+        int64_t prev = 0; \
+        for (size_t i = 0; i < n; i++) { \
+            int64_t d; \
+            if (!(p = get_svarint(p, end, &d))) return -1; \
+            prev += d; \
+            out[i].m = (type)prev; \
+        } \
+    }
+    BLOCK_INT_COLUMNS(DECODE_INT)
+
+#define DECODE_FLOAT(m) \
+    { \
+        uint32_t prev = 0; \
+        for (size_t i = 0; i < n; i++) { \
+            uint64_t x; \
+            if (!(p = get_uvarint(p, end, &x)) || x > UINT32_MAX) return -1; \
+            prev ^= (uint32_t)x; \
+            memcpy(&out[i].m, &prev, sizeof(prev)); \
+        } \
+    }
+    BLOCK_FLOAT_COLUMNS(DECODE_FLOAT)
+#undef DECODE_FLOAT
+    if (p != end) {
+        BLOCK_ID_COLUMNS(DECODE_INT)
+    }
+#undef DECODE_INT
+
+    return p == end ? (long)n : -1;
+}
+
+/* One integer column into out32 or out8 (both NULL to skip it), as block_decode reads it. */
+static const uint8_t *get_int_column(const uint8_t *p, const uint8_t *end, size_t n, uint32_t *out32,
+                                     int8_t *out8)
+{
+    int64_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t d;
+        if (!(p = get_svarint(p, end, &d))) return NULL;
+        prev += d;
+        if (out32) out32[i] = (uint32_t)prev;
+        if (out8) out8[i] = (int8_t)prev;
+    }
+    return p;
+}
+
+static const uint8_t *get_float_column(const uint8_t *p, const uint8_t *end, size_t n, float *out)
+{
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t x;
+        if (!(p = get_uvarint(p, end, &x)) || x > UINT32_MAX) return NULL;
+        prev ^= (uint32_t)x;
+        if (out) memcpy(&out[i], &prev, sizeof(prev));
+    }
+    return p;
+}
+
+static int8_t saturate_i8(int v)
+{
+    return (int8_t)(v < INT8_MIN ? INT8_MIN : v > INT8_MAX ? INT8_MAX : v);
+}
+
+#define COUNT_COLUMN(...) +1
+
+long block_decode_columns(const uint8_t *in, size_t len, struct block_columns *c)
+{
+    const uint8_t *p = in, *end = in + len;
+    uint64_t n;
+    if (!(p = get_uvarint(p, end, &n)) || n > BLOCK_MAX_SAMPLES) return -1;
+
+    uint64_t ts = 0;
+    int64_t delta = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t dd;
+        if (!(p = get_svarint(p, end, &dd))) return -1;
+        delta += dd;
+        ts += (uint64_t)delta;
+        c->ts_ns[i] = ts;
+    }
+
+    int64_t bssid = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t d;
+        if (!(p = get_svarint(p, end, &d))) return -1;
+        bssid += d;
+        c->bssid[i] = (uint64_t)bssid;
+    }
+
+    /* fields, signal_dbm and noise_dbm lead BLOCK_INT_COLUMNS; health ends BLOCK_FLOAT_COLUMNS. */
+    int8_t *noise = c->snr_db;      /* turned into SNR below */
+    if (!(p = get_int_column(p, end, n, c->fields, NULL)) ||
+        !(p = get_int_column(p, end, n, NULL, c->signal_dbm)) || !(p = get_int_column(p, end, n, NULL, noise))) {
+        return -1;
+    }
+    for (int col = 3; col < 0 BLOCK_INT_COLUMNS(COUNT_COLUMN); col++) {
+        if (!(p = get_int_column(p, end, n, NULL, NULL))) return -1;
+    }
+    for (int col = 1; col < 0 BLOCK_FLOAT_COLUMNS(COUNT_COLUMN); col++) {
+        if (!(p = get_float_column(p, end, n, NULL))) return -1;
+    }
+    if (!(p = get_float_column(p, end, n, c->health))) return -1;
+    /* ssid_id, then ifname_id, unless the block predates them. */
+    if (p == end) {
+        memset(c->ifname_id, 0, n * sizeof(*c->ifname_id));
+    } else if (!(p = get_int_column(p, end, n, NULL, NULL)) || !(p = get_int_column(p, end, n, c->ifname_id, NULL))) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        int nf = (c->fields[i] & FIELD_NOISE) ? noise[i] : DEFAULT_NOISE_DBM;
+        c->snr_db[i] = saturate_i8(c->signal_dbm[i] - nf);
+    }
+    c->n = n;
+    return p == end ? (long)n : -1;
+}
+
+void block_columns_from_samples(const struct wifi_sample *s, size_t n, struct block_columns *c)
+{
+    for (size_t i = 0; i < n; i++) {
+        c->ts_ns[i] = s[i].ts_ns;
+        c->bssid[i] = block_pack_bssid(s[i].bssid);
+        c->fields[i] = s[i].fields;
+        c->signal_dbm[i] = s[i].signal_dbm;
+        c->snr_db[i] = saturate_i8((int)sample_snr(&s[i]));
+        c->health[i] = s[i].health;
+        c->ifname_id[i] = s[i].ifname_id;
+    }
+    c->n = n;
+}
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* Double hashing: probe i is h1 + i * h2. */
+static void bloom_probes(const uint8_t bssid[6], uint32_t probes[BLOCK_BLOOM_HASHES])
+{
+    uint64_t h = mix64(block_pack_bssid(bssid));
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (int i = 0; i < BLOCK_BLOOM_HASHES; i++) probes[i] = (h1 + (uint32_t)i * h2) % (BLOCK_BLOOM_BYTES * 8);
+}
+
+void block_zone_build(const struct wifi_sample *s, size_t n, struct block_zone *z)
+{
+    memset(z, 0, sizeof(*z));
+    z->ts_min = n ? s[0].ts_ns : 0;
+    z->ts_max = n ? s[n - 1].ts_ns : 0;
+    int sig_min = INT8_MAX, sig_max = INT8_MIN, snr_min = INT8_MAX, snr_max = INT8_MIN;
+    uint64_t last_bssid = UINT64_MAX;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i].fields & FIELD_GAP) continue;
+        if (s[i].fields & FIELD_SIGNAL) {
+            int snr = saturate_i8((int)sample_snr(&s[i]));
+            if (s[i].signal_dbm < sig_min) sig_min = s[i].signal_dbm;
+            if (s[i].signal_dbm > sig_max) sig_max = s[i].signal_dbm;
+            if (snr < snr_min) snr_min = snr;
+            if (snr > snr_max) snr_max = snr;
+        }
+        /* Consecutive samples mostly share an AP: hash each run once. */
+        if ((s[i].fields & FIELD_BSSID) && block_pack_bssid(s[i].bssid) != last_bssid) {
+            uint32_t probes[BLOCK_BLOOM_HASHES];
+            last_bssid = block_pack_bssid(s[i].bssid);
+            bloom_probes(s[i].bssid, probes);
+            for (int k = 0; k < BLOCK_BLOOM_HASHES; k++) z->bssid_bloom[probes[k] / 8] |= (uint8_t)(1u << (probes[k] % 8));
+        }
+    }
+    z->signal_min = (int8_t)sig_min;
+    z->signal_max = (int8_t)sig_max;
+    z->snr_min = (int8_t)snr_min;
+    z->snr_max = (int8_t)snr_max;
+}
+
+void block_zone_unknown(struct block_zone *z, uint64_t ts_min, uint64_t ts_max)
+{
+    memset(z, 0xff, sizeof(*z));
+    z->ts_min = ts_min;
+    z->ts_max = ts_max;
+    z->signal_min = z->snr_min = INT8_MIN;
+    z->signal_max = z->snr_max = INT8_MAX;
+    z->reserved = 0;
+}
+
+int block_zone_may_have_bssid(const struct block_zone *z, const uint8_t bssid[6])
+{
+    uint32_t probes[BLOCK_BLOOM_HASHES];
+    bloom_probes(bssid, probes);
+    for (int k = 0; k < BLOCK_BLOOM_HASHES; k++) {
+        if (!(z->bssid_bloom[probes[k] / 8] & (1u << (probes[k] % 8)))) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,83 @@
+#ifndef SNR_BLOCK_H
+#define SNR_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sample.h"
+
+/*
+ * Column-compressed block of samples for the on-disk store. Every member
+ * of wifi_sample becomes its own column. Integer columns hold zigzag
+ * varint deltas from the previous sample, and the timestamp column holds
+ * deltas of deltas, so a steady interval costs one byte. Float columns
+ * hold the varint of the XOR with the previous bit pattern, so a repeat
+ * costs one byte. Lossless.
+ */
+
+#define BLOCK_MAX_SAMPLES 4096
+#define BLOCK_BLOOM_BYTES 64
+#define BLOCK_BLOOM_HASHES 4
+
+/*
+ * Zone map of one block: what a query can learn without decoding it.
+ * Signal and SNR ranges cover only samples with FIELD_SIGNAL and are empty
+ * (min > max) when there are none. The Bloom filter holds every BSSID in
+ * the block: 512 bits and 4 hashes give about 0.1% false positives at the
+ * 20 or so access points a block typically sees.
+ */
+struct block_zone {
+    uint64_t ts_min, ts_max;
+    int8_t signal_min, signal_max;
+    int8_t snr_min, snr_max;
+    uint32_t reserved;
+    uint8_t bssid_bloom[BLOCK_BLOOM_BYTES];
+};
+
+/*
+ * The columns queries filter and aggregate on, one array per member.
+ * bssid packs the six bytes with the first one most significant, and
+ * snr_db is sample_snr() saturated to int8. ifname_id is 0 in blocks
+ * written before the ID columns.
+ */
+struct block_columns {
+    size_t n;
+    uint64_t ts_ns[BLOCK_MAX_SAMPLES];
+    uint64_t bssid[BLOCK_MAX_SAMPLES];
+    uint32_t fields[BLOCK_MAX_SAMPLES];
+    int8_t signal_dbm[BLOCK_MAX_SAMPLES];
+    int8_t snr_db[BLOCK_MAX_SAMPLES];
+    float health[BLOCK_MAX_SAMPLES];
+    uint32_t ifname_id[BLOCK_MAX_SAMPLES];
+};
+
+/* Worst-case encoded size of n samples. */
+size_t block_bound(size_t n);
+
+/* Encodes n samples (at most BLOCK_MAX_SAMPLES) into out; returns the length. */
+size_t block_encode(const struct wifi_sample *s, size_t n, uint8_t *out);
+
+/* Sample count stored at the start of a block, or -1 if it is corrupt. */
+long block_count(const uint8_t *in, size_t len);
+
+/* Decodes into out (room for cap samples); returns the count, or -1 if corrupt. */
+long block_decode(const uint8_t *in, size_t len, struct wifi_sample *out, size_t cap);
+
+/* Decodes only the query columns, skipping the rest; the count, or -1 if corrupt. */
+long block_decode_columns(const uint8_t *in, size_t len, struct block_columns *c);
+
+/* The same columns from n (at most BLOCK_MAX_SAMPLES) decoded samples. */
+void block_columns_from_samples(const struct wifi_sample *s, size_t n, struct block_columns *c);
+
+/* A BSSID as it appears in block_columns.bssid. */
+uint64_t block_pack_bssid(const uint8_t bssid[6]);
+
+/* Builds the zone map of n samples sorted by time. */
+void block_zone_build(const struct wifi_sample *s, size_t n, struct block_zone *z);
+
+/* A zone with no pruning information: everything may match. */
+void block_zone_unknown(struct block_zone *z, uint64_t ts_min, uint64_t ts_max);
+
+/* 0 if no sample in the block can carry this BSSID. */
+int block_zone_may_have_bssid(const struct block_zone *z, const uint8_t bssid[6]);
+
+#endif
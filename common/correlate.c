@@ -0,0 +1,63 @@
+#include <math.h>
+
+#include "correlate.h"
+
+static int snr_band(float snr)
+{
+    if (snr < 10) return 0;
+    int band = 1 + (int)((snr - 10) / 5);
+    return band < SNR_BANDS ? band : SNR_BANDS - 1;
+}
+
+void correlation_add(struct link_correlation *c, const struct wifi_sample *s, float snr)
+{
+    if (!(s->fields & FIELD_LINK_RATES)) return;
+
+    double tput = (double)s->rx_bytes_per_s + s->tx_bytes_per_s;
+    double packets = (double)s->rx_packets_per_s + s->tx_packets_per_s;
+    struct band_stats *b = &c->bands[snr_band(snr)];
+    b->count++;
+    b->throughput_sum += tput;
+    if (packets > 0) {
+        b->error_rate_sum += ((double)s->rx_errors_per_s + s->tx_errors_per_s) / packets;
+        b->error_samples++;
+    }
+
+    c->n++;
+    double dx = snr - c->mean_snr;
+    double dy = tput - c->mean_tput;
+    c->mean_snr += dx / (double)c->n;
+    c->mean_tput += dy / (double)c->n;
+    c->m2_snr += dx * (snr - c->mean_snr);
+    c->m2_tput += dy * (tput - c->mean_tput);
+    c->co_moment += dx * (tput - c->mean_tput);
+}
+
+double correlation_pearson(const struct link_correlation *c)
+{
+    if (c->n < 2 || c->m2_snr <= 0 || c->m2_tput <= 0) return 0;
+    return c->co_moment / sqrt(c->m2_snr * c->m2_tput);
+}
+
+void correlation_report(const struct link_correlation *c, FILE *out)
+{
+    if (c->n == 0) return;
+
+    fprintf(out, "%-10s | %8s | %12s | %12s\n", "SNR band", "Samples", "Avg kB/s", "Err/packet");
+    fprintf(out, "--------------------------------------------------\n");
+    for (int i = 0; i < SNR_BANDS; i++) {
+        const struct band_stats *b = &c->bands[i];
+        if (b->count == 0) continue;
+
+        char label[16];
+        if (i == 0) snprintf(label, sizeof(label), "< 10 dB");
+        else if (i == SNR_BANDS - 1) snprintf(label, sizeof(label), ">= %d dB", 5 * i + 5);
+        else snprintf(label, sizeof(label), "%d-%d dB", 5 * i + 5, 5 * i + 10);
+
+        double err = b->error_samples ? b->error_rate_sum / (double)b->error_samples : 0;
+        fprintf(out, "%-10s | %8llu | %12.1f | %12.5f\n", label, (unsigned long long)b->count,
+                b->throughput_sum / (double)b->count / 1e3, err);
+    }
+    fprintf(out, "SNR/throughput correlation r = %.3f over %llu samples\n",
+            correlation_pearson(c), (unsigned long long)c->n);
+}
@@ -0,0 +1,34 @@
+#ifndef SNR_CORRELATE_H
+#define SNR_CORRELATE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sample.h"
+
+/* Band 0 is below 10 dB SNR, then 5 dB steps up to band 7 at 40 dB and above. */
+#define SNR_BANDS 8
+
+struct band_stats {
+    uint64_t count;
+    double throughput_sum;      /* rx + tx bytes/s */
+    double error_rate_sum;      /* errors per packet */
+    uint64_t error_samples;     /* samples that moved any packets */
+};
+
+/*
+ * Running SNR-versus-utilisation summary. Each sample updates its band and
+ * a Welford co-moment for the SNR/throughput correlation, so the report is
+ * available at any point without keeping the samples.
+ */
+struct link_correlation {
+    struct band_stats bands[SNR_BANDS];
+    uint64_t n;
+    double mean_snr, mean_tput;
+    double m2_snr, m2_tput, co_moment;
+};
+
+void correlation_add(struct link_correlation *c, const struct wifi_sample *s, float snr);
+double correlation_pearson(const struct link_correlation *c);
+void correlation_report(const struct link_correlation *c, FILE *out);
+
+#endif
@@ -0,0 +1,103 @@
+#include "health.h"
+
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+const struct health_weights health_default_weights = HEALTH_DEFAULT_WEIGHTS;
+
+#if defined(__SSE2__) || defined(_M_X64)
+/* Clamps to [0, 1] like health_clamp01: MAXPS and MINPS return their second operand for NaN. */
+static inline __m128 clamp01_ps(__m128 x)
+{
+    return _mm_min_ps(_mm_set1_ps(1.0f), _mm_max_ps(_mm_setzero_ps(), x));
+}
+#endif
+
+/*
+ * The compiler leaves the scalar loop alone without -ffast-math (the
+ * selects could trap), so it is spelt out: the same operations in the same
+ * order as health_score_inline, with compares and masks for the selects.
+ */
+void health_score_batch(const struct health_weights *w, const struct health_columns *c,
+                        float *out, size_t n)
+{
+    struct health_spans sp;
+    health_spans(w, &sp);
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 wsnr = _mm_set1_ps(w->snr), wrate = _mm_set1_ps(w->bitrate);
+    const __m128 wretry = _mm_set1_ps(w->retries), wbeacon = _mm_set1_ps(w->beacon_loss);
+    const __m128 floor = _mm_set1_ps(w->snr_floor_db), ssnr = _mm_set1_ps(sp.snr);
+    const __m128 srate = _mm_set1_ps(sp.rate), sretry = _mm_set1_ps(sp.retry), sbeacon = _mm_set1_ps(sp.beacon);
+    for (; i + 4 <= n; i += 4) {
+        __m128 snr = _mm_loadu_ps(c->snr_db + i), rate = _mm_loadu_ps(c->bitrate_mbps + i);
+        __m128 retry = _mm_loadu_ps(c->retry_ratio + i), beacon = _mm_loadu_ps(c->beacon_losses + i);
+        __m128 w_rate = _mm_and_ps(_mm_cmpge_ps(rate, zero), wrate);
+        __m128 w_retry = _mm_and_ps(_mm_cmpge_ps(retry, zero), wretry);
+        __m128 w_beacon = _mm_and_ps(_mm_cmpge_ps(beacon, zero), wbeacon);
+
+        __m128 sum = _mm_mul_ps(wsnr, clamp01_ps(_mm_mul_ps(_mm_sub_ps(snr, floor), ssnr)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(w_rate, clamp01_ps(_mm_mul_ps(rate, srate))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(w_retry, _mm_sub_ps(one, clamp01_ps(_mm_mul_ps(retry, sretry)))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(w_beacon, _mm_sub_ps(one, clamp01_ps(_mm_mul_ps(beacon, sbeacon)))));
+        __m128 total = _mm_add_ps(_mm_add_ps(_mm_add_ps(wsnr, w_rate), w_retry), w_beacon);
+
+        __m128 positive = _mm_cmpgt_ps(total, zero);
+        __m128 score = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(100.0f), sum), _mm_or_ps(_mm_and_ps(positive, total),
+                                                                                 _mm_andnot_ps(positive, one)));
+        _mm_storeu_ps(out + i, _mm_and_ps(positive, score));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = health_score_inline(w, &sp, c->snr_db[i], c->bitrate_mbps[i], c->retry_ratio[i],
+                                     c->beacon_losses[i]);
+    }
+}
+
+float health_score(const struct health_weights *w, float snr_db, float bitrate_mbps,
+                   float retry_ratio, float beacon_losses)
+{
+    struct health_spans sp;
+    health_spans(w, &sp);
+    return health_score_inline(w, &sp, snr_db, bitrate_mbps, retry_ratio, beacon_losses);
+}
+
+int health_parse_weights(const char *arg, struct health_weights *w)
+{
+    float *slots[] = { &w->snr, &w->bitrate, &w->retries, &w->beacon_loss };
+    char *end;
+    for (size_t i = 0; i < sizeof(slots) / sizeof(slots[0]) && *arg; i++) {
+        float v = strtof(arg, &end);
+        if (end == arg || v < 0) return 0;
+        *slots[i] = v;
+        arg = *end == ',' ? end + 1 : end;
+    }
+    return *arg == '\0' && w->snr + w->bitrate + w->retries + w->beacon_loss > 0;
+}
+
+const char *health_class(float score)
+{
+    static const char *const names[HEALTH_CLASSES] = { "GOOD", "FAIR", "DEGRADED", "POOR" };
+    return names[health_class_index(score)];
+}
+
+void health_update(const struct health_weights *w, struct health_tracker *t,
+                   struct wifi_sample *s)
+{
+    float retry, beacon, rate = -1.0f;
+    health_track(t, s, &retry, &beacon);
+
+    uint32_t rates = s->fields & (FIELD_RX_BITRATE | FIELD_TX_BITRATE);
+    if (rates == (FIELD_RX_BITRATE | FIELD_TX_BITRATE)) {
+        rate = (s->rx_bitrate_kbps + s->tx_bitrate_kbps) / 2000.0f;
+    } else if (rates) {
+        rate = (s->rx_bitrate_kbps + s->tx_bitrate_kbps) / 1000.0f;
+    }
+
+    s->health = health_score(w, sample_snr(s), rate, retry, beacon);
+    s->fields |= FIELD_HEALTH;
+}
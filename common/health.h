@@ -0,0 +1,162 @@
+#ifndef SNR_HEALTH_H
+#define SNR_HEALTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "sample.h"
+
+/*
+ * Link-health index, 0 (unusable) to 100 (ideal). Each metric is
+ * normalised to 0..1 between its floor and ceiling, then combined by
+ * weight. Missing metrics drop out of the weighted mean rather than
+ * counting as perfect or as zero.
+ */
+struct health_weights {
+    float snr;
+    float bitrate;
+    float retries;
+    float beacon_loss;
+    float snr_floor_db;         /* component is 0 at or below this SNR */
+    float snr_ceil_db;          /* ... and 1 at or above this one */
+    float bitrate_ceil_mbps;    /* mean of rx/tx bitrate that scores 1 */
+    float retry_ceil;           /* retry ratio that scores 0 */
+    float beacon_ceil;          /* beacon losses per sample that score 0 */
+};
+
+#define HEALTH_DEFAULT_WEIGHTS                                                  \
+    {                                                                           \
+        .snr = 0.45f, .bitrate = 0.25f, .retries = 0.20f, .beacon_loss = 0.10f, \
+        .snr_floor_db = 5.0f, .snr_ceil_db = 40.0f, .bitrate_ceil_mbps = 400.0f, \
+        .retry_ceil = 0.5f, .beacon_ceil = 2.0f,                                \
+    }
+
+extern const struct health_weights health_default_weights;
+
+/* Structure-of-arrays inputs; a negative value marks a missing metric. */
+struct health_columns {
+    const float *snr_db;
+    const float *bitrate_mbps;
+    const float *retry_ratio;
+    const float *beacon_losses;
+};
+
+/*
+ * Four samples at a time with SSE2 where there is SSE2, equal to
+ * health_score on each sample to the bit. Bulk paths such as --import use it.
+ */
+void health_score_batch(const struct health_weights *w, const struct health_columns *c,
+                        float *out, size_t n);
+
+float health_score(const struct health_weights *w, float snr_db, float bitrate_mbps,
+                   float retry_ratio, float beacon_losses);
+
+/* Reciprocals of each metric's range, hoisted out of per-sample loops. */
+struct health_spans {
+    float snr, rate, retry, beacon;
+};
+
+static inline void health_spans(const struct health_weights *w, struct health_spans *sp)
+{
+    sp->snr = 1.0f / (w->snr_ceil_db - w->snr_floor_db);
+    sp->rate = 1.0f / w->bitrate_ceil_mbps;
+    sp->retry = 1.0f / w->retry_ceil;
+    sp->beacon = 1.0f / w->beacon_ceil;
+}
+
+static inline float health_clamp01(float x)
+{
+    x = x < 0.0f ? 0.0f : x;
+    return x > 1.0f ? 1.0f : x;
+}
+
+/*
+ * The score of one sample; what health_score_batch computes per element.
+ * Inline so that a caller with constant weights gets them folded in.
+ */
+static inline float health_score_inline(const struct health_weights *w, const struct health_spans *sp,
+                                        float snr, float rate, float retry, float beacon)
+{
+    float w_rate = rate >= 0.0f ? w->bitrate : 0.0f;
+    float w_retry = retry >= 0.0f ? w->retries : 0.0f;
+    float w_beacon = beacon >= 0.0f ? w->beacon_loss : 0.0f;
+
+    float sum = w->snr * health_clamp01((snr - w->snr_floor_db) * sp->snr)
+              + w_rate * health_clamp01(rate * sp->rate)
+              + w_retry * (1.0f - health_clamp01(retry * sp->retry))
+              + w_beacon * (1.0f - health_clamp01(beacon * sp->beacon));
+    float total = w->snr + w_rate + w_retry + w_beacon;
+    return total > 0.0f ? 100.0f * sum / total : 0.0f;
+}
+
+/* "SNR,BITRATE,RETRIES,BEACON"; omitted trailing weights keep their values. */
+int health_parse_weights(const char *arg, struct health_weights *w);
+
+/* GOOD, FAIR, DEGRADED, POOR: a class's lowest score, for all but the last. */
+#define HEALTH_CLASSES 4
+static const float health_class_min[HEALTH_CLASSES - 1] = { 80.0f, 60.0f, 40.0f };
+
+/* health_class's index. Counting the thresholds above the score needs no branch; NaN is POOR. */
+static inline int health_class_index(float score)
+{
+    int cls = 0;
+    for (int i = 0; i < HEALTH_CLASSES - 1; i++) cls += !(score >= health_class_min[i]);
+    return cls;
+}
+
+const char *health_class(float score);
+
+/*
+ * nl80211 reports retries, packets and beacon losses as running totals;
+ * the tracker turns consecutive samples into per-interval values
+ * (-1 until two samples with the counters have been seen). The station
+ * restarts its counters on reassociation and roaming, so a counter that
+ * goes down or a new BSSID starts over from that sample rather than
+ * reading as four billion losses.
+ */
+struct health_tracker {
+    uint32_t tx_retries;
+    uint32_t tx_packets;
+    uint32_t beacon_loss;
+    uint8_t bssid[6];
+    int have_bssid;
+    int primed;
+};
+
+static inline void health_track(struct health_tracker *t, const struct wifi_sample *s,
+                                float *retry_ratio, float *beacon_losses)
+{
+    const uint32_t counters = FIELD_TX_RETRIES | FIELD_TX_PACKETS | FIELD_BEACON_LOSS;
+    *retry_ratio = -1.0f;
+    *beacon_losses = -1.0f;
+
+    if ((s->fields & counters) != counters) {
+        t->primed = 0;
+        return;
+    }
+    int have_bssid = (s->fields & FIELD_BSSID) != 0;
+    int same_link = have_bssid == t->have_bssid && (!have_bssid || memcmp(s->bssid, t->bssid, 6) == 0);
+    if (t->primed && same_link && s->tx_retries >= t->tx_retries && s->tx_packets >= t->tx_packets &&
+        s->beacon_loss >= t->beacon_loss) {
+        uint32_t retries = s->tx_retries - t->tx_retries;
+        uint32_t packets = s->tx_packets - t->tx_packets;
+        if (packets + retries > 0) *retry_ratio = (float)retries / ((float)packets + (float)retries);
+        *beacon_losses = (float)(s->beacon_loss - t->beacon_loss);
+    }
+    t->tx_retries = s->tx_retries;
+    t->tx_packets = s->tx_packets;
+    t->beacon_loss = s->beacon_loss;
+    if (have_bssid) memcpy(t->bssid, s->bssid, 6);
+    t->have_bssid = have_bssid;
+    t->primed = 1;
+}
+
+/* What health_update reads. A sample without some of them is scored on the rest. */
+#define HEALTH_FIELDS (FIELD_SIGNAL | FIELD_RX_BITRATE | FIELD_TX_BITRATE | FIELD_TX_RETRIES | FIELD_TX_PACKETS | \
+                       FIELD_BEACON_LOSS)
+
+/* Scores one sample in place: sets s->health and FIELD_HEALTH. */
+void health_update(const struct health_weights *w, struct health_tracker *t,
+                   struct wifi_sample *s);
+
+#endif
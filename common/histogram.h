@@ -0,0 +1,95 @@
+#ifndef SNR_HISTOGRAM_H
+#define SNR_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+ * Log-linear latency histogram: each power of two is split into
+ * 2^HIST_SUB_BITS buckets, so any recorded value is known to within 12.5%.
+ * Recording is a bit scan and an increment; no allocation.
+ */
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS (64u * HIST_SUB)
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+static inline unsigned hist_msb(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return (unsigned)i;
+#else
+    return 63u - (unsigned)__builtin_clzll(v);
+#endif
+}
+
+static inline unsigned hist_bucket(uint64_t v)
+{
+    if (v < HIST_SUB) return (unsigned)v;
+    unsigned shift = hist_msb(v) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (unsigned)((v >> shift) & (HIST_SUB - 1));
+}
+
+/* Smallest value that maps to bucket b. */
+static inline uint64_t hist_bucket_floor(unsigned b)
+{
+    if (b < HIST_SUB) return b;
+    unsigned shift = (b >> HIST_SUB_BITS) - 1;
+    return (uint64_t)(HIST_SUB + (b & (HIST_SUB - 1))) << shift;
+}
+
+static inline void hist_reset(struct histogram *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+static inline void hist_record(struct histogram *h, uint64_t v)
+{
+    h->buckets[hist_bucket(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hist_merge(struct histogram *dst, const struct histogram *src)
+{
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/* Upper edge of the bucket holding quantile q (0..1), capped at max. */
+static inline uint64_t hist_quantile(const struct histogram *h, double q)
+{
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)h->count + 0.5), seen = 0;
+    if (rank == 0) rank = 1;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t edge = i + 1 < HIST_BUCKETS ? hist_bucket_floor(i + 1) - 1 : h->max;
+            return edge < h->max ? edge : h->max;
+        }
+    }
+    return h->max;
+}
+
+static inline double hist_mean(const struct histogram *h)
+{
+    return h->count ? (double)h->sum / (double)h->count : 0.0;
+}
+
+#endif
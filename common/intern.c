@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define INTERN_EMPTY 0x80
+#define INTERN_GROUP 8
+#define ARENA_CHUNK 65536
+#define LSB 0x0101010101010101ull
+#define MSB 0x8080808080808080ull
+
+struct intern intern_global;
+
+static uint64_t hash_bytes(const char *s, size_t len)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+    for (; len >= 8; s += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 31;
+    }
+    uint64_t w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ w) * 0x94d049bb133111ebull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return h ^ (h >> 32);
+}
+
+/* Eight control bytes with byte i in bits 8i..8i+7, whatever the host byte order. */
+static uint64_t load_group(const uint8_t *ctrl)
+{
+    uint64_t g = 0;
+    for (int i = INTERN_GROUP - 1; i >= 0; i--) g = g << 8 | ctrl[i];
+    return g;
+}
+
+/* High bit set in each byte of g equal to b; may also flag a byte above a real match, so callers verify. */
+static uint64_t match_byte(uint64_t g, uint8_t b)
+{
+    uint64_t x = g ^ (LSB * b);
+    return (x - LSB) & ~x & MSB;
+}
+
+static unsigned lowest_byte(uint64_t bits)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, bits);
+    return (unsigned)i / 8;
+#else
+    return (unsigned)__builtin_ctzll(bits) / 8;
+#endif
+}
+
+/* The arena copy of id: a length byte, then the string and its NUL. */
+static const char *entry(const struct intern *t, uint32_t id)
+{
+    const char **page = id ? t->pages[id / INTERN_PAGE_IDS] : NULL;
+    return page ? page[id % INTERN_PAGE_IDS] : NULL;
+}
+
+const char *intern_str(const struct intern *t, uint32_t id)
+{
+    const char *e = entry(t, id);
+    return e ? e + 1 : NULL;
+}
+
+size_t intern_len(const struct intern *t, uint32_t id)
+{
+    const char *e = entry(t, id);
+    return e ? (uint8_t)e[0] : 0;
+}
+
+/*
+ * Walks the groups of h's probe sequence. Returns the slot holding s, or
+ * the first empty slot with *found = 0. The table always keeps an empty
+ * slot, so the walk ends.
+ */
+static size_t probe(const struct intern *t, const char *s, size_t len, uint64_t h, int *found)
+{
+    size_t groups = t->cap / INTERN_GROUP, g = (size_t)(h >> 7) & (groups - 1);
+    uint8_t tag = (uint8_t)(h & 0x7f);
+    for (size_t step = 1;; g = (g + step++) & (groups - 1)) {
+        const uint8_t *ctrl = t->ctrl + g * INTERN_GROUP;
+        uint64_t group = load_group(ctrl);
+        for (uint64_t m = match_byte(group, tag); m; m &= m - 1) {
+            size_t slot = g * INTERN_GROUP + lowest_byte(m);
+            if (ctrl[slot % INTERN_GROUP] != tag) continue;
+            const char *e = entry(t, t->slots[slot]);
+            if ((uint8_t)e[0] == len && memcmp(e + 1, s, len) == 0) {
+                *found = 1;
+                return slot;
+            }
+        }
+        uint64_t empty = group & MSB;
+        if (empty) {
+            *found = 0;
+            return g * INTERN_GROUP + lowest_byte(empty);
+        }
+    }
+}
+
+uint32_t intern_find(const struct intern *t, const char *s, size_t len)
+{
+    int found;
+    if (!t->cap || len > INTERN_MAX_LEN) return 0;
+    size_t slot = probe(t, s, len, hash_bytes(s, len), &found);
+    return found ? t->slots[slot] : 0;
+}
+
+static int grow(struct intern *t)
+{
+    size_t cap = t->cap ? t->cap * 2 : 16;
+    uint8_t *ctrl = malloc(cap);
+    uint32_t *slots = malloc(cap * sizeof(*slots));
+    if (!ctrl || !slots) {
+        free(ctrl);
+        free(slots);
+        return 0;
+    }
+    memset(ctrl, INTERN_EMPTY, cap);
+    free(t->ctrl);
+    free(t->slots);
+    t->ctrl = ctrl;
+    t->slots = slots;
+    t->cap = cap;
+    for (uint32_t id = 1; id <= t->count; id++) {
+        const char *e = entry(t, id);
+        size_t len = (uint8_t)e[0];
+        uint64_t h = hash_bytes(e + 1, len);
+        int found;
+        size_t slot = probe(t, e + 1, len, h, &found);
+        t->ctrl[slot] = (uint8_t)(h & 0x7f);
+        t->slots[slot] = id;
+    }
+    return 1;
+}
+
+/* Copies s into the arena as an entry; it never moves. */
+static const char *arena_copy(struct intern *t, const char *s, size_t len)
+{
+    if (!t->arena || t->arena_used + len + 2 > t->arena_cap) {
+        char *chunk = malloc(ARENA_CHUNK);
+        if (!chunk) return NULL;
+        memcpy(chunk, &t->arena, sizeof(t->arena));
+        t->arena = chunk;
+        t->arena_used = sizeof(t->arena);
+        t->arena_cap = ARENA_CHUNK;
+    }
+    char *p = t->arena + t->arena_used;
+    p[0] = (char)len;
+    memcpy(p + 1, s, len);
+    p[len + 1] = '\0';
+    t->arena_used += len + 2;
+    return p;
+}
+
+uint32_t intern_put(struct intern *t, const char *s, size_t len)
+{
+    if (len > INTERN_MAX_LEN) return 0;
+    uint64_t h = hash_bytes(s, len);
+    int found;
+    if (t->cap) {
+        size_t slot = probe(t, s, len, h, &found);
+        if (found) return t->slots[slot];
+    }
+
+    uint32_t id = t->count + 1;
+    if (id >= (uint32_t)INTERN_PAGE_IDS * INTERN_PAGES) return 0;
+    /* Keep the load at 7/8 or under. */
+    if ((size_t)id * 8 > t->cap * 7 && !grow(t)) return 0;
+    const char ***page = &t->pages[id / INTERN_PAGE_IDS];
+    if (!*page && !(*page = calloc(INTERN_PAGE_IDS, sizeof(**page)))) return 0;
+    const char *copy = arena_copy(t, s, len);
+    if (!copy) return 0;
+
+    size_t slot = probe(t, s, len, h, &found);
+    t->ctrl[slot] = (uint8_t)(h & 0x7f);
+    t->slots[slot] = id;
+    (*page)[id % INTERN_PAGE_IDS] = copy;
+    t->count = id;
+    return id;
+}
+
+void intern_free(struct intern *t)
+{
+    while (t->arena) {
+        char *prev;
+        memcpy(&prev, t->arena, sizeof(prev));
+        free(t->arena);
+        t->arena = prev;
+    }
+    for (size_t i = 0; i < INTERN_PAGES; i++) free((void *)t->pages[i]);
+    free(t->ctrl);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,52 @@
+#ifndef SNR_INTERN_H
+#define SNR_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * String interning: each distinct string gets a dense 32-bit ID, starting
+ * at 1, that stays valid for the life of the table. Samples carry these IDs
+ * for SSIDs and interface names instead of copies of the strings.
+ *
+ * Lookup by string goes through an open-addressing table in the style of
+ * a Swiss table. Each slot has a control byte holding seven bits of the
+ * hash, and eight control bytes are compared at once. Lookup by ID is two
+ * array loads. Strings live in arena chunks that never move, and the
+ * ID-to-string pages are never reallocated. A reader that got an ID
+ * through any synchronised hand-off can therefore call intern_str without
+ * a lock. Only one thread may add strings at a time.
+ *
+ * A zero-filled table is empty and ready to use.
+ */
+
+#define INTERN_MAX_LEN 255
+#define INTERN_PAGE_IDS 1024
+#define INTERN_PAGES 1024       /* at most INTERN_PAGE_IDS * INTERN_PAGES - 1 strings */
+
+struct intern {
+    uint8_t *ctrl;              /* cap control bytes: INTERN_EMPTY or seven hash bits */
+    uint32_t *slots;            /* ID in each full slot */
+    size_t cap;
+    uint32_t count;             /* IDs handed out */
+    char *arena;                /* current chunk; each links to the one before */
+    size_t arena_used, arena_cap;
+    const char **pages[INTERN_PAGES];
+};
+
+/* The process-wide table: SSIDs and interface names seen by this process. */
+extern struct intern intern_global;
+
+/* The ID of s[0..len), adding it if new; 0 if it is too long or memory ran out. */
+uint32_t intern_put(struct intern *t, const char *s, size_t len);
+
+/* The ID of s[0..len), or 0 if it was never added. */
+uint32_t intern_find(const struct intern *t, const char *s, size_t len);
+
+/* The NUL-terminated string of id, or NULL for 0 and unknown IDs. */
+const char *intern_str(const struct intern *t, uint32_t id);
+size_t intern_len(const struct intern *t, uint32_t id);
+
+void intern_free(struct intern *t);
+
+#endif
@@ -0,0 +1,455 @@
+#include <math.h>
+#include <string.h>
+
+#include "kernel.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KERNEL_HAVE_AVX2 1
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#endif
+
+static inline unsigned popcount64(uint64_t v)
+{
+#ifdef _MSC_VER
+    return (unsigned)__popcnt64(v);
+#else
+    return (unsigned)__builtin_popcountll(v);
+#endif
+}
+
+static inline unsigned lowest_bit(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctzll(v);
+#endif
+}
+
+void kernel_mask_all(uint64_t *mask, size_t n)
+{
+    size_t words = KERNEL_MASK_WORDS(n);
+    memset(mask, 0xff, words * sizeof(*mask));
+    if (n % 64) mask[words - 1] = (1ull << (n % 64)) - 1;
+}
+
+void kernel_mask_and(uint64_t *mask, const uint64_t *other, size_t n)
+{
+    for (size_t w = 0; w < KERNEL_MASK_WORDS(n); w++) mask[w] &= other[w];
+}
+
+size_t kernel_count(const uint64_t *mask, size_t n)
+{
+    size_t count = 0;
+    for (size_t w = 0; w < KERNEL_MASK_WORDS(n); w++) count += popcount64(mask[w]);
+    return count;
+}
+
+void kernel_agg_init(struct kernel_agg *a)
+{
+    a->count = 0;
+    a->sum = 0;
+    a->min = INFINITY;
+    a->max = -INFINITY;
+}
+
+/* ANDs pred, an expression of row i, into every mask word. */
+#define FILTER_WORDS(n, mask, pred) \
+    for (size_t w = 0; w < KERNEL_MASK_WORDS(n); w++) { \
+        size_t base = w * 64, rows = n - base < 64 ? n - base : 64; \
+        uint64_t bits = 0; \
+        for (size_t j = 0; j < rows; j++) { \
+            size_t i = base + j; \
+            bits |= (uint64_t)(pred) << j; \
+        } \
+        mask[w] &= bits; \
+    }
+
+/* Runs body with i set to each selected row, in order. */
+#define FOR_SELECTED(mask, n, body) \
+    for (size_t w = 0; w < KERNEL_MASK_WORDS(n); w++) { \
+        for (uint64_t bits = mask[w]; bits; bits &= bits - 1) { \
+            size_t i = w * 64 + lowest_bit(bits); \
+            body; \
+        } \
+    }
+
+static void scalar_range_i8(const int8_t *col, size_t n, int lo, int hi, uint64_t *mask)
+{
+    FILTER_WORDS(n, mask, col[i] >= lo && col[i] <= hi)
+}
+
+static void scalar_range_u64(const uint64_t *col, size_t n, uint64_t lo, uint64_t hi, uint64_t *mask)
+{
+    FILTER_WORDS(n, mask, col[i] >= lo && col[i] < hi)
+}
+
+static void scalar_eq_u64(const uint64_t *col, size_t n, uint64_t v, uint64_t *mask)
+{
+    FILTER_WORDS(n, mask, col[i] == v)
+}
+
+static void scalar_bits_u32(const uint32_t *col, size_t n, uint32_t set, uint32_t clear, uint64_t *mask)
+{
+    FILTER_WORDS(n, mask, (col[i] & set) == set && !(col[i] & clear))
+}
+
+static size_t scalar_select(const uint64_t *mask, size_t n, uint32_t *out)
+{
+    size_t k = 0;
+    FOR_SELECTED(mask, n, out[k++] = (uint32_t)i)
+    return k;
+}
+
+static size_t scalar_compress_f32(const float *col, const uint64_t *mask, size_t n, float *out)
+{
+    size_t k = 0;
+    FOR_SELECTED(mask, n, out[k++] = col[i])
+    return k;
+}
+
+static void scalar_agg_i8(const int8_t *col, const uint64_t *mask, size_t n, struct kernel_agg *a)
+{
+    int64_t sum = 0;
+    int lo = INT8_MAX, hi = INT8_MIN;
+    uint64_t count = 0;
+    FOR_SELECTED(mask, n, {
+        sum += col[i];
+        lo = col[i] < lo ? col[i] : lo;
+        hi = col[i] > hi ? col[i] : hi;
+        count++;
+    })
+    if (!count) return;
+    a->count += count;
+    a->sum += (double)sum;
+    if (lo < a->min) a->min = (float)lo;
+    if (hi > a->max) a->max = (float)hi;
+}
+
+static void scalar_agg_f32(const float *col, const uint64_t *mask, size_t n, struct kernel_agg *a)
+{
+    FOR_SELECTED(mask, n, {
+        a->sum += col[i];
+        a->min = col[i] < a->min ? col[i] : a->min;
+        a->max = col[i] > a->max ? col[i] : a->max;
+        a->count++;
+    })
+}
+
+static void scalar_hist_i8(const int8_t *col, const uint64_t *mask, size_t n, int lo, unsigned nbuckets,
+                           uint64_t *counts)
+{
+    int last = (int)nbuckets - 1;
+    FOR_SELECTED(mask, n, {
+        int b = col[i] - lo;
+        counts[b < 0 ? 0 : b > last ? last : b]++;
+    })
+}
+
+const struct kernel_ops kernel_scalar = {
+    .name = "scalar",
+    .range_i8 = scalar_range_i8,
+    .range_u64 = scalar_range_u64,
+    .eq_u64 = scalar_eq_u64,
+    .bits_u32 = scalar_bits_u32,
+    .select = scalar_select,
+    .compress_f32 = scalar_compress_f32,
+    .agg_i8 = scalar_agg_i8,
+    .agg_f32 = scalar_agg_f32,
+    .hist_i8 = scalar_hist_i8,
+};
+
+#ifdef KERNEL_HAVE_AVX2
+
+/*
+ * The AVX2 kernels handle whole vectors of rows and leave the remainder
+ * to scalar code, so they never read a column past n.
+ */
+
+AVX2 static void avx2_range_i8(const int8_t *col, size_t n, int lo, int hi, uint64_t *mask)
+{
+    lo = lo < INT8_MIN ? INT8_MIN : lo;
+    hi = hi > INT8_MAX ? INT8_MAX : hi;
+    if (lo > hi) {
+        memset(mask, 0, KERNEL_MASK_WORDS(n) * sizeof(*mask));
+        return;
+    }
+    const __m256i vlo = _mm256_set1_epi8((char)lo), vhi = _mm256_set1_epi8((char)hi);
+    size_t full = n / 64;
+    for (size_t w = 0; w < full; w++) {
+        uint64_t bits = 0;
+        for (int half = 0; half < 2; half++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(col + w * 64 + half * 32));
+            __m256i out = _mm256_or_si256(_mm256_cmpgt_epi8(vlo, v), _mm256_cmpgt_epi8(v, vhi));
+            bits |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(out) << (half * 32);
+        }
+        mask[w] &= bits;
+    }
+    scalar_range_i8(col + full * 64, n - full * 64, lo, hi, mask + full);
+}
+
+AVX2 static void avx2_range_u64(const uint64_t *col, size_t n, uint64_t lo, uint64_t hi, uint64_t *mask)
+{
+    /* Flipping the sign bit turns the unsigned comparison into a signed one. */
+    const __m256i flip = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+    const __m256i vlo = _mm256_xor_si256(_mm256_set1_epi64x((long long)lo), flip);
+    const __m256i vhi = _mm256_xor_si256(_mm256_set1_epi64x((long long)hi), flip);
+    size_t full = n / 64;
+    for (size_t w = 0; w < full; w++) {
+        uint64_t bits = 0;
+        for (int q = 0; q < 16; q++) {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(col + w * 64 + q * 4)), flip);
+            __m256i in = _mm256_andnot_si256(_mm256_cmpgt_epi64(vlo, v), _mm256_cmpgt_epi64(vhi, v));
+            bits |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(in)) << (q * 4);
+        }
+        mask[w] &= bits;
+    }
+    scalar_range_u64(col + full * 64, n - full * 64, lo, hi, mask + full);
+}
+
+AVX2 static void avx2_eq_u64(const uint64_t *col, size_t n, uint64_t v, uint64_t *mask)
+{
+    const __m256i want = _mm256_set1_epi64x((long long)v);
+    size_t full = n / 64;
+    for (size_t w = 0; w < full; w++) {
+        uint64_t bits = 0;
+        for (int q = 0; q < 16; q++) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(col + w * 64 + q * 4));
+            bits |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, want))) << (q * 4);
+        }
+        mask[w] &= bits;
+    }
+    scalar_eq_u64(col + full * 64, n - full * 64, v, mask + full);
+}
+
+AVX2 static void avx2_bits_u32(const uint32_t *col, size_t n, uint32_t set, uint32_t clear, uint64_t *mask)
+{
+    const __m256i vset = _mm256_set1_epi32((int)set), vclear = _mm256_set1_epi32((int)clear);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t full = n / 64;
+    for (size_t w = 0; w < full; w++) {
+        uint64_t bits = 0;
+        for (int q = 0; q < 8; q++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(col + w * 64 + q * 8));
+            __m256i in = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(v, vset), vset),
+                                          _mm256_cmpeq_epi32(_mm256_and_si256(v, vclear), zero));
+            bits |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(in)) << (q * 8);
+        }
+        mask[w] &= bits;
+    }
+    scalar_bits_u32(col + full * 64, n - full * 64, set, clear, mask + full);
+}
+
+/* Positions of the set bits of an 8-bit mask, packed into the low lanes. */
+AVX2 static inline __m256i compress_index(unsigned m)
+{
+    uint64_t spread = _pdep_u64(m, 0x0101010101010101ull) * 0xff;
+    uint64_t packed = _pext_u64(0x0706050403020100ull, spread);
+    return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)packed));
+}
+
+AVX2 static size_t avx2_select(const uint64_t *mask, size_t n, uint32_t *out)
+{
+    size_t k = 0;
+    for (size_t w = 0; w < KERNEL_MASK_WORDS(n); w++) {
+        uint64_t bits = mask[w];
+        for (unsigned b = 0; bits; b++, bits >>= 8) {
+            unsigned m = (unsigned)(bits & 0xff);
+            if (!m) continue;
+            __m256i idx = _mm256_add_epi32(compress_index(m), _mm256_set1_epi32((int)(w * 64 + b * 8)));
+            _mm256_storeu_si256((__m256i *)(out + k), idx);
+            k += popcount64(m);
+        }
+    }
+    return k;
+}
+
+AVX2 static size_t avx2_compress_f32(const float *col, const uint64_t *mask, size_t n, float *out)
+{
+    size_t k = 0, full = n / 8;
+    for (size_t g = 0; g < full; g++) {
+        if (g % 8 == 0 && !mask[g / 8]) {
+            g += 7;
+            continue;
+        }
+        unsigned m = (unsigned)(mask[g / 8] >> (g % 8 * 8)) & 0xff;
+        if (!m) continue;
+        __m256 v = _mm256_permutevar8x32_ps(_mm256_loadu_ps(col + g * 8), compress_index(m));
+        _mm256_storeu_ps(out + k, v);
+        k += popcount64(m);
+    }
+    for (size_t i = full * 8; i < n; i++) {
+        if (mask[i / 64] >> (i % 64) & 1) out[k++] = col[i];
+    }
+    return k;
+}
+
+/* Bit i of m as a full byte, for the 32 rows m covers. */
+AVX2 static inline __m256i expand_bytes(uint32_t m)
+{
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bit = _mm256_set1_epi64x((long long)0x8040201008040201ull);
+    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32((int)m), spread);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(v, bit), bit);
+}
+
+/* Bit i of m as a full lane, for the 8 rows m covers. */
+AVX2 static inline __m256i expand_lanes(unsigned m)
+{
+    const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)m), bit), bit);
+}
+
+AVX2 static void avx2_agg_i8(const int8_t *col, const uint64_t *mask, size_t n, struct kernel_agg *a)
+{
+    /* Offset by 128 so _mm256_sad_epu8 sums the bytes. */
+    const __m256i offset = _mm256_set1_epi8((char)0x80);
+    __m256i vmin = _mm256_set1_epi8(INT8_MAX), vmax = _mm256_set1_epi8(INT8_MIN), sum = _mm256_setzero_si256();
+    uint64_t count = 0;
+    size_t full = n / 32;
+    for (size_t g = 0; g < full; g++) {
+        if (g % 2 == 0 && !mask[g / 2]) {
+            g++;
+            continue;
+        }
+        uint32_t m = (uint32_t)(mask[g / 2] >> (g % 2 * 32));
+        if (!m) continue;
+        __m256i sel = expand_bytes(m), v = _mm256_loadu_si256((const __m256i *)(col + g * 32));
+        vmin = _mm256_min_epi8(vmin, _mm256_blendv_epi8(_mm256_set1_epi8(INT8_MAX), v, sel));
+        vmax = _mm256_max_epi8(vmax, _mm256_blendv_epi8(_mm256_set1_epi8(INT8_MIN), v, sel));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_and_si256(_mm256_xor_si256(v, offset), sel),
+                                                    _mm256_setzero_si256()));
+        count += popcount64(m);
+    }
+    if (count) {
+        int8_t lo[32], hi[32];
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lo, vmin);
+        _mm256_storeu_si256((__m256i *)hi, vmax);
+        _mm256_storeu_si256((__m256i *)lanes, sum);
+        int l = INT8_MAX, h = INT8_MIN;
+        for (int i = 0; i < 32; i++) {
+            l = lo[i] < l ? lo[i] : l;
+            h = hi[i] > h ? hi[i] : h;
+        }
+        a->count += count;
+        a->sum += (double)((int64_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) - 128 * (int64_t)count);
+        if (l < a->min) a->min = (float)l;
+        if (h > a->max) a->max = (float)h;
+    }
+    /* The last n % 32 rows, with their mask bits shifted down into a word of their own. */
+    uint64_t tail[1] = { full * 32 < n ? mask[full / 2] >> (full % 2 * 32) : 0 };
+    scalar_agg_i8(col + full * 32, tail, n - full * 32, a);
+}
+
+AVX2 static void avx2_agg_f32(const float *col, const uint64_t *mask, size_t n, struct kernel_agg *a)
+{
+    __m256 vmin = _mm256_set1_ps(INFINITY), vmax = _mm256_set1_ps(-INFINITY);
+    __m256d sum_lo = _mm256_setzero_pd(), sum_hi = _mm256_setzero_pd();
+    uint64_t count = 0;
+    size_t full = n / 8;
+    for (size_t g = 0; g < full; g++) {
+        if (g % 8 == 0 && !mask[g / 8]) {
+            g += 7;
+            continue;
+        }
+        unsigned m = (unsigned)(mask[g / 8] >> (g % 8 * 8)) & 0xff;
+        if (!m) continue;
+        __m256 sel = _mm256_castsi256_ps(expand_lanes(m)), v = _mm256_loadu_ps(col + g * 8);
+        vmin = _mm256_min_ps(vmin, _mm256_blendv_ps(_mm256_set1_ps(INFINITY), v, sel));
+        vmax = _mm256_max_ps(vmax, _mm256_blendv_ps(_mm256_set1_ps(-INFINITY), v, sel));
+        __m256 kept = _mm256_and_ps(v, sel);
+        sum_lo = _mm256_add_pd(sum_lo, _mm256_cvtps_pd(_mm256_castps256_ps128(kept)));
+        sum_hi = _mm256_add_pd(sum_hi, _mm256_cvtps_pd(_mm256_extractf128_ps(kept, 1)));
+        count += popcount64(m);
+    }
+    if (count) {
+        float lo[8], hi[8];
+        double s[4];
+        _mm256_storeu_ps(lo, vmin);
+        _mm256_storeu_ps(hi, vmax);
+        _mm256_storeu_pd(s, _mm256_add_pd(sum_lo, sum_hi));
+        for (int i = 0; i < 8; i++) {
+            a->min = lo[i] < a->min ? lo[i] : a->min;
+            a->max = hi[i] > a->max ? hi[i] : a->max;
+        }
+        a->count += count;
+        a->sum += s[0] + s[1] + s[2] + s[3];
+    }
+    for (size_t i = full * 8; i < n; i++) {
+        if (!(mask[i / 64] >> (i % 64) & 1)) continue;
+        a->sum += col[i];
+        a->min = col[i] < a->min ? col[i] : a->min;
+        a->max = col[i] > a->max ? col[i] : a->max;
+        a->count++;
+    }
+}
+
+AVX2 static void avx2_hist_i8(const int8_t *col, const uint64_t *mask, size_t n, int lo, unsigned nbuckets,
+                              uint64_t *counts)
+{
+    /* Bucket numbers are clamped 16 at a time in 16-bit lanes; only the increments are scalar. */
+    const __m256i vlo = _mm256_set1_epi16((short)lo), last = _mm256_set1_epi16((short)(nbuckets - 1));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t full = n / 16;
+    for (size_t g = 0; g < full; g++) {
+        if (g % 4 == 0 && !mask[g / 4]) {
+            g += 3;
+            continue;
+        }
+        unsigned m = (unsigned)(mask[g / 4] >> (g % 4 * 16)) & 0xffff;
+        if (!m) continue;
+        __m256i v = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(col + g * 16)));
+        __m256i b = _mm256_min_epi16(_mm256_max_epi16(_mm256_sub_epi16(v, vlo), zero), last);
+        uint16_t idx[16];
+        _mm256_storeu_si256((__m256i *)idx, b);
+        for (; m; m &= m - 1) counts[idx[lowest_bit(m)]]++;
+    }
+    int top = (int)nbuckets - 1;
+    for (size_t i = full * 16; i < n; i++) {
+        if (!(mask[i / 64] >> (i % 64) & 1)) continue;
+        int b = col[i] - lo;
+        counts[b < 0 ? 0 : b > top ? top : b]++;
+    }
+}
+
+static const struct kernel_ops kernel_avx2_ops = {
+    .name = "avx2",
+    .range_i8 = avx2_range_i8,
+    .range_u64 = avx2_range_u64,
+    .eq_u64 = avx2_eq_u64,
+    .bits_u32 = avx2_bits_u32,
+    .select = avx2_select,
+    .compress_f32 = avx2_compress_f32,
+    .agg_i8 = avx2_agg_i8,
+    .agg_f32 = avx2_agg_f32,
+    .hist_i8 = avx2_hist_i8,
+};
+
+const struct kernel_ops *kernel_avx2(void)
+{
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") ? &kernel_avx2_ops : NULL;
+}
+
+#else
+
+const struct kernel_ops *kernel_avx2(void)
+{
+    return NULL;
+}
+
+#endif
+
+const struct kernel_ops *kernel_best(void)
+{
+    const struct kernel_ops *k = kernel_avx2();
+    return k ? k : &kernel_scalar;
+}
@@ -0,0 +1,59 @@
+#ifndef SNR_KERNEL_H
+#define SNR_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Filter and aggregate kernels over block_columns. A selection is a
+ * bitmap with bit i%64 of word i/64 standing for row i. Filters compare a
+ * column against a constant and AND the result into the bitmap. select
+ * and compress_f32 turn a bitmap into packed row numbers or values, and
+ * the aggregates fold the selected rows of one column.
+ *
+ * Every kernel exists in portable C and, on x86-64, in AVX2. kernel_best
+ * picks AVX2 when the CPU has it, so no build flags are needed.
+ */
+
+#define KERNEL_MASK_WORDS(n) (((n) + 63) / 64)
+#define KERNEL_SLACK 8          /* select and compress_f32 may store this far past their result */
+
+struct kernel_agg {
+    uint64_t count;
+    double sum;
+    float min, max;             /* INFINITY and -INFINITY before the first row */
+};
+
+struct kernel_ops {
+    const char *name;
+    /* lo <= v <= hi; bounds outside int8 are clamped. */
+    void (*range_i8)(const int8_t *col, size_t n, int lo, int hi, uint64_t *mask);
+    /* lo <= v < hi */
+    void (*range_u64)(const uint64_t *col, size_t n, uint64_t lo, uint64_t hi, uint64_t *mask);
+    void (*eq_u64)(const uint64_t *col, size_t n, uint64_t v, uint64_t *mask);
+    /* Every bit of set present and every bit of clear absent. */
+    void (*bits_u32)(const uint32_t *col, size_t n, uint32_t set, uint32_t clear, uint64_t *mask);
+    /* Selected row numbers into out; returns how many. */
+    size_t (*select)(const uint64_t *mask, size_t n, uint32_t *out);
+    size_t (*compress_f32)(const float *col, const uint64_t *mask, size_t n, float *out);
+    /* Fold the selected rows into a, which kernel_agg_init prepares. */
+    void (*agg_i8)(const int8_t *col, const uint64_t *mask, size_t n, struct kernel_agg *a);
+    void (*agg_f32)(const float *col, const uint64_t *mask, size_t n, struct kernel_agg *a);
+    /* Adds one to counts[v - lo] per selected row, clamping to [0, nbuckets); nbuckets <= 256. */
+    void (*hist_i8)(const int8_t *col, const uint64_t *mask, size_t n, int lo, unsigned nbuckets,
+                    uint64_t *counts);
+};
+
+extern const struct kernel_ops kernel_scalar;
+
+/* The AVX2 kernels, or NULL when this CPU or build cannot run them. */
+const struct kernel_ops *kernel_avx2(void);
+const struct kernel_ops *kernel_best(void);
+
+/* Sets the first n bits and clears the rest of the last word. */
+void kernel_mask_all(uint64_t *mask, size_t n);
+void kernel_mask_and(uint64_t *mask, const uint64_t *other, size_t n);
+size_t kernel_count(const uint64_t *mask, size_t n);
+void kernel_agg_init(struct kernel_agg *a);
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netsh.h"
+
+/* Row labels by locale: en, de, fr, es, ru, ja, ar. SSID and BSSID are not translated. */
+static const struct {
+    const char *text;
+    enum netsh_field field;
+} labels[] = {
+    { "State", NETSH_STATE },
+    { "Status", NETSH_STATE },
+    { "\xc3\x89tat", NETSH_STATE },
+    { "Estado", NETSH_STATE },
+    { "\xd0\xa1\xd0\xbe\xd1\x81\xd1\x82\xd0\xbe\xd1\x8f\xd0\xbd\xd0\xb8\xd0\xb5", NETSH_STATE },
+    { "\xe7\x8a\xb6\xe6\x85\x8b", NETSH_STATE },
+    { "\xd8\xa7\xd9\x84\xd8\xad\xd8\xa7\xd9\x84\xd8\xa9", NETSH_STATE },
+    { "SSID", NETSH_SSID },
+    { "BSSID", NETSH_BSSID },
+    { "AP BSSID", NETSH_BSSID },
+    { "Signal", NETSH_SIGNAL },
+    { "Se\xc3\xb1" "al", NETSH_SIGNAL },
+    { "\xd0\xa1\xd0\xb8\xd0\xb3\xd0\xbd\xd0\xb0\xd0\xbb", NETSH_SIGNAL },
+    { "\xe3\x82\xb7\xe3\x82\xb0\xe3\x83\x8a\xe3\x83\xab", NETSH_SIGNAL },
+    { "\xd8\xa7\xd9\x84\xd8\xa5\xd8\xb4\xd8\xa7\xd8\xb1\xd8\xa9", NETSH_SIGNAL },
+    { "Receive rate", NETSH_RX_RATE },
+    { "Empfangsrate", NETSH_RX_RATE },
+    { "R\xc3\xa9" "ception", NETSH_RX_RATE },
+    { "Velocidad de recepci\xc3\xb3n", NETSH_RX_RATE },
+    { "\xd0\xa1\xd0\xba\xd0\xbe\xd1\x80\xd0\xbe\xd1\x81\xd1\x82\xd1\x8c "
+      "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb5\xd0\xbc\xd0\xb0", NETSH_RX_RATE },
+    { "\xe5\x8f\x97\xe4\xbf\xa1\xe9\x80\x9f\xe5\xba\xa6", NETSH_RX_RATE },
+    { "\xd9\x85\xd8\xb9\xd8\xaf\xd9\x84 "
+      "\xd8\xa7\xd9\x84\xd8\xa7\xd8\xb3\xd8\xaa\xd9\x84\xd8\xa7\xd9\x85", NETSH_RX_RATE },
+    { "Transmit rate", NETSH_TX_RATE },
+    { "\xc3\x9c" "bertragungsrate", NETSH_TX_RATE },
+    { "Transmission", NETSH_TX_RATE },
+    { "Velocidad de transmisi\xc3\xb3n", NETSH_TX_RATE },
+    { "\xd0\xa1\xd0\xba\xd0\xbe\xd1\x80\xd0\xbe\xd1\x81\xd1\x82\xd1\x8c "
+      "\xd0\xbf\xd0\xb5\xd1\x80\xd0\xb5\xd0\xb4\xd0\xb0\xd1\x87\xd0\xb8", NETSH_TX_RATE },
+    { "\xe9\x80\x81\xe4\xbf\xa1\xe9\x80\x9f\xe5\xba\xa6", NETSH_TX_RATE },
+    { "\xd9\x85\xd8\xb9\xd8\xaf\xd9\x84 \xd8\xa7\xd9\x84\xd8\xa5\xd8\xb1\xd8\xb3\xd8\xa7\xd9\x84", NETSH_TX_RATE },
+};
+
+/* State values, same locales. Some disconnected forms contain the connected one, so compare whole values. */
+static const struct {
+    const char *text;
+    enum netsh_state state;
+} states[] = {
+    { "connected", NETSH_STATE_CONNECTED },
+    { "disconnected", NETSH_STATE_DISCONNECTED },
+    { "associating", NETSH_STATE_CONNECTING },
+    { "authenticating", NETSH_STATE_CONNECTING },
+    { "disconnecting", NETSH_STATE_DISCONNECTING },
+    { "verbunden", NETSH_STATE_CONNECTED },
+    { "getrennt", NETSH_STATE_DISCONNECTED },
+    { "connect\xc3\xa9", NETSH_STATE_CONNECTED },
+    { "d\xc3\xa9" "connect\xc3\xa9", NETSH_STATE_DISCONNECTED },
+    { "conectado", NETSH_STATE_CONNECTED },
+    { "desconectado", NETSH_STATE_DISCONNECTED },
+    { "\xd0\xbf\xd0\xbe\xd0\xb4\xd0\xba\xd0\xbb\xd1\x8e\xd1\x87\xd0\xb5\xd0\xbd\xd0\xbe", NETSH_STATE_CONNECTED },
+    { "\xd0\xbe\xd1\x82\xd0\xba\xd0\xbb\xd1\x8e\xd1\x87\xd0\xb5\xd0\xbd\xd0\xbe", NETSH_STATE_DISCONNECTED },
+    { "\xe6\x8e\xa5\xe7\xb6\x9a\xe3\x81\x95\xe3\x82\x8c\xe3\x81\xbe\xe3\x81\x97\xe3\x81\x9f", NETSH_STATE_CONNECTED },
+    { "\xe5\x88\x87\xe6\x96\xad\xe3\x81\x95\xe3\x82\x8c\xe3\x81\xbe\xe3\x81\x97\xe3\x81\x9f",
+      NETSH_STATE_DISCONNECTED },
+    { "\xd9\x85\xd8\xaa\xd8\xb5\xd9\x84", NETSH_STATE_CONNECTED },
+    { "\xd8\xba\xd9\x8a\xd8\xb1 \xd9\x85\xd8\xaa\xd8\xb5\xd9\x84", NETSH_STATE_DISCONNECTED },
+};
+
+#define NLABELS (sizeof(labels) / sizeof(labels[0]))
+
+/*
+ * Node 0 is the root. A transition to 0 means no label continues that
+ * way, since no label is empty. Bytes outside every label share class 0,
+ * whose column is all zeros, and that includes the NUL and the newline.
+ */
+static struct {
+    unsigned nclasses;
+    uint8_t cls[256];
+    uint16_t *next;             /* nodes * nclasses */
+    int8_t *field;              /* label ending at the node, or -1 */
+} ac;
+
+int netsh_init(void)
+{
+    size_t nodes = 1;
+    if (ac.next) return 1;
+    memset(ac.cls, 0, sizeof(ac.cls));
+    ac.nclasses = 1;
+    for (size_t i = 0; i < NLABELS; i++) {
+        for (const unsigned char *c = (const unsigned char *)labels[i].text; *c; c++) {
+            if (!ac.cls[*c]) ac.cls[*c] = (uint8_t)ac.nclasses++;
+            nodes++;
+        }
+    }
+    ac.next = calloc(nodes * ac.nclasses, sizeof(*ac.next));
+    ac.field = malloc(nodes);
+    if (!ac.next || !ac.field) {
+        netsh_free();
+        return 0;
+    }
+    memset(ac.field, -1, nodes);
+
+    uint16_t used = 1;
+    for (size_t i = 0; i < NLABELS; i++) {
+        unsigned s = 0;
+        for (const unsigned char *c = (const unsigned char *)labels[i].text; *c; c++) {
+            uint16_t *t = &ac.next[s * ac.nclasses + ac.cls[*c]];
+            if (!*t) *t = used++;
+            s = *t;
+        }
+        ac.field[s] = (int8_t)labels[i].field;
+    }
+    return 1;
+}
+
+void netsh_free(void)
+{
+    free(ac.next);
+    free(ac.field);
+    ac.next = NULL;
+    ac.field = NULL;
+}
+
+/* After a label: optional "(unit)", then ':'. Sets the trimmed value that follows; 0 if p is not a label's end. */
+static int row_value(const char *p, const char **value, size_t *len)
+{
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '(') {
+        p += strcspn(p, ")\r\n");
+        if (*p++ != ')') return 0;
+        while (*p == ' ' || *p == '\t') p++;
+    }
+    if (*p++ != ':') return 0;
+    while (*p == ' ' || *p == '\t') p++;
+    const char *end = p + strcspn(p, "\r\n");
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *value = p;
+    *len = (size_t)(end - p);
+    return 1;
+}
+
+static int finish(struct netsh_info *info, int found)
+{
+    if (info->value[NETSH_STATE]) info->state = netsh_state_of(info->value[NETSH_STATE], info->len[NETSH_STATE]);
+    return found;
+}
+
+int netsh_parse(const char *output, struct netsh_info *info)
+{
+    memset(info, 0, sizeof(*info));
+    int found = 0;
+    unsigned seen = 0;
+    const char *p = output;
+    while (p && *p && found < NETSH_FIELDS) {
+        while (*p == ' ' || *p == '\t') p++;
+        unsigned s = 0;
+        while ((s = ac.next[s * ac.nclasses + ac.cls[(unsigned char)*p]]) != 0) {
+            p++;
+            int f = ac.field[s];
+            const char *v;
+            size_t len;
+            if (f < 0 || !row_value(p, &v, &len)) continue;
+            /* A field seen twice starts the next interface: report the first one only. */
+            if (seen & (1u << f)) return finish(info, found);
+            seen |= 1u << f;
+            if (len) {
+                info->value[f] = v;
+                info->len[f] = len;
+                found++;
+            }
+            break;
+        }
+        p = strchr(p, '\n');
+        if (p) p++;
+    }
+    return finish(info, found);
+}
+
+enum netsh_state netsh_state_of(const char *value, size_t len)
+{
+    for (size_t i = 0; i < sizeof(states) / sizeof(states[0]); i++) {
+        const char *t = states[i].text;
+        size_t k = 0;
+        for (; k < len && t[k]; k++) {
+            char c = value[k];
+            if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+            if (c != t[k]) break;
+        }
+        if (k == len && !t[k]) return states[i].state;
+    }
+    return NETSH_STATE_UNKNOWN;
+}
+
+/* The field's value NUL-terminated in buf, or NULL if missing or too long. */
+static const char *field_text(const struct netsh_info *info, enum netsh_field f, char *buf, size_t size)
+{
+    if (!info->value[f] || info->len[f] >= size) return NULL;
+    memcpy(buf, info->value[f], info->len[f]);
+    buf[info->len[f]] = '\0';
+    return buf;
+}
+
+int netsh_signal_pct(const struct netsh_info *info)
+{
+    char buf[16], *end;
+    const char *text = field_text(info, NETSH_SIGNAL, buf, sizeof(buf));
+    if (!text) return -1;
+    long pct = strtol(text, &end, 10);
+    /* French puts a (no-break) space before the '%'. */
+    if (end == text || pct < 0 || pct > 100 || !strchr(end, '%')) return -1;
+    return (int)pct;
+}
+
+unsigned netsh_rate_kbps(const struct netsh_info *info, enum netsh_field field)
+{
+    char buf[24], *end;
+    if (!field_text(info, field, buf, sizeof(buf))) return 0;
+    char *comma = strchr(buf, ',');
+    if (comma) *comma = '.';
+    double mbps = strtod(buf, &end);
+    return end != buf && mbps > 0 && mbps < 4e6 ? (unsigned)(mbps * 1000.0) : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SNR_NETSH_H
+#define SNR_NETSH_H
+
+#include <stddef.h>
+
+/*
+ * Parser for "netsh wlan show interfaces" in any supported display
+ * language. netsh translates its row labels and its State values, but
+ * the layout stays the same in every locale: one "Label : value" row per
+ * line, with the label at the start of the line after indentation.
+ *
+ * The labels of every locale go into one automaton, built by netsh_init
+ * as a table with a row per trie node and a column per byte class.
+ * netsh_parse makes a single pass over the output and costs one table
+ * load per label byte. A label must start its row, so there is nothing to
+ * fall back to on a miss: the rest of the row is skipped. A label must
+ * also be followed by an optional "(unit)" and the ':', so "Status" does
+ * not fire on a longer row name that starts with it.
+ *
+ * Labels and state values are UTF-8. netsh writes in the OEM code page
+ * when its output is a pipe, so windows/poc.c converts before parsing.
+ */
+
+enum netsh_field {
+    NETSH_STATE,
+    NETSH_SSID,
+    NETSH_BSSID,
+    NETSH_SIGNAL,
+    NETSH_RX_RATE,
+    NETSH_TX_RATE,
+    NETSH_FIELDS
+};
+
+enum netsh_state {
+    NETSH_STATE_UNKNOWN,        /* no State row, or a value not in the table */
+    NETSH_STATE_CONNECTED,
+    NETSH_STATE_CONNECTING,     /* associating or authenticating */
+    NETSH_STATE_DISCONNECTING,
+    NETSH_STATE_DISCONNECTED,
+};
+
+struct netsh_info {
+    /* Value of each field's first row, trimmed; points into the output. NULL if absent. */
+    const char *value[NETSH_FIELDS];
+    size_t len[NETSH_FIELDS];
+    enum netsh_state state;
+};
+
+/* Builds the automaton; call once before netsh_parse. Returns 0 if out of memory. */
+int netsh_init(void);
+void netsh_free(void);
+
+/* Fills info from NUL-terminated netsh output; returns how many fields were found. */
+int netsh_parse(const char *output, struct netsh_info *info);
+
+/* A State value in any supported language; ASCII letters compare without case. */
+enum netsh_state netsh_state_of(const char *value, size_t len);
+
+/* "92%" or "92 %"; -1 when the row is missing or malformed. */
+int netsh_signal_pct(const struct netsh_info *info);
+
+/* Rate rows in Mbit/s, with '.' or ',' as the decimal mark, as kbit/s; 0 when missing. */
+unsigned netsh_rate_kbps(const struct netsh_info *info, enum netsh_field field);
+
+#endif
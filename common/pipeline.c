@@ -0,0 +1,15 @@
+#include "pipeline.h"
+
+size_t pipeline_run(const struct pipeline_ops *ops, struct pipeline *p, size_t max)
+{
+    size_t n = 0;
+    struct wifi_sample s;
+    for (; n < max && ops->source(p->source, &s); n++) {
+        struct pipeline_features f;
+        if (!ops->filter(p->cfg, &s)) continue;
+        ops->features(p->cfg, &p->state, &s, &f);
+        int cls = ops->classify(p->cfg, &p->state, &s, &f);
+        ops->sink(p->sink, &s, cls, p->state.edge);
+    }
+    return n;
+}
@@ -0,0 +1,142 @@
+#ifndef SNR_PIPELINE_H
+#define SNR_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "health.h"
+#include "sample.h"
+#include "sink.h"
+
+/*
+ * The per-sample path as five stages. A source yields samples. A filter
+ * drops those that cannot be scored. The feature stage derives SNR, mean
+ * bitrate, retry ratio and beacon losses. The classifier scores the
+ * sample, picks its class and runs the alert hysteresis. A sink takes
+ * the result.
+ *
+ * PIPELINE_DEFINE stitches five stage functions and a configuration into
+ * one loop. With static inline stages and a static const configuration,
+ * the compiler inlines the whole path and folds the weights and
+ * thresholds into it. pipeline_run is the same loop through a
+ * pipeline_ops table, with the configuration read at run time. It is the
+ * fallback for stages picked by the command line or a config file.
+ * The class thresholds and the alert hysteresis are health_class's and
+ * health_alert_check's.
+ */
+
+struct pipeline_config {
+    struct health_weights weights;
+    uint32_t require;           /* fields a sample needs to be scored */
+    float alert_below;          /* < 0 for no alert */
+    float hysteresis;           /* score must climb this far above alert_below to clear */
+};
+
+#define PIPELINE_DEFAULT_CONFIG                                                 \
+    {                                                                           \
+        .weights = HEALTH_DEFAULT_WEIGHTS, .require = FIELD_SIGNAL,             \
+        .alert_below = 40.0f, .hysteresis = HEALTH_HYSTERESIS,                  \
+    }
+
+struct pipeline_features {
+    float snr_db;
+    float rate_mbps;            /* -1 when missing, as for health_score */
+    float retry_ratio;
+    float beacon_losses;
+};
+
+struct pipeline_state {
+    struct health_tracker tracker;
+    int alerting;
+    int edge;                   /* last classify: 1 alert raised, -1 cleared, 0 neither */
+};
+
+struct pipeline {
+    const struct pipeline_config *cfg;  /* pipeline_run only; PIPELINE_DEFINE names its own */
+    struct pipeline_state state;
+    void *source;
+    void *sink;
+};
+
+/* Stage signatures; a source returns 0 when it has no more samples. */
+typedef int (*pipeline_source_fn)(void *source, struct wifi_sample *s);
+typedef int (*pipeline_filter_fn)(const struct pipeline_config *c, const struct wifi_sample *s);
+typedef void (*pipeline_features_fn)(const struct pipeline_config *c, struct pipeline_state *st,
+                                     const struct wifi_sample *s, struct pipeline_features *f);
+typedef int (*pipeline_classify_fn)(const struct pipeline_config *c, struct pipeline_state *st,
+                                    struct wifi_sample *s, const struct pipeline_features *f);
+typedef void (*pipeline_sink_fn)(void *sink, const struct wifi_sample *s, int cls, int edge);
+
+struct pipeline_ops {
+    pipeline_source_fn source;
+    pipeline_filter_fn filter;
+    pipeline_features_fn features;
+    pipeline_classify_fn classify;
+    pipeline_sink_fn sink;
+};
+
+/*
+ * Defines "static size_t name(struct pipeline *p, size_t max)", which
+ * runs up to max samples through the stages and returns how many it
+ * took from the source. cfg is an object, not a pointer; "*p->cfg" names
+ * a configuration chosen at run time while the stages stay inlined.
+ */
+#define PIPELINE_DEFINE(name, cfg, source_fn, filter_fn, features_fn, classify_fn, sink_fn) \
+    static size_t name(struct pipeline *p, size_t max)                                         \
+    {                                                                                          \
+        size_t n = 0;                                                                          \
+        struct wifi_sample s;                                                                  \
+        for (; n < max && source_fn(p->source, &s); n++) {                                     \
+            struct pipeline_features f;                                                        \
+            if (!filter_fn(&(cfg), &s)) continue;                                              \
+            features_fn(&(cfg), &p->state, &s, &f);                                            \
+            int cls = classify_fn(&(cfg), &p->state, &s, &f);                                  \
+            sink_fn(p->sink, &s, cls, p->state.edge);                                          \
+        }                                                                                      \
+        return n;                                                                              \
+    }
+
+size_t pipeline_run(const struct pipeline_ops *ops, struct pipeline *p, size_t max);
+
+/* --- stock stages --- */
+
+/* Keeps samples with every required field and no gap. */
+static inline int pipeline_filter_required(const struct pipeline_config *c, const struct wifi_sample *s)
+{
+    return (s->fields & (c->require | FIELD_GAP)) == c->require;
+}
+
+/* What health_update feeds health_score. */
+static inline void pipeline_features_health(const struct pipeline_config *c, struct pipeline_state *st,
+                                            const struct wifi_sample *s, struct pipeline_features *f)
+{
+    (void)c;
+    health_track(&st->tracker, s, &f->retry_ratio, &f->beacon_losses);
+    f->snr_db = sample_snr(s);
+    uint32_t rates = s->fields & (FIELD_RX_BITRATE | FIELD_TX_BITRATE);
+    if (rates == (FIELD_RX_BITRATE | FIELD_TX_BITRATE)) {
+        f->rate_mbps = (s->rx_bitrate_kbps + s->tx_bitrate_kbps) / 2000.0f;
+    } else if (rates) {
+        f->rate_mbps = (s->rx_bitrate_kbps + s->tx_bitrate_kbps) / 1000.0f;
+    } else {
+        f->rate_mbps = -1.0f;
+    }
+}
+
+/* Sets s->health; returns the class index and leaves the alert transition in st->edge. */
+static inline int pipeline_classify_health(const struct pipeline_config *c, struct pipeline_state *st,
+                                           struct wifi_sample *s, const struct pipeline_features *f)
+{
+    struct health_spans sp;
+    health_spans(&c->weights, &sp);
+    s->health = health_score_inline(&c->weights, &sp, f->snr_db, f->rate_mbps, f->retry_ratio, f->beacon_losses);
+    s->fields |= FIELD_HEALTH;
+
+    st->edge = 0;
+    if (c->alert_below >= 0) {
+        st->edge = health_alert_firing(st->alerting, s->health, c->alert_below, c->hysteresis) - st->alerting;
+        st->alerting += st->edge;
+    }
+    return health_class_index(s->health);
+}
+
+#endif
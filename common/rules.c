@@ -0,0 +1,703 @@
+#include "rules.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum feature {
+    F_SNR, F_SIGNAL, F_NOISE, F_HEALTH, F_RX_RATE, F_TX_RATE, F_LINK_KBPS,
+    F_RX_ERRORS, F_TX_ERRORS, F_TX_RETRIES, F_BEACON_LOSS,
+    FEATURES,
+};
+
+static const char *const feature_names[FEATURES] = {
+    "snr", "signal", "noise", "health", "rx_rate", "tx_rate", "link_kbps",
+    "rx_errors", "tx_errors", "tx_retries", "beacon_loss",
+};
+
+enum agg { AGG_AVG, AGG_MIN, AGG_MAX, AGG_P50, AGG_P90, AGG_P99, AGG_COUNT, AGGS };
+
+static const char *const agg_names[AGGS] = { "avg", "min", "max", "p50", "p90", "p99", "count" };
+
+static const char *const event_names[RULE_EVENTS] = { "connect", "disconnect", "gap" };
+
+#define BSSID_SLOT(b) (FEATURES + (b))
+#define AGG_SLOT(a) (FEATURES + RULE_MAX_BSSIDS + (a))
+#define MAX_NODES 64
+
+enum node_kind { N_PRED, N_AND, N_OR, N_NOT };
+
+struct node {
+    int kind;
+    int a, b;                   /* children, or the predicate for N_PRED */
+};
+
+struct parser {
+    struct rule_set *rs;
+    const char *p;
+    int line;
+    int bssid;
+    int failed;
+    char *err;
+    size_t err_size;
+    struct node nodes[MAX_NODES];
+    int nnodes;
+    struct rule_pred preds[RULE_MAX_PREDS];
+    int npreds;
+};
+
+static int fail(struct parser *ps, const char *fmt, ...)
+{
+    if (ps->failed) return -1;
+    ps->failed = 1;
+    int n = snprintf(ps->err, ps->err_size, "line %d: ", ps->line);
+    if (n >= 0 && (size_t)n < ps->err_size) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(ps->err + n, ps->err_size - (size_t)n, fmt, ap);
+        va_end(ap);
+    }
+    return -1;
+}
+
+static void skip_space(struct parser *ps)
+{
+    while (*ps->p == ' ' || *ps->p == '\t') ps->p++;
+}
+
+/* Reads an identifier into out; returns its length (0 if none). */
+static size_t ident(struct parser *ps, char *out, size_t size)
+{
+    skip_space(ps);
+    size_t n = 0;
+    while (isalnum((unsigned char)ps->p[n]) || ps->p[n] == '_') n++;
+    if (n == 0 || n >= size || isdigit((unsigned char)ps->p[0])) return 0;
+    memcpy(out, ps->p, n);
+    out[n] = '\0';
+    ps->p += n;
+    return n;
+}
+
+static int accept(struct parser *ps, const char *tok)
+{
+    skip_space(ps);
+    size_t n = strlen(tok);
+    if (strncmp(ps->p, tok, n) != 0) return 0;
+    /* Keywords must not run into an identifier ("order" is not "or"). */
+    if (isalpha((unsigned char)tok[0]) && (isalnum((unsigned char)ps->p[n]) || ps->p[n] == '_')) return 0;
+    ps->p += n;
+    return 1;
+}
+
+static int lookup(const char *const *names, int n, const char *name)
+{
+    for (int i = 0; i < n; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static int parse_duration(struct parser *ps, uint64_t *ns)
+{
+    skip_space(ps);
+    char *end;
+    double v = strtod(ps->p, &end);
+    if (end == ps->p || v <= 0) return fail(ps, "expected a window such as 60s");
+    double unit = 1e9;
+    if (strncmp(end, "ms", 2) == 0) unit = 1e6, end += 2;
+    else if (*end == 's') end++;
+    else if (*end == 'm') unit = 60e9, end++;
+    else if (*end == 'h') unit = 3600e9, end++;
+    ps->p = end;
+    *ns = (uint64_t)(v * unit);
+    return 0;
+}
+
+static int parse_bssid(const char *p, uint8_t mac[6])
+{
+    unsigned v[6];
+    int n = 0;
+    if (sscanf(p, "%2x:%2x:%2x:%2x:%2x:%2x%n", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &n) != 6) {
+        return 0;
+    }
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)v[i];
+    p += n;
+    while (*p == ' ' || *p == '\t') p++;
+    return *p == '\0';
+}
+
+static void *grow(void *arr, size_t *cap, size_t need, size_t elem)
+{
+    if (need <= *cap) return arr;
+    size_t n = *cap ? *cap * 2 : 16;
+    while (n < need) n *= 2;
+    void *p = realloc(arr, n * elem);
+    if (p) *cap = n;
+    return p;
+}
+
+static int find_window(struct parser *ps, int src, int is_event, uint64_t span_ns)
+{
+    struct rule_set *rs = ps->rs;
+    int bssid = is_event ? -1 : ps->bssid;
+    for (size_t i = 0; i < rs->nwindows; i++) {
+        const struct rule_window *w = &rs->windows[i];
+        if (w->src == src && w->is_event == is_event && w->bssid == bssid && w->span_ns == span_ns) {
+            return (int)i;
+        }
+    }
+
+    struct rule_window *windows = grow(rs->windows, &rs->windows_cap, rs->nwindows + 1, sizeof(*windows));
+    if (!windows) return fail(ps, "out of memory");
+    rs->windows = windows;
+    struct rule_window *w = &rs->windows[rs->nwindows];
+    *w = (struct rule_window){ .src = src, .is_event = is_event, .bssid = bssid, .span_ns = span_ns,
+                               .cap = RULE_WINDOW_CAP };
+    w->ts = malloc(RULE_WINDOW_CAP * sizeof(*w->ts));
+    if (!is_event) {
+        w->vals = malloc(RULE_WINDOW_CAP * sizeof(*w->vals));
+        w->sorted = malloc(RULE_WINDOW_CAP * sizeof(*w->sorted));
+    }
+    if (!w->ts || (!is_event && (!w->vals || !w->sorted))) {
+        free(w->ts);
+        free(w->vals);
+        free(w->sorted);
+        return fail(ps, "out of memory");
+    }
+    return (int)rs->nwindows++;
+}
+
+/* Finds or creates the aggregate; identical ones are shared between rules. */
+static int agg_slot(struct parser *ps, int agg, int src, uint64_t span_ns)
+{
+    struct rule_set *rs = ps->rs;
+    int w = find_window(ps, src, agg == AGG_COUNT, span_ns);
+    if (w < 0) return -1;
+    for (size_t i = 0; i < rs->naggs; i++) {
+        if (rs->aggs[i].agg == agg && rs->aggs[i].window == (uint32_t)w) return (int)AGG_SLOT(i);
+    }
+    struct rule_agg *aggs = grow(rs->aggs, &rs->aggs_cap, rs->naggs + 1, sizeof(*aggs));
+    if (!aggs) return fail(ps, "out of memory");
+    rs->aggs = aggs;
+    rs->aggs[rs->naggs] = (struct rule_agg){ agg, (uint32_t)w };
+    return (int)AGG_SLOT(rs->naggs++);
+}
+
+/* feature | agg(feature, window) | count(event, window) */
+static int parse_value(struct parser *ps)
+{
+    char name[32], arg[32];
+    if (!ident(ps, name, sizeof(name))) return fail(ps, "expected a feature or aggregate");
+
+    if (!accept(ps, "(")) {
+        int f = lookup(feature_names, FEATURES, name);
+        if (f < 0) return fail(ps, "unknown feature '%s'", name);
+        return f;
+    }
+
+    int agg = lookup(agg_names, AGGS, name);
+    if (agg < 0) return fail(ps, "unknown aggregate '%s'", name);
+    if (!ident(ps, arg, sizeof(arg))) return fail(ps, "expected an argument to %s", name);
+    int src = agg == AGG_COUNT ? lookup(event_names, RULE_EVENTS, arg) : lookup(feature_names, FEATURES, arg);
+    if (src < 0) return fail(ps, "unknown %s '%s'", agg == AGG_COUNT ? "event" : "feature", arg);
+
+    uint64_t span = 0;
+    if (!accept(ps, ",")) return fail(ps, "expected ',' and a window");
+    if (parse_duration(ps, &span) < 0) return -1;
+    if (!accept(ps, ")")) return fail(ps, "expected ')'");
+    return agg_slot(ps, agg, src, span);
+}
+
+static int new_node(struct parser *ps, int kind, int a, int b)
+{
+    if (ps->nnodes >= MAX_NODES) return fail(ps, "expression too long");
+    ps->nodes[ps->nnodes] = (struct node){ kind, a, b };
+    return ps->nnodes++;
+}
+
+static int new_pred(struct parser *ps, uint32_t slot, float lo, float hi, uint32_t neg)
+{
+    if (ps->npreds >= RULE_MAX_PREDS) return fail(ps, "more than %d comparisons", RULE_MAX_PREDS);
+    ps->preds[ps->npreds] = (struct rule_pred){ slot, neg, lo, hi };
+    return ps->npreds++;
+}
+
+/* value OP number, as a half-open range so every operator evaluates alike. */
+static int parse_cmp(struct parser *ps)
+{
+    int slot = parse_value(ps);
+    if (slot < 0) return -1;
+
+    static const char *const ops[] = { "<=", ">=", "==", "!=", "<", ">" };
+    int op = -1;
+    for (int i = 0; i < 6 && op < 0; i++) {
+        if (accept(ps, ops[i])) op = i;
+    }
+    if (op < 0) return fail(ps, "expected a comparison");
+
+    skip_space(ps);
+    char *end;
+    float c = strtof(ps->p, &end);
+    if (end == ps->p) return fail(ps, "expected a number");
+    ps->p = end;
+
+    float lo = -INFINITY, hi = INFINITY, up = nextafterf(c, INFINITY);
+    uint32_t neg = 0;
+    switch (op) {
+    case 0: hi = up; break;
+    case 1: lo = c; break;
+    case 3: neg = 1; /* fall through */
+    case 2: lo = c; hi = up; break;
+    case 4: hi = c; break;
+    case 5: lo = up; break;
+    }
+    int pred = new_pred(ps, (uint32_t)slot, lo, hi, neg);
+    return pred < 0 ? -1 : new_node(ps, N_PRED, pred, 0);
+}
+
+static int parse_or(struct parser *ps);
+
+static int parse_unary(struct parser *ps)
+{
+    if (accept(ps, "not")) {
+        int a = parse_unary(ps);
+        return a < 0 ? -1 : new_node(ps, N_NOT, a, 0);
+    }
+    if (accept(ps, "(")) {
+        int a = parse_or(ps);
+        if (a < 0) return -1;
+        return accept(ps, ")") ? a : fail(ps, "expected ')'");
+    }
+    return parse_cmp(ps);
+}
+
+static int parse_and(struct parser *ps)
+{
+    int a = parse_unary(ps);
+    while (a >= 0 && accept(ps, "and")) {
+        int b = parse_unary(ps);
+        a = b < 0 ? -1 : new_node(ps, N_AND, a, b);
+    }
+    return a;
+}
+
+static int parse_or(struct parser *ps)
+{
+    int a = parse_and(ps);
+    while (a >= 0 && accept(ps, "or")) {
+        int b = parse_and(ps);
+        a = b < 0 ? -1 : new_node(ps, N_OR, a, b);
+    }
+    return a;
+}
+
+struct dnf {
+    uint32_t masks[RULE_MAX_CONJ];
+    int n;
+};
+
+/* Negations are pushed onto the predicates, then and/or distribute. */
+static int to_dnf(struct parser *ps, int node, int neg, struct dnf *out)
+{
+    const struct node *nd = &ps->nodes[node];
+    int kind = nd->kind;
+    if (kind == N_NOT) return to_dnf(ps, nd->a, !neg, out);
+
+    if (kind == N_PRED) {
+        int pred = nd->a;
+        if (neg) {
+            const struct rule_pred *p = &ps->preds[pred];
+            pred = new_pred(ps, p->slot, p->lo, p->hi, !p->neg);
+            if (pred < 0) return -1;
+        }
+        out->masks[0] = 1u << pred;
+        out->n = 1;
+        return 0;
+    }
+
+    struct dnf a, b;
+    if (to_dnf(ps, nd->a, neg, &a) < 0 || to_dnf(ps, nd->b, neg, &b) < 0) return -1;
+    if ((kind == N_OR) != neg) {
+        if (a.n + b.n > RULE_MAX_CONJ) return fail(ps, "more than %d alternatives", RULE_MAX_CONJ);
+        *out = a;
+        for (int i = 0; i < b.n; i++) out->masks[out->n++] = b.masks[i];
+        return 0;
+    }
+    if (a.n * b.n > RULE_MAX_CONJ) return fail(ps, "more than %d alternatives", RULE_MAX_CONJ);
+    out->n = 0;
+    for (int i = 0; i < a.n; i++) {
+        for (int j = 0; j < b.n; j++) out->masks[out->n++] = a.masks[i] | b.masks[j];
+    }
+    return 0;
+}
+
+static int bssid_index(struct parser *ps, const uint8_t mac[6])
+{
+    struct rule_set *rs = ps->rs;
+    for (int i = 0; i < rs->nbssids; i++) {
+        if (memcmp(rs->bssids[i], mac, 6) == 0) return i;
+    }
+    if (rs->nbssids >= RULE_MAX_BSSIDS) return fail(ps, "more than %d distinct BSSIDs", RULE_MAX_BSSIDS);
+    memcpy(rs->bssids[rs->nbssids], mac, 6);
+    return rs->nbssids++;
+}
+
+/* "rule NAME: EXPR [for bssid MAC]", already stripped of comments. */
+static int compile_line(struct parser *ps, char *line)
+{
+    struct rule r = {0};
+    ps->p = line;
+    ps->nnodes = ps->npreds = 0;
+    ps->bssid = -1;
+
+    if (!accept(ps, "rule")) return fail(ps, "expected 'rule NAME: ...'");
+    if (!ident(ps, r.name, sizeof(r.name))) return fail(ps, "expected a rule name");
+    if (!accept(ps, ":")) return fail(ps, "expected ':' after the rule name");
+
+    char *filter = strstr(ps->p, " for bssid ");
+    if (filter) {
+        uint8_t mac[6];
+        if (!parse_bssid(filter + strlen(" for bssid "), mac)) return fail(ps, "bad BSSID");
+        if ((ps->bssid = bssid_index(ps, mac)) < 0) return -1;
+        *filter = '\0';
+    }
+
+    int root = parse_or(ps);
+    if (root < 0) return -1;
+    skip_space(ps);
+    if (*ps->p) return fail(ps, "unexpected '%s'", ps->p);
+
+    if (ps->bssid >= 0) {
+        int pred = new_pred(ps, BSSID_SLOT((uint32_t)ps->bssid), 1.0f, INFINITY, 0);
+        if (pred < 0 || (root = new_node(ps, N_AND, root, new_node(ps, N_PRED, pred, 0))) < 0) return -1;
+    }
+
+    struct dnf d;
+    if (to_dnf(ps, root, 0, &d) < 0) return -1;
+
+    struct rule_set *rs = ps->rs;
+    struct rule *rules = grow(rs->rules, &rs->rules_cap, rs->nrules + 1, sizeof(*rules));
+    if (rules) rs->rules = rules;
+    struct rule_pred *preds = grow(rs->preds, &rs->preds_cap, rs->npreds + (size_t)ps->npreds, sizeof(*preds));
+    if (preds) rs->preds = preds;
+    uint32_t *conj = grow(rs->conj, &rs->conj_cap, rs->nconj + (size_t)d.n, sizeof(*conj));
+    if (conj) rs->conj = conj;
+    if (!rules || !preds || !conj) return fail(ps, "out of memory");
+
+    r.first_pred = (uint32_t)rs->npreds;
+    r.npred = (uint32_t)ps->npreds;
+    r.first_conj = (uint32_t)rs->nconj;
+    r.nconj = (uint32_t)d.n;
+    memcpy(rs->preds + rs->npreds, ps->preds, (size_t)ps->npreds * sizeof(*preds));
+    memcpy(rs->conj + rs->nconj, d.masks, (size_t)d.n * sizeof(*conj));
+    rs->npreds += (size_t)ps->npreds;
+    rs->nconj += (size_t)d.n;
+    rs->rules[rs->nrules++] = r;
+    return 0;
+}
+
+int rules_compile(struct rule_set *rs, const char *text, char *err, size_t err_size)
+{
+    struct parser ps = { .rs = rs, .err = err, .err_size = err_size };
+    char line[512];
+
+    while (*text) {
+        size_t n = strcspn(text, "\n");
+        ps.line++;
+        if (n >= sizeof(line)) {
+            fail(&ps, "line too long");
+            return 0;
+        }
+        memcpy(line, text, n);
+        line[n] = '\0';
+        text += n + (text[n] == '\n');
+
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0') continue;
+        for (char *e = p + strlen(p); e > p && isspace((unsigned char)e[-1]); ) *--e = '\0';
+
+        if (compile_line(&ps, p) < 0) return 0;
+    }
+
+    size_t nvals = AGG_SLOT(rs->naggs);
+    float *vals = realloc(rs->vals, nvals * sizeof(*vals));
+    if (!vals) {
+        fail(&ps, "out of memory");
+        return 0;
+    }
+    rs->vals = vals;
+    /* New aggregates start empty; existing values are kept across appends. */
+    for (size_t i = rs->nvals; i < nvals; i++) rs->vals[i] = i < AGG_SLOT(0) ? 0 : NAN;
+    for (size_t i = 0; i < rs->naggs; i++) {
+        if (rs->aggs[i].agg == AGG_COUNT && AGG_SLOT(i) >= rs->nvals) rs->vals[AGG_SLOT(i)] = 0;
+    }
+    rs->nvals = nvals;
+    return 1;
+}
+
+int rules_load(struct rule_set *rs, const char *path, char *err, size_t err_size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        snprintf(err, err_size, "cannot open %s", path);
+        return 0;
+    }
+    size_t len = 0, cap = 4096;
+    char *text = malloc(cap);
+    size_t n;
+    while (text && (n = fread(text + len, 1, cap - len - 1, fp)) > 0) {
+        len += n;
+        if (len + 1 == cap) {
+            char *t = realloc(text, cap * 2);
+            if (!t) {
+                free(text);
+                text = NULL;
+                break;
+            }
+            text = t;
+            cap *= 2;
+        }
+    }
+    fclose(fp);
+    if (!text) {
+        snprintf(err, err_size, "out of memory reading %s", path);
+        return 0;
+    }
+    text[len] = '\0';
+    int ok = rules_compile(rs, text, err, err_size);
+    free(text);
+    return ok;
+}
+
+void rules_free(struct rule_set *rs)
+{
+    for (size_t i = 0; i < rs->nwindows; i++) {
+        free(rs->windows[i].ts);
+        free(rs->windows[i].vals);
+        free(rs->windows[i].sorted);
+    }
+    free(rs->windows);
+    free(rs->aggs);
+    free(rs->rules);
+    free(rs->preds);
+    free(rs->conj);
+    free(rs->vals);
+    memset(rs, 0, sizeof(*rs));
+}
+
+/* First index in sorted[0..n) not less than v. */
+static uint32_t lower_bound(const float *sorted, uint32_t n, float v)
+{
+    uint32_t lo = 0;
+    while (n > 0) {
+        uint32_t half = n / 2;
+        if (sorted[lo + half] < v) {
+            lo += half + 1;
+            n -= half + 1;
+        } else {
+            n = half;
+        }
+    }
+    return lo;
+}
+
+static void window_pop(struct rule_window *w)
+{
+    if (w->vals) {
+        float v = w->vals[w->head];
+        uint32_t i = lower_bound(w->sorted, w->len, v);
+        memmove(w->sorted + i, w->sorted + i + 1, (w->len - i - 1) * sizeof(float));
+        w->sum -= v;
+    }
+    w->head = (w->head + 1) % w->cap;
+    w->len--;
+}
+
+/* Doubles a full window, unrolling the ring to start at 0; 0 when out of memory. */
+static int window_grow(struct rule_window *w)
+{
+    uint32_t cap = w->cap * 2, tail = w->cap - w->head;
+    uint64_t *ts = malloc(cap * sizeof(*ts));
+    float *vals = w->vals ? malloc(cap * sizeof(*vals)) : NULL;
+    float *sorted = w->vals ? realloc(w->sorted, cap * sizeof(*sorted)) : NULL;
+    if (sorted) w->sorted = sorted;
+    if (!ts || (w->vals && (!vals || !sorted))) {
+        free(ts);
+        free(vals);
+        return 0;
+    }
+    memcpy(ts, w->ts + w->head, tail * sizeof(*ts));
+    memcpy(ts + tail, w->ts, w->head * sizeof(*ts));
+    free(w->ts);
+    w->ts = ts;
+    if (vals) {
+        memcpy(vals, w->vals + w->head, tail * sizeof(*vals));
+        memcpy(vals + tail, w->vals, w->head * sizeof(*vals));
+        free(w->vals);
+        w->vals = vals;
+    }
+    w->head = 0;
+    w->cap = cap;
+    return 1;
+}
+
+static void window_push(struct rule_window *w, uint64_t ts, float v)
+{
+    /* Only out of memory does a window lose samples before they expire. */
+    if (w->len == w->cap && !window_grow(w)) window_pop(w);
+    uint32_t i = (w->head + w->len) % w->cap;
+    w->ts[i] = ts;
+    if (w->vals) {
+        w->vals[i] = v;
+        uint32_t at = lower_bound(w->sorted, w->len, v);
+        memmove(w->sorted + at + 1, w->sorted + at, (w->len - at) * sizeof(float));
+        w->sorted[at] = v;
+        w->sum += v;
+    }
+    w->len++;
+}
+
+static void window_expire(struct rule_window *w, uint64_t now)
+{
+    uint64_t cutoff = now > w->span_ns ? now - w->span_ns : 0;
+    while (w->len && w->ts[w->head] < cutoff) window_pop(w);
+    if (w->len == 0) w->sum = 0;    /* shed accumulated rounding */
+}
+
+static float agg_value(int agg, const struct rule_window *w)
+{
+    if (agg == AGG_COUNT) return (float)w->len;
+    if (w->len == 0) return NAN;
+
+    uint32_t last = w->len - 1;
+    switch (agg) {
+    case AGG_AVG: return (float)(w->sum / w->len);
+    case AGG_MIN: return w->sorted[0];
+    case AGG_MAX: return w->sorted[last];
+    case AGG_P50: return w->sorted[(uint32_t)(0.5 * last + 0.5)];
+    case AGG_P90: return w->sorted[(uint32_t)(0.9 * last + 0.5)];
+    default: return w->sorted[(uint32_t)(0.99 * last + 0.5)];
+    }
+}
+
+static void refresh_aggs(struct rule_set *rs, int events_only)
+{
+    for (size_t i = 0; i < rs->naggs; i++) {
+        const struct rule_agg *a = &rs->aggs[i];
+        const struct rule_window *w = &rs->windows[a->window];
+        if (!events_only || w->is_event) rs->vals[AGG_SLOT(i)] = agg_value(a->agg, w);
+    }
+}
+
+static void features(const struct wifi_sample *s, float *f)
+{
+    uint32_t m = s->fields;
+    f[F_SNR] = m & FIELD_SIGNAL ? sample_snr(s) : NAN;
+    f[F_SIGNAL] = m & FIELD_SIGNAL ? (float)s->signal_dbm : NAN;
+    f[F_NOISE] = m & FIELD_NOISE ? (float)s->noise_dbm : NAN;
+    f[F_HEALTH] = m & FIELD_HEALTH ? s->health : NAN;
+    f[F_RX_RATE] = m & FIELD_RX_BITRATE ? s->rx_bitrate_kbps / 1000.0f : NAN;
+    f[F_TX_RATE] = m & FIELD_TX_BITRATE ? s->tx_bitrate_kbps / 1000.0f : NAN;
+    f[F_LINK_KBPS] = m & FIELD_LINK_RATES ? (s->rx_bytes_per_s + s->tx_bytes_per_s) / 1e3f : NAN;
+    f[F_RX_ERRORS] = m & FIELD_LINK_RATES ? s->rx_errors_per_s : NAN;
+    f[F_TX_ERRORS] = m & FIELD_LINK_RATES ? s->tx_errors_per_s : NAN;
+    f[F_TX_RETRIES] = m & FIELD_TX_RETRIES ? (float)s->tx_retries : NAN;
+    f[F_BEACON_LOSS] = m & FIELD_BEACON_LOSS ? (float)s->beacon_loss : NAN;
+}
+
+void rules_update(struct rule_set *rs, const struct wifi_sample *s)
+{
+    if (!rs->nvals) return;
+    float *vals = rs->vals;
+
+    if (s->fields & FIELD_GAP) {
+        /* No new readings: rules keep their state and only the gap counts. */
+        rules_event(rs, s->ts_ns, RULE_EV_GAP);
+        return;
+    }
+    features(s, vals);
+    for (int b = 0; b < rs->nbssids; b++) {
+        vals[BSSID_SLOT(b)] = (s->fields & FIELD_BSSID) && memcmp(s->bssid, rs->bssids[b], 6) == 0;
+    }
+
+    for (size_t i = 0; i < rs->nwindows; i++) {
+        struct rule_window *w = &rs->windows[i];
+        if (!w->is_event) {
+            float v = vals[w->src];
+            int match = w->bssid < 0 || vals[BSSID_SLOT(w->bssid)] > 0;
+            if (match && !isnan(v)) window_push(w, s->ts_ns, v);
+        }
+        window_expire(w, s->ts_ns);
+    }
+    refresh_aggs(rs, 0);
+}
+
+void rules_event(struct rule_set *rs, uint64_t ts_ns, enum rule_event ev)
+{
+    for (size_t i = 0; i < rs->nwindows; i++) {
+        struct rule_window *w = &rs->windows[i];
+        if (!w->is_event) continue;
+        if (w->src == (int)ev) window_push(w, ts_ns, 0);
+        window_expire(w, ts_ns);
+    }
+    if (rs->nvals) refresh_aggs(rs, 1);
+}
+
+void rules_eval(struct rule_set *rs, uint64_t ts_ns, struct sink_set *sinks)
+{
+    const float *vals = rs->vals;
+
+    for (size_t r = 0; r < rs->nrules; r++) {
+        struct rule *rule = &rs->rules[r];
+        const struct rule_pred *p = rs->preds + rule->first_pred;
+        const uint32_t *conj = rs->conj + rule->first_conj;
+
+        uint32_t m = 0;
+        for (uint32_t i = 0; i < rule->npred; i++) {
+            float v = vals[p[i].slot];
+            /* A missing value (an empty window, a field the backend lacks) fails negated predicates too. */
+            uint32_t in = (uint32_t)(v >= p[i].lo) & (uint32_t)(v < p[i].hi);
+            m |= ((in ^ p[i].neg) & (uint32_t)!isnan(v)) << i;
+        }
+        int hit = 0;
+        for (uint32_t i = 0; i < rule->nconj; i++) hit |= (m & conj[i]) == conj[i];
+
+        if (hit != rule->firing) {
+            rule->firing = hit;
+            struct alert a = { ts_ns, rule->name, vals[p[0].slot], hit };
+            if (sinks) sinks_alert(sinks, &a);
+        }
+    }
+}
+
+void rules_agg_name(const struct rule_set *rs, size_t i, char *out, size_t size)
+{
+    const struct rule_agg *a = &rs->aggs[i];
+    const struct rule_window *w = &rs->windows[a->window];
+    const char *src = w->is_event ? event_names[w->src] : feature_names[w->src];
+
+    uint64_t span = w->span_ns;
+    unsigned long long n = span / 1000000;
+    const char *unit = "ms";
+    if (span % 3600000000000ull == 0) n = span / 3600000000000ull, unit = "h";
+    else if (span % 60000000000ull == 0) n = span / 60000000000ull, unit = "m";
+    else if (span % 1000000000ull == 0) n = span / 1000000000ull, unit = "s";
+
+    int len = snprintf(out, size, "%s(%s, %llu%s)", agg_names[a->agg], src, n, unit);
+    if (w->bssid >= 0 && len >= 0 && (size_t)len < size) {
+        const uint8_t *m = rs->bssids[w->bssid];
+        snprintf(out + len, size - (size_t)len, " for bssid %02x:%02x:%02x:%02x:%02x:%02x", m[0], m[1],
+                 m[2], m[3], m[4], m[5]);
+    }
+}
+
+float rules_agg_value(const struct rule_set *rs, size_t i)
+{
+    return rs->vals[AGG_SLOT(i)];
+}
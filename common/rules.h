@@ -0,0 +1,118 @@
+#ifndef SNR_RULES_H
+#define SNR_RULES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sample.h"
+#include "sink.h"
+
+/*
+ * Alert rules, one per line:
+ *
+ *     rule weak_ap: p50(snr, 60s) < 20 for bssid 02:00:5e:10:20:30
+ *     rule flappy:  count(disconnect, 5m) > 3
+ *     rule bad:     health < 40 and (tx_rate < 50 or not avg(snr, 30s) >= 15)
+ *
+ * Features: snr signal noise health rx_rate tx_rate (Mb/s) link_kbps
+ * rx_errors tx_errors (per s) tx_retries beacon_loss. Aggregates avg min
+ * max p50 p90 p99 take (feature, window); count takes (event, window) with
+ * events connect, disconnect and gap. "for bssid" restricts the rule and
+ * the samples its windows see to one access point. A comparison with a
+ * missing value, such as an aggregate over an empty window or a feature
+ * the backend does not report, is false whether negated or not.
+ *
+ * Each rule compiles to disjunctive normal form over range predicates on
+ * a shared value vector, so evaluation is a few compares and mask tests
+ * with no per-node dispatch. Identical windows and aggregates are shared
+ * between rules.
+ */
+
+#define RULE_NAME_MAX 48
+#define RULE_MAX_PREDS 32          /* per rule, after negation push-down */
+#define RULE_MAX_CONJ 16           /* "or" branches per rule, after DNF */
+#define RULE_MAX_BSSIDS 64
+#define RULE_WINDOW_CAP 1024       /* samples a window starts with room for; it doubles when full */
+
+enum rule_event {
+    RULE_EV_CONNECT,
+    RULE_EV_DISCONNECT,
+    RULE_EV_GAP,
+    RULE_EVENTS,
+};
+
+struct rule_pred {
+    uint32_t slot;              /* index into the value vector */
+    uint32_t neg;               /* result is inverted */
+    float lo, hi;               /* true when lo <= v < hi */
+};
+
+struct rule {
+    char name[RULE_NAME_MAX];
+    uint32_t first_pred, npred;
+    uint32_t first_conj, nconj;
+    int firing;
+};
+
+/*
+ * One time window over a feature (or an event kind). Order statistics read
+ * a sorted copy kept up to date on insert and expiry, so every aggregate
+ * over the window costs O(1) however many rules use it.
+ */
+struct rule_window {
+    int src;                    /* feature index or enum rule_event */
+    int is_event;
+    int bssid;                  /* -1 for any */
+    uint64_t span_ns;
+    uint64_t *ts;
+    float *vals;                /* arrival order, NULL for events */
+    float *sorted;              /* NULL for events */
+    uint32_t head, len, cap;
+    double sum;
+};
+
+struct rule_agg {
+    int agg;
+    uint32_t window;
+};
+
+struct rule_set {
+    struct rule *rules;
+    size_t nrules, rules_cap;
+    struct rule_pred *preds;
+    size_t npreds, preds_cap;
+    uint32_t *conj;             /* one predicate bitmask per conjunct */
+    size_t nconj, conj_cap;
+    struct rule_window *windows;
+    size_t nwindows, windows_cap;
+    struct rule_agg *aggs;
+    size_t naggs, aggs_cap;
+    uint8_t bssids[RULE_MAX_BSSIDS][6];
+    int nbssids;
+    float *vals;                /* features, then bssid matches, then aggregates */
+    size_t nvals;
+};
+
+/* Compiles rule text; on failure returns 0 with "line N: ..." in err. */
+int rules_compile(struct rule_set *rs, const char *text, char *err, size_t err_size);
+int rules_load(struct rule_set *rs, const char *path, char *err, size_t err_size);
+void rules_free(struct rule_set *rs);
+
+/* Feeds a sample into the feature vector and windows; a FIELD_GAP sample only counts as a gap event. */
+void rules_update(struct rule_set *rs, const struct wifi_sample *s);
+/* Records a link event at ts_ns and refreshes the event windows. */
+void rules_event(struct rule_set *rs, uint64_t ts_ns, enum rule_event ev);
+/* Evaluates every rule, emitting an alert to the sinks on each edge. */
+void rules_eval(struct rule_set *rs, uint64_t ts_ns, struct sink_set *sinks);
+
+/* "p50(snr, 60s)" plus " for bssid ..." when filtered; for status queries. */
+void rules_agg_name(const struct rule_set *rs, size_t i, char *out, size_t size);
+float rules_agg_value(const struct rule_set *rs, size_t i);
+
+static inline void rules_sample(struct rule_set *rs, const struct wifi_sample *s,
+                                struct sink_set *sinks)
+{
+    rules_update(rs, s);
+    rules_eval(rs, s->ts_ns, sinks);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SNR_SAMPLE_H
+#define SNR_SAMPLE_H
+
+#include <stdint.h>
+
+#define MAX_CHAINS 4
+
+/* Bits in wifi_sample.fields: which members a backend actually filled. */
+#define FIELD_SIGNAL        (1u << 0)
+#define FIELD_NOISE         (1u << 1)
+#define FIELD_SIGNAL_AVG    (1u << 2)
+#define FIELD_CHAIN_SIGNAL  (1u << 3)
+#define FIELD_RX_BITRATE    (1u << 4)
+#define FIELD_TX_BITRATE    (1u << 5)
+#define FIELD_TX_RETRIES    (1u << 6)
+#define FIELD_TX_FAILED     (1u << 7)
+#define FIELD_BEACON_LOSS   (1u << 8)
+#define FIELD_BSSID         (1u << 9)
+#define FIELD_LINK_RATES    (1u << 10)  /* the *_per_s columns from sysfs counters */
+#define FIELD_TX_PACKETS    (1u << 11)
+#define FIELD_HEALTH        (1u << 12)
+#define FIELD_SSID          (1u << 13)
+#define FIELD_GAP           (1u << 31)  /* no data: the backend missed its deadline */
+
+#define DEFAULT_NOISE_DBM   (-90)
+
+struct wifi_sample {
+    uint64_t ts_ns;
+    uint32_t fields;
+    int8_t signal_dbm;
+    int8_t noise_dbm;
+    int8_t signal_avg_dbm;
+    uint8_t chains;
+    int8_t chain_signal_dbm[MAX_CHAINS];
+    uint8_t bssid[6];
+    uint32_t rx_bitrate_kbps;
+    uint32_t tx_bitrate_kbps;
+    uint32_t tx_packets;
+    uint32_t tx_retries;
+    uint32_t tx_failed;
+    uint32_t beacon_loss;
+    float rx_bytes_per_s;
+    float tx_bytes_per_s;
+    float rx_packets_per_s;
+    float tx_packets_per_s;
+    float rx_errors_per_s;
+    float tx_errors_per_s;
+    float health;               /* link-health index, 0-100 */
+    uint32_t ssid_id;           /* intern IDs (common/intern.h); 0 when unknown */
+    uint32_t ifname_id;
+};
+
+/* Same fallback as Poc.py: assume a -90 dBm floor when noise is unknown. */
+static inline float sample_snr(const struct wifi_sample *s)
+{
+    int noise = (s->fields & FIELD_NOISE) ? s->noise_dbm : DEFAULT_NOISE_DBM;
+    return (float)(s->signal_dbm - noise);
+}
+
+#endif
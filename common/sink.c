@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "intern.h"
+#include "sink.h"
+
+int sinks_add(struct sink_set *set, const struct sink *k)
+{
+    if (set->n >= MAX_SINKS) return 0;
+    set->sinks[set->n++] = *k;
+    return 1;
+}
+
+void sinks_sample(struct sink_set *set, const struct wifi_sample *s)
+{
+    for (int i = 0; i < set->n; i++) {
+        if (set->sinks[i].sample) set->sinks[i].sample(&set->sinks[i], s);
+    }
+}
+
+void sinks_alert(struct sink_set *set, const struct alert *a)
+{
+    for (int i = 0; i < set->n; i++) {
+        if (set->sinks[i].alert) set->sinks[i].alert(&set->sinks[i], a);
+    }
+}
+
+void sinks_flush(struct sink_set *set)
+{
+    for (int i = 0; i < set->n; i++) {
+        if (set->sinks[i].flush) set->sinks[i].flush(&set->sinks[i]);
+    }
+}
+
+void sinks_close(struct sink_set *set)
+{
+    for (int i = 0; i < set->n; i++) {
+        if (set->sinks[i].close) set->sinks[i].close(&set->sinks[i]);
+    }
+    set->n = 0;
+}
+
+/* An SSID is arbitrary bytes: quote it when it holds a comma, quote or line break. */
+void csv_string(FILE *fp, const char *v)
+{
+    if (!v) return;
+    if (!v[strcspn(v, ",\"\r\n")]) {
+        fputs(v, fp);
+        return;
+    }
+    fputc('"', fp);
+    for (; *v; v++) {
+        if (*v == '"') fputc('"', fp);
+        fputc(*v, fp);
+    }
+    fputc('"', fp);
+}
+
+static void csv_sample(struct sink *k, const struct wifi_sample *s)
+{
+    FILE *fp = k->priv;
+    if (s->fields & FIELD_GAP) {
+        fprintf(fp, "%llu,sample,,,,,,,gap,\n", (unsigned long long)s->ts_ns);
+        return;
+    }
+    fprintf(fp, "%llu,sample,%.1f,%d,%.1f,%u,%u,%u,%u,", (unsigned long long)s->ts_ns, s->health,
+            s->signal_dbm, sample_snr(s), s->rx_bitrate_kbps, s->tx_bitrate_kbps, s->tx_retries,
+            s->beacon_loss);
+    if (s->fields & FIELD_SSID) csv_string(fp, intern_str(&intern_global, s->ssid_id));
+    fputc('\n', fp);
+}
+
+static void csv_alert(struct sink *k, const struct alert *a)
+{
+    fprintf(k->priv, "%llu,%s,%.1f,,,,,,%s,\n", (unsigned long long)a->ts_ns,
+            a->firing ? "alert" : "clear", a->value, a->rule);
+}
+
+static void file_flush(struct sink *k)
+{
+    fflush(k->priv);
+}
+
+static void file_close(struct sink *k)
+{
+    fclose(k->priv);
+    k->priv = NULL;
+}
+
+int sink_csv_open(struct sink *k, const char *path)
+{
+    FILE *fp = fopen(path, "a");
+    if (!fp) return 0;
+    if (ftell(fp) == 0) {
+        fprintf(fp, "ts_ns,kind,health,signal_dbm,snr_db,rx_kbps,tx_kbps,tx_retries,beacon_loss,ssid\n");
+    }
+    *k = (struct sink){
+        .name = "csv", .sample = csv_sample, .alert = csv_alert,
+        .flush = file_flush, .close = file_close, .priv = fp,
+    };
+    return 1;
+}
+
+static void stream_alert(struct sink *k, const struct alert *a)
+{
+    /* Leading \r so the alert replaces a live status line rather than trailing it. */
+    fprintf(k->priv, "\r%s: %s (%.1f)%40s\n", a->firing ? "ALERT" : "CLEARED", a->rule, a->value, "");
+    fflush(k->priv);
+}
+
+void sink_alert_stream(struct sink *k, FILE *fp)
+{
+    *k = (struct sink){ .name = "stream", .alert = stream_alert, .priv = fp };
+}
+
+void health_alert_emit(const struct wifi_sample *s, int firing, struct sink_set *set)
+{
+    struct alert a = { s->ts_ns, "link health low", s->health, firing };
+    sinks_alert(set, &a);
+}
+
+void health_alert_check(struct health_alert *h, const struct wifi_sample *s, struct sink_set *set)
+{
+    if (!(s->fields & FIELD_HEALTH)) return;
+    int firing = health_alert_firing(h->firing, s->health, h->below, h->hysteresis);
+    if (firing == h->firing) return;
+
+    h->firing = firing;
+    health_alert_emit(s, firing, set);
+}
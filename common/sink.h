@@ -0,0 +1,74 @@
+#ifndef SNR_SINK_H
+#define SNR_SINK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sample.h"
+
+#define MAX_SINKS 8
+
+struct alert {
+    uint64_t ts_ns;
+    const char *rule;
+    float value;
+    int firing;                 /* 1 on entering the alert state, 0 on clearing */
+};
+
+/*
+ * Destination for samples and alerts. Every hook is optional, so a sink
+ * that only cares about alerts leaves sample NULL.
+ */
+struct sink {
+    const char *name;
+    void (*sample)(struct sink *k, const struct wifi_sample *s);
+    void (*alert)(struct sink *k, const struct alert *a);
+    void (*flush)(struct sink *k);
+    void (*close)(struct sink *k);
+    void *priv;
+};
+
+struct sink_set {
+    struct sink sinks[MAX_SINKS];
+    int n;
+};
+
+int sinks_add(struct sink_set *set, const struct sink *k);
+void sinks_sample(struct sink_set *set, const struct wifi_sample *s);
+void sinks_alert(struct sink_set *set, const struct alert *a);
+void sinks_flush(struct sink_set *set);
+void sinks_close(struct sink_set *set);
+
+/* One CSV row per sample and per alert, health first. Owns the FILE. */
+int sink_csv_open(struct sink *k, const char *path);
+
+/* Writes v as one CSV field, quoted if it needs to be; nothing for NULL. */
+void csv_string(FILE *fp, const char *v);
+
+/* Alerts only, one line each, for a console or pipe. Does not own the FILE. */
+void sink_alert_stream(struct sink *k, FILE *fp);
+
+/*
+ * Fires when the health index drops below `below` and clears once it is
+ * back above `below + hysteresis`, so a link hovering on the threshold
+ * does not alert on every sample.
+ */
+struct health_alert {
+    float below;
+    float hysteresis;
+    int firing;
+};
+
+#define HEALTH_HYSTERESIS 5.0f
+
+/* Whether the alert fires for a score of health, given whether it was firing. */
+static inline int health_alert_firing(int firing, float health, float below, float hysteresis)
+{
+    return firing ? health < below + hysteresis : health < below;
+}
+
+/* Passes the alert for s, raised when firing and cleared when not, to the sinks in set. */
+void health_alert_emit(const struct wifi_sample *s, int firing, struct sink_set *set);
+
+void health_alert_check(struct health_alert *h, const struct wifi_sample *s, struct sink_set *set);
+
+#endif
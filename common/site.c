@@ -0,0 +1,296 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "site.h"
+
+#define SITE_BASELINE_SAMPLES 172800    /* a day at 500 ms */
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint8_t rssi_bucket(int8_t dbm)
+{
+    int b = (dbm - SITE_MIN_DBM) / SITE_RSSI_STEP_DB;
+    return (uint8_t)(b < 0 ? 0 : b > 15 ? 15 : b);
+}
+
+void site_fingerprint(const struct site_ap *aps, size_t n, struct site_fp *fp)
+{
+    memset(fp->min, 0xff, sizeof(fp->min));
+    memset(fp->rssi, 0, sizeof(fp->rssi));
+    fp->aps = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (aps[i].signal_dbm < SITE_MIN_DBM) continue;
+        uint64_t mac = 0;
+        for (int j = 0; j < 6; j++) mac = mac << 8 | aps[i].bssid[j];
+        uint64_t h = mix64(mac);
+        uint8_t bucket = rssi_bucket(aps[i].signal_dbm);
+        /* Hash k is the top half of a mix of h and k: 64 independent-enough functions from one. */
+        for (uint32_t k = 0; k < SITE_HASHES; k++) {
+            uint32_t v = (uint32_t)(mix64(h + (k + 1) * 0x9e3779b97f4a7c15ull) >> 32);
+            if (v < fp->min[k]) {
+                fp->min[k] = v;
+                fp->rssi[k] = bucket;
+            }
+        }
+        fp->aps++;
+    }
+}
+
+float site_score(const struct site_fp *a, const struct site_fp *b)
+{
+    if (!a->aps || !b->aps) return 0;
+    unsigned near = 0, far = 0;
+    for (int k = 0; k < SITE_HASHES; k++) {
+        if (a->min[k] != b->min[k]) continue;
+        int d = a->rssi[k] - b->rssi[k];
+        if (d >= -1 && d <= 1) near++;
+        else far++;
+    }
+    return (near + 0.5f * far) / SITE_HASHES;
+}
+
+static uint64_t band_key(const struct site_fp *fp, unsigned band)
+{
+    uint64_t h = mix64(band + 1);
+    for (unsigned r = 0; r < SITE_ROWS; r++) h = mix64(h ^ fp->min[band * SITE_ROWS + r]);
+    return h;
+}
+
+static int cmp_key(const void *a, const void *b)
+{
+    const struct site_key *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+int site_lib_index(struct site_lib *l)
+{
+    struct site_key *keys = malloc((l->n ? l->n : 1) * SITE_BANDS * sizeof(*keys));
+    if (!keys) return 0;
+    size_t m = 0;
+    for (size_t i = 0; i < l->n; i++) {
+        if (!l->sites[i].fp.aps) continue;
+        for (unsigned b = 0; b < SITE_BANDS; b++) {
+            keys[m].key = band_key(&l->sites[i].fp, b);
+            keys[m++].site = (uint32_t)i;
+        }
+    }
+    qsort(keys, m, sizeof(*keys), cmp_key);
+    free(l->keys);
+    l->keys = keys;
+    l->nkeys = m;
+    return 1;
+}
+
+int site_name_ok(const char *name)
+{
+    size_t n = strlen(name);
+    if (n == 0 || n >= SITE_NAME_SIZE || name[0] == '.') return 0;
+    return strspn(name, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._-") == n;
+}
+
+long site_lib_find(const struct site_lib *l, const char *name)
+{
+    for (size_t i = 0; i < l->n; i++) {
+        if (strcmp(l->sites[i].name, name) == 0) return (long)i;
+    }
+    return -1;
+}
+
+long site_lib_add(struct site_lib *l, const char *name, const struct site_fp *fp)
+{
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 64;
+        struct site *s = realloc(l->sites, cap * sizeof(*s));
+        if (!s) return -1;
+        l->sites = s;
+        l->cap = cap;
+    }
+    struct site *s = &l->sites[l->n];
+    memset(s, 0, sizeof(*s));
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->fp = *fp;
+    return (long)l->n++;
+}
+
+long site_lib_put(struct site_lib *l, const char *name, const struct site_fp *fp)
+{
+    long i = site_lib_find(l, name);
+    if (i >= 0) l->sites[i].fp = *fp;
+    else i = site_lib_add(l, name, fp);
+    return i >= 0 && site_lib_index(l) ? i : -1;
+}
+
+/* Candidates are collected once each; the first SITE_MAX_CANDIDATES are enough for any real site. */
+long site_lib_match(const struct site_lib *l, const struct site_fp *fp, float *score)
+{
+    uint32_t cand[SITE_MAX_CANDIDATES];
+    size_t nc = 0, nkeys = l->nkeys;
+    long best = -1;
+    float best_score = 0;
+    if (!fp->aps || !l->keys) return -1;
+
+    for (unsigned b = 0; b < SITE_BANDS && nc < SITE_MAX_CANDIDATES; b++) {
+        uint64_t key = band_key(fp, b);
+        size_t lo = 0, hi = nkeys;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (l->keys[mid].key < key) lo = mid + 1;
+            else hi = mid;
+        }
+        for (; lo < nkeys && l->keys[lo].key == key && nc < SITE_MAX_CANDIDATES; lo++) {
+            uint32_t s = l->keys[lo].site;
+            size_t j = 0;
+            while (j < nc && cand[j] != s) j++;
+            if (j < nc) continue;
+            cand[nc++] = s;
+            float sc = site_score(fp, &l->sites[s].fp);
+            if (sc > best_score) {
+                best_score = sc;
+                best = s;
+            }
+        }
+    }
+    if (best_score < SITE_MATCH) best = -1;
+    if (score) *score = best_score;
+    return best;
+}
+
+long site_lib_match_all(const struct site_lib *l, const struct site_fp *fp, float *score)
+{
+    long best = -1;
+    float best_score = 0;
+    for (size_t i = 0; i < l->n; i++) {
+        float sc = site_score(fp, &l->sites[i].fp);
+        if (sc > best_score) {
+            best_score = sc;
+            best = (long)i;
+        }
+    }
+    if (best_score < SITE_MATCH) best = -1;
+    if (score) *score = best_score;
+    return best;
+}
+
+void site_baseline_merge(struct site_baseline *b, const struct site_baseline *visit)
+{
+    if (!visit->samples) return;
+    double old = (double)(b->samples < SITE_BASELINE_SAMPLES ? b->samples : SITE_BASELINE_SAMPLES);
+    double now = (double)visit->samples, total = old + now;
+    b->snr_db = (float)((b->snr_db * old + visit->snr_db * now) / total);
+    b->signal_dbm = (float)((b->signal_dbm * old + visit->signal_dbm * now) / total);
+    b->health = (float)((b->health * old + visit->health * now) / total);
+    b->samples += visit->samples;
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* NAME SNR SIGNAL HEALTH SAMPLES APS MINS(8 hex each) RSSI(1 hex each) */
+static int parse_line(struct site_lib *l, char *line)
+{
+    char name[64], sig[SITE_HASHES * 8 + 2], rssi[SITE_HASHES + 2];
+    struct site_baseline base;
+    unsigned long long samples;
+    unsigned aps;
+    struct site_fp fp;
+    if (sscanf(line, "%63s %f %f %f %llu %u %513s %65s", name, &base.snr_db, &base.signal_dbm, &base.health,
+               &samples, &aps, sig, rssi) != 8) {
+        return 0;
+    }
+    if (!site_name_ok(name) || strlen(sig) != SITE_HASHES * 8 || strlen(rssi) != SITE_HASHES) return 0;
+    for (int k = 0; k < SITE_HASHES; k++) {
+        uint32_t v = 0;
+        for (int j = 0; j < 8; j++) {
+            int d = hex_nibble(sig[k * 8 + j]);
+            if (d < 0) return 0;
+            v = v << 4 | (uint32_t)d;
+        }
+        int r = hex_nibble(rssi[k]);
+        if (r < 0) return 0;
+        fp.min[k] = v;
+        fp.rssi[k] = (uint8_t)r;
+    }
+    base.samples = samples;
+    fp.aps = aps;
+    long i = site_lib_add(l, name, &fp);
+    if (i < 0) return 0;
+    l->sites[i].base = base;
+    return 1;
+}
+
+int site_lib_load(struct site_lib *l, const char *path, char *err, size_t err_size)
+{
+    memset(l, 0, sizeof(*l));
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        if (errno == ENOENT) return site_lib_index(l);
+        snprintf(err, err_size, "cannot open %s: %s", path, strerror(errno));
+        return 0;
+    }
+    char line[SITE_HASHES * 10 + 160];
+    int lineno = 0, ok = 1;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+        if (!parse_line(l, line)) {
+            snprintf(err, err_size, "%s: line %d: bad site", path, lineno);
+            ok = 0;
+        }
+    }
+    fclose(fp);
+    if (ok && !site_lib_index(l)) {
+        snprintf(err, err_size, "out of memory");
+        ok = 0;
+    }
+    if (!ok) site_lib_free(l);
+    return ok;
+}
+
+/* Written next to the library and renamed over it, so a reader never sees half a file. */
+int site_lib_save(const struct site_lib *l, const char *path, char *err, size_t err_size)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) {
+        snprintf(err, err_size, "cannot write %s: %s", tmp, strerror(errno));
+        return 0;
+    }
+    fprintf(fp, "# name snr_db signal_dbm health samples aps minhash rssi\n");
+    for (size_t i = 0; i < l->n; i++) {
+        const struct site *s = &l->sites[i];
+        fprintf(fp, "%s %.2f %.2f %.2f %llu %u ", s->name, s->base.snr_db, s->base.signal_dbm, s->base.health,
+                (unsigned long long)s->base.samples, s->fp.aps);
+        for (int k = 0; k < SITE_HASHES; k++) fprintf(fp, "%08x", s->fp.min[k]);
+        fputc(' ', fp);
+        for (int k = 0; k < SITE_HASHES; k++) fputc("0123456789abcdef"[s->fp.rssi[k] & 15], fp);
+        fputc('\n', fp);
+    }
+    if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+        snprintf(err, err_size, "cannot write %s: %s", path, strerror(errno));
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+void site_lib_free(struct site_lib *l)
+{
+    free(l->sites);
+    free(l->keys);
+    memset(l, 0, sizeof(*l));
+}
@@ -0,0 +1,109 @@
+#ifndef SNR_SITE_H
+#define SNR_SITE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Site recognition from the access points in view.
+ *
+ * A fingerprint is a MinHash signature of the visible BSSID set: for each
+ * of SITE_HASHES hash functions, the smallest hash of any BSSID. Two
+ * fingerprints agree in a slot with probability equal to the Jaccard
+ * similarity of their sets, so the fraction of equal slots estimates it
+ * from 320 bytes, however many APs a site has. Next to each slot is the
+ * signal of the BSSID that won it, in SITE_RSSI_STEP_DB buckets: two
+ * floors of one building see the same APs, but not equally loud.
+ *
+ * The library finds candidates by locality-sensitive hashing: the
+ * signature is cut into SITE_BANDS bands of SITE_ROWS slots, and a site
+ * is a candidate if any band matches exactly. With 2 rows in 32 bands a
+ * site with Jaccard 0.3 is found 95% of the time and one with 0.5 almost
+ * always, while sites sharing no AP only collide through the 64-bit band
+ * keys. The band keys of all sites sit in one sorted array, so a lookup
+ * is SITE_BANDS binary searches plus a comparison per candidate.
+ */
+
+#define SITE_HASHES 64
+#define SITE_BANDS 32
+#define SITE_ROWS (SITE_HASHES / SITE_BANDS)
+#define SITE_MIN_DBM (-90)          /* weaker APs come and go between scans */
+#define SITE_RSSI_STEP_DB 8
+#define SITE_MATCH 0.4f             /* least score that counts as being at a site */
+#define SITE_MAX_APS 512
+#define SITE_MAX_CANDIDATES 256
+#define SITE_NAME_SIZE 32
+
+struct site_ap {
+    uint8_t bssid[6];
+    int8_t signal_dbm;
+};
+
+struct site_fp {
+    uint32_t min[SITE_HASHES];
+    uint8_t rssi[SITE_HASHES];  /* signal bucket of the BSSID behind each min */
+    uint32_t aps;               /* BSSIDs hashed; 0 matches nothing */
+};
+
+/* What the link looked like at the site: means over the samples taken there. */
+struct site_baseline {
+    float snr_db;
+    float signal_dbm;
+    float health;
+    uint64_t samples;
+};
+
+struct site {
+    char name[SITE_NAME_SIZE];
+    struct site_fp fp;
+    struct site_baseline base;
+};
+
+struct site_key {
+    uint64_t key;               /* band number and its slots, hashed */
+    uint32_t site;
+};
+
+struct site_lib {
+    struct site *sites;
+    size_t n, cap;
+    struct site_key *keys;      /* SITE_BANDS per site with APs, sorted by key */
+    size_t nkeys;
+};
+
+/* Fingerprints the APs at or above SITE_MIN_DBM. */
+void site_fingerprint(const struct site_ap *aps, size_t n, struct site_fp *fp);
+
+/*
+ * Estimated Jaccard similarity, with slots whose signal buckets are more
+ * than one apart counting half.
+ */
+float site_score(const struct site_fp *a, const struct site_fp *b);
+
+/*
+ * Library file: a line per site of name, baseline, and the signature in
+ * hex. Missing is an empty library. Names are [A-Za-z0-9._-].
+ */
+int site_lib_load(struct site_lib *l, const char *path, char *err, size_t err_size);
+int site_lib_save(const struct site_lib *l, const char *path, char *err, size_t err_size);
+void site_lib_free(struct site_lib *l);
+int site_name_ok(const char *name);
+
+/* Adds a site or replaces the one with its name, and reindexes; returns its index, -1 when out of memory. */
+long site_lib_put(struct site_lib *l, const char *name, const struct site_fp *fp);
+long site_lib_find(const struct site_lib *l, const char *name);
+
+/* Bulk loading: appends without a name check or reindexing, then site_lib_index once. */
+long site_lib_add(struct site_lib *l, const char *name, const struct site_fp *fp);
+int site_lib_index(struct site_lib *l);
+
+/* The best scoring candidate of at least SITE_MATCH, or -1. score may be NULL. */
+long site_lib_match(const struct site_lib *l, const struct site_fp *fp, float *score);
+
+/* Exact search over every site, for checking the index. */
+long site_lib_match_all(const struct site_lib *l, const struct site_fp *fp, float *score);
+
+/* Folds a visit's means into the baseline, weighting history up to a day of samples. */
+void site_baseline_merge(struct site_baseline *b, const struct site_baseline *visit);
+
+#endif
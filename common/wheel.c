@@ -0,0 +1,175 @@
+#include "wheel.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define SLOT_MASK (WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(l) ((unsigned)(l) * WHEEL_BITS)
+#define WHEEL_SPAN (1ull << LEVEL_SHIFT(WHEEL_LEVELS))
+
+static unsigned lowest_bit(uint64_t bits)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, bits);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctzll(bits);
+#endif
+}
+
+/* bits rotated right by n, so bit 0 is slot n. */
+static uint64_t rotate(uint64_t bits, unsigned n)
+{
+    return n ? bits >> n | bits << (WHEEL_SLOTS - n) : bits;
+}
+
+static void list_init(struct wheel_link *head)
+{
+    head->next = head->prev = head;
+}
+
+void wheel_init(struct wheel *w, uint64_t now)
+{
+    w->now = now;
+    w->count = 0;
+    for (unsigned l = 0; l < WHEEL_LEVELS; l++) {
+        w->occupied[l] = 0;
+        for (unsigned i = 0; i < WHEEL_SLOTS; i++) list_init(&w->slots[l][i]);
+    }
+}
+
+/* Links t into the slot its expiry falls in, seen from w->now. */
+static void place(struct wheel *w, struct timer *t)
+{
+    uint64_t at = t->expires < w->now ? w->now : t->expires;
+    uint64_t delta = at - w->now;
+    if (delta >= WHEEL_SPAN) at = w->now + WHEEL_SPAN - 1;
+
+    unsigned l = 0;
+    while (l < WHEEL_LEVELS - 1 && delta >= 1ull << LEVEL_SHIFT(l + 1)) l++;
+    unsigned i = (unsigned)(at >> LEVEL_SHIFT(l)) & SLOT_MASK;
+
+    struct wheel_link *head = &w->slots[l][i];
+    t->link.next = head;
+    t->link.prev = head->prev;
+    head->prev->next = &t->link;
+    head->prev = &t->link;
+    w->occupied[l] |= 1ull << i;
+}
+
+static void unlink_timer(struct wheel *w, struct timer *t)
+{
+    struct wheel_link *next = t->link.next, *prev = t->link.prev;
+    prev->next = next;
+    next->prev = prev;
+    t->link.next = t->link.prev = NULL;
+    /*
+     * The neighbours are the same list head only if the list is now empty.
+     * That head is a slot's, or run_tick's list of timers firing this tick.
+     */
+    uintptr_t off = (uintptr_t)next - (uintptr_t)w->slots;
+    if (next == prev && off < sizeof(w->slots)) {
+        size_t i = off / sizeof(struct wheel_link);
+        w->occupied[i / WHEEL_SLOTS] &= ~(1ull << (i % WHEEL_SLOTS));
+    }
+}
+
+void wheel_add(struct wheel *w, struct timer *t, uint64_t expires)
+{
+    if (timer_pending(t)) unlink_timer(w, t);
+    else w->count++;
+    t->expires = expires;
+    place(w, t);
+}
+
+void wheel_cancel(struct wheel *w, struct timer *t)
+{
+    if (!timer_pending(t)) return;
+    unlink_timer(w, t);
+    w->count--;
+}
+
+/* Moves slot i of level l onto the local list out, leaving the slot empty. */
+static void take_slot(struct wheel *w, unsigned l, unsigned i, struct wheel_link *out)
+{
+    struct wheel_link *head = &w->slots[l][i];
+    list_init(out);
+    if (head->next == head) return;
+    out->next = head->next;
+    out->prev = head->prev;
+    out->next->prev = out;
+    out->prev->next = out;
+    list_init(head);
+    w->occupied[l] &= ~(1ull << i);
+}
+
+static struct timer *pop(struct wheel_link *list)
+{
+    struct wheel_link *first = list->next;
+    if (first == list) return NULL;
+    list->next = first->next;
+    first->next->prev = list;
+    first->next = first->prev = NULL;
+    return (struct timer *)first;
+}
+
+/* Tick w->now: cascades whose level boundary it is, then fires level 0's slot. */
+static size_t run_tick(struct wheel *w)
+{
+    uint64_t tick = w->now;
+    struct wheel_link list;
+    struct timer *t;
+
+    for (unsigned l = 1; l < WHEEL_LEVELS && (tick & ((1ull << LEVEL_SHIFT(l)) - 1)) == 0; l++) {
+        take_slot(w, l, (unsigned)(tick >> LEVEL_SHIFT(l)) & SLOT_MASK, &list);
+        while ((t = pop(&list)) != NULL) place(w, t);
+    }
+
+    take_slot(w, 0, (unsigned)tick & SLOT_MASK, &list);
+    w->now = tick + 1;
+    size_t fired = 0;
+    while ((t = pop(&list)) != NULL) {
+        if (t->period) {
+            /* Fixed rate from the previous expiry; periods missed while late are skipped. */
+            uint64_t late = tick > t->expires ? tick - t->expires : 0;
+            t->expires += t->period * (late / t->period + 1);
+            place(w, t);
+        } else {
+            w->count--;
+        }
+        t->fn(t, tick);
+        fired++;
+    }
+    return fired;
+}
+
+uint64_t wheel_next(const struct wheel *w)
+{
+    uint64_t next = UINT64_MAX;
+    if (w->occupied[0]) next = w->now + lowest_bit(rotate(w->occupied[0], (unsigned)w->now & SLOT_MASK));
+
+    for (unsigned l = 1; l < WHEEL_LEVELS; l++) {
+        if (!w->occupied[l]) continue;
+        /* The first boundary of this level not yet run: now itself if aligned, else the next one. */
+        uint64_t block = w->now >> LEVEL_SHIFT(l);
+        if (w->now & ((1ull << LEVEL_SHIFT(l)) - 1)) block++;
+        uint64_t r = rotate(w->occupied[l], (unsigned)block & SLOT_MASK);
+        uint64_t at = (block + lowest_bit(r)) << LEVEL_SHIFT(l);
+        if (at < next) next = at;
+    }
+    return next;
+}
+
+size_t wheel_advance(struct wheel *w, uint64_t now)
+{
+    size_t fired = 0;
+    uint64_t next;
+    while ((next = wheel_next(w)) <= now) {
+        w->now = next;
+        fired += run_tick(w);
+    }
+    if (w->now <= now) w->now = now + 1;
+    return fired;
+}
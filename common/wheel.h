@@ -0,0 +1,76 @@
+#ifndef SNR_WHEEL_H
+#define SNR_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel. Time is in ticks, which are milliseconds of
+ * the monotonic clock in the sampler. The wheel has WHEEL_LEVELS levels of
+ * WHEEL_SLOTS slots each. A timer due within 64 ticks sits in a level 0
+ * slot by its exact tick. A timer further out sits in a coarser level.
+ * When time reaches that slot, the timer is redistributed one level down
+ * or more ("cascaded").
+ *
+ * Slots are intrusive doubly linked lists, so adding and cancelling a
+ * timer are O(1) and allocate nothing. Each level keeps a 64-bit mask of
+ * its non-empty slots. wheel_next and wheel_advance use the masks to skip
+ * idle ticks, so a sleeping caller does not step through every
+ * millisecond.
+ *
+ * A timer with a period is re-armed at a fixed rate before its callback
+ * runs. A late caller skips the missed periods instead of firing them
+ * all. The callback may cancel the timer or re-add it with another period.
+ * Not thread-safe: one thread owns a wheel and its timers.
+ */
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_LEVELS 5          /* 2^30 ticks ahead, 12 days in ms; later expiries wait at the top */
+
+struct wheel_link {
+    struct wheel_link *next, *prev;
+};
+
+struct timer;
+typedef void (*timer_fn)(struct timer *t, uint64_t now);
+
+struct timer {
+    struct wheel_link link;     /* next is NULL while not pending; keep first */
+    uint64_t expires;           /* tick it fires on */
+    uint64_t period;            /* 0 for a one-shot timer */
+    timer_fn fn;
+    void *arg;
+};
+
+struct wheel {
+    uint64_t now;               /* next tick to run */
+    size_t count;               /* pending timers */
+    uint64_t occupied[WHEEL_LEVELS];
+    struct wheel_link slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+void wheel_init(struct wheel *w, uint64_t now);
+
+/* Arms t to fire on tick expires, or on the next tick run if that is past. A pending t is moved. */
+void wheel_add(struct wheel *w, struct timer *t, uint64_t expires);
+
+/* Does nothing if t is not pending. */
+void wheel_cancel(struct wheel *w, struct timer *t);
+
+static inline int timer_pending(const struct timer *t)
+{
+    return t->link.next != NULL;
+}
+
+/* Runs every timer due up to and including tick now; returns how many fired. */
+size_t wheel_advance(struct wheel *w, uint64_t now);
+
+/*
+ * The first tick at which wheel_advance has work, or UINT64_MAX if none
+ * is pending. Work may be a cascade that fires nothing, so this is a lower
+ * bound on the next expiry. It is the tick to sleep until.
+ */
+uint64_t wheel_next(const struct wheel *w);
+
+#endif
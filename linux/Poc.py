@@ -1,3 +1,4 @@
+import json
 import os
 import re
 import time
@@ -11,53 +12,127 @@ THRESHOLD_AWAY = 15
 SAMPLING_RATE = 0.5
 SMOOTHING_FACTOR = 0.7
 
-def get_wireless_metrics(interface):
+PROBE_SAMPLES = 3
+PROBE_FAILURES = 5
+PROBE_CACHE = os.path.expanduser("~/.cache/snr-poc/probe.json")
+
+def read_iw(interface):
     metrics = {'signal': None, 'noise': None}
-    
-    # Method 1: Use `iw`
-    try:
-        output = subprocess.check_output(
-            ["iw", "dev", interface, "link"],
-            stderr=subprocess.DEVNULL,
-            text=True
-        )
-        sig_match = re.search(r"signal:\s*(-?\d+)\s*dBm", output)
-        if sig_match:
-            metrics['signal'] = int(sig_match.group(1))
-    except Exception:
-        pass
+    output = subprocess.check_output(
+        ["iw", "dev", interface, "link"],
+        stderr=subprocess.DEVNULL,
+        text=True
+    )
+    sig_match = re.search(r"signal:\s*(-?\d+)\s*dBm", output)
+    if sig_match:
+        metrics['signal'] = int(sig_match.group(1))
+    return metrics
 
-    if metrics['signal'] is None:
-        try:
-            with open("/proc/net/wireless", "r") as f:
-                for line in f.readlines()[2:]:
-                    if interface in line:
-                        parts = line.strip().split()
-                        if len(parts) >= 5:
-                            # Convert to dBm from quality (heuristic)
-                            metrics['signal'] = int(float(parts[3]))
-                            metrics['noise'] = int(float(parts[4]))
-                            break
-        except Exception:
-            pass
+def read_proc(interface):
+    metrics = {'signal': None, 'noise': None}
+    with open("/proc/net/wireless", "r") as f:
+        for line in f.readlines()[2:]:
+            if interface in line:
+                parts = line.strip().split()
+                if len(parts) >= 5:
+                    # Convert to dBm from quality (heuristic)
+                    metrics['signal'] = int(float(parts[3]))
+                    metrics['noise'] = int(float(parts[4]))
+                    break
+    return metrics
+
+def read_iwconfig(interface):
+    metrics = {'signal': None, 'noise': None}
+    output = subprocess.check_output(
+        ["iwconfig", interface],
+        stderr=subprocess.DEVNULL,
+        text=True
+    )
+    sig_match = re.search(r"Signal level=(-?\d+) dBm", output)
+    noise_match = re.search(r"Noise level=(-?\d+) dBm", output)
+    if sig_match:
+        metrics['signal'] = int(sig_match.group(1))
+    if noise_match:
+        metrics['noise'] = int(noise_match.group(1))
+    return metrics
+
+BACKENDS = {'iw': read_iw, 'proc': read_proc, 'iwconfig': read_iwconfig}
 
-    if metrics['signal'] is None:
+def probe_key(interface):
+    try:
+        driver = os.path.basename(os.readlink(f"/sys/class/net/{interface}/device/driver"))
+    except OSError:
+        driver = "none"
+    return f"{os.uname().release}|{driver}|{interface}"
+
+# Time each method once and keep the cheapest one that yields a signal;
+# methods that also report noise win. The choice is cached on disk per
+# kernel release, driver and interface.
+def probe_backends(interface, use_cache=True):
+    key = probe_key(interface)
+    cache = {}
+    try:
+        with open(PROBE_CACHE, "r") as f:
+            cache = json.load(f)
+    except (OSError, ValueError):
+        pass
+    if use_cache and cache.get(key) in BACKENDS:
+        return cache[key]
+
+    best, best_rank = None, None
+    for name, reader in BACKENDS.items():
+        costs = []
+        metrics = None
+        for _ in range(PROBE_SAMPLES):
+            start = time.perf_counter()
+            try:
+                metrics = reader(interface)
+            except Exception:
+                metrics = None
+            costs.append(time.perf_counter() - start)
+            if metrics is None or metrics['signal'] is None:
+                break
+        if metrics is None or metrics['signal'] is None:
+            continue
+        rank = (metrics['noise'] is None, sorted(costs)[len(costs) // 2])
+        if best_rank is None or rank < best_rank:
+            best, best_rank = name, rank
+
+    if best is not None:
+        cache[key] = best
         try:
-            output = subprocess.check_output(
-                ["iwconfig", interface],
-                stderr=subprocess.DEVNULL,
-                text=True
-            )
-            sig_match = re.search(r"Signal level=(-?\d+) dBm", output)
-            noise_match = re.search(r"Noise level=(-?\d+) dBm", output)
-            if sig_match:
-                metrics['signal'] = int(sig_match.group(1))
-            if noise_match:
-                metrics['noise'] = int(noise_match.group(1))
-        except Exception:
+            os.makedirs(os.path.dirname(PROBE_CACHE), exist_ok=True)
+            tmp = PROBE_CACHE + ".tmp"
+            with open(tmp, "w") as f:
+                json.dump(cache, f)
+            os.replace(tmp, PROBE_CACHE)
+        except OSError:
             pass
-
-    return metrics
+    return best
+
+# Calls only the probed backend; re-probes after repeated failures.
+class WirelessSampler:
+    def __init__(self, interface):
+        self.interface = interface
+        self.backend = probe_backends(interface)
+        self.failures = 0
+
+    def sample(self):
+        metrics = {'signal': None, 'noise': None}
+        if self.backend is not None:
+            try:
+                metrics = BACKENDS[self.backend](self.interface)
+            except Exception:
+                pass
+        if metrics['signal'] is not None:
+            self.failures = 0
+            return metrics
+
+        self.failures += 1
+        if self.failures >= PROBE_FAILURES:
+            self.failures = 0
+            self.backend = probe_backends(self.interface, use_cache=False)
+        return metrics
 
 def calculate_snr(metrics):
     if metrics['signal'] is not None and metrics['noise'] is not None:
@@ -79,8 +154,9 @@ def main():
         os.system("ip -o link | awk '!/loopback/ {print $2}' | cut -d':' -f1")
         sys.exit(1)
 
+    sampler = WirelessSampler(INTERFACE)
     smoothed_snr = None
-    print("Wi-Fi Proximity Detection using SNR")
+    print(f"Wi-Fi Proximity Detection using SNR (backend: {sampler.backend or 'none'})")
     print("=" * 50)
     print(f"{'Time':<8} | {'Signal':>7} | {'Noise':>7} | {'SNR':>6} | {'Dist':>6} | {'Status':<25}")
     print("-" * 75)
@@ -88,7 +164,7 @@ def main():
     try:
         while True:
             timestamp = time.strftime("%H:%M:%S")
-            metrics = get_wireless_metrics(INTERFACE)
+            metrics = sampler.sample()
             snr = calculate_snr(metrics)
 
             if snr is not None:
@@ -0,0 +1,224 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "align.h"
+
+#define NO_SAMPLE UINT64_MAX
+
+void align_init(struct align *a, uint64_t step_ns, int fill, int column)
+{
+    memset(a, 0, sizeof(*a));
+    a->step_ns = step_ns;
+    a->max_gap_ns = ALIGN_MAX_GAP_MS * 1000000ull;
+    a->fill = fill;
+    a->column = column;
+}
+
+int align_parse_fill(const char *s, int *fill)
+{
+    if (strcmp(s, "last") == 0) *fill = ALIGN_LAST;
+    else if (strcmp(s, "linear") == 0) *fill = ALIGN_LINEAR;
+    else return 0;
+    return 1;
+}
+
+int align_parse_column(const char *s, int *column)
+{
+    if (strcmp(s, "snr") == 0) *column = ALIGN_SNR;
+    else if (strcmp(s, "signal") == 0) *column = ALIGN_SIGNAL;
+    else if (strcmp(s, "health") == 0) *column = ALIGN_HEALTH;
+    else return 0;
+    return 1;
+}
+
+/* Splits a store=DIR term out of terms into dir, leaving the query terms in rest. */
+static int split_store(const char *terms, char *dir, size_t dir_size, char *rest, size_t rest_size)
+{
+    size_t used = 0;
+    rest[0] = '\0';
+    for (const char *p = terms; *p;) {
+        p += strspn(p, " \t,");
+        size_t len = strcspn(p, " \t,");
+        if (len == 0) break;
+        if (len > 6 && strncmp(p, "store=", 6) == 0) {
+            if (len - 6 >= dir_size) return 0;
+            memcpy(dir, p + 6, len - 6);
+            dir[len - 6] = '\0';
+        } else {
+            if (used + len + 2 > rest_size) return 0;
+            rest[used++] = ' ';
+            memcpy(rest + used, p, len);
+            used += len;
+            rest[used] = '\0';
+        }
+        p += len;
+    }
+    return 1;
+}
+
+int align_add(struct align *a, const char *dir, const char *where, const char *terms, char *err, size_t err_size)
+{
+    char store_dir[200], rest[512], text[1024];
+    snprintf(store_dir, sizeof(store_dir), "%s", dir);
+    if (a->n == ALIGN_MAX_SERIES) {
+        snprintf(err, err_size, "at most %d series", ALIGN_MAX_SERIES);
+        return 0;
+    }
+    if (!split_store(terms, store_dir, sizeof(store_dir), rest, sizeof(rest))) {
+        snprintf(err, err_size, "series too long");
+        return 0;
+    }
+    struct align_series *s = calloc(1, sizeof(*s));
+    if (!s) {
+        snprintf(err, err_size, "out of memory");
+        return 0;
+    }
+    snprintf(s->label, sizeof(s->label), "%s", terms);
+    snprintf(text, sizeof(text), "%s%s", where, rest);
+    if (!query_parse(text, &s->q, err, err_size)) {
+        free(s);
+        return 0;
+    }
+
+    /* Series of one store share its view. */
+    for (size_t i = 0; i < a->n && !s->view; i++) {
+        if (strcmp(a->series[i]->view->dir, store_dir) == 0) s->view = a->series[i]->view;
+    }
+    if (!s->view) {
+        s->view = malloc(sizeof(*s->view));
+        if (!s->view || !store_view_open(s->view, store_dir, err, err_size)) {
+            if (s->view) snprintf(text, sizeof(text), "%s: %s", store_dir, err);
+            else snprintf(text, sizeof(text), "out of memory");
+            snprintf(err, err_size, "%s", text);
+            free(s->view);
+            free(s);
+            return 0;
+        }
+        s->owns_view = 1;
+    }
+    query_bind(&s->q, s->view);
+    a->series[a->n++] = s;
+    return 1;
+}
+
+void align_free(struct align *a)
+{
+    for (size_t i = 0; i < a->n; i++) {
+        struct align_series *s = a->series[i];
+        store_cursor_close(&s->cur);
+        if (s->owns_view) {
+            store_view_close(s->view);
+            free(s->view);
+        }
+        free(s);
+    }
+    a->n = 0;
+}
+
+static double value_at(const struct block_columns *c, size_t i, int column)
+{
+    switch (column) {
+    case ALIGN_SIGNAL: return c->signal_dbm[i];
+    case ALIGN_HEALTH: return c->health[i];
+    default: return c->snr_db[i];
+    }
+}
+
+/* Moves the series' next sample into next_ts and next; NO_SAMPLE at the end. Returns 0 on a read error. */
+static int load_next(struct align *a, struct align_series *s)
+{
+    uint32_t need = a->column == ALIGN_HEALTH ? FIELD_HEALTH : FIELD_SIGNAL;
+    for (;;) {
+        while (s->row < s->nrows) {
+            size_t i = s->rows[s->row++];
+            /* A raw file may hold a sample or two out of order: the merge cannot go back. */
+            if (s->prev_ts != NO_SAMPLE && s->cols->ts_ns[i] < s->prev_ts) continue;
+            s->next_ts = s->cols->ts_ns[i];
+            s->next = value_at(s->cols, i, a->column);
+            a->samples++;
+            return 1;
+        }
+        if (!(s->cols = store_cursor_next(&s->cur))) {
+            s->next_ts = NO_SAMPLE;
+            return !s->cur.failed;
+        }
+        query_mask(&s->q, s->cols, s->mask);
+        s->q.kern->bits_u32(s->cols->fields, s->cols->n, need, 0, s->mask);
+        s->nrows = s->q.kern->select(s->mask, s->cols->n, s->rows);
+        s->row = 0;
+    }
+}
+
+/* Steps the series to grid time t: prev becomes its last sample at or before t. */
+static int advance(struct align *a, struct align_series *s, uint64_t t)
+{
+    int ok = 1;
+    while (ok && s->next_ts <= t) {
+        s->prev_ts = s->next_ts;
+        s->prev = s->next;
+        ok = load_next(a, s);
+    }
+    return ok;
+}
+
+static double fill(const struct align *a, const struct align_series *s, uint64_t t)
+{
+    if (s->prev_ts == NO_SAMPLE) return NAN;
+    if (s->prev_ts == t) return s->prev;
+    if (a->fill == ALIGN_LAST) return t - s->prev_ts <= a->max_gap_ns ? s->prev : NAN;
+    if (s->next_ts == NO_SAMPLE || s->next_ts - s->prev_ts > a->max_gap_ns) return NAN;
+    return s->prev + (s->next - s->prev) * (double)(t - s->prev_ts) / (double)(s->next_ts - s->prev_ts);
+}
+
+int align_run(struct align *a, align_row_fn fn, void *ctx)
+{
+    uint64_t from = 0, to = UINT64_MAX, first = NO_SAMPLE;
+    int ok = a->n > 0;
+    a->samples = 0;
+    for (size_t i = 0; ok && i < a->n; i++) {
+        struct align_series *s = a->series[i];
+        store_cursor_close(&s->cur);
+        ok = store_cursor_open(&s->cur, s->view, &s->q.prune);
+        s->cols = NULL;
+        s->nrows = s->row = 0;
+        s->prev_ts = s->next_ts = NO_SAMPLE;
+        ok = ok && load_next(a, s);
+        if (s->q.prune.from_ns > from) from = s->q.prune.from_ns;
+        if (s->q.prune.to_ns < to) to = s->q.prune.to_ns;
+        if (s->next_ts < first) first = s->next_ts;
+    }
+
+    double values[ALIGN_MAX_SERIES];
+    int more = 1;
+    if (ok && !a->step_ns) {
+        /* As-of join: a row per sample of the first series. */
+        uint64_t t;
+        while (ok && more && (t = a->series[0]->next_ts) != NO_SAMPLE) {
+            for (size_t i = 0; ok && i < a->n; i++) ok = advance(a, a->series[i], t);
+            for (size_t i = 0; i < a->n; i++) values[i] = fill(a, a->series[i], t);
+            if (ok) more = fn(ctx, t, values, a->n);
+        }
+    } else if (ok && first != NO_SAMPLE) {
+        if (!from) from = first - first % a->step_ns;
+        for (uint64_t t = from; ok && more && t < to; t += a->step_ns) {
+            uint64_t last = 0;
+            int live = 0;
+            for (size_t i = 0; ok && i < a->n; i++) {
+                struct align_series *s = a->series[i];
+                ok = advance(a, s, t);
+                live |= s->next_ts != NO_SAMPLE;
+                if (s->prev_ts != NO_SAMPLE && s->prev_ts > last) last = s->prev_ts;
+            }
+            /* Without to=, the grid ends at the last sample. */
+            if (!ok || (!live && to == UINT64_MAX && t > last)) break;
+            for (size_t i = 0; i < a->n; i++) values[i] = fill(a, a->series[i], t);
+            more = fn(ctx, t, values, a->n);
+            if (t > UINT64_MAX - a->step_ns) break;
+        }
+    }
+
+    for (size_t i = 0; i < a->n; i++) store_cursor_close(&a->series[i]->cur);
+    return ok;
+}
@@ -0,0 +1,90 @@
+#ifndef SNR_ALIGN_H
+#define SNR_ALIGN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/kernel.h"
+#include "query.h"
+#include "store.h"
+
+/*
+ * Time alignment of several series, for comparing two radios on one host
+ * or one access point seen from two hosts.
+ *
+ * A series is a query over a store: a store directory and query terms,
+ * usually iface= or bssid=. Each series reads its store through its own
+ * store_cursor, so the samples arrive in time order and a block at a time.
+ * The series advance together like the inputs of a merge join. Each
+ * sample is looked at once and nothing is collected in between, so a run
+ * costs O(samples + rows * series).
+ *
+ * The rows fall on a grid. With a step, the grid is every step from the
+ * query's from= (or the first sample, rounded down to the step) to its to=
+ * (or the last sample). With no step it is an as-of join: one row per
+ * sample of the first series, the others aligned to it. A series' value at
+ * a grid time is its last sample at or before that time (ALIGN_LAST), or
+ * the straight line between the samples either side (ALIGN_LINEAR). A
+ * series has no value (NaN) where the sample to use is older than
+ * max_gap_ns or, for ALIGN_LINEAR, where the samples either side are
+ * further apart than that. Only samples with the value's field count, and
+ * samples older than the last one used are skipped.
+ */
+
+#define ALIGN_MAX_SERIES 16
+#define ALIGN_MAX_GAP_MS 10000
+
+enum align_fill {
+    ALIGN_LAST,
+    ALIGN_LINEAR,
+};
+
+enum align_column {
+    ALIGN_SNR,
+    ALIGN_SIGNAL,
+    ALIGN_HEALTH,
+};
+
+struct align_series {
+    char label[160];
+    struct query q;
+    struct store_view *view;    /* shared by the series of one store */
+    int owns_view;
+    struct store_cursor cur;
+    const struct block_columns *cols;
+    uint32_t rows[BLOCK_MAX_SAMPLES + KERNEL_SLACK];
+    size_t nrows, row;
+    uint64_t mask[KERNEL_MASK_WORDS(BLOCK_MAX_SAMPLES)];
+    /* The samples either side of the grid time; ts is UINT64_MAX for none. */
+    uint64_t prev_ts, next_ts;
+    double prev, next;
+};
+
+struct align {
+    uint64_t step_ns;           /* 0 for an as-of join on the first series */
+    uint64_t max_gap_ns;
+    int fill, column;
+    size_t n;
+    struct align_series *series[ALIGN_MAX_SERIES];
+    uint64_t samples;           /* read by the last align_run */
+};
+
+/* Called per row with one value per series, NaN where a series has none; return 0 to stop. */
+typedef int (*align_row_fn)(void *ctx, uint64_t ts_ns, const double *values, size_t n);
+
+void align_init(struct align *a, uint64_t step_ns, int fill, int column);
+
+/*
+ * Adds a series: query terms, with an optional store=DIR term for a store
+ * other than dir. where is ANDed with every series' terms. The label is
+ * the terms as given.
+ */
+int align_add(struct align *a, const char *dir, const char *where, const char *terms, char *err, size_t err_size);
+
+int align_run(struct align *a, align_row_fn fn, void *ctx);
+void align_free(struct align *a);
+
+int align_parse_fill(const char *s, int *fill);
+int align_parse_column(const char *s, int *column);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SNR_BACKEND_H
+#define SNR_BACKEND_H
+
+#include "../common/sample.h"
+
+#define BACKEND_DEADLINE_MS 1000
+#define SAMPLE_TIMEOUT (-1)
+
+/*
+ * A sampling backend. open/sample return 1 on success and 0 on failure,
+ * like run_netsh in windows/poc.c. sample returns SAMPLE_TIMEOUT instead
+ * when the call was abandoned at deadline_ms (0 means BACKEND_DEADLINE_MS),
+ * which must be set before open.
+ */
+struct backend {
+    const char *name;
+    unsigned fields;    /* FIELD_* bits a successful sample fills */
+    unsigned deadline_ms;
+    int (*open)(struct backend *b, const char *ifname);
+    int (*sample)(struct backend *b, struct wifi_sample *s);
+    void (*close)(struct backend *b);
+    void *priv;
+};
+
+static inline unsigned backend_deadline_ms(const struct backend *b)
+{
+    return b->deadline_ms ? b->deadline_ms : BACKEND_DEADLINE_MS;
+}
+
+extern const struct backend nl80211_backend;
+extern const struct backend iw_backend;
+extern const struct backend procfs_backend;
+extern const struct backend iwconfig_backend;
+
+struct runner;
+
+int parse_iw_link(const char *out, struct wifi_sample *s);
+
+/*
+ * Samples up to 16 interfaces in one tick: every `iw dev <if> link` runs
+ * concurrently under one deadline and each output is parsed as soon as
+ * its command ends. Timed-out interfaces come back as FIELD_GAP samples.
+ * Returns how many interfaces produced a signal.
+ */
+int iw_link_all(struct runner *r, const char *const *ifnames, int n, struct wifi_sample *out,
+                unsigned deadline_ms);
+int parse_iwconfig(const char *out, struct wifi_sample *s);
+int parse_proc_wireless(const char *text, const char *ifname, struct wifi_sample *s);
+void iw_set_command(struct backend *b, const char *cmd);
+
+#endif
@@ -0,0 +1,204 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "batchread.h"
+
+#define RING_ENTRIES 256
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned submit, unsigned complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned op, void *arg, unsigned n)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+static void uring_teardown(struct batch_reader *br)
+{
+    if (br->sqes) munmap(br->sqes, br->sqes_len);
+    if (br->cq_ptr && br->cq_ptr != br->sq_ptr) munmap(br->cq_ptr, br->cq_len);
+    if (br->sq_ptr) munmap(br->sq_ptr, br->sq_len);
+    if (br->ring_fd >= 0) close(br->ring_fd);
+    br->sqes = NULL;
+    br->sq_ptr = br->cq_ptr = NULL;
+    br->ring_fd = -1;
+    br->use_uring = 0;
+}
+
+static int uring_init(struct batch_reader *br)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    br->ring_fd = uring_setup(RING_ENTRIES, &p);
+    if (br->ring_fd < 0) return 0;
+    br->entries = p.sq_entries;
+
+    br->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    br->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (br->cq_len > br->sq_len) br->sq_len = br->cq_len;
+        br->cq_len = br->sq_len;
+    }
+
+    br->sq_ptr = mmap(NULL, br->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      br->ring_fd, IORING_OFF_SQ_RING);
+    if (br->sq_ptr == MAP_FAILED) {
+        br->sq_ptr = NULL;
+        uring_teardown(br);
+        return 0;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        br->cq_ptr = br->sq_ptr;
+    } else {
+        br->cq_ptr = mmap(NULL, br->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          br->ring_fd, IORING_OFF_CQ_RING);
+        if (br->cq_ptr == MAP_FAILED) {
+            br->cq_ptr = NULL;
+            uring_teardown(br);
+            return 0;
+        }
+    }
+    br->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    br->sqes = mmap(NULL, br->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    br->ring_fd, IORING_OFF_SQES);
+    if (br->sqes == MAP_FAILED) {
+        br->sqes = NULL;
+        uring_teardown(br);
+        return 0;
+    }
+
+    char *sq = br->sq_ptr, *cq = br->cq_ptr;
+    br->sq_head = (unsigned *)(sq + p.sq_off.head);
+    br->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    br->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    br->sq_array = (unsigned *)(sq + p.sq_off.array);
+    br->cq_head = (unsigned *)(cq + p.cq_off.head);
+    br->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    br->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    br->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    /* One registered buffer covers every slot; READ_FIXED addresses into it. */
+    struct iovec iov = { br->arena, (size_t)br->slots * br->slot_size };
+    if (uring_register(br->ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        uring_teardown(br);
+        return 0;
+    }
+    br->use_uring = 1;
+    return 1;
+}
+
+int batch_init(struct batch_reader *br, unsigned slots, size_t slot_size, int want_uring)
+{
+    memset(br, 0, sizeof(*br));
+    br->ring_fd = -1;
+    br->slots = slots;
+    br->slot_size = slot_size;
+
+    /* Page-aligned so the registered buffer pins whole pages. */
+    if (posix_memalign((void **)&br->arena, 4096, (size_t)slots * slot_size) != 0) return 0;
+    memset(br->arena, 0, (size_t)slots * slot_size);
+
+    if (want_uring) uring_init(br);
+    return 1;
+}
+
+void batch_close(struct batch_reader *br)
+{
+    uring_teardown(br);
+    free(br->arena);
+    br->arena = NULL;
+}
+
+static unsigned read_pread(struct batch_reader *br, const int *fds, unsigned first, unsigned n,
+                           int *lens)
+{
+    unsigned ok = 0;
+    for (unsigned i = first; i < n; i++) {
+        char *slot = batch_slot(br, i);
+        ssize_t r = pread(fds[i], slot, br->slot_size - 1, 0);
+        br->syscalls++;
+        lens[i] = r < 0 ? -errno : (int)r;
+        slot[r > 0 ? r : 0] = '\0';
+        ok += r >= 0;
+    }
+    return ok;
+}
+
+static unsigned read_uring(struct batch_reader *br, const int *fds, unsigned n, int *lens)
+{
+    unsigned ok = 0, done = 0;
+
+    while (done < n) {
+        unsigned chunk = n - done < br->entries ? n - done : br->entries;
+        unsigned tail = *br->sq_tail, mask = *br->sq_mask;
+
+        for (unsigned k = 0; k < chunk; k++) {
+            unsigned i = done + k, idx = (tail + k) & mask;
+            struct io_uring_sqe *sqe = &br->sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->fd = fds[i];
+            sqe->addr = (uint64_t)(uintptr_t)batch_slot(br, i);
+            sqe->len = (uint32_t)(br->slot_size - 1);
+            sqe->off = 0;
+            sqe->buf_index = 0;
+            sqe->user_data = i;
+            br->sq_array[idx] = idx;
+        }
+        atomic_store_explicit((_Atomic unsigned *)br->sq_tail, tail + chunk, memory_order_release);
+
+        int r;
+        do {
+            r = uring_enter(br->ring_fd, chunk, chunk, IORING_ENTER_GETEVENTS);
+            br->syscalls++;
+        } while (r < 0 && errno == EINTR);
+        if (r < 0) {
+            /* Ring unusable (e.g. a seccomp filter): drop it for good. */
+            uring_teardown(br);
+            return ok + read_pread(br, fds, done, n, lens);
+        }
+
+        /* Reap the whole chunk; the enter above waited for all of it. */
+        unsigned seen = 0;
+        while (seen < chunk) {
+            unsigned head = *br->cq_head;
+            unsigned ctail = atomic_load_explicit((_Atomic unsigned *)br->cq_tail, memory_order_acquire);
+            if (head == ctail) {
+                uring_enter(br->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+                br->syscalls++;
+                continue;
+            }
+            for (; head != ctail; head++, seen++) {
+                const struct io_uring_cqe *cqe = &br->cqes[head & *br->cq_mask];
+                unsigned i = (unsigned)cqe->user_data;
+                lens[i] = cqe->res;
+                batch_slot(br, i)[cqe->res > 0 ? cqe->res : 0] = '\0';
+                ok += cqe->res >= 0;
+            }
+            atomic_store_explicit((_Atomic unsigned *)br->cq_head, head, memory_order_release);
+        }
+        done += chunk;
+    }
+    return ok;
+}
+
+unsigned batch_read(struct batch_reader *br, const int *fds, unsigned n, int *lens)
+{
+    if (n > br->slots) n = br->slots;
+    return br->use_uring ? read_uring(br, fds, n, lens) : read_pread(br, fds, 0, n, lens);
+}
@@ -0,0 +1,46 @@
+#ifndef SNR_BATCHREAD_H
+#define SNR_BATCHREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-tick reader for many small procfs/sysfs files. Slot i receives the
+ * contents of fds[i] read from offset 0. With io_uring the whole tick is
+ * one io_uring_enter per ring-full of READ_FIXED requests into a single
+ * registered arena; otherwise each slot costs one pread.
+ */
+struct batch_reader {
+    int use_uring;
+    unsigned slots;
+    size_t slot_size;
+    char *arena;
+    uint64_t syscalls;      /* reads or io_uring_enter calls issued so far */
+
+    int ring_fd;
+    unsigned entries;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+/* want_uring = 0 forces pread; io_uring falls back to pread if unavailable. */
+int batch_init(struct batch_reader *br, unsigned slots, size_t slot_size, int want_uring);
+void batch_close(struct batch_reader *br);
+
+static inline char *batch_slot(const struct batch_reader *br, unsigned i)
+{
+    return br->arena + (size_t)i * br->slot_size;
+}
+
+/*
+ * Reads fds[0..n) into slots 0..n); lens[i] gets the byte count or -errno.
+ * Slots are NUL-terminated. Returns the number of successful reads.
+ */
+unsigned batch_read(struct batch_reader *br, const int *fds, unsigned n, int *lens);
+
+#endif
@@ -0,0 +1,3735 @@
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <iconv.h>
+#include <math.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/health.h"
+#include "../common/histogram.h"
+#include "../common/intern.h"
+#include "../common/kernel.h"
+#include "../common/netsh.h"
+#include "../common/pipeline.h"
+#include "../common/rules.h"
+#include "../common/site.h"
+#include "../common/wheel.h"
+#include "align.h"
+#include "backend.h"
+#include "batchread.h"
+#include "bench.h"
+#include "clock.h"
+#include "control.h"
+#include "flight.h"
+#include "import.h"
+#include "ingest.h"
+#include "linkwatch.h"
+#include "metrics.h"
+#include "nl80211.h"
+#include "nlmock.h"
+#include "pool.h"
+#include "query.h"
+#include "store.h"
+#include "subproc.h"
+
+#define BACKEND_ITERATIONS 2000
+#define LINK_EVENTS 10
+#define BENCH_RULES 1000
+#define RULE_TICKS 20000
+#define CONTROL_REQUESTS 2000
+#define METRICS_SCRAPES 2000
+#define FLIGHT_WRITES 1000000
+#define FLIGHT_CRASHES 20
+#define STORE_DAYS 4
+#define STORE_EPOCH_DAY 20000        /* 2024-10-04, a fixed UTC midnight */
+#define SURVEY_DAYS 30
+#define SURVEY_FLOORS 10
+#define SURVEY_APS 20                 /* per floor */
+#define KERNEL_ROWS (1u << 20)
+#define KERNEL_MIN_NS 200000000ull    /* per kernel and implementation */
+#define NETSH_MIN_NS 50000000ull      /* per output and parser */
+#define PIPELINE_SAMPLES (1u << 12)   /* a power of two */
+#define PIPELINE_MIN_NS 300000000ull
+#define SCHED_TICKS 10000u            /* 10 s of 1 ms ticks */
+#define SCHED_CHURN 8                 /* timers cancelled and re-added per tick */
+#define SCHED_LIST_MAX 10000          /* the sorted list is quadratic beyond this */
+#define POOL_TREE_TASKS (1u << 20)
+#define POOL_THREAD_TASKS 2000        /* pthread_create per task is slow; fewer of them */
+#define POOL_FLOOD_RT 20000
+#define POOL_FLOOD_BG 2000
+#define POOL_LAT_BG 400               /* background tasks queued ahead of the realtime ones */
+#define POOL_LAT_BG_NS 200000ull
+#define POOL_LAT_RT 50                /* one per ms, as a sampler tick would */
+#define INGEST_SAMPLES (1u << 20)     /* per run, split across the producers */
+#define INGEST_RING 1024              /* per producer; the mutex queue gets the same total */
+#define INGEST_BATCH 256
+#define INGEST_MAX_PRODUCERS 64
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_latency(const char *name, uint64_t *ns, int n, int ok)
+{
+    if (n == 0) {
+        printf("%-20s | %6s | unavailable\n", name, "0");
+        return;
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) sum += ns[i];
+    qsort(ns, (size_t)n, sizeof(ns[0]), cmp_u64);
+    printf("%-20s | %6d | %9.1f | %9.1f | %9.1f | %9.1f\n", name, ok,
+           sum / (double)n / 1e3, ns[n / 2] / 1e3, ns[(n * 99) / 100] / 1e3, ns[n - 1] / 1e3);
+}
+
+static int time_backend(struct backend *b, uint64_t *ns, int iterations, int *ok)
+{
+    *ok = 0;
+    for (int i = 0; i < iterations; i++) {
+        struct wifi_sample s = {0};
+        uint64_t t0 = mono_ns();
+        *ok += b->sample(b, &s) == 1;
+        ns[i] = mono_ns() - t0;
+    }
+    return iterations;
+}
+
+static int have_iw(void)
+{
+    return system("command -v iw >/dev/null 2>&1") == 0;
+}
+
+/*
+ * nl80211 (against the in-process mock responder) versus the `iw`
+ * subprocess path. Without iw installed the subprocess path runs `cat`
+ * on a recorded `iw dev link` output so the fork/exec cost is the same.
+ */
+static int bench_backends(const struct bench_args *a)
+{
+    const char *ifname = a->ifname;
+    int iterations = a->iterations ? a->iterations : BACKEND_ITERATIONS;
+    static const char iw_fixture[] =
+        "Connected to 02:00:5e:10:20:30 (on wlan0)\n"
+        "\tSSID: lab\n\tfreq: 5180\n"
+        "\tsignal: -55 dBm\n"
+        "\trx bitrate: 866.7 MBit/s VHT-MCS 9 80MHz short GI VHT-NSS 2\n"
+        "\ttx bitrate: 780.0 MBit/s VHT-MCS 8 80MHz short GI VHT-NSS 2\n";
+
+    uint64_t *ns = malloc(sizeof(*ns) * (size_t)iterations);
+    if (!ns) return 1;
+
+    printf("%-20s | %6s | %9s | %9s | %9s | %9s\n", "Backend", "OK", "Mean us", "p50 us",
+           "p99 us", "Max us");
+    printf("-----------------------------------------------------------------------------\n");
+
+    struct nlmock mock;
+    struct backend nl = nl80211_backend;
+    int fd, ok;
+    if (nlmock_start(&mock, NULL, &fd) && nl80211_backend_attach(&nl, fd, 1)) {
+        int n = time_backend(&nl, ns, iterations, &ok);
+        print_latency("nl80211 (mock)", ns, n, ok);
+        nl.close(&nl);
+        nlmock_stop(&mock);
+    } else {
+        print_latency("nl80211 (mock)", ns, 0, 0);
+    }
+
+    char path[] = "/tmp/snrmon-iw-XXXXXX";
+    struct backend iw = iw_backend;
+    int tmp = -1;
+    if (iw.open(&iw, ifname)) {
+        if (!have_iw() && (tmp = mkstemp(path)) >= 0) {
+            char cmd[64];
+            if (write(tmp, iw_fixture, sizeof(iw_fixture) - 1) < 0) {}
+            snprintf(cmd, sizeof(cmd), "cat %s", path);
+            iw_set_command(&iw, cmd);
+        }
+        int n = time_backend(&iw, ns, iterations / 10 > 0 ? iterations / 10 : 1, &ok);
+        print_latency(tmp >= 0 ? "iw subprocess (cat)" : "iw subprocess", ns, n, ok);
+        iw.close(&iw);
+    }
+    if (tmp >= 0) {
+        close(tmp);
+        unlink(path);
+    }
+
+    free(ns);
+    return 0;
+}
+
+struct flapper {
+    int mode;                   /* 0: notify over sockets, 1: flip polled state */
+    int rt_fd, genl_fd;
+    unsigned period_ms;
+    _Atomic int state;
+    _Atomic uint64_t emitted_ns[LINK_EVENTS];
+};
+
+static void sleep_ns(uint64_t ns)
+{
+    struct timespec ts = { (time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull) };
+    while (nanosleep(&ts, &ts) != 0) {}
+}
+
+/* Toggles the link at a random phase, never twice within one poll period. */
+static void *flap(void *arg)
+{
+    struct flapper *f = arg;
+    unsigned seed = 0x5eed;
+
+    for (int i = 0; i < LINK_EVENTS; i++) {
+        uint64_t period_ns = (uint64_t)f->period_ms * 1000000ull;
+        sleep_ns(period_ns + period_ns / 2 + (uint64_t)rand_r(&seed) % period_ns);
+
+        int up = i % 2;
+        atomic_store(&f->emitted_ns[i], mono_ns());
+        if (f->mode == 1) {
+            atomic_store(&f->state, up ? LINK_UP : LINK_DOWN);
+        } else if (i % 4 < 2) {
+            nlmock_send_link(f->rt_fd, 1, up);
+        } else {
+            nlmock_send_mlme(f->genl_fd, 1, up);
+        }
+    }
+    return NULL;
+}
+
+static void print_detection(const char *name, uint64_t *ns, int n)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) sum += ns[i];
+    qsort(ns, (size_t)n, sizeof(ns[0]), cmp_u64);
+    printf("%-20s | %6d | %11.3f | %11.3f | %11.3f\n", name, n, sum / (double)n / 1e6,
+           ns[n / 2] / 1e6, ns[n - 1] / 1e6);
+}
+
+/*
+ * Disconnect detection latency: rtnetlink/nl80211 notifications through
+ * linkwatch versus re-reading the state every interval, as poc.c does
+ * with netsh. Both paths see the same randomly phased link flaps.
+ */
+static int bench_link(const struct bench_args *a)
+{
+    uint64_t event_ns[LINK_EVENTS], poll_ns[LINK_EVENTS];
+    int rt[2], genl[2];
+    pthread_t t;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, rt) < 0) return 1;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, genl) < 0) return 1;
+
+    struct flapper f = { .mode = 0, .rt_fd = rt[1], .genl_fd = genl[1], .period_ms = a->interval_ms };
+    struct linkwatch w;
+    linkwatch_attach(&w, rt[0], genl[0], 1, NLMOCK_FAMILY, LINK_UP);
+
+    printf("Detection latency over %d link flaps, poll period %u ms\n", LINK_EVENTS, a->interval_ms);
+    printf("%-20s | %6s | %11s | %11s | %11s\n", "Path", "Events", "Mean ms", "p50 ms", "Max ms");
+    printf("---------------------------------------------------------------------\n");
+
+    pthread_create(&t, NULL, flap, &f);
+    for (int i = 0; i < LINK_EVENTS; i++) {
+        struct link_event ev;
+        while (!linkwatch_wait(&w, -1, &ev)) {}
+        event_ns[i] = ev.ts_ns - atomic_load(&f.emitted_ns[i]);
+    }
+    pthread_join(t, NULL);
+    linkwatch_close(&w);
+    close(rt[1]);
+    close(genl[1]);
+    print_detection("linkwatch events", event_ns, LINK_EVENTS);
+
+    f.mode = 1;
+    atomic_store(&f.state, LINK_UP);
+    pthread_create(&t, NULL, flap, &f);
+    int last = LINK_UP;
+    for (int i = 0; i < LINK_EVENTS;) {
+        sleep_ns((uint64_t)a->interval_ms * 1000000ull);
+        int s = atomic_load(&f.state);
+        if (s == last) continue;
+        last = s;
+        poll_ns[i] = mono_ns() - atomic_load(&f.emitted_ns[i]);
+        i++;
+    }
+    pthread_join(t, NULL);
+    print_detection("state polling", poll_ns, LINK_EVENTS);
+    return 0;
+}
+
+#define DEADLINE_CALLS 10
+#define DEADLINE_MS 100
+
+static void print_hist(const char *name, const struct histogram *h)
+{
+    printf("%-20s | %6llu | %9.2f | %9.2f | %9.2f\n", name, (unsigned long long)h->count,
+           hist_quantile(h, 0.5) / 1e6, hist_quantile(h, 0.99) / 1e6, h->max / 1e6);
+}
+
+/*
+ * Tail latency with wedged backends: a subprocess that never exits and an
+ * nl80211 responder that never answers must both come back at the deadline.
+ */
+static int bench_deadline(const struct bench_args *a)
+{
+    (void)a;
+    struct histogram h;
+    char out[256];
+    char *const hang[] = { "sleep", "30", NULL };
+
+    printf("Wedged backend calls under a %d ms deadline\n", DEADLINE_MS);
+    printf("%-20s | %6s | %9s | %9s | %9s\n", "Path", "Calls", "p50 ms", "p99 ms", "Max ms");
+    printf("-----------------------------------------------------------------\n");
+
+    hist_reset(&h);
+    for (int i = 0; i < DEADLINE_CALLS; i++) {
+        uint64_t t0 = mono_ns();
+        if (run_command(hang, out, sizeof(out), DEADLINE_MS) == RUN_TIMEOUT) hist_record(&h, mono_ns() - t0);
+    }
+    print_hist("hung subprocess", &h);
+
+    struct nlmock mock;
+    struct backend nl = nl80211_backend;
+    int fd;
+    nl.deadline_ms = DEADLINE_MS;
+    hist_reset(&h);
+    if (nlmock_start(&mock, NULL, &fd) && nl80211_backend_attach(&nl, fd, 1)) {
+        mock.stall_every = 1;
+        for (int i = 0; i < DEADLINE_CALLS; i++) {
+            struct wifi_sample s = {0};
+            uint64_t t0 = mono_ns();
+            if (nl.sample(&nl, &s) == SAMPLE_TIMEOUT) hist_record(&h, mono_ns() - t0);
+        }
+        nl.close(&nl);
+        nlmock_stop(&mock);
+    }
+    print_hist("silent nl80211", &h);
+    return 0;
+}
+
+#define RUNNER_JOBS 8
+#define RUNNER_OUTPUT (256 * 1024)
+
+struct runner_trace {
+    uint64_t done_ns[RUNNER_JOBS];
+    int order[RUNNER_JOBS];
+    int finished;
+};
+
+static void runner_done(struct run_job *job, void *ctx)
+{
+    struct runner_trace *t = ctx;
+    int i = (int)(intptr_t)job->arg;
+    t->done_ns[i] = job->elapsed_ns;
+    t->order[t->finished++] = i;
+}
+
+/*
+ * Serial run_command calls versus one runner_run tick over stand-in
+ * commands with mixed delays and output sizes, including outputs larger
+ * than a pipe buffer and larger than the capture buffer.
+ */
+static int bench_runner(const struct bench_args *a)
+{
+    (void)a;
+    static const struct { unsigned delay_ms; unsigned bytes; } spec[RUNNER_JOBS] = {
+        { 0, 512 }, { 10, 4096 }, { 30, 65536 }, { 50, 262144 },
+        { 5, 1048576 }, { 20, 128 }, { 40, 16384 }, { 0, 200000 },
+    };
+    char scripts[RUNNER_JOBS][96];
+    char *argv[RUNNER_JOBS][4];
+    struct run_job jobs[RUNNER_JOBS];
+    uint64_t serial_ns[RUNNER_JOBS], serial_total = 0;
+    int serial_rc[RUNNER_JOBS];
+    struct runner_trace trace = { .finished = 0 };
+    struct runner r;
+
+    char *buf = malloc((size_t)RUNNER_JOBS * RUNNER_OUTPUT);
+    if (!buf || !runner_init(&r)) {
+        free(buf);
+        return 1;
+    }
+
+    for (int i = 0; i < RUNNER_JOBS; i++) {
+        snprintf(scripts[i], sizeof(scripts[i]), "sleep %u.%03u; head -c %u /dev/zero",
+                 spec[i].delay_ms / 1000, spec[i].delay_ms % 1000, spec[i].bytes);
+        argv[i][0] = "sh";
+        argv[i][1] = "-c";
+        argv[i][2] = scripts[i];
+        argv[i][3] = NULL;
+
+        uint64_t t0 = mono_ns();
+        serial_rc[i] = run_command(argv[i], buf, RUNNER_OUTPUT, 5000);
+        serial_ns[i] = mono_ns() - t0;
+        serial_total += serial_ns[i];
+
+        jobs[i] = (struct run_job){ .argv = argv[i], .out = buf + (size_t)i * RUNNER_OUTPUT,
+                                    .size = RUNNER_OUTPUT, .arg = (void *)(intptr_t)i };
+    }
+
+    uint64_t t0 = mono_ns();
+    int ok = runner_run(&r, jobs, RUNNER_JOBS, 5000, runner_done, &trace);
+    uint64_t concurrent_total = mono_ns() - t0;
+
+    printf("%-4s | %8s | %9s | %9s | %-9s | %10s | %s\n", "Job", "Delay ms", "Bytes", "Captured", "Result",
+           "Serial ms", "Done at ms (epoll)");
+    printf("---------------------------------------------------------------------------------------\n");
+    /* Output that does not fit, even by the one byte the NUL takes, is a failure on both paths. */
+    int as_expected = 1;
+    for (int i = 0; i < RUNNER_JOBS; i++) {
+        int expect = spec[i].bytes < RUNNER_OUTPUT ? 1 : RUN_TRUNCATED;
+        as_expected &= jobs[i].result == expect && serial_rc[i] == expect;
+        printf("%-4d | %8u | %9u | %9zu | %-9s | %10.2f | %.2f%s\n", i, spec[i].delay_ms, spec[i].bytes,
+               jobs[i].len, jobs[i].result == 1 ? "ok" : jobs[i].result == RUN_TRUNCATED ? "truncated" :
+               jobs[i].result == RUN_TIMEOUT ? "timeout" : "failed", serial_ns[i] / 1e6, trace.done_ns[i] / 1e6,
+               jobs[i].result == expect && serial_rc[i] == expect ? "" : "  UNEXPECTED");
+    }
+    printf("Total: serial %.2f ms, concurrent %.2f ms (%d/%d ok), completion order:",
+           serial_total / 1e6, concurrent_total / 1e6, ok, RUNNER_JOBS);
+    for (int i = 0; i < trace.finished; i++) printf(" %d", trace.order[i]);
+    printf("\n");
+
+    runner_close(&r);
+    free(buf);
+    return !as_expected;
+}
+
+#define FIXTURE_FILES 7
+#define FIXTURE_TICKS 200
+
+static const char *const fixture_names[FIXTURE_FILES] = {
+    "operstate", "rx_bytes", "tx_bytes", "rx_packets", "tx_packets", "rx_errors", "tx_errors",
+};
+
+/* Creates per-interface sysfs-like files plus one shared wireless table. */
+static int make_fixture(const char *dir, unsigned ifaces, int *fds)
+{
+    char path[256];
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < ifaces; i++) {
+        for (int f = 0; f < FIXTURE_FILES; f++) {
+            snprintf(path, sizeof(path), "%s/wlan%u.%s", dir, i, fixture_names[f]);
+            int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if (fd < 0) return -1;
+            dprintf(fd, f == 0 ? "up\n" : "%u\n", 1000000u * (i + 1) + (unsigned)f);
+            fds[n++] = fd;
+        }
+    }
+    snprintf(path, sizeof(path), "%s/wireless", dir);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    dprintf(fd, "Inter-| sta-|   Quality        |   Discarded packets\n"
+                " face | tus | link level noise |  nwid  crypt   frag  retry   misc | beacon | 22\n");
+    for (unsigned i = 0; i < ifaces; i++) {
+        dprintf(fd, " wlan%u: 0000   60.  -50.  -256        0      0      0      0      0        0\n", i);
+    }
+    fds[n++] = fd;
+    return (int)n;
+}
+
+static void remove_fixture(const char *dir, unsigned ifaces, const int *fds, int n)
+{
+    char path[256];
+    for (int i = 0; i < n; i++) close(fds[i]);
+    for (unsigned i = 0; i < ifaces; i++) {
+        for (int f = 0; f < FIXTURE_FILES; f++) {
+            snprintf(path, sizeof(path), "%s/wlan%u.%s", dir, i, fixture_names[f]);
+            unlink(path);
+        }
+    }
+    snprintf(path, sizeof(path), "%s/wireless", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+/* Per-tick cost of reading every stats file: pread each versus one io_uring batch. */
+static int bench_batchread(const struct bench_args *a)
+{
+    (void)a;
+    static const unsigned sizes[] = { 1, 32, 256 };
+
+    printf("%-7s | %5s | %-8s | %7s | %13s | %10s\n", "Ifaces", "Files", "Path", "Read OK",
+           "Syscalls/tick", "us/tick");
+    printf("----------------------------------------------------------------------\n");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        char dir[] = "/tmp/snrmon-fixture-XXXXXX";
+        if (!mkdtemp(dir)) return 1;
+
+        unsigned max_files = sizes[s] * FIXTURE_FILES + 1;
+        int *fds = malloc(sizeof(int) * max_files * 2);
+        int *lens = fds + max_files;
+        int n = fds ? make_fixture(dir, sizes[s], fds) : -1;
+        if (n < 0) {
+            free(fds);
+            return 1;
+        }
+
+        for (int uring = 0; uring < 2; uring++) {
+            struct batch_reader br;
+            if (!batch_init(&br, (unsigned)n, 4096, uring)) break;
+            if (uring && !br.use_uring) {
+                printf("%-7u | %5d | %-8s | %7s | %13s | %10s\n", sizes[s], n, "io_uring", "n/a",
+                       "n/a", "n/a");
+                batch_close(&br);
+                break;
+            }
+
+            unsigned ok = batch_read(&br, fds, (unsigned)n, lens);
+            br.syscalls = 0;
+            uint64_t t0 = mono_ns();
+            for (int t = 0; t < FIXTURE_TICKS; t++) batch_read(&br, fds, (unsigned)n, lens);
+            uint64_t elapsed = mono_ns() - t0;
+
+            printf("%-7u | %5d | %-8s | %7u | %13.1f | %10.1f\n", sizes[s], n,
+                   uring ? "io_uring" : "pread", ok, (double)br.syscalls / FIXTURE_TICKS,
+                   elapsed / 1e3 / FIXTURE_TICKS);
+            batch_close(&br);
+        }
+
+        remove_fixture(dir, sizes[s], fds, n);
+        free(fds);
+    }
+    return 0;
+}
+
+/* Varied shapes over a few dozen distinct windows, as a real rule file would have. */
+static char *make_rules(int n)
+{
+    static const char *const feats[] = { "snr", "signal", "health", "tx_rate", "rx_rate" };
+    static const char *const aggs[] = { "avg", "min", "max", "p50", "p90" };
+    static const char *const spans[] = { "10s", "60s", "5m" };
+    size_t size = (size_t)n * 160, len = 0;
+    char *text = malloc(size);
+    if (!text) return NULL;
+
+    for (int i = 0; i < n; i++) {
+        const char *f = feats[i % 5], *g = aggs[(i / 5) % 5], *w = spans[(i / 25) % 3];
+        int t = 10 + i % 30;
+        switch (i % 4) {
+        case 0:
+            len += (size_t)snprintf(text + len, size - len, "rule r%d: %s(%s, %s) < %d\n", i, g, f, w, t);
+            break;
+        case 1:
+            len += (size_t)snprintf(text + len, size - len, "rule r%d: %s < %d and %s(%s, %s) >= %d\n",
+                                    i, f, t, g, f, w, t / 2);
+            break;
+        case 2:
+            len += (size_t)snprintf(text + len, size - len,
+                                    "rule r%d: count(disconnect, 5m) > %d or health < %d\n", i, i % 5, t);
+            break;
+        default:
+            len += (size_t)snprintf(text + len, size - len,
+                                    "rule r%d: not (%s(snr, %s) > %d) for bssid 02:00:5e:10:20:%02x\n", i,
+                                    g, w, t, i % 4);
+            break;
+        }
+    }
+    return text;
+}
+
+/* Per-sample cost with BENCH_RULES rules loaded: window upkeep and rule evaluation. */
+/*
+ * Semantics the timing loop does not reach: negated predicates over
+ * missing values stay false, and a window longer than RULE_WINDOW_CAP
+ * samples keeps them all.
+ */
+static int rules_edge_checks(void)
+{
+    static const char text[] =
+        "rule blind: not avg(health, 30s) >= 15\n"
+        "rule noisy: noise != -95\n"
+        "rule long:  min(signal, 20m) > -60\n";
+    struct rule_set rs = {0};
+    char err[128];
+    if (!rules_compile(&rs, text, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s\n", err);
+        return 0;
+    }
+    /* 2400 samples at 2 Hz: 20 minutes less half a second, so the first, weakest one is still in the window. */
+    int missing_fired = 0;
+    for (int t = 0; t < 2400; t++) {
+        struct wifi_sample s = { .ts_ns = (uint64_t)t * 500000000ull, .fields = FIELD_SIGNAL,
+                                 .signal_dbm = (int8_t)(t ? -50 : -70) };
+        rules_update(&rs, &s);
+        rules_eval(&rs, s.ts_ns, NULL);
+        missing_fired |= rs.rules[0].firing | rs.rules[1].firing;
+    }
+    int truncated = rs.rules[2].firing;
+    rules_free(&rs);
+    printf("Negated rules over missing values: %s; a 2400-sample window: %s\n",
+           missing_fired ? "FIRED" : "quiet", truncated ? "TRUNCATED" : "complete");
+    return !missing_fired && !truncated;
+}
+
+static int bench_rules(const struct bench_args *a)
+{
+    (void)a;
+    char *text = make_rules(BENCH_RULES);
+    struct rule_set rs = {0};
+    char err[128];
+    uint64_t t0 = mono_ns();
+    if (!text || !rules_compile(&rs, text, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s\n", text ? err : "out of memory");
+        free(text);
+        return 1;
+    }
+    uint64_t compile_ns = mono_ns() - t0;
+    free(text);
+
+    struct nlmock mock;
+    int fd;
+    struct backend b = nl80211_backend;
+    if (!nlmock_start(&mock, NULL, &fd) || !nl80211_backend_attach(&b, fd, 1)) return 1;
+    struct wifi_sample trace[64];
+    for (int i = 0; i < 64; i++) {
+        memset(&trace[i], 0, sizeof(trace[i]));
+        b.sample(&b, &trace[i]);
+        trace[i].health = 100.0f - (float)i;
+        trace[i].fields |= FIELD_HEALTH;
+    }
+    b.close(&b);
+    nlmock_stop(&mock);
+
+    uint64_t update_ns = 0, eval_ns = 0, fired = 0;
+    struct sink_set sinks = {0};
+    for (int t = 0; t < RULE_TICKS; t++) {
+        struct wifi_sample s = trace[t % 64];
+        s.ts_ns = (uint64_t)t * 500000000ull;
+        if (t % 97 == 0) rules_event(&rs, s.ts_ns, RULE_EV_DISCONNECT);
+        uint64_t t1 = mono_ns();
+        rules_update(&rs, &s);
+        uint64_t t2 = mono_ns();
+        rules_eval(&rs, s.ts_ns, &sinks);
+        uint64_t t3 = mono_ns();
+        update_ns += t2 - t1;
+        eval_ns += t3 - t2;
+    }
+    for (size_t i = 0; i < rs.nrules; i++) fired += rs.rules[i].firing != 0;
+
+    printf("Rules: %zu (%zu predicates, %zu aggregates over %zu windows), compiled in %.2f ms\n",
+           rs.nrules, rs.npreds, rs.naggs, rs.nwindows, compile_ns / 1e6);
+    printf("%-16s | %12s | %12s\n", "Stage", "us/sample", "ns/rule");
+    printf("----------------------------------------------\n");
+    printf("%-16s | %12.2f | %12.1f\n", "window update", update_ns / 1e3 / RULE_TICKS,
+           (double)update_ns / RULE_TICKS / rs.nrules);
+    printf("%-16s | %12.2f | %12.1f\n", "rule eval", eval_ns / 1e3 / RULE_TICKS,
+           (double)eval_ns / RULE_TICKS / rs.nrules);
+    printf("%-16s | %12.2f | %12.1f\n", "total", (update_ns + eval_ns) / 1e3 / RULE_TICKS,
+           (double)(update_ns + eval_ns) / RULE_TICKS / rs.nrules);
+    printf("Firing at end: %llu\n", (unsigned long long)fired);
+    rules_free(&rs);
+    return !rules_edge_checks();
+}
+
+struct control_load {
+    struct control *ctl;
+    const char *path;
+    uint64_t *ns;
+    int n;
+    int failed;
+    atomic_int *stop;
+    struct rule_set *rules;
+    uint64_t publishes, publish_max_ns;
+};
+
+/* One persistent connection issuing SAMPLE round trips back to back. */
+static void *control_client(void *arg)
+{
+    struct control_load *l = arg;
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    strcpy(sa.sun_path, l->path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        l->failed = 1;
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    char buf[4096];
+    for (int i = 0; i < l->n; i++) {
+        uint64_t t0 = mono_ns();
+        if (send(fd, "SAMPLE\n", 7, MSG_NOSIGNAL) != 7) break;
+        size_t len = 0;
+        int done = 0;
+        while (!done) {
+            ssize_t r = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+            if (r <= 0) break;
+            len += (size_t)r;
+            done = len >= 2 && buf[len - 2] == '\n' && buf[len - 1] == '\n';
+        }
+        if (!done) {
+            l->failed = 1;
+            break;
+        }
+        l->ns[i] = mono_ns() - t0;
+    }
+    close(fd);
+    return NULL;
+}
+
+/* Stands in for the sampler: publishes as fast as it can and times each call. */
+static void *control_publisher(void *arg)
+{
+    struct control_load *l = arg;
+    struct wifi_sample s = { .fields = FIELD_SIGNAL | FIELD_HEALTH, .signal_dbm = -55, .health = 80 };
+    struct histogram lat, timeouts;
+    hist_reset(&lat);
+    hist_reset(&timeouts);
+
+    while (!atomic_load(l->stop)) {
+        s.ts_ns = wall_ns();
+        uint64_t t0 = mono_ns();
+        control_publish(l->ctl, &s, &lat, &timeouts, l->rules, 1);
+        uint64_t dt = mono_ns() - t0;
+        if (dt > l->publish_max_ns) l->publish_max_ns = dt;
+        l->publishes++;
+        sleep_ns(100000);
+    }
+    return NULL;
+}
+
+/* What control_start does with whatever is already at its path. */
+static int control_path_checks(const char *path)
+{
+    struct control a, b;
+    int ok = 1;
+
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    fclose(f);
+    struct stat st;
+    int refused = !control_start(&a, path, NULL) && errno == EEXIST;
+    if (!refused) control_stop(&a);
+    int kept = lstat(path, &st) == 0 && S_ISREG(st.st_mode);
+    printf("Regular file at the path: %s\n", refused && kept ? "left alone" : "REMOVED");
+    ok &= refused && kept;
+    unlink(path);
+
+    /* A socket bound and closed without unlinking, as a crashed run leaves it. */
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) return 0;
+    close(fd);
+    int replaced = control_start(&a, path, NULL);
+    printf("Stale socket: %s\n", replaced ? "replaced" : "NOT REPLACED");
+    ok &= replaced;
+    if (!replaced) return 0;
+
+    int busy = !control_start(&b, path, NULL) && errno == EADDRINUSE;
+    if (!busy) control_stop(&b);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int alive = fd >= 0 && connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0;
+    if (fd >= 0) close(fd);
+    printf("Running instance: %s\n", busy && alive ? "left alone" : "TAKEN OVER");
+    ok &= busy && alive;
+    control_stop(&a);
+    return ok;
+}
+
+/* Request latency with 1..64 concurrent clients while a sampler keeps publishing. */
+static int bench_control(const struct bench_args *a)
+{
+    (void)a;
+    static const int clients[] = { 1, 4, 16, 64 };
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/snrmon-bench-%d.sock", (int)getpid());
+
+    struct rule_set rules = {0};
+    char err[128];
+    char *text = make_rules(64);
+    if (!text || !rules_compile(&rules, text, err, sizeof(err))) {
+        free(text);
+        return 1;
+    }
+    free(text);
+    if (!control_path_checks(path)) {
+        rules_free(&rules);
+        return 1;
+    }
+
+    struct control ctl;
+    if (!control_start(&ctl, path, NULL)) {
+        fprintf(stderr, "ERROR: Could not listen on %s\n", path);
+        rules_free(&rules);
+        return 1;
+    }
+
+    printf("%-7s | %8s | %9s | %9s | %9s | %9s | %14s | %7s\n", "Clients", "Requests", "req/s",
+           "p50 us", "p99 us", "max us", "publish max us", "skipped");
+    printf("--------------------------------------------------------------------------------------------\n");
+
+    int rc = 0;
+    for (size_t c = 0; c < sizeof(clients) / sizeof(clients[0]) && rc == 0; c++) {
+        int n = clients[c], per = CONTROL_REQUESTS / n > 200 ? CONTROL_REQUESTS / n : 200;
+        uint64_t *ns = calloc((size_t)n * (size_t)per, sizeof(*ns));
+        struct control_load *loads = calloc((size_t)n + 1, sizeof(*loads));
+        pthread_t *threads = calloc((size_t)n + 1, sizeof(*threads));
+        atomic_int stop = 0;
+        if (!ns || !loads || !threads) {
+            free(ns);
+            free(loads);
+            free(threads);
+            rc = 1;
+            break;
+        }
+
+        uint64_t skipped0 = atomic_load(&ctl.skipped);
+        struct control_load *pub = &loads[n];
+        *pub = (struct control_load){ .ctl = &ctl, .stop = &stop, .rules = &rules };
+        pthread_create(&threads[n], NULL, control_publisher, pub);
+
+        uint64_t t0 = mono_ns();
+        for (int i = 0; i < n; i++) {
+            loads[i] = (struct control_load){ .ctl = &ctl, .path = path, .ns = ns + (size_t)i * per, .n = per };
+            pthread_create(&threads[i], NULL, control_client, &loads[i]);
+        }
+        int failed = 0;
+        for (int i = 0; i < n; i++) {
+            pthread_join(threads[i], NULL);
+            failed |= loads[i].failed;
+        }
+        uint64_t elapsed = mono_ns() - t0;
+        atomic_store(&stop, 1);
+        pthread_join(threads[n], NULL);
+
+        int total = n * per;
+        if (failed) {
+            printf("%-7d | %8d | failed\n", n, total);
+            rc = 1;
+        } else {
+            qsort(ns, (size_t)total, sizeof(ns[0]), cmp_u64);
+            printf("%-7d | %8d | %9.0f | %9.1f | %9.1f | %9.1f | %14.1f | %7llu\n", n, total,
+                   total / (elapsed / 1e9), ns[total / 2] / 1e3, ns[(total * 99) / 100] / 1e3,
+                   ns[total - 1] / 1e3, pub->publish_max_ns / 1e3,
+                   (unsigned long long)(atomic_load(&ctl.skipped) - skipped0));
+        }
+        free(ns);
+        free(loads);
+        free(threads);
+    }
+
+    control_stop(&ctl);
+    rules_free(&rules);
+    return rc;
+}
+
+/* One HTTP request on a keep-alive connection; returns the body length or -1. */
+static int http_get(int fd, const char *path, char *buf, size_t size, int *status, const char **body)
+{
+    char req[128];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    if (send(fd, req, (size_t)n, MSG_NOSIGNAL) != n) return -1;
+
+    size_t len = 0;
+    long want = -1;
+    const char *head_end = NULL;
+    while (want < 0 || len < (size_t)(head_end + 4 - buf) + (size_t)want) {
+        if (len >= size - 1) return -1;
+        ssize_t r = recv(fd, buf + len, size - 1 - len, 0);
+        if (r <= 0) return -1;
+        len += (size_t)r;
+        buf[len] = '\0';
+        if (want < 0 && (head_end = strstr(buf, "\r\n\r\n")) != NULL) {
+            const char *cl = strstr(buf, "Content-Length: ");
+            if (!cl || cl > head_end || sscanf(buf, "HTTP/1.1 %d", status) != 1) return -1;
+            want = strtol(cl + 16, NULL, 10);
+        }
+    }
+    *body = head_end + 4;
+    return (int)want;
+}
+
+/*
+ * Checks the exposition the way a scraper would: every sample line is
+ * name{labels} value, and the published sample shows up in it.
+ */
+static int check_exposition(const char *body, int len)
+{
+    int samples = 0, signal_ok = 0, class_ok = 0;
+    const char *end = body + len;
+    for (const char *p = body; p < end;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) return 0;
+        if (*p != '#') {
+            char name[96], labels[128];
+            double v;
+            if (sscanf(p, "%95[a-z_]{%127[^}]} %lf", name, labels, &v) != 3 &&
+                !(sscanf(p, "%95[a-z_]{%127[^}]} NaN", name, labels) == 2)) {
+                return 0;
+            }
+            if (strcmp(name, "wifi_signal_dbm") == 0 && v == -55) signal_ok = 1;
+            if (strcmp(name, "wifi_link_health_class") == 0 && strstr(labels, "\"FAIR\"") && v == 1) class_ok = 1;
+            samples++;
+        }
+        p = nl + 1;
+    }
+    return samples > 0 && signal_ok && class_ok ? samples : 0;
+}
+
+/* Scrape latency over keep-alive TCP while a sampler keeps publishing. */
+/* What a unix: endpoint does with whatever is already at its path, and that it cleans up only its own. */
+static int metrics_unix_checks(const char *ifname)
+{
+    static struct metrics a, b;
+    char path[64], addr[80];
+    struct stat st;
+    snprintf(path, sizeof(path), "/tmp/snrmon-bench-%d.metrics", (int)getpid());
+    snprintf(addr, sizeof(addr), "unix:%s", path);
+
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    fclose(f);
+    int refused = !metrics_start(&a, addr, ifname) && errno == EEXIST;
+    if (!refused) metrics_stop(&a);
+    int kept = lstat(path, &st) == 0 && S_ISREG(st.st_mode);
+    unlink(path);
+
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) return 0;
+    close(fd);
+    int replaced = metrics_start(&a, addr, ifname);
+    int busy = 0, alive = 0;
+    if (replaced) {
+        busy = !metrics_start(&b, addr, ifname) && errno == EADDRINUSE;
+        if (!busy) metrics_stop(&b);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        alive = fd >= 0 && connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0;
+        if (fd >= 0) close(fd);
+        metrics_stop(&a);
+    }
+    int gone = lstat(path, &st) < 0;
+    unlink(path);
+    int ok = refused && kept && replaced && busy && alive && gone;
+    printf("unix: endpoint: regular file %s, stale socket %s, running instance %s, removed at stop: %s%s\n\n",
+           refused && kept ? "left alone" : "REMOVED", replaced ? "replaced" : "NOT REPLACED",
+           busy && alive ? "left alone" : "TAKEN OVER", gone ? "yes" : "NO", ok ? "" : "  WRONG");
+    return ok;
+}
+
+static int bench_metrics(const struct bench_args *a)
+{
+    if (!metrics_unix_checks(a->ifname)) return 1;
+    static struct metrics met;
+    if (!metrics_start(&met, "127.0.0.1:0", a->ifname)) {
+        fprintf(stderr, "ERROR: Could not start the metrics endpoint\n");
+        return 1;
+    }
+    struct wifi_sample s = {
+        .fields = FIELD_SIGNAL | FIELD_HEALTH | FIELD_RX_BITRATE | FIELD_TX_RETRIES,
+        .signal_dbm = -55, .health = 72.5f, .rx_bitrate_kbps = 433300, .tx_retries = 17,
+    };
+    struct histogram lat, timeouts;
+    hist_reset(&lat);
+    hist_reset(&timeouts);
+    for (int i = 0; i < 100; i++) hist_record(&lat, 20000 + (uint64_t)i * 1000);
+    metrics_publish(&met, &s, &lat, &timeouts);
+
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons((uint16_t)metrics_port(&met)) };
+    inet_pton(AF_INET, "127.0.0.1", &sa.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        if (fd >= 0) close(fd);
+        metrics_stop(&met);
+        return 1;
+    }
+
+    static char buf[METRICS_RESPONSE_MAX + 1024];
+    static uint64_t ns[METRICS_SCRAPES];
+    const char *body;
+    int status = 0, rc = 0, samples = 0, len;
+    uint64_t render_max = 0;
+
+    len = http_get(fd, "/nope", buf, sizeof(buf), &status, &body);
+    if (len < 0 || status != 404) {
+        printf("metrics: unknown path answered %d, expected 404\n", status);
+        rc = 1;
+    }
+    for (int i = 0; i < METRICS_SCRAPES && rc == 0; i++) {
+        s.ts_ns = wall_ns();
+        metrics_publish(&met, &s, &lat, &timeouts);
+        uint64_t t0 = mono_ns();
+        len = http_get(fd, "/metrics", buf, sizeof(buf), &status, &body);
+        ns[i] = mono_ns() - t0;
+        if (len < 0 || status != 200 || (i == 0 && !(samples = check_exposition(body, len)))) {
+            printf("metrics: scrape %d failed (status %d)\n", i, status);
+            rc = 1;
+        }
+        if (met.render_ns > render_max) render_max = met.render_ns;
+    }
+    close(fd);
+
+    if (rc == 0) {
+        qsort(ns, METRICS_SCRAPES, sizeof(ns[0]), cmp_u64);
+        printf("%-8s | %7s | %8s | %9s | %9s | %9s | %13s\n", "Scrapes", "Samples", "Bytes", "p50 us",
+               "p99 us", "max us", "render max us");
+        printf("---------------------------------------------------------------------------------\n");
+        printf("%-8d | %7d | %8d | %9.1f | %9.1f | %9.1f | %13.1f\n", METRICS_SCRAPES, samples, len,
+               ns[METRICS_SCRAPES / 2] / 1e3, ns[METRICS_SCRAPES * 99 / 100] / 1e3,
+               ns[METRICS_SCRAPES - 1] / 1e3, render_max / 1e3);
+    }
+    metrics_stop(&met);
+    return rc;
+}
+
+/* Writer for the crash test: the payload repeats the sequence number. */
+static void flight_child(const char *path)
+{
+    struct flight f;
+    if (!flight_open(&f, path, "bench0", 1, 20)) _exit(1);
+    struct wifi_sample s = { .fields = FIELD_SIGNAL | FIELD_TX_RETRIES, .signal_dbm = -60 };
+    for (;;) {
+        s.ts_ns = f.next_seq;
+        s.tx_retries = (uint32_t)f.next_seq;
+        flight_write(&f, &s, f.next_seq, 1);
+    }
+}
+
+/* Per-write cost, then SIGKILL a writer mid-stream and check the tail it leaves. */
+static int bench_flight(const struct bench_args *a)
+{
+    (void)a;
+    char path[64], err[128];
+    snprintf(path, sizeof(path), "/tmp/snrmon-bench-%d.flight", (int)getpid());
+    unlink(path);
+
+    struct flight f;
+    if (!flight_open(&f, path, "bench0", 1, 20)) {
+        fprintf(stderr, "ERROR: Could not map %s\n", path);
+        return 1;
+    }
+    struct wifi_sample s = { .fields = FIELD_SIGNAL, .signal_dbm = -60 };
+    uint64_t t0 = mono_ns();
+    for (int i = 0; i < FLIGHT_WRITES; i++) {
+        s.ts_ns = (uint64_t)i;
+        flight_write(&f, &s, 0, 1);
+    }
+    uint64_t elapsed = mono_ns() - t0;
+    flight_close(&f);
+    printf("%-22s | %9.1f ns/write over %d writes (%u-record ring)\n", "flight_write", (double)elapsed / FLIGHT_WRITES,
+           FLIGHT_WRITES, f.capacity);
+
+    int rc = 0, ok = 0;
+    size_t shortest = SIZE_MAX;
+    uint64_t last = 0;
+    for (int round = 0; round < FLIGHT_CRASHES; round++) {
+        pid_t pid = fork();
+        if (pid < 0) return 1;
+        if (pid == 0) flight_child(path);
+        sleep_ns(2000000 + (uint64_t)(rand() % 20) * 1000000);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        struct flight_tail t;
+        if (!flight_read(path, &t, err, sizeof(err))) {
+            printf("round %d: %s\n", round, err);
+            rc = 1;
+            break;
+        }
+        int good = t.n > 0 && t.last_seq > last;
+        for (size_t i = 0; good && i < t.n; i++) {
+            const struct flight_record *r = &t.records[i];
+            uint64_t seq = t.first_seq + i;
+            good = r->seq == seq && r->sample.ts_ns == seq && r->sample.tx_retries == (uint32_t)seq &&
+                   r->backend_ns == seq;
+        }
+        ok += good;
+        if (t.n < shortest) shortest = t.n;
+        last = t.last_seq;
+        flight_tail_free(&t);
+    }
+    printf("%-22s | %d/%d tails consistent, shortest %zu records, %llu written in all\n", "kill -9 mid-write", ok,
+           FLIGHT_CRASHES, shortest, (unsigned long long)last);
+    unlink(path);
+    return rc || ok != FLIGHT_CRASHES;
+}
+
+/* A plausible 1 Hz survey: SNR drifting with the hour, roaming between three APs. */
+static void synth_sample(uint64_t ts_ns, uint32_t *rng, struct wifi_sample *s)
+{
+    static const uint32_t rates[] = { 6500, 58500, 130000, 300000, 433300, 866700 };
+    double t = (double)(ts_ns / 1000000000ull);
+    *rng = *rng * 1664525u + 1013904223u;
+    int signal = (int)(-58 + 12 * sin(t * 2 * M_PI / 3600) + (int)(*rng >> 29) - 4);
+    int ap = (int)(ts_ns / (3 * STORE_HOUR_NS) % 3);
+    unsigned tier = signal > -50 ? 5 : signal > -60 ? 4 : signal > -67 ? 3 : signal > -72 ? 2 : signal > -78 ? 1 : 0;
+    uint32_t prev_retries = s->tx_retries, prev_packets = s->tx_packets, prev_beacon = s->beacon_loss;
+
+    memset(s, 0, sizeof(*s));
+    s->ts_ns = ts_ns;
+    s->fields = FIELD_SIGNAL | FIELD_NOISE | FIELD_RX_BITRATE | FIELD_TX_BITRATE | FIELD_TX_PACKETS |
+                FIELD_TX_RETRIES | FIELD_BEACON_LOSS | FIELD_BSSID | FIELD_HEALTH;
+    s->signal_dbm = (int8_t)signal;
+    s->noise_dbm = -92;
+    memcpy(s->bssid, (const uint8_t[6]){ 0x02, 0x00, 0x5e, 0x10, 0x20, (uint8_t)(0x30 + ap) }, 6);
+    s->rx_bitrate_kbps = rates[tier];
+    s->tx_bitrate_kbps = rates[tier ? tier - 1 : 0];
+    s->tx_packets = prev_packets + 40;
+    s->tx_retries = prev_retries + (tier < 3 ? (*rng >> 28) : (*rng >> 31));
+    s->beacon_loss = prev_beacon + (signal < -75 && (*rng & 7) == 0);
+    s->health = health_score(&health_default_weights, sample_snr(s), (s->rx_bitrate_kbps + s->tx_bitrate_kbps) / 2e3f,
+                             -1, -1);
+}
+
+struct store_check {
+    const char *dir;
+    atomic_int *stop;
+    uint64_t day0;
+    uint64_t per_day[STORE_DAYS];
+    uint64_t last_ts;
+    int ordered;
+    unsigned views, bad, rollup_days;
+};
+
+static int count_samples(void *ctx, const struct wifi_sample *s, size_t n)
+{
+    struct store_check *c = ctx;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i].ts_ns <= c->last_ts) c->ordered = 0;
+        c->last_ts = s[i].ts_ns;
+        uint64_t day = (s[i].ts_ns - c->day0) / STORE_DAY_NS;
+        if (day < STORE_DAYS) c->per_day[day]++;
+    }
+    return 1;
+}
+
+/* Every day a view shows is whole: all its samples, in order, or none of them. */
+static void *store_reader(void *arg)
+{
+    struct store_check *c = arg;
+    char err[128];
+    while (!atomic_load(c->stop)) {
+        struct store_view v;
+        if (!store_view_open(&v, c->dir, err, sizeof(err))) {
+            c->bad++;
+            continue;
+        }
+        memset(c->per_day, 0, sizeof(c->per_day));
+        c->last_ts = 0;
+        c->ordered = 1;
+        int ok = store_scan(&v, 0, UINT64_MAX, count_samples, c) && c->ordered;
+        for (int d = 0; d < STORE_DAYS; d++) ok &= c->per_day[d] == 0 || c->per_day[d] == 86400;
+        c->bad += !ok;
+        c->views++;
+        store_view_close(&v);
+    }
+    return NULL;
+}
+
+static int count_rollups(void *ctx, const struct store_rollup *r, size_t n)
+{
+    (void)r;
+    *(uint64_t *)ctx += n;
+    return 1;
+}
+
+static void print_compaction(const char *name, const struct store_compact_stats *s)
+{
+    double mb = (s->bytes_read + s->bytes_written) / 1e6, sec = s->elapsed_ns / 1e9;
+    printf("%-24s | %4u | %7u | %9.1f | %9.2f | %8.1f\n", name, s->days_compacted, s->days_expired, mb, sec,
+           sec > 0 ? mb / sec : 0);
+}
+
+/* Writes STORE_DAYS days through the sink, then compacts and expires them under a reader. */
+struct match_count {
+    const struct query *q;      /* NULL: the batch is already filtered */
+    uint64_t n;
+};
+
+static int count_matches(void *ctx, const struct wifi_sample *s, size_t n)
+{
+    struct match_count *c = ctx;
+    if (!c->q) {
+        c->n += n;
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) c->n += query_match(c->q, &s[i]);
+    return 1;
+}
+
+/* A wall clock that steps back leaves a raw file out of order; a window scan must still filter every sample. */
+static int store_order_check(void)
+{
+    char dir[64], err[128];
+    snprintf(dir, sizeof(dir), "/tmp/snrmon-bench-%d.order", (int)getpid());
+    struct store st;
+    if (!store_open(&st, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", dir, err);
+        return 0;
+    }
+    uint64_t t = (uint64_t)STORE_EPOCH_DAY * STORE_DAY_NS + STORE_HOUR_NS / 2;
+    static const int64_t steps_s[] = { 0, 2, -5, 3 };
+    struct sink k;
+    struct wifi_sample s = {0};
+    uint32_t rng = 3;
+    sink_store(&k, &st);
+    for (size_t i = 0; i < sizeof(steps_s) / sizeof(steps_s[0]); i++) {
+        synth_sample(t + (uint64_t)(steps_s[i] * 1000000000ll), &rng, &s);
+        k.sample(&k, &s);
+    }
+    k.close(&k);
+
+    struct store_view v;
+    struct match_count c = { NULL, 0 };
+    int ok = store_view_open(&v, dir, err, sizeof(err));
+    if (ok) {
+        ok = store_scan(&v, t, t + 10000000000ull, count_matches, &c);
+        store_view_close(&v);
+    }
+    store_close(&st);
+    printf("Raw file with the clock stepped back: %llu of 4 samples in the window (3 expected)\n\n",
+           (unsigned long long)c.n);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "WARNING: could not remove %s\n", dir);
+    return ok && c.n == 3;
+}
+
+static int bench_store(const struct bench_args *a)
+{
+    (void)a;
+    char dir[64], err[128];
+    snprintf(dir, sizeof(dir), "/tmp/snrmon-bench-%d.store", (int)getpid());
+    struct store st;
+    if (!store_open(&st, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", dir, err);
+        return 1;
+    }
+    st.throttle_bps = 0;
+    int order_ok = store_order_check();
+    /* A second writer, such as an --import while the monitor runs, is turned away. */
+    struct store second;
+    int locked = !store_open(&second, dir, err, sizeof(err));
+    if (!locked) store_close(&second);
+    printf("Second writer on the same store: %s\n", locked ? err : "opened, not refused");
+
+    uint64_t day0 = (uint64_t)STORE_EPOCH_DAY * STORE_DAY_NS;
+    struct sink k;
+    struct wifi_sample s = {0};
+    uint32_t rng = 1;
+    sink_store(&k, &st);
+    uint64_t t0 = mono_ns();
+    for (uint64_t i = 0; i < STORE_DAYS * 86400ull; i++) {
+        synth_sample(day0 + i * 1000000000ull, &rng, &s);
+        k.sample(&k, &s);
+    }
+    k.close(&k);
+    uint64_t write_ns = mono_ns() - t0;
+
+    atomic_int stop = 0;
+    struct store_check check = { .dir = dir, .stop = &stop, .day0 = day0 };
+    pthread_t reader;
+    pthread_create(&reader, NULL, store_reader, &check);
+
+    printf("%d days at 1 Hz written through the sink in %.2f s\n\n", STORE_DAYS, write_ns / 1e9);
+    printf("%-24s | %4s | %7s | %9s | %9s | %8s\n", "Pass", "Days", "Expired", "MB moved", "Seconds", "MB/s");
+    printf("------------------------------------------------------------------------\n");
+
+    /* One day throttled, to show the limiter holding; the rest flat out. */
+    struct store_compact_stats stats;
+    int ok = 1;
+    st.throttle_bps = 16u << 20;
+    ok &= store_compact(&st, day0 + STORE_DAY_NS, &stats);
+    print_compaction("throttled 16 MiB/s", &stats);
+    st.throttle_bps = 0;
+    ok &= store_compact(&st, day0 + STORE_DAYS * STORE_DAY_NS + STORE_HOUR_NS, &stats);
+    print_compaction("unthrottled", &stats);
+    st.retain_raw_days = 2;
+    ok &= store_compact(&st, day0 + STORE_DAYS * STORE_DAY_NS + STORE_HOUR_NS, &stats);
+    print_compaction("retain raw 2 days", &stats);
+
+    sleep_ns(50000000);
+    atomic_store(&stop, 1);
+    pthread_join(reader, NULL);
+
+    struct store_view v;
+    uint64_t rollups = 0;
+    if (store_view_open(&v, dir, err, sizeof(err))) {
+        printf("\n");
+        store_info(&v, stdout);
+        ok &= store_scan_rollups(&v, 0, UINT64_MAX, count_rollups, &rollups);
+        store_view_close(&v);
+    }
+    printf("\n%u reader views during compaction, %u inconsistent; %llu minute rollups kept (%d expected)\n",
+           check.views, check.bad, (unsigned long long)rollups, STORE_DAYS * 1440);
+    store_close(&st);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "WARNING: could not remove %s\n", dir);
+    return !ok || !order_ok || !locked || check.bad || rollups != STORE_DAYS * 1440;
+}
+
+static uint32_t hash32(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+/*
+ * A site survey at 1 Hz: one floor a day, a new access point every five
+ * minutes along the walk, and one stretch in twelve through a dead zone.
+ */
+static void survey_sample(uint64_t ts_ns, uint32_t *rng, struct wifi_sample *s)
+{
+    uint64_t secs = ts_ns / 1000000000ull, segment = secs / 300;
+    unsigned floor = (unsigned)(secs / 86400 % SURVEY_FLOORS), ap = hash32(segment) % SURVEY_APS;
+    int dead = hash32(segment * 7 + 1) % 12 == 0;
+    *rng = *rng * 1664525u + 1013904223u;
+    int signal = dead ? -84 + (int)(*rng >> 29) : -48 - (int)(hash32(segment * 3) % 22) - (int)(*rng >> 30);
+    uint32_t retries = s->tx_retries;
+
+    memset(s, 0, sizeof(*s));
+    s->ts_ns = ts_ns;
+    s->fields = FIELD_SIGNAL | FIELD_NOISE | FIELD_RX_BITRATE | FIELD_TX_BITRATE | FIELD_TX_RETRIES | FIELD_BSSID |
+                FIELD_HEALTH;
+    s->signal_dbm = (int8_t)signal;
+    s->noise_dbm = -92;
+    memcpy(s->bssid, (const uint8_t[6]){ 0x02, 0x00, 0x5e, 0x00, (uint8_t)floor, (uint8_t)ap }, 6);
+    s->rx_bitrate_kbps = signal > -60 ? 866700 : signal > -72 ? 300000 : 58500;
+    s->tx_bitrate_kbps = s->rx_bitrate_kbps / 2;
+    s->tx_retries = retries + (signal < -72 ? (*rng >> 29) : 0);
+    s->health = health_score(&health_default_weights, sample_snr(s), s->rx_bitrate_kbps * 0.75f / 1000, -1, -1);
+}
+
+/* Block skip ratio of typical survey queries over a month of 1 Hz data. */
+static int bench_zonemap(const struct bench_args *a)
+{
+    (void)a;
+    static const char *const queries[] = {
+        "bssid=02:00:5e:00:03:07 snr<15",
+        "bssid=02:00:5e:00:03:07",
+        "snr<15",
+        "signal>=-50",
+        "from=2024-10-20 to=2024-10-21",
+        "bssid=02:00:5e:00:07:0b from=2024-10-20 to=2024-10-25",
+        "",
+    };
+    char dir[64], err[128];
+    snprintf(dir, sizeof(dir), "/tmp/snrmon-bench-%d.survey", (int)getpid());
+    struct store st;
+    if (!store_open(&st, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", dir, err);
+        return 1;
+    }
+    st.throttle_bps = 0;
+    st.retain_raw_days = 0;
+
+    uint64_t day0 = (uint64_t)STORE_EPOCH_DAY * STORE_DAY_NS;
+    struct sink k;
+    struct wifi_sample s = {0};
+    uint32_t rng = 7;
+    int ok = 1;
+    sink_store(&k, &st);
+    for (int d = 0; d < SURVEY_DAYS && ok; d++) {
+        for (uint64_t i = 0; i < 86400; i++) {
+            survey_sample(day0 + (uint64_t)d * STORE_DAY_NS + i * 1000000000ull, &rng, &s);
+            k.sample(&k, &s);
+        }
+        k.flush(&k);
+        ok = store_compact(&st, day0 + (uint64_t)(d + 1) * STORE_DAY_NS, NULL);
+    }
+    k.close(&k);
+    ok = ok && store_compact(&st, day0 + (SURVEY_DAYS + 1ull) * STORE_DAY_NS, NULL);
+
+    struct store_view v;
+    if (!ok || !store_view_open(&v, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: could not build the survey store\n");
+        store_close(&st);
+        return 1;
+    }
+    printf("%d days, %d samples, %zu files\n\n", SURVEY_DAYS, SURVEY_DAYS * 86400, v.manifest.n);
+    printf("%-54s | %8s | %6s | %5s | %5s | %5s | %6s | %8s | %8s | %8s\n", "Query", "Matches", "Blocks", "Time",
+           "Zone", "Bloom", "Skip", "Pruned", "Summary", "Full");
+    printf("-------------------------------------------------------------------------------------------------------------------------------------\n");
+
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]) && ok; i++) {
+        struct query q;
+        struct store_scan_stats stats;
+        if (!query_parse(queries[i], &q, err, sizeof(err))) {
+            fprintf(stderr, "ERROR: %s: %s\n", queries[i], err);
+            ok = 0;
+            break;
+        }
+        struct match_count pruned = { NULL, 0 }, full = { &q, 0 };
+        struct store_scan_stats all_stats;
+        struct store_prune all;
+        store_prune_all(&all, 0, UINT64_MAX);
+        uint64_t t0 = mono_ns();
+        ok &= store_scan_pruned(&v, &all, count_matches, &full, &all_stats);
+        uint64_t t1 = mono_ns();
+        ok &= query_run(&v, &q, count_matches, &pruned, &stats);
+        uint64_t t2 = mono_ns();
+        struct query_summary z;
+        ok &= query_summarize(&v, &q, &z, NULL);
+        uint64_t t3 = mono_ns();
+        /* Day files outside the time range are skipped whole; count their blocks too. */
+        stats.skipped_time += all_stats.blocks - stats.blocks;
+        stats.blocks = all_stats.blocks;
+        if (pruned.n != full.n || z.matches != full.n) {
+            printf("%-54s | pruned scan found %llu, summary %llu, full scan %llu\n", queries[i],
+                   (unsigned long long)pruned.n, (unsigned long long)z.matches, (unsigned long long)full.n);
+            ok = 0;
+        }
+        uint64_t skipped = stats.skipped_time + stats.skipped_zone + stats.skipped_bloom;
+        printf("%-54s | %8llu | %6llu | %5llu | %5llu | %5llu | %5.1f%% | %6.1fms | %6.1fms | %6.1fms\n",
+               *queries[i] ? queries[i] : "(everything)", (unsigned long long)pruned.n,
+               (unsigned long long)stats.blocks, (unsigned long long)stats.skipped_time,
+               (unsigned long long)stats.skipped_zone, (unsigned long long)stats.skipped_bloom,
+               stats.blocks ? 100.0 * skipped / stats.blocks : 0, (t2 - t1) / 1e6, (t3 - t2) / 1e6, (t1 - t0) / 1e6);
+    }
+    store_view_close(&v);
+    store_close(&st);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "WARNING: could not remove %s\n", dir);
+    return !ok;
+}
+
+enum kernel_case {
+    K_RANGE_I8,
+    K_RANGE_U64,
+    K_EQ_U64,
+    K_BITS_U32,
+    K_SELECT,
+    K_COMPRESS_F32,
+    K_AGG_I8,
+    K_AGG_F32,
+    K_HIST_I8,
+    K_CASES,
+};
+
+static const struct {
+    const char *name;
+    unsigned bytes;             /* column bytes read per row */
+} kernel_cases[K_CASES] = {
+    { "range_i8 (snr)", 1 },
+    { "range_u64 (time)", 8 },
+    { "eq_u64 (bssid)", 8 },
+    { "bits_u32 (fields)", 4 },
+    { "select", 0 },
+    { "compress_f32 (health)", 4 },
+    { "agg_i8 (snr)", 1 },
+    { "agg_f32 (health)", 4 },
+    { "hist_i8 (snr)", 1 },
+};
+
+struct kernel_data {
+    uint64_t *ts_ns, *bssid;    /* KERNEL_ROWS rows each */
+    uint32_t *fields;
+    int8_t *snr_db;
+    float *health;
+    uint64_t *sel;              /* SNR of 32 dB or more: about half the rows */
+    uint64_t *mask;
+    uint32_t *rows;
+    float *values;
+    struct kernel_agg agg;
+    uint64_t hist[QUERY_SNR_BUCKETS];
+    size_t out;
+};
+
+/* One pass of a kernel over every row; what it produced is left in d. */
+static void run_kernel(const struct kernel_ops *k, enum kernel_case which, struct kernel_data *d)
+{
+    size_t n = KERNEL_ROWS;
+    if (which <= K_BITS_U32) kernel_mask_all(d->mask, n);
+    switch (which) {
+    case K_RANGE_I8: k->range_i8(d->snr_db, n, INT8_MIN, 14, d->mask); break;
+    case K_RANGE_U64: k->range_u64(d->ts_ns, n, d->ts_ns[n / 4], d->ts_ns[n / 2], d->mask); break;
+    case K_EQ_U64: k->eq_u64(d->bssid, n, d->bssid[n / 3], d->mask); break;
+    case K_BITS_U32: k->bits_u32(d->fields, n, FIELD_SIGNAL | FIELD_BSSID, FIELD_GAP, d->mask); break;
+    case K_SELECT: d->out = k->select(d->sel, n, d->rows); break;
+    case K_COMPRESS_F32: d->out = k->compress_f32(d->health, d->sel, n, d->values); break;
+    case K_AGG_I8:
+        kernel_agg_init(&d->agg);
+        k->agg_i8(d->snr_db, d->sel, n, &d->agg);
+        break;
+    case K_AGG_F32:
+        kernel_agg_init(&d->agg);
+        k->agg_f32(d->health, d->sel, n, &d->agg);
+        break;
+    case K_HIST_I8:
+        memset(d->hist, 0, sizeof(d->hist));
+        k->hist_i8(d->snr_db, d->sel, n, 0, QUERY_SNR_BUCKETS, d->hist);
+        break;
+    default: break;
+    }
+}
+
+/* Whether two implementations left the same result. */
+static int same_result(enum kernel_case which, const struct kernel_data *a, const struct kernel_data *b)
+{
+    switch (which) {
+    case K_SELECT: return a->out == b->out && memcmp(a->rows, b->rows, a->out * sizeof(*a->rows)) == 0;
+    case K_COMPRESS_F32: return a->out == b->out && memcmp(a->values, b->values, a->out * sizeof(*a->values)) == 0;
+    case K_AGG_I8:
+    case K_AGG_F32:
+        return a->agg.count == b->agg.count && a->agg.min == b->agg.min && a->agg.max == b->agg.max &&
+               fabs(a->agg.sum - b->agg.sum) <= 1e-9 * fabs(a->agg.sum) + 1e-6;
+    case K_HIST_I8: return memcmp(a->hist, b->hist, sizeof(a->hist)) == 0;
+    default: return memcmp(a->mask, b->mask, KERNEL_MASK_WORDS(KERNEL_ROWS) * sizeof(*a->mask)) == 0;
+    }
+}
+
+/* Rows per second over at least KERNEL_MIN_NS of passes. */
+static double time_kernel(const struct kernel_ops *k, enum kernel_case which, struct kernel_data *d)
+{
+    uint64_t passes = 0, t0 = mono_ns(), t;
+    do {
+        run_kernel(k, which, d);
+        passes++;
+    } while ((t = mono_ns()) - t0 < KERNEL_MIN_NS);
+    return (double)passes * KERNEL_ROWS / ((t - t0) / 1e9);
+}
+
+static void kernel_data_free(struct kernel_data *d)
+{
+    free(d->ts_ns);
+    free(d->bssid);
+    free(d->fields);
+    free(d->snr_db);
+    free(d->health);
+    free(d->sel);
+    free(d->mask);
+    free(d->rows);
+    free(d->values);
+}
+
+/* Columns of a month-long survey, as the store decodes them. */
+static int kernel_data_init(struct kernel_data *d)
+{
+    size_t n = KERNEL_ROWS, words = KERNEL_MASK_WORDS(n);
+    memset(d, 0, sizeof(*d));
+    d->ts_ns = malloc(n * sizeof(*d->ts_ns));
+    d->bssid = malloc(n * sizeof(*d->bssid));
+    d->fields = malloc(n * sizeof(*d->fields));
+    d->snr_db = malloc(n);
+    d->health = malloc(n * sizeof(*d->health));
+    d->sel = calloc(words, sizeof(*d->sel));
+    d->mask = malloc(words * sizeof(*d->mask));
+    d->rows = malloc((n + KERNEL_SLACK) * sizeof(*d->rows));
+    d->values = malloc((n + KERNEL_SLACK) * sizeof(*d->values));
+    if (!d->ts_ns || !d->bssid || !d->fields || !d->snr_db || !d->health || !d->sel || !d->mask || !d->rows ||
+        !d->values) {
+        kernel_data_free(d);
+        return 0;
+    }
+    struct wifi_sample s = {0};
+    uint32_t rng = 11;
+    uint64_t day0 = (uint64_t)STORE_EPOCH_DAY * STORE_DAY_NS;
+    for (size_t i = 0; i < n; i++) {
+        survey_sample(day0 + i * 2500000000ull, &rng, &s);
+        d->ts_ns[i] = s.ts_ns;
+        d->bssid[i] = block_pack_bssid(s.bssid);
+        d->fields[i] = s.fields;
+        d->snr_db[i] = (int8_t)sample_snr(&s);
+        d->health[i] = s.health;
+        if (d->snr_db[i] >= 32) d->sel[i / 64] |= 1ull << (i % 64);
+    }
+    return 1;
+}
+
+/* A query's filter over decoded blocks: query_match per sample, then query_mask with each kernel set. */
+static int bench_query_paths(const struct kernel_ops *avx2)
+{
+    static const char *const queries[] = {
+        "bssid=02:00:5e:00:03:07 snr<15",
+        "snr<15",
+        "signal>=-60 signal<=-50 from=2024-10-05 to=2024-10-12",
+    };
+    size_t blocks = KERNEL_ROWS / BLOCK_MAX_SAMPLES;
+    struct wifi_sample *rows = malloc(KERNEL_ROWS * sizeof(*rows));
+    struct block_columns *cols = malloc(blocks * sizeof(*cols));
+    uint64_t *mask = malloc(KERNEL_MASK_WORDS(BLOCK_MAX_SAMPLES) * sizeof(*mask));
+    if (!rows || !cols || !mask) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        free(rows);
+        free(cols);
+        free(mask);
+        return 0;
+    }
+    struct wifi_sample s = {0};
+    uint32_t rng = 11;
+    uint64_t day0 = (uint64_t)STORE_EPOCH_DAY * STORE_DAY_NS;
+    for (size_t i = 0; i < KERNEL_ROWS; i++) {
+        survey_sample(day0 + i * 2500000000ull, &rng, &s);
+        rows[i] = s;
+    }
+    for (size_t b = 0; b < blocks; b++) {
+        block_columns_from_samples(rows + b * BLOCK_MAX_SAMPLES, BLOCK_MAX_SAMPLES, &cols[b]);
+    }
+
+    printf("\n%-54s | %8s | %9s | %9s | %9s\n", "Query filter, Mrows/s", "Matches", "Per row", "Scalar", "AVX2");
+    printf("--------------------------------------------------------------------------------------------------\n");
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        struct query q;
+        char err[128];
+        if (!query_parse(queries[i], &q, err, sizeof(err))) {
+            fprintf(stderr, "ERROR: %s: %s\n", queries[i], err);
+            ok = 0;
+            break;
+        }
+        uint64_t per_row = 0, t0 = mono_ns();
+        for (size_t r = 0; r < KERNEL_ROWS; r++) per_row += query_match(&q, &rows[r]);
+        uint64_t t1 = mono_ns();
+
+        const struct kernel_ops *sets[2] = { &kernel_scalar, avx2 };
+        double rate[2] = { 0, 0 };
+        for (int k = 0; k < 2 && sets[k]; k++) {
+            q.kern = sets[k];
+            uint64_t found = 0, t2 = mono_ns();
+            for (size_t b = 0; b < blocks; b++) {
+                query_mask(&q, &cols[b], mask);
+                found += kernel_count(mask, BLOCK_MAX_SAMPLES);
+            }
+            rate[k] = KERNEL_ROWS / ((mono_ns() - t2) / 1e3);
+            if (found != per_row) {
+                printf("%-54s | %s kernels found %llu, query_match %llu\n", queries[i], sets[k]->name,
+                       (unsigned long long)found, (unsigned long long)per_row);
+                ok = 0;
+            }
+        }
+        printf("%-54s | %8llu | %9.1f | %9.1f | %9.1f\n", queries[i], (unsigned long long)per_row,
+               KERNEL_ROWS / ((t1 - t0) / 1e3), rate[0], rate[1]);
+    }
+    free(rows);
+    free(cols);
+    free(mask);
+    return ok;
+}
+
+#define HEALTH_ROWS 65536
+
+/* health_score_batch against health_score per row, over readings with gaps, NaNs and out-of-range values. */
+static int bench_health_batch(void)
+{
+    static float snr[HEALTH_ROWS], rate[HEALTH_ROWS], retry[HEALTH_ROWS], beacon[HEALTH_ROWS];
+    static float batch[HEALTH_ROWS], scalar[HEALTH_ROWS];
+    uint32_t rng = 1;
+    for (size_t i = 0; i < HEALTH_ROWS; i++) {
+        float *cols[] = { &snr[i], &rate[i], &retry[i], &beacon[i] };
+        static const float span[] = { 60.0f, 1200.0f, 1.2f, 4.0f };
+        for (int j = 0; j < 4; j++) {
+            rng = rng * 1664525u + 1013904223u;
+            unsigned r = rng >> 8;
+            *cols[j] = r % 16 == 0 ? -1.0f : r % 97 == 0 ? NAN : (float)(r % 100000) / 100000.0f * span[j] - 0.1f;
+        }
+    }
+    struct health_columns c = { snr, rate, retry, beacon };
+    uint64_t best_batch = UINT64_MAX, best_scalar = UINT64_MAX;
+    for (int rep = 0; rep < 5; rep++) {
+        uint64_t t = mono_ns();
+        health_score_batch(&health_default_weights, &c, batch, HEALTH_ROWS);
+        t = mono_ns() - t;
+        if (t < best_batch) best_batch = t;
+        t = mono_ns();
+        for (size_t i = 0; i < HEALTH_ROWS; i++) {
+            scalar[i] = health_score(&health_default_weights, snr[i], rate[i], retry[i], beacon[i]);
+        }
+        t = mono_ns() - t;
+        if (t < best_scalar) best_scalar = t;
+    }
+    unsigned wrong = 0;
+    for (size_t i = 0; i < HEALTH_ROWS; i++) wrong += !(batch[i] == scalar[i] || (isnan(batch[i]) && isnan(scalar[i])));
+    printf("\nhealth_score_batch: %.2f ns/row against %.2f per health_score call, %u of %u rows differ%s\n",
+           (double)best_batch / HEALTH_ROWS, (double)best_scalar / HEALTH_ROWS, wrong, HEALTH_ROWS,
+           wrong ? "  MISMATCH" : "");
+    return !wrong;
+}
+
+/*
+ * health_track over a reassociation and a roam: the station's counters
+ * restart, and the sample after must read as no retry or beacon data, not
+ * as four billion losses.
+ */
+static int health_track_checks(void)
+{
+    static const struct { uint32_t retries, packets, losses; uint8_t ap; float ratio, beacon; } steps[] = {
+        { 1000, 9000, 40, 1, -1.0f, -1.0f },    /* first sample primes */
+        { 1010, 9090, 41, 1, 0.1f, 1.0f },
+        { 3, 50, 0, 1, -1.0f, -1.0f },          /* reassociated: every counter restarted */
+        { 13, 140, 0, 1, 0.1f, 0.0f },
+        { 20, 150, 2, 1, 0.41176471f, 2.0f },
+        { 25, 160, 0, 1, -1.0f, -1.0f },        /* only beacon loss went back */
+        { 30, 250, 1, 2, -1.0f, -1.0f },        /* roamed: counters kept going, another AP */
+        { 35, 295, 1, 2, 0.1f, 0.0f },
+    };
+    struct health_tracker t = {0};
+    int wrong = 0;
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        struct wifi_sample s = { .fields = FIELD_TX_RETRIES | FIELD_TX_PACKETS | FIELD_BEACON_LOSS | FIELD_BSSID,
+                                 .tx_retries = steps[i].retries, .tx_packets = steps[i].packets,
+                                 .beacon_loss = steps[i].losses, .bssid = { 2, 0, 0, 0, 0, steps[i].ap } };
+        float ratio, beacon;
+        health_track(&t, &s, &ratio, &beacon);
+        wrong += fabsf(ratio - steps[i].ratio) > 1e-6f || beacon != steps[i].beacon;
+    }
+    printf("health_track over counter resets and a roam: %d of %zu steps wrong%s\n", wrong,
+           sizeof(steps) / sizeof(steps[0]), wrong ? "  WRONG" : "");
+    return !wrong;
+}
+
+/* Filter and aggregate kernels: scalar against AVX2, then whole queries against query_match. */
+static int bench_kernels(const struct bench_args *a)
+{
+    (void)a;
+    const struct kernel_ops *avx2 = kernel_avx2();
+    struct kernel_data scalar_out, avx2_out;
+    if (!kernel_data_init(&scalar_out) || !kernel_data_init(&avx2_out)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    printf("%u rows, %zu selected for select, compress and the aggregates%s\n\n", KERNEL_ROWS,
+           kernel_count(scalar_out.sel, KERNEL_ROWS), avx2 ? "" : "; no AVX2 on this CPU");
+    printf("%-22s | %9s | %11s | %11s | %7s\n", "Kernel", "Bytes/row", "Scalar GB/s", "AVX2 GB/s", "Speedup");
+    printf("------------------------------------------------------------------------\n");
+
+    int ok = 1;
+    for (int i = 0; i < K_CASES; i++) {
+        double rs = time_kernel(&kernel_scalar, (enum kernel_case)i, &scalar_out);
+        double rv = avx2 ? time_kernel(avx2, (enum kernel_case)i, &avx2_out) : 0;
+        /* select reads only the bitmap: report it in rows rather than column bytes. */
+        unsigned bytes = kernel_cases[i].bytes;
+        char width[16];
+        snprintf(width, sizeof(width), bytes ? "%u" : "(Grows/s)", bytes);
+        double scale = (bytes ? bytes : 1) / 1e9;
+        int same = !avx2 || same_result((enum kernel_case)i, &scalar_out, &avx2_out);
+        printf("%-22s | %9s | %11.2f | %11.2f | %6.1fx%s\n", kernel_cases[i].name, width, rs * scale, rv * scale,
+               avx2 ? rv / rs : 0.0, same ? "" : "  MISMATCH");
+        ok &= same;
+    }
+    kernel_data_free(&scalar_out);
+    kernel_data_free(&avx2_out);
+    ok &= bench_health_batch();
+    ok &= health_track_checks();
+    return !(ok && bench_query_paths(avx2));
+}
+
+/* Recorded "netsh wlan show interfaces" outputs in each supported display language, with what they hold. */
+static const struct netsh_case {
+    const char *name;
+    enum netsh_state state;
+    const char *ssid;           /* "" when there is no SSID row or it is empty */
+    int signal_pct;             /* -1 without a Signal row */
+    unsigned rx_kbps, tx_kbps;
+    const char *text;
+} netsh_corpus[] = {
+    { "en connected", NETSH_STATE_CONNECTED, "HomeNet", 92, 866700, 780000,
+      "\r\n"
+      "There is 1 interface on the system: \r\n"
+      "\r\n"
+      "    Name                   : Wi-Fi\r\n"
+      "    Description            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Physical address       : 3c:a9:f4:12:34:56\r\n"
+      "    Interface type         : Primary\r\n"
+      "    State                  : connected\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    AP BSSID               : 02:00:5e:10:20:30\r\n"
+      "    Band                   : 5 GHz\r\n"
+      "    Radio type             : 802.11ax\r\n"
+      "    Authentication         : WPA2-Personal\r\n"
+      "    Cipher                 : CCMP\r\n"
+      "    Connection mode        : Auto Connect\r\n"
+      "    Channel                : 36\r\n"
+      "    Receive rate (Mbps)    : 866.7\r\n"
+      "    Transmit rate (Mbps)   : 780\r\n"
+      "    Signal                 : 92%\r\n"
+      "    Profile                : HomeNet\r\n"
+      "    Hosted network status  : Not available\r\n"
+      "\r\n" },
+    { "de connected", NETSH_STATE_CONNECTED, "Büro-5G", 88, 585100, 526500,
+      "\r\n"
+      "Es ist 1 Schnittstelle auf dem System vorhanden: \r\n"
+      "\r\n"
+      "    Name                   : Wi-Fi\r\n"
+      "    Beschreibung           : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Physische Adresse      : 3c:a9:f4:12:34:56\r\n"
+      "    Schnittstellentyp      : Primär\r\n"
+      "    Status                 : Verbunden\r\n"
+      "    SSID                   : Büro-5G\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Band                   : 5 GHz\r\n"
+      "    Funktyp                : 802.11ax\r\n"
+      "    Authentifizierung      : WPA2-Personal\r\n"
+      "    Verschlüsselung        : CCMP\r\n"
+      "    Verbindungsmodus       : Auto Connect\r\n"
+      "    Kanal                  : 36\r\n"
+      "    Empfangsrate (MBit/s)  : 585,1\r\n"
+      "    Übertragungsrate (MBit/s): 526,5\r\n"
+      "    Signal                 : 88%\r\n"
+      "    Profil                 : HomeNet\r\n"
+      "    Status des gehosteten Netzwerks: Nicht verfügbar\r\n"
+      "\r\n" },
+    { "fr connected", NETSH_STATE_CONNECTED, "HomeNet", 75, 433000, 390000,
+      "\r\n"
+      "Il existe 1 interface sur le système : \r\n"
+      "\r\n"
+      "    Nom                    : Wi-Fi\r\n"
+      "    Description            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Adresse physique       : 3c:a9:f4:12:34:56\r\n"
+      "    Type d'interface       : Principal\r\n"
+      "    État                   : connecté\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Bande                  : 5 GHz\r\n"
+      "    Type de radio          : 802.11ax\r\n"
+      "    Authentification       : WPA2-Personal\r\n"
+      "    Chiffrement            : CCMP\r\n"
+      "    Mode de connexion      : Auto Connect\r\n"
+      "    Canal                  : 36\r\n"
+      "    Réception (Mbits/s)    : 433\r\n"
+      "    Transmission (Mbits/s) : 390\r\n"
+      "    Signal                 : 75 %\r\n"
+      "    Profil                 : HomeNet\r\n"
+      "    État du réseau hébergé : Non disponible\r\n"
+      "\r\n" },
+    { "es connected", NETSH_STATE_CONNECTED, "HomeNet", 61, 300000, 270000,
+      "\r\n"
+      "Hay 1 interfaz en el sistema: \r\n"
+      "\r\n"
+      "    Nombre                 : Wi-Fi\r\n"
+      "    Descripción            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Dirección física       : 3c:a9:f4:12:34:56\r\n"
+      "    Tipo de interfaz       : Principal\r\n"
+      "    Estado                 : conectado\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Banda                  : 5 GHz\r\n"
+      "    Tipo de radio          : 802.11ax\r\n"
+      "    Autenticación          : WPA2-Personal\r\n"
+      "    Cifrado                : CCMP\r\n"
+      "    Modo de conexión       : Auto Connect\r\n"
+      "    Canal                  : 36\r\n"
+      "    Velocidad de recepción (Mbps): 300\r\n"
+      "    Velocidad de transmisión (Mbps): 270\r\n"
+      "    Señal                  : 61%\r\n"
+      "    Perfil                 : HomeNet\r\n"
+      "    Estado de la red hospedada: No disponible\r\n"
+      "\r\n" },
+    { "ru connected", NETSH_STATE_CONNECTED, "HomeNet", 54, 144400, 130000,
+      "\r\n"
+      "В системе есть 1 интерфейс: \r\n"
+      "\r\n"
+      "    Имя                    : Wi-Fi\r\n"
+      "    Описание               : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Физический адрес       : 3c:a9:f4:12:34:56\r\n"
+      "    Тип интерфейса         : Principal\r\n"
+      "    Состояние              : подключено\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Диапазон               : 5 GHz\r\n"
+      "    Тип радио              : 802.11ax\r\n"
+      "    Проверка подлинности   : WPA2-Personal\r\n"
+      "    Шифр                   : CCMP\r\n"
+      "    Режим подключения      : Auto Connect\r\n"
+      "    Канал                  : 36\r\n"
+      "    Скорость приема (Мбит/с): 144.4\r\n"
+      "    Скорость передачи (Мбит/с): 130\r\n"
+      "    Сигнал                 : 54%\r\n"
+      "    Профиль                : HomeNet\r\n"
+      "    Состояние размещенной сети: Недоступно\r\n"
+      "\r\n" },
+    { "ja connected", NETSH_STATE_CONNECTED, "HomeNet", 83, 1201000, 960000,
+      "\r\n"
+      "システムに 1 インターフェイスがあります: \r\n"
+      "\r\n"
+      "    名前                     : Wi-Fi\r\n"
+      "    説明                     : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    物理アドレス                 : 3c:a9:f4:12:34:56\r\n"
+      "    インターフェイスの種類            : Principal\r\n"
+      "    状態                     : 接続されました\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    バンド                    : 5 GHz\r\n"
+      "    無線の種類                  : 802.11ax\r\n"
+      "    認証                     : WPA2-Personal\r\n"
+      "    暗号                     : CCMP\r\n"
+      "    接続モード                  : Auto Connect\r\n"
+      "    チャネル                   : 36\r\n"
+      "    受信速度 (Mbps)            : 1201\r\n"
+      "    送信速度 (Mbps)            : 960\r\n"
+      "    シグナル                   : 83%\r\n"
+      "    プロファイル                 : HomeNet\r\n"
+      "    ホストされたネットワークの状態        : 利用不可\r\n"
+      "\r\n" },
+    { "ar connected", NETSH_STATE_CONNECTED, "HomeNet", 70, 72200, 65000,
+      "\r\n"
+      "توجد واجهة 1 على النظام: \r\n"
+      "\r\n"
+      "    الاسم                  : Wi-Fi\r\n"
+      "    الوصف                  : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    العنوان الفعلي         : 3c:a9:f4:12:34:56\r\n"
+      "    نوع الواجهة            : Principal\r\n"
+      "    الحالة                 : متصل\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    النطاق                 : 5 GHz\r\n"
+      "    نوع الراديو            : 802.11ax\r\n"
+      "    المصادقة               : WPA2-Personal\r\n"
+      "    التشفير                : CCMP\r\n"
+      "    وضع الاتصال            : Auto Connect\r\n"
+      "    القناة                 : 36\r\n"
+      "    معدل الاستلام (ميجابت/ثانية): 72.2\r\n"
+      "    معدل الإرسال (ميجابت/ثانية): 65\r\n"
+      "    الإشارة                : 70%\r\n"
+      "    ملف التعريف            : HomeNet\r\n"
+      "    حالة الشبكة المستضافة  : غير متوفر\r\n"
+      "\r\n" },
+    { "en disconnected", NETSH_STATE_DISCONNECTED, "", -1, 0, 0,
+      "\r\n"
+      "There is 1 interface on the system: \r\n"
+      "\r\n"
+      "    Name                   : Wi-Fi\r\n"
+      "    Description            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Physical address       : 3c:a9:f4:12:34:56\r\n"
+      "    Interface type         : Primary\r\n"
+      "    State                  : disconnected\r\n"
+      "    Radio status           : Hardware On\r\n"
+      "                           : Software On\r\n"
+      "    Hosted network status  : Not available\r\n"
+      "\r\n" },
+    { "de disconnected", NETSH_STATE_DISCONNECTED, "", -1, 0, 0,
+      "\r\n"
+      "Es ist 1 Schnittstelle auf dem System vorhanden: \r\n"
+      "\r\n"
+      "    Name                   : WLAN\r\n"
+      "    Beschreibung           : Realtek 8822CE Wireless LAN 802.11ac PCI-E NIC\r\n"
+      "    GUID                   : 9d1e0b3c-5a7f-4e62-8c19-2b4d6f80a1e3\r\n"
+      "    Physische Adresse      : f4:5c:89:aa:bb:cc\r\n"
+      "    Status                 : Getrennt\r\n"
+      "    Funkstatus             : Hardware Ein\r\n"
+      "    Status des gehosteten Netzwerks: Nicht verfügbar\r\n"
+      "\r\n" },
+    { "en two interfaces", NETSH_STATE_CONNECTING, "", 40, 144400, 144400,
+      "\r\n"
+      "There are 2 interfaces on the system: \r\n"
+      "\r\n"
+      "    Name                   : Wi-Fi\r\n"
+      "    Description            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Physical address       : 3c:a9:f4:12:34:56\r\n"
+      "    Interface type         : Primary\r\n"
+      "    State                  : authenticating\r\n"
+      "    SSID                   : \r\n"
+      "    AP BSSID               : 02:00:5e:0a:0b:0c\r\n"
+      "    Band                   : 2.4 GHz\r\n"
+      "    Radio type             : 802.11n\r\n"
+      "    Authentication         : WPA2-Enterprise\r\n"
+      "    Cipher                 : CCMP\r\n"
+      "    Connection mode        : Profile\r\n"
+      "    Channel                : 6\r\n"
+      "    Receive rate (Mbps)    : 144.4\r\n"
+      "    Transmit rate (Mbps)   : 144.4\r\n"
+      "    Signal                 : 40%\r\n"
+      "    Profile                : Corp\r\n"
+      "    Hosted network status  : Not available\r\n"
+      "\r\n"
+      "    Name                   : Wi-Fi 2\r\n"
+      "    Description            : TP-Link Wireless USB Adapter\r\n"
+      "    GUID                   : 0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9\r\n"
+      "    Physical address       : 50:c7:bf:01:02:03\r\n"
+      "    Interface type         : Secondary\r\n"
+      "    State                  : connected\r\n"
+      "    SSID                   : Guest\r\n"
+      "    AP BSSID               : 02:00:5e:99:88:77\r\n"
+      "    Band                   : 5 GHz\r\n"
+      "    Radio type             : 802.11ac\r\n"
+      "    Authentication         : Open\r\n"
+      "    Cipher                 : None\r\n"
+      "    Connection mode        : Auto Connect\r\n"
+      "    Channel                : 44\r\n"
+      "    Receive rate (Mbps)    : 433\r\n"
+      "    Transmit rate (Mbps)   : 433\r\n"
+      "    Signal                 : 99%\r\n"
+      "    Profile                : Guest\r\n"
+      "    Hosted network status  : Not available\r\n"
+      "\r\n" },
+};
+
+#define NETSH_CASES (sizeof(netsh_corpus) / sizeof(netsh_corpus[0]))
+
+/*
+ * Some of the outputs above as netsh writes them into a pipe: in the OEM
+ * code page, which poc.c converts to UTF-8 before parsing. Arabic (720)
+ * is missing because glibc's iconv, standing in for Windows here, has no
+ * table for it.
+ */
+static const struct netsh_oem_case {
+    const char *name;           /* the UTF-8 case this one should parse like */
+    const char *codepage;
+    const char *text;
+} netsh_oem_corpus[] = {
+    { "de connected", "CP850",
+      "\r\n"
+      "Es ist 1 Schnittstelle auf dem System vorhanden: \r\n"
+      "\r\n"
+      "    Name                   : Wi-Fi\r\n"
+      "    Beschreibung           : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Physische Adresse      : 3c:a9:f4:12:34:56\r\n"
+      "    Schnittstellentyp      : Prim\204r\r\n"
+      "    Status                 : Verbunden\r\n"
+      "    SSID                   : B\201ro-5G\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Band                   : 5 GHz\r\n"
+      "    Funktyp                : 802.11ax\r\n"
+      "    Authentifizierung      : WPA2-Personal\r\n"
+      "    Verschl\201sselung        : CCMP\r\n"
+      "    Verbindungsmodus       : Auto Connect\r\n"
+      "    Kanal                  : 36\r\n"
+      "    Empfangsrate (MBit/s)  : 585,1\r\n"
+      "    \232bertragungsrate (MBit/s): 526,5\r\n"
+      "    Signal                 : 88%\r\n"
+      "    Profil                 : HomeNet\r\n"
+      "    Status des gehosteten Netzwerks: Nicht verf\201gbar\r\n"
+      "\r\n" },
+    { "fr connected", "CP850",
+      "\r\n"
+      "Il existe 1 interface sur le syst\212me : \r\n"
+      "\r\n"
+      "    Nom                    : Wi-Fi\r\n"
+      "    Description            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Adresse physique       : 3c:a9:f4:12:34:56\r\n"
+      "    Type d'interface       : Principal\r\n"
+      "    \220tat                   : connect\202\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Bande                  : 5 GHz\r\n"
+      "    Type de radio          : 802.11ax\r\n"
+      "    Authentification       : WPA2-Personal\r\n"
+      "    Chiffrement            : CCMP\r\n"
+      "    Mode de connexion      : Auto Connect\r\n"
+      "    Canal                  : 36\r\n"
+      "    R\202ception (Mbits/s)    : 433\r\n"
+      "    Transmission (Mbits/s) : 390\r\n"
+      "    Signal                 : 75 %\r\n"
+      "    Profil                 : HomeNet\r\n"
+      "    \220tat du r\202seau h\202berg\202 : Non disponible\r\n"
+      "\r\n" },
+    { "es connected", "CP850",
+      "\r\n"
+      "Hay 1 interfaz en el sistema: \r\n"
+      "\r\n"
+      "    Nombre                 : Wi-Fi\r\n"
+      "    Descripci\242n            : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    Direcci\242n f\241sica       : 3c:a9:f4:12:34:56\r\n"
+      "    Tipo de interfaz       : Principal\r\n"
+      "    Estado                 : conectado\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    Banda                  : 5 GHz\r\n"
+      "    Tipo de radio          : 802.11ax\r\n"
+      "    Autenticaci\242n          : WPA2-Personal\r\n"
+      "    Cifrado                : CCMP\r\n"
+      "    Modo de conexi\242n       : Auto Connect\r\n"
+      "    Canal                  : 36\r\n"
+      "    Velocidad de recepci\242n (Mbps): 300\r\n"
+      "    Velocidad de transmisi\242n (Mbps): 270\r\n"
+      "    Se\244al                  : 61%\r\n"
+      "    Perfil                 : HomeNet\r\n"
+      "    Estado de la red hospedada: No disponible\r\n"
+      "\r\n" },
+    { "ru connected", "CP866",
+      "\r\n"
+      "\202 \341\250\341\342\245\254\245 \245\341\342\354 1 \250\255\342\245\340\344\245\251\341: \r\n"
+      "\r\n"
+      "    \210\254\357                    : Wi-Fi\r\n"
+      "    \216\257\250\341\240\255\250\245               : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    \224\250\247\250\347\245\341\252\250\251 \240\244\340\245\341       : 3c:a9:f4:12:34:56\r\n"
+      "    \222\250\257 \250\255\342\245\340\344\245\251\341\240         : Principal\r\n"
+      "    \221\256\341\342\256\357\255\250\245              : \257\256\244\252\253\356\347\245\255\256\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    \204\250\240\257\240\247\256\255               : 5 GHz\r\n"
+      "    \222\250\257 \340\240\244\250\256              : 802.11ax\r\n"
+      "    \217\340\256\242\245\340\252\240 \257\256\244\253\250\255\255\256\341\342\250   : WPA2-Personal"
+      "\r\n"
+      "    \230\250\344\340                   : CCMP\r\n"
+      "    \220\245\246\250\254 \257\256\244\252\253\356\347\245\255\250\357      : Auto Connect\r\n"
+      "    \212\240\255\240\253                  : 36\r\n"
+      "    \221\252\256\340\256\341\342\354 \257\340\250\245\254\240 (\214\241\250\342/\341): 144.4\r\n"
+      "    \221\252\256\340\256\341\342\354 \257\245\340\245\244\240\347\250 (\214\241\250\342/\341): 130\r"
+      "\n"
+      "    \221\250\243\255\240\253                 : 54%\r\n"
+      "    \217\340\256\344\250\253\354                : HomeNet\r\n"
+      "    \221\256\341\342\256\357\255\250\245 \340\240\247\254\245\351\245\255\255\256\251 \341\245\342"
+      "\250: \215\245\244\256\341\342\343\257\255\256\r\n"
+      "\r\n" },
+    { "ja connected", "CP932",
+      "\r\n"
+      "\203V\203X\203e\203\200\202\311 1 \203C\203\223\203^\201[\203t\203F\203C\203X\202\252\202\240\202"
+      "\350\202\334\202\267: \r\n"
+      "\r\n"
+      "    \226\274\221O                     : Wi-Fi\r\n"
+      "    \220\340\226\276                     : Intel(R) Wi-Fi 6 AX201 160MHz\r\n"
+      "    GUID                   : 5f0c2a1e-7b3d-4c8e-9a41-0d2f6e8b7c15\r\n"
+      "    \225\250\227\235\203A\203h\203\214\203X                 : 3c:a9:f4:12:34:56\r\n"
+      "    \203C\203\223\203^\201[\203t\203F\203C\203X\202\314\216\355\227\336            : Principal\r\n"
+      "    \217\363\221\324                     : \220\332\221\261\202\263\202\352\202\334\202\265\202\275"
+      "\r\n"
+      "    SSID                   : HomeNet\r\n"
+      "    BSSID                  : 02:00:5e:10:20:30\r\n"
+      "    \203o\203\223\203h                    : 5 GHz\r\n"
+      "    \226\263\220\374\202\314\216\355\227\336                  : 802.11ax\r\n"
+      "    \224F\217\330                     : WPA2-Personal\r\n"
+      "    \210\303\215\206                     : CCMP\r\n"
+      "    \220\332\221\261\203\202\201[\203h                  : Auto Connect\r\n"
+      "    \203`\203\203\203l\203\213                   : 36\r\n"
+      "    \216\363\220M\221\254\223x (Mbps)            : 1201\r\n"
+      "    \221\227\220M\221\254\223x (Mbps)            : 960\r\n"
+      "    \203V\203O\203i\203\213                   : 83%\r\n"
+      "    \203v\203\215\203t\203@\203C\203\213                 : HomeNet\r\n"
+      "    \203z\203X\203g\202\263\202\352\202\275\203l\203b\203g\203\217\201[\203N\202\314\217\363\221\324"
+      "        : \227\230\227p\225s\211\302\r\n"
+      "\r\n" },
+};
+
+#define NETSH_OEM_CASES (sizeof(netsh_oem_corpus) / sizeof(netsh_oem_corpus[0]))
+
+/* windows/poc.c before the automaton: one strstr per English label, then the value up to the line end. */
+static int legacy_value(const char *output, const char *field, char *result, size_t size)
+{
+    const char *p = strstr(output, field);
+    if (!p || !(p = strchr(p, ':'))) return 0;
+    for (p++; *p == ' ' || *p == '\t'; p++) {}
+    size_t len = strcspn(p, "\r\n");
+    while (len && (p[len - 1] == ' ' || p[len - 1] == '\t')) len--;
+    if (!len) return 0;
+    if (len >= size) len = size - 1;
+    memcpy(result, p, len);
+    result[len] = '\0';
+    return 1;
+}
+
+struct legacy_info {
+    int connected;
+    char ssid[64];
+    int signal_pct;
+    unsigned rx_kbps, tx_kbps;
+};
+
+static unsigned legacy_rate(const char *output, const char *field)
+{
+    char text[16];
+    float mbps = 0;
+    if (!legacy_value(output, field, text, sizeof(text)) || sscanf(text, "%f", &mbps) != 1 || mbps < 0) return 0;
+    return (unsigned)(mbps * 1000.0f);
+}
+
+static void legacy_parse(const char *output, struct legacy_info *out)
+{
+    char text[32];
+    memset(out, 0, sizeof(*out));
+    if (legacy_value(output, "State", text, sizeof(text))) {
+        for (char *c = text; *c; c++) *c = (char)tolower((unsigned char)*c);
+        out->connected = strstr(text, "connected") != NULL;
+    }
+    legacy_value(output, "SSID", out->ssid, sizeof(out->ssid));
+    out->signal_pct = legacy_value(output, "Signal", text, sizeof(text)) ? atoi(text) : -1;
+    out->rx_kbps = legacy_rate(output, "Receive rate");
+    out->tx_kbps = legacy_rate(output, "Transmit rate");
+}
+
+static int netsh_case_ok(const struct netsh_case *c, const struct netsh_info *info)
+{
+    size_t len = info->value[NETSH_SSID] ? info->len[NETSH_SSID] : 0;
+    return info->state == c->state && len == strlen(c->ssid) && memcmp(info->value[NETSH_SSID], c->ssid, len) == 0 &&
+           netsh_signal_pct(info) == c->signal_pct && netsh_rate_kbps(info, NETSH_RX_RATE) == c->rx_kbps &&
+           netsh_rate_kbps(info, NETSH_TX_RATE) == c->tx_kbps;
+}
+
+static int legacy_case_ok(const struct netsh_case *c, const struct legacy_info *l)
+{
+    return l->connected == (c->state == NETSH_STATE_CONNECTED) && strcmp(l->ssid, c->ssid) == 0 &&
+           l->signal_pct == c->signal_pct && l->rx_kbps == c->rx_kbps && l->tx_kbps == c->tx_kbps;
+}
+
+/* Nanoseconds per parse of one output, over at least NETSH_MIN_NS. */
+static double time_netsh(const char *text, int legacy)
+{
+    struct netsh_info info;
+    struct legacy_info l;
+    uint64_t passes = 0, t0 = mono_ns(), t;
+    volatile unsigned sink = 0;
+    do {
+        if (legacy) {
+            legacy_parse(text, &l);
+            sink += l.rx_kbps;
+        } else {
+            sink += (unsigned)netsh_parse(text, &info);
+        }
+        passes++;
+    } while ((t = mono_ns()) - t0 < NETSH_MIN_NS);
+    (void)sink;
+    return (double)(t - t0) / passes;
+}
+
+/* What oem_to_utf8 in windows/poc.c does with MultiByteToWideChar and WideCharToMultiByte. */
+static int netsh_from_oem(const char *codepage, const char *in, char *out, size_t size)
+{
+    iconv_t cd = iconv_open("UTF-8", codepage);
+    if (cd == (iconv_t)-1) return 0;
+    char *src = (char *)in, *dst = out;
+    size_t left = strlen(in), room = size - 1;
+    size_t r = iconv(cd, &src, &left, &dst, &room);
+    iconv_close(cd);
+    *dst = '\0';
+    return r != (size_t)-1;
+}
+
+/* The OEM captures, raw and converted: only the converted ones must parse like their UTF-8 twins. */
+static int netsh_oem_checks(void)
+{
+    static char utf8[16384];
+    int wrong = 0;
+    printf("\n%-20s | %-5s | %-9s | %-9s\n", "OEM output", "Code", "Raw", "Converted");
+    printf("-----------------------------------------------------\n");
+    for (size_t i = 0; i < NETSH_OEM_CASES; i++) {
+        const struct netsh_oem_case *o = &netsh_oem_corpus[i];
+        const struct netsh_case *c = NULL;
+        for (size_t j = 0; j < NETSH_CASES && !c; j++) {
+            if (strcmp(netsh_corpus[j].name, o->name) == 0) c = &netsh_corpus[j];
+        }
+        struct netsh_info info;
+        netsh_parse(o->text, &info);
+        int raw_ok = c && netsh_case_ok(c, &info);
+        int ok = c && netsh_from_oem(o->codepage, o->text, utf8, sizeof(utf8)) && netsh_parse(utf8, &info) >= 0 &&
+                 netsh_case_ok(c, &info);
+        printf("%-20s | %-5s | %-9s | %-9s\n", o->name, o->codepage + 2, raw_ok ? "ok" : "wrong", ok ? "ok" : "WRONG");
+        wrong += !ok;
+    }
+    return wrong;
+}
+
+/* The multi-locale parser against the English-only lookups it replaced: results on the corpus, then speed. */
+static int bench_netsh(const struct bench_args *a)
+{
+    (void)a;
+    uint64_t t0 = mono_ns();
+    if (!netsh_init()) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    printf("Automaton built in %.1f us\n\n", (mono_ns() - t0) / 1e3);
+    printf("%-20s | %5s | %9s | %7s | %9s | %7s | %-9s | %-6s\n", "Output", "Bytes", "Automaton", "MB/s", "Legacy",
+           "MB/s", "Automaton", "Legacy");
+    printf("------------------------------------------------------------------------------------------------\n");
+
+    int wrong = 0, legacy_right = 0;
+    double ns_new = 0, ns_old = 0, bytes = 0;
+    for (size_t i = 0; i < NETSH_CASES; i++) {
+        const struct netsh_case *c = &netsh_corpus[i];
+        struct netsh_info info;
+        struct legacy_info l;
+        netsh_parse(c->text, &info);
+        legacy_parse(c->text, &l);
+        int ok = netsh_case_ok(c, &info), old_ok = legacy_case_ok(c, &l);
+        size_t len = strlen(c->text);
+        double tn = time_netsh(c->text, 0), to = time_netsh(c->text, 1);
+        printf("%-20s | %5zu | %7.0fns | %7.0f | %7.0fns | %7.0f | %-9s | %-6s\n", c->name, len, tn, len / tn * 1e3,
+               to, len / to * 1e3, ok ? "ok" : "WRONG", old_ok ? "ok" : "wrong");
+        wrong += !ok;
+        legacy_right += old_ok;
+        ns_new += tn;
+        ns_old += to;
+        bytes += (double)len;
+    }
+    char right_new[16], right_old[16];
+    snprintf(right_new, sizeof(right_new), "%zu/%zu", NETSH_CASES - (size_t)wrong, NETSH_CASES);
+    snprintf(right_old, sizeof(right_old), "%d/%zu", legacy_right, NETSH_CASES);
+    printf("%-20s | %5.0f | %7.0fns | %7.0f | %7.0fns | %7.0f | %-9s | %-6s\n", "(all)", bytes, ns_new,
+           bytes / ns_new * 1e3, ns_old, bytes / ns_old * 1e3, right_new, right_old);
+    wrong += netsh_oem_checks();
+    netsh_free();
+    if (wrong) fprintf(stderr, "ERROR: %d outputs misparsed\n", wrong);
+    return wrong != 0;
+}
+
+struct replay {
+    const struct wifi_sample *s;
+    size_t i;
+};
+
+static int replay_next(void *arg, struct wifi_sample *s)
+{
+    struct replay *r = arg;
+    *s = r->s[r->i++ & (PIPELINE_SAMPLES - 1)];
+    return 1;
+}
+
+struct tally {
+    uint64_t classes[HEALTH_CLASSES];
+    uint64_t alerts, clears;
+    double health_sum;
+};
+
+static void tally_sample(void *arg, const struct wifi_sample *s, int cls, int edge)
+{
+    struct tally *t = arg;
+    t->classes[cls]++;
+    t->alerts += edge > 0;
+    t->clears += edge < 0;
+    t->health_sum += s->health;
+}
+
+static const struct pipeline_config bench_pipeline_config = PIPELINE_DEFAULT_CONFIG;
+
+PIPELINE_DEFINE(run_static_pipeline, bench_pipeline_config, replay_next, pipeline_filter_required,
+                pipeline_features_health, pipeline_classify_health, tally_sample)
+
+/* The monitor's own loop: health_update, then the sink set and the health alert. */
+struct snrmon_loop {
+    struct health_tracker tracker;
+    struct health_alert alert;
+    struct sink_set sinks;
+    struct tally *tally;
+};
+
+static void loop_sample(struct sink *k, const struct wifi_sample *s)
+{
+    struct tally *t = k->priv;
+    t->classes[health_class_index(s->health)]++;
+    t->health_sum += s->health;
+}
+
+static void loop_alert(struct sink *k, const struct alert *a)
+{
+    struct tally *t = k->priv;
+    t->alerts += a->firing != 0;
+    t->clears += a->firing == 0;
+}
+
+static void run_snrmon_loop(struct snrmon_loop *l, const struct health_weights *w, struct replay *r, size_t max)
+{
+    for (size_t n = 0; n < max; n++) {
+        struct wifi_sample s;
+        replay_next(r, &s);
+        if ((s.fields & (FIELD_SIGNAL | FIELD_GAP)) != FIELD_SIGNAL) continue;
+        health_update(w, &l->tracker, &s);
+        sinks_sample(&l->sinks, &s);
+        health_alert_check(&l->alert, &s, &l->sinks);
+    }
+}
+
+static int same_tally(const struct tally *a, const struct tally *b)
+{
+    return memcmp(a->classes, b->classes, sizeof(a->classes)) == 0 && a->alerts == b->alerts &&
+           a->clears == b->clears && a->health_sum == b->health_sum;
+}
+
+/* Samples per second for one of the three paths, over at least PIPELINE_MIN_NS; one pass fills *t. */
+static double time_pipeline(int which, const struct wifi_sample *trace, struct tally *t)
+{
+    struct pipeline_config cfg = bench_pipeline_config;
+    struct pipeline_ops ops = { replay_next, pipeline_filter_required, pipeline_features_health,
+                                pipeline_classify_health, tally_sample };
+    struct replay r = { trace, 0 };
+    struct tally scratch;
+    struct pipeline p = { &cfg, { { 0 }, 0, 0 }, &r, t };
+    struct snrmon_loop l = { .alert = { cfg.alert_below, cfg.hysteresis, 0 }, .tally = t };
+    struct sink k = { .name = "tally", .sample = loop_sample, .alert = loop_alert, .priv = t };
+    sinks_add(&l.sinks, &k);
+
+    uint64_t passes = 0, t0 = 0, now;
+    memset(t, 0, sizeof(*t));
+    do {
+        if (which == 0) run_static_pipeline(&p, PIPELINE_SAMPLES);
+        else if (which == 1) pipeline_run(&ops, &p, PIPELINE_SAMPLES);
+        else run_snrmon_loop(&l, &cfg.weights, &r, PIPELINE_SAMPLES);
+        /* The first pass is the one compared; later ones count into scratch. */
+        if (passes++ == 0) {
+            p.sink = l.sinks.sinks[0].priv = &scratch;
+            t0 = mono_ns();
+        }
+    } while ((now = mono_ns()) - t0 < PIPELINE_MIN_NS);
+    return (double)(passes - 1) * PIPELINE_SAMPLES / ((now - t0) / 1e9);
+}
+
+/* The compile-time pipeline against the same stages through pointers, and against the monitor's loop. */
+static int bench_pipeline(const struct bench_args *a)
+{
+    (void)a;
+    struct wifi_sample *trace = malloc(PIPELINE_SAMPLES * sizeof(*trace));
+    if (!trace) return 1;
+    uint32_t rng = 7;
+    memset(trace, 0, sizeof(*trace));
+    for (size_t i = 0; i < PIPELINE_SAMPLES; i++) {
+        if (i) trace[i] = trace[i - 1];
+        synth_sample((uint64_t)i * 1000000000ull, &rng, &trace[i]);
+        trace[i].fields &= ~FIELD_HEALTH;
+        /* Fades deep enough to raise and clear the alert, and the odd gap. */
+        if (i % 600 < 40) trace[i].signal_dbm = (int8_t)(trace[i].signal_dbm - 30);
+        if (i % 97 == 0) trace[i].fields = FIELD_GAP;
+    }
+
+    static const char *const names[] = { "PIPELINE_DEFINE", "pipeline_run (pointers)", "health_update + sinks" };
+    struct tally t[3];
+    double rate[3];
+    for (int i = 0; i < 3; i++) rate[i] = time_pipeline(i, trace, &t[i]);
+    int same = same_tally(&t[0], &t[1]) && same_tally(&t[0], &t[2]);
+
+    printf("%u samples per pass; per pass: %llu GOOD, %llu FAIR, %llu DEGRADED, %llu POOR, %llu alerts%s\n\n",
+           PIPELINE_SAMPLES, (unsigned long long)t[0].classes[0], (unsigned long long)t[0].classes[1],
+           (unsigned long long)t[0].classes[2], (unsigned long long)t[0].classes[3],
+           (unsigned long long)t[0].alerts, same ? "" : "  MISMATCH");
+    printf("%-26s | %10s | %9s | %7s\n", "Path", "Msamples/s", "ns/sample", "Speedup");
+    printf("----------------------------------------------------------------\n");
+    for (int i = 0; i < 3; i++) {
+        printf("%-26s | %10.1f | %9.2f | %6.2fx\n", names[i], rate[i] / 1e6, 1e9 / rate[i], rate[0] / rate[i]);
+    }
+    free(trace);
+    return !same;
+}
+
+/* --- timer schedulers: the wheel against a binary heap and a sorted list --- */
+
+/* Sample intervals, survey scans, rule windows and rollup flushes, in ms. */
+static const uint32_t sched_periods[] = { 100, 200, 500, 1000, 2000, 5000, 10000, 30000, 60000, 300000 };
+
+#define SCHED_PERIODS (sizeof(sched_periods) / sizeof(sched_periods[0]))
+
+static uint64_t sched_mix(uint64_t id, uint64_t tick)
+{
+    uint64_t h = id * 0x9e3779b97f4a7c15ull ^ tick * 0xc2b2ae3d27d4eb4full;
+    h = (h ^ h >> 31) * 0xbf58476d1ce4e5b9ull;
+    return h ^ h >> 29;
+}
+
+/*
+ * One run's counters. Every choice depends only on a timer's ID and the
+ * tick, never on the order timers fire within a tick, so the three
+ * schedulers must end with the same counts and checksum.
+ */
+struct sched_load {
+    size_t n;
+    uint64_t fires, adapted, churned, sum;
+    uint32_t rng;
+};
+
+static uint32_t sched_period(uint64_t id, uint64_t salt)
+{
+    return sched_periods[sched_mix(id, salt) % SCHED_PERIODS];
+}
+
+/* Counts a fire; returns the timer's new period when it adapts its rate, 0 to keep it. */
+static uint32_t sched_fire(struct sched_load *ld, uint64_t id, uint64_t tick)
+{
+    ld->fires++;
+    ld->sum += sched_mix(id, tick);
+    if (sched_mix(tick, id) & 7) return 0;
+    ld->adapted++;
+    return sched_period(id, tick ^ 1ull << 40);
+}
+
+/* The next rate change from outside the schedule: which timer, and its new period. */
+static uint64_t sched_churn(struct sched_load *ld, uint64_t tick, uint32_t *period)
+{
+    ld->rng ^= ld->rng << 13;
+    ld->rng ^= ld->rng >> 17;
+    ld->rng ^= ld->rng << 5;
+    ld->churned++;
+    uint64_t id = ld->rng % ld->n;
+    *period = sched_period(id, tick ^ 1ull << 41);
+    return id;
+}
+
+static uint64_t sched_first(uint64_t id, uint32_t *period)
+{
+    *period = sched_period(id, 0);
+    return 1 + sched_mix(id, 1) % *period;
+}
+
+struct wheel_load {
+    struct sched_load ld;
+    struct wheel w;
+    struct timer *t;
+};
+
+static void wheel_load_fire(struct timer *t, uint64_t now)
+{
+    struct wheel_load *wl = t->arg;
+    uint32_t p = sched_fire(&wl->ld, (uint64_t)(t - wl->t), now);
+    if (p) {
+        t->period = p;
+        wheel_add(&wl->w, t, now + p);
+    }
+}
+
+static int run_wheel_load(struct sched_load *ld)
+{
+    struct wheel_load *wl = malloc(sizeof(*wl));
+    if (!wl || !(wl->t = calloc(ld->n, sizeof(*wl->t)))) {
+        free(wl);
+        return 0;
+    }
+    wl->ld = *ld;
+    wheel_init(&wl->w, 0);
+    for (size_t i = 0; i < ld->n; i++) {
+        uint32_t p;
+        uint64_t at = sched_first(i, &p);
+        wl->t[i] = (struct timer){ .period = p, .fn = wheel_load_fire, .arg = wl };
+        wheel_add(&wl->w, &wl->t[i], at);
+    }
+    for (uint64_t tick = 1; tick <= SCHED_TICKS; tick++) {
+        wheel_advance(&wl->w, tick);
+        for (int c = 0; c < SCHED_CHURN; c++) {
+            uint32_t p;
+            struct timer *t = &wl->t[sched_churn(&wl->ld, tick, &p)];
+            wheel_cancel(&wl->w, t);
+            t->period = p;
+            wheel_add(&wl->w, t, tick + p);
+        }
+    }
+    *ld = wl->ld;
+    free(wl->t);
+    free(wl);
+    return 1;
+}
+
+/* A binary min-heap of timer IDs with each timer's heap position, so cancel is O(log n). */
+struct heap_load {
+    uint32_t *heap, *pos, *period;
+    uint64_t *expires;
+    size_t len;
+};
+
+static void heap_swap(struct heap_load *h, size_t a, size_t b)
+{
+    uint32_t t = h->heap[a];
+    h->heap[a] = h->heap[b];
+    h->heap[b] = t;
+    h->pos[h->heap[a]] = (uint32_t)a;
+    h->pos[h->heap[b]] = (uint32_t)b;
+}
+
+static void heap_fix(struct heap_load *h, size_t i)
+{
+    while (i && h->expires[h->heap[i]] < h->expires[h->heap[(i - 1) / 2]]) {
+        heap_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t m = i, l = 2 * i + 1, r = l + 1;
+        if (l < h->len && h->expires[h->heap[l]] < h->expires[h->heap[m]]) m = l;
+        if (r < h->len && h->expires[h->heap[r]] < h->expires[h->heap[m]]) m = r;
+        if (m == i) return;
+        heap_swap(h, i, m);
+        i = m;
+    }
+}
+
+static void heap_push(struct heap_load *h, uint32_t id, uint64_t at)
+{
+    h->expires[id] = at;
+    h->heap[h->len] = id;
+    h->pos[id] = (uint32_t)h->len++;
+    heap_fix(h, h->len - 1);
+}
+
+static void heap_remove(struct heap_load *h, uint32_t id)
+{
+    size_t i = h->pos[id];
+    heap_swap(h, i, --h->len);
+    if (i < h->len) heap_fix(h, i);
+}
+
+static int run_heap_load(struct sched_load *ld)
+{
+    struct heap_load h = { malloc(ld->n * 4), malloc(ld->n * 4), malloc(ld->n * 4), malloc(ld->n * 8), 0 };
+    int ok = h.heap && h.pos && h.period && h.expires;
+    for (uint32_t i = 0; ok && i < ld->n; i++) heap_push(&h, i, sched_first(i, &h.period[i]));
+    for (uint64_t tick = 1; ok && tick <= SCHED_TICKS; tick++) {
+        while (h.len && h.expires[h.heap[0]] <= tick) {
+            uint32_t id = h.heap[0];
+            uint32_t p = sched_fire(ld, id, tick);
+            if (p) h.period[id] = p;
+            h.expires[id] = tick + h.period[id];
+            heap_fix(&h, 0);
+        }
+        for (int c = 0; c < SCHED_CHURN; c++) {
+            uint32_t p, id = (uint32_t)sched_churn(ld, tick, &p);
+            heap_remove(&h, id);
+            h.period[id] = p;
+            heap_push(&h, id, tick + p);
+        }
+    }
+    free(h.heap);
+    free(h.pos);
+    free(h.period);
+    free(h.expires);
+    return ok;
+}
+
+/* A list kept sorted by expiry, as a naive scheduler does; node n is the head. */
+struct list_load {
+    uint32_t *next, *prev, *period;
+    uint64_t *expires;
+    uint32_t head;
+};
+
+/* Walks back from the tail: new expiries are mostly late ones. */
+static void list_insert(struct list_load *l, uint32_t id, uint64_t at)
+{
+    uint32_t after = l->prev[l->head];
+    while (after != l->head && l->expires[after] > at) after = l->prev[after];
+    l->expires[id] = at;
+    l->prev[id] = after;
+    l->next[id] = l->next[after];
+    l->prev[l->next[after]] = id;
+    l->next[after] = id;
+}
+
+static void list_remove(struct list_load *l, uint32_t id)
+{
+    l->next[l->prev[id]] = l->next[id];
+    l->prev[l->next[id]] = l->prev[id];
+}
+
+static int run_list_load(struct sched_load *ld)
+{
+    uint32_t n = (uint32_t)ld->n;
+    struct list_load l = { malloc((n + 1) * 4), malloc((n + 1) * 4), malloc(n * 4), malloc(n * 8), n };
+    int ok = l.next && l.prev && l.period && l.expires;
+    if (ok) l.next[n] = l.prev[n] = n;
+    for (uint32_t i = 0; ok && i < n; i++) list_insert(&l, i, sched_first(i, &l.period[i]));
+    for (uint64_t tick = 1; ok && tick <= SCHED_TICKS; tick++) {
+        uint32_t id;
+        while ((id = l.next[n]) != n && l.expires[id] <= tick) {
+            list_remove(&l, id);
+            uint32_t p = sched_fire(ld, id, tick);
+            if (p) l.period[id] = p;
+            list_insert(&l, id, tick + l.period[id]);
+        }
+        for (int c = 0; c < SCHED_CHURN; c++) {
+            uint32_t p;
+            id = (uint32_t)sched_churn(ld, tick, &p);
+            list_remove(&l, id);
+            l.period[id] = p;
+            list_insert(&l, id, tick + p);
+        }
+    }
+    free(l.next);
+    free(l.prev);
+    free(l.period);
+    free(l.expires);
+    return ok;
+}
+
+/* 10 s of periodic timers with rate changes, at 1k to 100k timers. */
+static int bench_wheel(const struct bench_args *a)
+{
+    (void)a;
+    static const size_t counts[] = { 1000, 10000, 100000 };
+    static const struct {
+        const char *name;
+        int (*run)(struct sched_load *ld);
+    } scheds[] = {
+        { "sorted list", run_list_load },
+        { "binary heap", run_heap_load },
+        { "timer wheel", run_wheel_load },
+    };
+    int bad = 0;
+
+    printf("%u ticks of 1 ms, %d cancels and re-adds per tick, 1 in 8 fires changes its period\n\n", SCHED_TICKS,
+           SCHED_CHURN);
+    printf("%-7s | %-12s | %9s | %8s | %8s | %s\n", "Timers", "Scheduler", "Fires", "Time ms", "ns/op", "Check");
+    printf("-------------------------------------------------------------------\n");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        struct sched_load ref = { 0 };
+        for (size_t k = 0; k < sizeof(scheds) / sizeof(scheds[0]); k++) {
+            if (k == 0 && counts[c] > SCHED_LIST_MAX) {
+                printf("%-7zu | %-12s | %9s | %8s | %8s | skipped, O(n) insert\n", counts[c], scheds[k].name, "-",
+                       "-", "-");
+                continue;
+            }
+            struct sched_load ld = { .n = counts[c], .rng = 2463534242u };
+            uint64_t t0 = mono_ns();
+            if (!scheds[k].run(&ld)) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            uint64_t ns = mono_ns() - t0;
+            /* A fire is one pop and one insert, as is a cancel and re-add. */
+            double ops = 2.0 * (double)(ld.fires + ld.churned);
+            if (!ref.fires) ref = ld;
+            int same = ld.fires == ref.fires && ld.adapted == ref.adapted && ld.sum == ref.sum;
+            bad |= !same;
+            printf("%-7zu | %-12s | %9llu | %8.1f | %8.1f | %s\n", counts[c], scheds[k].name,
+                   (unsigned long long)ld.fires, ns / 1e6, ns / ops, same ? "ok" : "MISMATCH");
+        }
+    }
+    return bad;
+}
+
+/* --- thread pool: scheduling overhead, stealing balance and lane fairness --- */
+
+/* A mutex-and-condvar FIFO shared by all workers: the ad-hoc pool the work-stealing one replaces. */
+struct fifo_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv, done_cv;
+    struct pool_task *head, *tail;
+    int stop;
+    unsigned n;
+    pthread_t threads[POOL_MAX_WORKERS];
+};
+
+static void *fifo_worker(void *arg)
+{
+    struct fifo_pool *f = arg;
+    pthread_mutex_lock(&f->lock);
+    while (!f->stop) {
+        struct pool_task *t = f->head;
+        if (!t) {
+            pthread_cond_wait(&f->work_cv, &f->lock);
+            continue;
+        }
+        f->head = t->next;
+        if (!f->head) f->tail = NULL;
+        pthread_mutex_unlock(&f->lock);
+        struct pool_group *g = t->group;
+        t->fn(t);
+        pthread_mutex_lock(&f->lock);
+        if (g && atomic_fetch_sub(&g->pending, 1) == 1) pthread_cond_broadcast(&f->done_cv);
+    }
+    pthread_mutex_unlock(&f->lock);
+    return NULL;
+}
+
+static void fifo_submit(struct fifo_pool *f, struct pool_task *t, struct pool_group *g)
+{
+    t->group = g;
+    t->next = NULL;
+    if (g) atomic_fetch_add(&g->pending, 1);
+    pthread_mutex_lock(&f->lock);
+    if (f->tail) f->tail->next = t;
+    else f->head = t;
+    f->tail = t;
+    pthread_cond_signal(&f->work_cv);
+    pthread_mutex_unlock(&f->lock);
+}
+
+static void fifo_wait(struct fifo_pool *f, struct pool_group *g)
+{
+    pthread_mutex_lock(&f->lock);
+    while (atomic_load(&g->pending)) pthread_cond_wait(&f->done_cv, &f->lock);
+    pthread_mutex_unlock(&f->lock);
+}
+
+static int fifo_start(struct fifo_pool *f, unsigned n)
+{
+    memset(f, 0, sizeof(*f));
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->work_cv, NULL);
+    pthread_cond_init(&f->done_cv, NULL);
+    for (; f->n < n; f->n++) {
+        if (pthread_create(&f->threads[f->n], NULL, fifo_worker, f) != 0) return 0;
+    }
+    return 1;
+}
+
+static void fifo_stop(struct fifo_pool *f)
+{
+    pthread_mutex_lock(&f->lock);
+    f->stop = 1;
+    pthread_cond_broadcast(&f->work_cv);
+    pthread_mutex_unlock(&f->lock);
+    for (unsigned i = 0; i < f->n; i++) pthread_join(f->threads[i], NULL);
+    pthread_cond_destroy(&f->work_cv);
+    pthread_cond_destroy(&f->done_cv);
+    pthread_mutex_destroy(&f->lock);
+}
+
+/* Where a bench's tasks go: the work-stealing pool, the FIFO, or straight to the caller. */
+struct pool_target {
+    struct pool *pool;
+    struct fifo_pool *fifo;
+    struct pool_group group;
+};
+
+static void target_submit(struct pool_target *to, struct pool_task *t, int lane)
+{
+    if (to->pool) pool_submit(to->pool, t, lane, &to->group);
+    else if (to->fifo) fifo_submit(to->fifo, t, &to->group);
+    else t->fn(t);
+}
+
+static void target_wait(struct pool_target *to)
+{
+    if (to->pool) pool_wait(to->pool, &to->group);
+    else if (to->fifo) fifo_wait(to->fifo, &to->group);
+}
+
+/*
+ * Fork-join over [0, POOL_TREE_TASKS): task lo owns [lo, hi[lo]). It
+ * hands the upper half of its range to a new task until one index is
+ * left, so every index is one task and all but the root are spawned by
+ * a worker, as a recursive analysis would.
+ */
+struct tree_load {
+    struct pool_target to;
+    struct pool_task *tasks;
+    uint32_t *hi;
+    atomic_uint_fast64_t leaves;
+};
+
+static void tree_task(struct pool_task *t)
+{
+    struct tree_load *tl = t->arg;
+    uint32_t lo = (uint32_t)(t - tl->tasks), hi = tl->hi[lo];
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        tl->hi[mid] = hi;
+        tl->tasks[mid] = (struct pool_task){ .fn = tree_task, .arg = tl };
+        target_submit(&tl->to, &tl->tasks[mid], POOL_REALTIME);
+        hi = mid;
+    }
+    atomic_fetch_add_explicit(&tl->leaves, 1, memory_order_relaxed);
+}
+
+/* ns per task for the whole tree, or for POOL_TREE_TASKS flat tasks submitted from outside the pool. */
+static double time_tree(struct tree_load *tl, int flat)
+{
+    atomic_store(&tl->leaves, 0);
+    atomic_store(&tl->to.group.pending, 0);
+    uint64_t t0 = mono_ns();
+    if (flat) {
+        for (uint32_t i = 0; i < POOL_TREE_TASKS; i++) {
+            tl->hi[i] = i + 1;
+            tl->tasks[i] = (struct pool_task){ .fn = tree_task, .arg = tl };
+            target_submit(&tl->to, &tl->tasks[i], POOL_REALTIME);
+        }
+    } else {
+        tl->hi[0] = POOL_TREE_TASKS;
+        tl->tasks[0] = (struct pool_task){ .fn = tree_task, .arg = tl };
+        target_submit(&tl->to, &tl->tasks[0], POOL_REALTIME);
+    }
+    target_wait(&tl->to);
+    uint64_t ns = mono_ns() - t0;
+    return atomic_load(&tl->leaves) == POOL_TREE_TASKS ? (double)ns / POOL_TREE_TASKS : -1.0;
+}
+
+static void *empty_thread(void *arg)
+{
+    return arg;
+}
+
+static void spin_ns(uint64_t ns)
+{
+    uint64_t t0 = mono_ns();
+    while (mono_ns() - t0 < ns) {}
+}
+
+/* Completion order of a realtime flood with background work queued alongside it. */
+struct flood_load {
+    struct pool_task *tasks;
+    atomic_uint done;
+    atomic_uint bg_early;       /* background tasks among the first POOL_FLOOD_RT to finish */
+};
+
+/* Holds a worker until the flood is queued. */
+static void gate_task(struct pool_task *t)
+{
+    while (!atomic_load((atomic_int *)t->arg)) sched_yield();
+}
+
+static void flood_task(struct pool_task *t)
+{
+    struct flood_load *fl = t->arg;
+    spin_ns(1000);
+    if (atomic_fetch_add(&fl->done, 1) < POOL_FLOOD_RT && t->lane == POOL_BACKGROUND) {
+        atomic_fetch_add(&fl->bg_early, 1);
+    }
+}
+
+/* Submit-to-start latency of realtime tasks behind a background backlog. */
+struct latency_load {
+    struct pool_target to;
+    struct pool_task bg[POOL_LAT_BG], rt[POOL_LAT_RT];
+    uint64_t submitted[POOL_LAT_RT], started[POOL_LAT_RT];
+};
+
+static void lat_bg_task(struct pool_task *t)
+{
+    (void)t;
+    spin_ns(POOL_LAT_BG_NS);
+}
+
+static void lat_rt_task(struct pool_task *t)
+{
+    struct latency_load *ll = t->arg;
+    ll->started[t - ll->rt] = mono_ns();
+}
+
+static void time_latency(struct latency_load *ll, double *p50_us, double *max_us)
+{
+    for (int i = 0; i < POOL_LAT_BG; i++) {
+        ll->bg[i] = (struct pool_task){ .fn = lat_bg_task, .arg = ll };
+        target_submit(&ll->to, &ll->bg[i], POOL_BACKGROUND);
+    }
+    for (int i = 0; i < POOL_LAT_RT; i++) {
+        sleep_ns(1000000);
+        ll->rt[i] = (struct pool_task){ .fn = lat_rt_task, .arg = ll };
+        ll->submitted[i] = mono_ns();
+        target_submit(&ll->to, &ll->rt[i], POOL_REALTIME);
+    }
+    target_wait(&ll->to);
+    uint64_t lat[POOL_LAT_RT];
+    for (int i = 0; i < POOL_LAT_RT; i++) lat[i] = ll->started[i] - ll->submitted[i];
+    qsort(lat, POOL_LAT_RT, sizeof(lat[0]), cmp_u64);
+    *p50_us = lat[POOL_LAT_RT / 2] / 1e3;
+    *max_us = lat[POOL_LAT_RT - 1] / 1e3;
+}
+
+static int bench_pool(const struct bench_args *a)
+{
+    (void)a;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned n = cpus > 1 ? (unsigned)cpus : 2;
+    if (n > 16) n = 16;
+    int bad = 0;
+
+    struct tree_load *tl = calloc(1, sizeof(*tl));
+    struct latency_load *ll = calloc(1, sizeof(*ll));
+    struct flood_load fl = { 0 };
+    if (tl) tl->tasks = malloc(POOL_TREE_TASKS * sizeof(*tl->tasks));
+    if (tl) tl->hi = malloc(POOL_TREE_TASKS * sizeof(*tl->hi));
+    fl.tasks = malloc((POOL_FLOOD_RT + POOL_FLOOD_BG) * sizeof(*fl.tasks));
+    struct pool *p = malloc(sizeof(*p));
+    struct fifo_pool *f = malloc(sizeof(*f));
+    if (!tl || !tl->tasks || !tl->hi || !ll || !fl.tasks || !p || !f || !pool_init(p, n, 0)) {
+        fprintf(stderr, "pool setup failed\n");
+        return 1;
+    }
+    if (!fifo_start(f, n)) {
+        fprintf(stderr, "fifo setup failed\n");
+        return 1;
+    }
+
+    printf("%u workers on %ld CPUs, %u tasks per run\n\n", n, cpus, POOL_TREE_TASKS);
+    printf("%-34s | %10s | %10s\n", "Scheduler", "Fork-join", "Submitted");
+    printf("%-34s | %10s | %10s\n", "", "ns/task", "ns/task");
+    printf("----------------------------------------------------------------\n");
+
+    tl->to = (struct pool_target){ 0 };
+    double serial = time_tree(tl, 0);
+    printf("%-34s | %10.1f | %10s\n", "inline calls (no scheduler)", serial, "-");
+
+    uint64_t t0 = mono_ns();
+    for (int i = 0; i < POOL_THREAD_TASKS; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, empty_thread, NULL) == 0) pthread_join(t, NULL);
+    }
+    printf("%-34s | %10s | %10.1f\n", "pthread_create per task", "-", (double)(mono_ns() - t0) / POOL_THREAD_TASKS);
+
+    tl->to = (struct pool_target){ .fifo = f };
+    double fifo_tree = time_tree(tl, 0), fifo_flat = time_tree(tl, 1);
+    printf("%-34s | %10.1f | %10.1f\n", "shared FIFO, mutex + condvar", fifo_tree, fifo_flat);
+
+    for (unsigned i = 0; i < n; i++) p->workers[i].ran[POOL_REALTIME] = p->workers[i].stolen = 0;
+    tl->to = (struct pool_target){ .pool = p };
+    double ws_tree = time_tree(tl, 0);
+    uint64_t lo = UINT64_MAX, hi = 0, stolen = 0;
+    for (unsigned i = 0; i < n; i++) {
+        uint64_t r = p->workers[i].ran[POOL_REALTIME];
+        lo = r < lo ? r : lo;
+        hi = r > hi ? r : hi;
+        stolen += p->workers[i].stolen;
+    }
+    double ws_flat = time_tree(tl, 1);
+    printf("%-34s | %10.1f | %10.1f\n", "work-stealing pool", ws_tree, ws_flat);
+    bad |= serial < 0 || fifo_tree < 0 || fifo_flat < 0 || ws_tree < 0 || ws_flat < 0;
+
+    printf("\nFork-join balance: %llu stolen, busiest worker ran %llu tasks, idlest %llu\n",
+           (unsigned long long)stolen, (unsigned long long)hi, (unsigned long long)lo);
+
+    /* Lanes: gates hold every worker until the whole flood is queued, so only the starvation rule interleaves. */
+    struct pool_group g = { 0 };
+    struct pool_task gates[16];
+    atomic_int open = 0;
+    for (unsigned i = 0; i < n; i++) {
+        gates[i] = (struct pool_task){ .fn = gate_task, .arg = &open };
+        pool_submit(p, &gates[i], POOL_REALTIME, &g);
+    }
+    for (int i = 0; i < POOL_FLOOD_RT + POOL_FLOOD_BG; i++) {
+        fl.tasks[i] = (struct pool_task){ .fn = flood_task, .arg = &fl };
+        pool_submit(p, &fl.tasks[i], i < POOL_FLOOD_RT ? POOL_REALTIME : POOL_BACKGROUND, &g);
+    }
+    atomic_store(&open, 1);
+    pool_wait(p, &g);
+    unsigned bg = atomic_load(&fl.bg_early), expect = POOL_FLOOD_RT / (POOL_STARVE_LIMIT + 1);
+    int fair = bg >= expect / 2 && bg <= expect * 2;
+    bad |= !fair;
+    printf("Realtime flood: %u background tasks among the first %u to finish (expect ~%u, one per %u realtime) %s\n",
+           bg, POOL_FLOOD_RT, expect, POOL_STARVE_LIMIT, fair ? "ok" : "FAIL");
+
+    double p50, max, fifo_p50, fifo_max;
+    ll->to = (struct pool_target){ .pool = p };
+    time_latency(ll, &p50, &max);
+    ll->to = (struct pool_target){ .fifo = f };
+    time_latency(ll, &fifo_p50, &fifo_max);
+    int prompt = max < fifo_max;
+    bad |= !prompt;
+    printf("Realtime start latency behind %u x %.1f ms of background work: p50 %.0f us, max %.0f us "
+           "(shared FIFO: p50 %.0f us, max %.0f us) %s\n", POOL_LAT_BG, POOL_LAT_BG_NS / 1e6, p50, max, fifo_p50,
+           fifo_max, prompt ? "ok" : "FAIL");
+
+    fifo_stop(f);
+    pool_destroy(p);
+    free(f);
+    free(p);
+    free(fl.tasks);
+    free(ll);
+    free(tl->tasks);
+    free(tl->hi);
+    free(tl);
+    return bad;
+}
+
+/* --- many producers, one aggregator: per-producer rings with a merge against a mutex queue --- */
+
+/* One bounded ring behind a mutex, the queue the rings replace. It keeps arrival order only. */
+struct locked_queue {
+    pthread_mutex_t lock;
+    struct wifi_sample *slots;
+    size_t cap, head, len;
+};
+
+struct ingest_load {
+    struct ingest q;
+    struct locked_queue lq;
+    int locked;                 /* which of the two this run uses */
+    unsigned producers;
+    atomic_int go;
+};
+
+struct ingest_producer {
+    struct ingest_load *ld;
+    unsigned index;
+    pthread_t thread;
+};
+
+static int locked_push(struct locked_queue *lq, const struct wifi_sample *s)
+{
+    pthread_mutex_lock(&lq->lock);
+    int ok = lq->len < lq->cap;
+    if (ok) lq->slots[(lq->head + lq->len++) % lq->cap] = *s;
+    pthread_mutex_unlock(&lq->lock);
+    return ok;
+}
+
+static size_t locked_drain(struct locked_queue *lq, struct wifi_sample *out, size_t max)
+{
+    pthread_mutex_lock(&lq->lock);
+    size_t n = lq->len < max ? lq->len : max;
+    for (size_t i = 0; i < n; i++) out[i] = lq->slots[(lq->head + i) % lq->cap];
+    lq->head = (lq->head + n) % lq->cap;
+    lq->len -= n;
+    pthread_mutex_unlock(&lq->lock);
+    return n;
+}
+
+/* Producer p stamps sample i with i * producers + p: each producer in order, the producers interleaved. */
+static void *ingest_producer_main(void *arg)
+{
+    struct ingest_producer *pr = arg;
+    struct ingest_load *ld = pr->ld;
+    struct wifi_sample s = { .fields = FIELD_SIGNAL, .signal_dbm = -60 };
+    while (!atomic_load(&ld->go)) sched_yield();
+    for (uint64_t i = 0; i < INGEST_SAMPLES / ld->producers; i++) {
+        s.ts_ns = i * ld->producers + pr->index;
+        while (!(ld->locked ? locked_push(&ld->lq, &s) : ingest_push(&ld->q, pr->index, &s))) sched_yield();
+    }
+    if (!ld->locked) ingest_close(&ld->q, pr->index);
+    return NULL;
+}
+
+/* Samples per second through the aggregator; *inversions counts samples older than one delivered before. */
+static double time_ingest(struct ingest_load *ld, struct ingest_producer *prs, uint64_t *inversions)
+{
+    static struct wifi_sample batch[INGEST_BATCH];
+    uint64_t total = INGEST_SAMPLES / ld->producers * ld->producers, got = 0, last = 0;
+    *inversions = 0;
+    atomic_store(&ld->go, 0);
+    for (unsigned p = 0; p < ld->producers; p++) {
+        prs[p] = (struct ingest_producer){ ld, p, 0 };
+        pthread_create(&prs[p].thread, NULL, ingest_producer_main, &prs[p]);
+    }
+    uint64_t t0 = mono_ns();
+    atomic_store(&ld->go, 1);
+    while (got < total) {
+        size_t n = ld->locked ? locked_drain(&ld->lq, batch, INGEST_BATCH) : ingest_drain(&ld->q, batch, INGEST_BATCH);
+        if (!n) sched_yield();
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i].ts_ns < last) (*inversions)++;
+            else last = batch[i].ts_ns;
+        }
+        got += n;
+    }
+    uint64_t ns = mono_ns() - t0;
+    for (unsigned p = 0; p < ld->producers; p++) pthread_join(prs[p].thread, NULL);
+    return (double)total / (ns / 1e9);
+}
+
+static int bench_ingest(const struct bench_args *a)
+{
+    (void)a;
+    struct ingest_load *ld = calloc(1, sizeof(*ld));
+    struct ingest_producer *prs = calloc(INGEST_MAX_PRODUCERS, sizeof(*prs));
+    if (!ld || !prs) {
+        free(ld);
+        return 1;
+    }
+    int bad = 0;
+
+    printf("%u samples per run; rings of %u per producer, mutex queue of %u x producers\n\n", INGEST_SAMPLES,
+           INGEST_RING, INGEST_RING);
+    printf("%-9s | %14s | %11s | %14s | %11s\n", "Producers", "Mutex Msamp/s", "Out of order", "Rings Msamp/s",
+           "Out of order");
+    printf("---------------------------------------------------------------------------\n");
+    for (unsigned producers = 1; producers <= INGEST_MAX_PRODUCERS; producers *= 2) {
+        uint64_t inv_locked, inv_rings;
+        ld->producers = producers;
+
+        ld->locked = 1;
+        ld->lq = (struct locked_queue){ .cap = (size_t)INGEST_RING * producers };
+        pthread_mutex_init(&ld->lq.lock, NULL);
+        ld->lq.slots = malloc(ld->lq.cap * sizeof(*ld->lq.slots));
+        if (!ld->lq.slots) break;
+        double locked = time_ingest(ld, prs, &inv_locked);
+        free(ld->lq.slots);
+        pthread_mutex_destroy(&ld->lq.lock);
+
+        ld->locked = 0;
+        if (!ingest_init(&ld->q, producers, INGEST_RING)) break;
+        double rings = time_ingest(ld, prs, &inv_rings);
+        ingest_free(&ld->q);
+
+        bad |= inv_rings != 0;
+        printf("%-9u | %14.2f | %11llu | %14.2f | %11llu%s\n", producers, locked / 1e6,
+               (unsigned long long)inv_locked, rings / 1e6, (unsigned long long)inv_rings,
+               inv_rings ? "  MISORDERED" : "");
+    }
+    free(prs);
+    free(ld);
+    return bad;
+}
+
+#define ALIGN_DAYS 2
+#define ALIGN_B_PERIOD_MS 1300
+#define ALIGN_B_OFFSET_MS 400
+
+/* Two radios: wlan0 at 1 Hz, wlan1 slower and out of phase, and silent for 3 minutes an hour. */
+static int build_align_store(const char *dir)
+{
+    char err[128];
+    struct store st;
+    if (!store_open(&st, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", dir, err);
+        return 0;
+    }
+    st.throttle_bps = 0;
+    st.retain_raw_days = 30;
+
+    uint64_t day0 = (uint64_t)STORE_EPOCH_DAY * STORE_DAY_NS;
+    uint32_t ids[2] = { intern_put(&intern_global, "wlan0", 5), intern_put(&intern_global, "wlan1", 5) };
+    uint32_t rng = 11;
+    struct sink k;
+    struct wifi_sample s = {0};
+    int ok = 1;
+    sink_store(&k, &st);
+    for (int d = 0; d < ALIGN_DAYS && ok; d++) {
+        uint64_t start = day0 + (uint64_t)d * STORE_DAY_NS;
+        uint64_t a = 0, b = ALIGN_B_OFFSET_MS;       /* ms into the day */
+        while (a < 86400000 || b < 86400000) {
+            int radio = a <= b ? 0 : 1;
+            uint64_t ms = radio ? b : a;
+            if (radio) b += ALIGN_B_PERIOD_MS;
+            else a += 1000;
+            if (ms >= 86400000 || (radio && ms / 60000 % 60 >= 10 && ms / 60000 % 60 < 13)) continue;
+            rng = rng * 1664525u + 1013904223u;
+            memset(&s, 0, sizeof(s));
+            s.ts_ns = start + ms * 1000000ull;
+            s.fields = FIELD_SIGNAL | FIELD_NOISE | FIELD_HEALTH;
+            s.signal_dbm = (int8_t)(-60 - 10 * radio + 12 * sin((double)ms / 600000.0) - (int)(rng >> 30));
+            s.noise_dbm = -92;
+            s.health = 50 + s.signal_dbm / 2.0f;
+            s.ifname_id = ids[radio];
+            k.sample(&k, &s);
+        }
+        k.flush(&k);
+        /* The first day goes to a day file, the last stays in hourly raw files. */
+        if (d + 1 < ALIGN_DAYS) ok = store_compact(&st, start + STORE_DAY_NS + STORE_DAY_NS / 2, NULL);
+    }
+    k.close(&k);
+    store_close(&st);
+    return ok;
+}
+
+/* A materialised series: every sample's time and SNR. */
+struct align_ref {
+    uint64_t *ts;
+    double *v;
+    size_t n, cap;
+};
+
+static int collect_ref(void *ctx, const struct wifi_sample *s, size_t n)
+{
+    struct align_ref *r = ctx;
+    if (r->n + n > r->cap) {
+        r->cap = (r->n + n) * 2;
+        r->ts = realloc(r->ts, r->cap * sizeof(*r->ts));
+        r->v = realloc(r->v, r->cap * sizeof(*r->v));
+        if (!r->ts || !r->v) return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        r->ts[r->n] = s[i].ts_ns;
+        int snr = (int)sample_snr(&s[i]);       /* as the SNR column saturates it */
+        r->v[r->n++] = snr < INT8_MIN ? INT8_MIN : snr > INT8_MAX ? INT8_MAX : snr;
+    }
+    return 1;
+}
+
+/* What align_run should say for r at t, by binary search. */
+static double ref_value(const struct align *a, const struct align_ref *r, uint64_t t)
+{
+    size_t lo = 0, hi = r->n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->ts[mid] <= t) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return NAN;
+    size_t j = lo - 1;
+    uint64_t gap = a->max_gap_ns;
+    if (r->ts[j] == t) return r->v[j];
+    if (a->fill == ALIGN_LAST) return t - r->ts[j] <= gap ? r->v[j] : NAN;
+    if (j + 1 == r->n || r->ts[j + 1] - r->ts[j] > gap) return NAN;
+    return r->v[j] + (r->v[j + 1] - r->v[j]) * (double)(t - r->ts[j]) / (double)(r->ts[j + 1] - r->ts[j]);
+}
+
+struct align_check {
+    const struct align *a;
+    const struct align_ref *refs;
+    uint64_t rows, mismatches;
+    double sum;
+};
+
+static int check_row(void *ctx, uint64_t ts_ns, const double *values, size_t n)
+{
+    struct align_check *c = ctx;
+    for (size_t i = 0; i < n; i++) {
+        double want = ref_value(c->a, &c->refs[i], ts_ns);
+        if (isnan(want) != isnan(values[i]) || (!isnan(want) && want != values[i])) c->mismatches++;
+    }
+    c->rows++;
+    return 1;
+}
+
+static void ref_row(struct align_check *c, uint64_t t)
+{
+    for (size_t i = 0; i < c->a->n; i++) {
+        double v = ref_value(c->a, &c->refs[i], t);
+        c->sum += isnan(v) ? 0 : v;
+    }
+    c->rows++;
+}
+
+static int count_row(void *ctx, uint64_t ts_ns, const double *values, size_t n)
+{
+    struct align_check *c = ctx;
+    (void)ts_ns;
+    for (size_t i = 0; i < n; i++) c->sum += isnan(values[i]) ? 0 : values[i];
+    c->rows++;
+    return 1;
+}
+
+/*
+ * The merge-join alignment against materialising each series and binary
+ * searching it per row: same rows and values, and the time each takes.
+ */
+static int bench_align(const struct bench_args *args)
+{
+    (void)args;
+    static const struct {
+        const char *name;
+        uint64_t step_ms;
+        int fill;
+    } modes[] = {
+        { "grid 1 s, last", 1000, ALIGN_LAST },
+        { "grid 1 s, linear", 1000, ALIGN_LINEAR },
+        { "grid 250 ms, linear", 250, ALIGN_LINEAR },
+        { "as-of wlan0, last", 0, ALIGN_LAST },
+        { "as-of wlan0, linear", 0, ALIGN_LINEAR },
+    };
+    static const char *const series[] = { "iface=wlan0", "iface=wlan1" };
+    char dir[64], err[160];
+    snprintf(dir, sizeof(dir), "/tmp/snrmon-bench-%d.align", (int)getpid());
+    if (!build_align_store(dir)) return 1;
+
+    printf("%d days of wlan0 at 1 Hz and wlan1 every %d ms, %d ms out of phase\n\n", ALIGN_DAYS,
+           ALIGN_B_PERIOD_MS, ALIGN_B_OFFSET_MS);
+    printf("%-22s | %8s | %9s | %10s | %12s | %10s\n", "Mode", "Rows", "Samples", "Mismatches", "Materialise",
+           "Merge");
+    printf("------------------------------------------------------------------------------------\n");
+    int bad = 0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]) && !bad; m++) {
+        struct align a;
+        struct align_ref refs[2] = { { 0 } };
+        align_init(&a, modes[m].step_ms * 1000000ull, modes[m].fill, ALIGN_SNR);
+        for (size_t i = 0; i < 2 && !bad; i++) {
+            if (!align_add(&a, dir, "", series[i], err, sizeof(err))) {
+                fprintf(stderr, "ERROR: %s: %s\n", series[i], err);
+                bad = 1;
+            }
+        }
+
+        /* The reference: every series in memory, then a binary search per row and series. */
+        uint64_t t0 = mono_ns();
+        for (size_t i = 0; i < a.n && !bad; i++) {
+            bad = !query_run(a.series[i]->view, &a.series[i]->q, collect_ref, &refs[i], NULL);
+        }
+        struct align_check ref = { &a, refs, 0, 0, 0 };
+        if (!bad && refs[0].n && refs[1].n) {
+            uint64_t first = refs[0].ts[0] < refs[1].ts[0] ? refs[0].ts[0] : refs[1].ts[0];
+            uint64_t last = refs[0].ts[refs[0].n - 1] > refs[1].ts[refs[1].n - 1] ? refs[0].ts[refs[0].n - 1]
+                                                                                   : refs[1].ts[refs[1].n - 1];
+            if (a.step_ns) {
+                for (uint64_t t = first - first % a.step_ns; t <= last; t += a.step_ns) ref_row(&ref, t);
+            } else {
+                for (size_t k = 0; k < refs[0].n; k++) ref_row(&ref, refs[0].ts[k]);
+            }
+        }
+        uint64_t t1 = mono_ns();
+        struct align_check merged = { &a, refs, 0, 0, 0 }, checked = { &a, refs, 0, 0, 0 };
+        bad = bad || !align_run(&a, count_row, &merged);
+        uint64_t t2 = mono_ns();
+        bad = bad || !align_run(&a, check_row, &checked);
+
+        int differ = merged.rows != ref.rows || checked.mismatches || merged.sum != ref.sum;
+        bad |= differ;
+        printf("%-22s | %8llu | %9llu | %10llu | %10.1fms | %8.1fms%s\n", modes[m].name,
+               (unsigned long long)merged.rows, (unsigned long long)a.samples,
+               (unsigned long long)checked.mismatches, (t1 - t0) / 1e6, (t2 - t1) / 1e6,
+               differ ? "  DIFFERENT" : "");
+        for (size_t i = 0; i < 2; i++) {
+            free(refs[i].ts);
+            free(refs[i].v);
+        }
+        align_free(&a);
+    }
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "WARNING: could not remove %s\n", dir);
+    return bad;
+}
+
+#define IMPORT_FILES 8
+#define IMPORT_ROWS 200000          /* per file, one a second: 2.3 days */
+
+/* Expected signal of row i in layout i's file: what the importer should read back. */
+static int import_signal(unsigned layout, uint64_t i)
+{
+    if (layout == 2) return -40 - (int)(i % 50);
+    int pct = 40 + (int)(i % 60);
+    return (int)(pct / 2.0f - 100.0f);
+}
+
+/* Capture j of the three layouts in turn: rows from t0 at 1 Hz, mtime at the last one. */
+static int write_capture(const char *path, unsigned layout, time_t t0)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    fprintf(fp, "=== Wi-Fi Link Health Monitor - Live Feed ===\n\n[+] Connected! Starting live monitoring...\n\n");
+    for (uint64_t i = 0; i < IMPORT_ROWS; i++) {
+        time_t t = t0 + (time_t)i;
+        struct tm tm;
+        char when[10];
+        localtime_r(&t, &tm);
+        strftime(when, sizeof(when), "%H:%M:%S", &tm);
+        int pct = 40 + (int)(i % 60);
+        float dbm = pct / 2.0f - 100.0f;
+        if (layout == 0) {
+            fprintf(fp, "\r%-8s | %6.1f | %-20s | %3d%% (%+5.1f dBm) | %5.1f dB | %6.1f/%-6.1f | %-8s", when,
+                    50.0 + i % 40, i / 3600 % 2 ? "Office-5G" : "HomeNet", pct, dbm, dbm + 95, 144.4, 72.2, "FAIR");
+        } else if (layout == 1) {
+            fprintf(fp, "\r%-8s | %-20s | %3d%% (%+5.1f dBm) | %5.1f dB | %s     ", when, "HomeNet", pct, dbm,
+                    dbm + 95, "AI");
+        } else {
+            char signal[16];
+            snprintf(signal, sizeof(signal), "%d dBm", import_signal(2, i));
+            fprintf(fp, "%-8s | %7s | %7s | %6s | %6s | %-25s\r", when, signal, "-92 dBm", "30.1 dB", "80 cm",
+                    "NORMAL RANGE (0.5-2 m)");
+        }
+    }
+    fprintf(fp, "\nMonitoring stopped.\n");
+    int ok = fclose(fp) == 0;
+    struct timespec times[2] = { { t0 + IMPORT_ROWS - 1, 0 }, { t0 + IMPORT_ROWS - 1, 0 } };
+    return ok && utimensat(AT_FDCWD, path, times, 0) == 0;
+}
+
+struct import_check {
+    uint64_t next_ns;           /* the captures are back to back at 1 Hz */
+    uint64_t n, wrong_time, wrong_signal, wrong_health;
+};
+
+static void check_import(struct sink *k, const struct wifi_sample *s)
+{
+    struct import_check *c = k->priv;
+    uint64_t file = c->n / IMPORT_ROWS, row = c->n % IMPORT_ROWS;
+    c->wrong_time += s->ts_ns != c->next_ns;
+    c->wrong_signal += s->signal_dbm != import_signal((unsigned)(file % 3), row);
+    /* The layouts without a health column were batch scored: the scalar path must agree to the bit. */
+    if (file % 3) {
+        float snr = file % 3 == 1 ? (40 + (int)(row % 60)) / 2.0f - 5.0f : sample_snr(s);
+        c->wrong_health += s->health != health_score(&health_default_weights, snr, -1.0f, -1.0f, -1.0f);
+    }
+    c->next_ns = s->ts_ns + 1000000000ull;
+    c->n++;
+}
+
+struct import_order {
+    uint64_t last_ns, n, backwards;
+};
+
+static void check_order(struct sink *k, const struct wifi_sample *s)
+{
+    struct import_order *o = k->priv;
+    o->backwards += s->ts_ns < o->last_ns;
+    o->last_ns = s->ts_ns;
+    o->n++;
+}
+
+/* Two captures running half a file apart in one batch: their rows must come out interleaved in time order. */
+static int import_overlap(const char *const *paths, time_t t0)
+{
+    struct pool pool;
+    struct import_order order = {0};
+    struct sink k = { .name = "order", .sample = check_order, .priv = &order };
+    int ok = write_capture(paths[0], 0, t0) && write_capture(paths[1], 2, t0 + IMPORT_ROWS / 2) &&
+             pool_init(&pool, 2, 0);
+    if (!ok) return 0;
+    ok = import_run(&pool, paths, 2, &k, NULL, NULL, NULL);
+    pool_destroy(&pool);
+    ok = ok && order.n == 2ull * IMPORT_ROWS && !order.backwards;
+    printf("\nOverlapping captures: %llu samples, %llu out of order%s\n", (unsigned long long)order.n,
+           (unsigned long long)order.backwards, ok ? "" : "  WRONG");
+    return ok;
+}
+
+/* Line splitting by scanner, then whole imports on 1 to 8 workers, checked row by row. */
+static int bench_import(const struct bench_args *a)
+{
+    (void)a;
+    char dir[64], paths[IMPORT_FILES][96];
+    const char *list[IMPORT_FILES];
+    snprintf(dir, sizeof(dir), "/tmp/snrmon-bench-%d.captures", (int)getpid());
+    if (mkdir(dir, 0755) != 0) return 1;
+    /* A June fortnight: no clock changes in the zones that have them. */
+    struct tm start = { .tm_year = 124, .tm_mon = 5, .tm_mday = 1, .tm_hour = 9, .tm_isdst = -1 };
+    time_t t0 = mktime(&start);
+    int ok = 1;
+    uint64_t bytes = 0;
+    for (unsigned j = 0; j < IMPORT_FILES && ok; j++) {
+        struct stat sb;
+        snprintf(paths[j], sizeof(paths[j]), "%s/capture-%u.txt", dir, j);
+        list[j] = paths[j];
+        ok = write_capture(paths[j], j % 3, t0 + (time_t)j * IMPORT_ROWS) && stat(paths[j], &sb) == 0;
+        bytes += ok ? (uint64_t)sb.st_size : 0;
+    }
+
+    /* Splitting alone, over the poc.c capture read into memory. */
+    FILE *fp = ok ? fopen(paths[0], "rb") : NULL;
+    struct stat sb;
+    char *buf = fp && fstat(fileno(fp), &sb) == 0 ? malloc((size_t)sb.st_size) : NULL;
+    ok = buf && fread(buf, 1, (size_t)sb.st_size, fp) == (size_t)sb.st_size;
+    if (fp) fclose(fp);
+    if (ok) {
+        printf("%u captures, %.1f MB, %u rows each\n\n", IMPORT_FILES, bytes / 1e6, IMPORT_ROWS);
+        printf("%-22s | %8s | %8s\n", "Line splitting", "Lines", "GB/s");
+        printf("--------------------------------------------\n");
+        const char *names[] = { "byte loop", "portable (8 bytes)", "widest (AVX2)" };
+        for (int v = 0; v < 3; v++) {
+            import_scan_fn scan = v ? import_scanner(v == 2) : NULL;
+            const char *end = buf + sb.st_size;
+            uint64_t lines = 0, best = UINT64_MAX;
+            for (int rep = 0; rep < 5; rep++) {
+                uint64_t t = mono_ns();
+                lines = 0;
+                for (const char *p = buf; p < end; lines++) {
+                    const char *b = p;
+                    if (scan) b = scan(p, end);
+                    else while (b < end && *b != '\r' && *b != '\n') b++;
+                    p = b + 1;
+                }
+                t = mono_ns() - t;
+                if (t < best) best = t;
+            }
+            printf("%-22s | %8llu | %8.2f\n", names[v], (unsigned long long)lines, sb.st_size / (double)best);
+        }
+    }
+    free(buf);
+
+    printf("\n%-8s | %9s | %8s | %10s | %12s | %13s | %12s\n", "Workers", "Samples", "MB/s", "Skipped",
+           "Wrong time", "Wrong signal", "Wrong health");
+    printf("-----------------------------------------------------------------------------------------\n");
+    for (unsigned workers = 1; ok && workers <= IMPORT_FILES; workers *= 2) {
+        struct pool pool;
+        struct import_check check = { (uint64_t)t0 * 1000000000ull, 0, 0, 0, 0 };
+        struct sink k = { .name = "check", .sample = check_import, .priv = &check };
+        struct import_stats stats;
+        if (!pool_init(&pool, workers, 0)) break;
+        ok = import_run(&pool, list, IMPORT_FILES, &k, NULL, NULL, &stats);
+        pool_destroy(&pool);
+        ok = ok && check.n == (uint64_t)IMPORT_FILES * IMPORT_ROWS && !check.wrong_time && !check.wrong_signal &&
+             !check.wrong_health;
+        printf("%-8u | %9llu | %8.0f | %10llu | %12llu | %13llu | %12llu%s\n", workers,
+               (unsigned long long)check.n, stats.bytes * 1e3 / stats.elapsed_ns, (unsigned long long)stats.skipped,
+               (unsigned long long)check.wrong_time, (unsigned long long)check.wrong_signal,
+               (unsigned long long)check.wrong_health, ok ? "" : "  WRONG");
+    }
+    if (ok) ok = import_overlap(list, t0);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "WARNING: could not remove %s\n", dir);
+    return !ok;
+}
+
+#define SITES_FLOORS 4             /* floors per building, which share the building's APs */
+#define SITES_OWN_APS 30
+#define SITES_SHARED_APS 10
+#define SITES_QUERIES 2000
+
+static uint32_t site_rand(uint32_t *rng)
+{
+    *rng = *rng * 1664525u + 1013904223u;
+    return *rng >> 8;
+}
+
+static void site_bssid(uint32_t id, uint8_t bssid[6])
+{
+    uint8_t b[6] = { 0x02, 0x1a, (uint8_t)(id >> 24), (uint8_t)(id >> 16), (uint8_t)(id >> 8), (uint8_t)id };
+    memcpy(bssid, b, 6);
+}
+
+/*
+ * What floor `site` would see on a scan: its own APs, the building's shared
+ * ones louder on the floors nearer theirs. With noisy, a fifth of the APs
+ * are missed, signals move by up to 5 dB, and three phones' hotspots show up.
+ */
+static size_t site_scan(uint32_t site, int noisy, uint32_t *rng, struct site_ap *aps)
+{
+    size_t n = 0;
+    uint32_t building = site / SITES_FLOORS, floor = site % SITES_FLOORS;
+    for (uint32_t j = 0; j < SITES_OWN_APS + SITES_SHARED_APS; j++) {
+        int shared = j >= SITES_OWN_APS;
+        uint32_t id = shared ? 0x800000u + building * SITES_SHARED_APS + (j - SITES_OWN_APS)
+                             : site * SITES_OWN_APS + j;
+        int dbm = -45 - (int)(j % 10) * 4;
+        if (shared) dbm = -50 - (int)((floor + j) % SITES_FLOORS) * 12;
+        if (noisy) {
+            if (site_rand(rng) % 5 == 0) continue;
+            dbm += (int)(site_rand(rng) % 11) - 5;
+        }
+        site_bssid(id, aps[n].bssid);
+        aps[n++].signal_dbm = (int8_t)dbm;
+    }
+    for (int j = 0; noisy && j < 3; j++) {
+        site_bssid(0xf000000u + site_rand(rng), aps[n].bssid);
+        aps[n++].signal_dbm = (int8_t)(-40 - (int)(site_rand(rng) % 30));
+    }
+    return n;
+}
+
+/* Library lookups by LSH against a scan of every site, at growing library sizes. */
+static int write_text(const char *path, const char *text)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    fputs(text, fp);
+    return fclose(fp) == 0;
+}
+
+/* This binary on the mock at an enrolled site: does the --rules rule fire there? -1 if the run failed. */
+static int site_run_alerts(const char *dir, const char *rules, const char *enroll)
+{
+    static char out[16384];
+    char *argv[] = { "/proc/self/exe", "--mock", "--sites", (char *)dir, "--rules", (char *)rules, "-n", "2",
+                     "-t", "50", enroll ? "--enroll-site" : NULL, (char *)enroll, NULL };
+    if (run_command(argv, out, sizeof(out), 10000) != 1) return -1;
+    return strstr(out, "ALERT: always") != NULL;
+}
+
+/* A NAME.conf with no rule lines keeps --rules; one with rules replaces them. */
+static int sites_rules_check(void)
+{
+    char dir[64], rules[96], conf[96], cmd[96];
+    snprintf(dir, sizeof(dir), "/tmp/snrmon-bench-%d.sitedir", (int)getpid());
+    snprintf(rules, sizeof(rules), "%s/alerts.rules", dir);
+    snprintf(conf, sizeof(conf), "%s/home.conf", dir);
+    if (mkdir(dir, 0755) != 0) return 0;
+    int enrolled = -1, kept = -1, replaced = -1;
+    if (write_text(rules, "rule always: signal < 0\n")) enrolled = site_run_alerts(dir, rules, "home");
+    if (enrolled == 1 && write_text(conf, "alert_below = 10\n")) kept = site_run_alerts(dir, rules, NULL);
+    if (kept == 1 && write_text(conf, "rule own: signal > 0\n")) replaced = !site_run_alerts(dir, rules, NULL);
+    int ok = enrolled == 1 && kept == 1 && replaced == 1;
+    printf("\n--rules at a site: %s without rule lines in NAME.conf, %s by them%s\n", kept == 1 ? "kept" : "LOST",
+           replaced == 1 ? "replaced" : replaced == 0 ? "NOT REPLACED" : "not run", ok ? "" : "  WRONG");
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "WARNING: could not remove %s\n", dir);
+    return ok;
+}
+
+static int bench_sites(const struct bench_args *a)
+{
+    (void)a;
+    static const uint32_t sizes[] = { 300, 3000, 30000 };
+    static struct site_ap aps[SITES_OWN_APS + SITES_SHARED_APS + 3];
+    char path[64], err[320];
+    snprintf(path, sizeof(path), "/tmp/snrmon-bench-%d.sites", (int)getpid());
+    int ok = 1;
+
+    /* Fingerprinting: a scan's worth of APs, SITE_HASHES hashes each. */
+    uint32_t rng = 1;
+    struct site_fp fp;
+    size_t n = site_scan(0, 0, &rng, aps);
+    uint64_t t = mono_ns();
+    for (int i = 0; i < 10000; i++) {
+        aps[0].bssid[5] = (uint8_t)i;
+        site_fingerprint(aps, n, &fp);
+    }
+    printf("site_fingerprint: %zu APs in %.1f us\n\n", n, (mono_ns() - t) / 1e3 / 10000);
+
+    printf("%-6s | %7s | %9s | %9s | %10s | %9s | %9s | %7s | %7s\n", "Sites", "Load ms", "LSH p50us",
+           "LSH p99us", "Exact us", "LSH right", "Exact rt", "Unknown", "Agree");
+    printf("------------------------------------------------------------------------------------------------\n");
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]) && ok; z++) {
+        struct site_lib lib = {0};
+        char name[SITE_NAME_SIZE];
+        for (uint32_t i = 0; i < sizes[z] && ok; i++) {
+            snprintf(name, sizeof(name), "site-%u", i);
+            site_fingerprint(aps, site_scan(i, 0, &rng, aps), &fp);
+            ok = site_lib_add(&lib, name, &fp) >= 0;
+        }
+        /* Round trip through the file: what the monitor starts from. */
+        ok = ok && site_lib_save(&lib, path, err, sizeof(err));
+        site_lib_free(&lib);
+        t = mono_ns();
+        ok = ok && site_lib_load(&lib, path, err, sizeof(err)) && lib.n == sizes[z];
+        double load_ms = (mono_ns() - t) / 1e6;
+        if (!ok) {
+            fprintf(stderr, "ERROR: %s\n", err);
+            break;
+        }
+
+        struct histogram lat;
+        hist_reset(&lat);
+        uint64_t exact_ns = 0;
+        unsigned right = 0, exact_right = 0, unknown = 0, agree = 0;
+        rng = (uint32_t)z + 7;
+        for (uint32_t q = 0; q < SITES_QUERIES; q++) {
+            uint32_t site = (uint32_t)((uint64_t)q * sizes[z] / SITES_QUERIES);
+            site_fingerprint(aps, site_scan(site, 1, &rng, aps), &fp);
+            t = mono_ns();
+            long got = site_lib_match(&lib, &fp, NULL);
+            hist_record(&lat, mono_ns() - t);
+            t = mono_ns();
+            long want = site_lib_match_all(&lib, &fp, NULL);
+            exact_ns += mono_ns() - t;
+            snprintf(name, sizeof(name), "site-%u", site);
+            right += got >= 0 && strcmp(lib.sites[got].name, name) == 0;
+            exact_right += want >= 0 && strcmp(lib.sites[want].name, name) == 0;
+            agree += got == want;
+
+            /* A site that is not in the library must not match one that is. */
+            struct site_fp other;
+            site_fingerprint(aps, site_scan(sizes[z] + q, 1, &rng, aps), &other);
+            unknown += site_lib_match(&lib, &other, NULL) >= 0;
+        }
+        int good = right >= SITES_QUERIES * 99 / 100 && !unknown && hist_quantile(&lat, 0.99) < 1000000;
+        printf("%-6u | %7.1f | %9.2f | %9.2f | %10.1f | %8.1f%% | %8.1f%% | %7u | %6.1f%%%s\n", sizes[z], load_ms,
+               hist_quantile(&lat, 0.5) / 1e3, hist_quantile(&lat, 0.99) / 1e3, exact_ns / 1e3 / SITES_QUERIES,
+               100.0 * right / SITES_QUERIES, 100.0 * exact_right / SITES_QUERIES, unknown,
+               100.0 * agree / SITES_QUERIES, good ? "" : "  WRONG");
+        ok = good;
+        site_lib_free(&lib);
+    }
+    remove(path);
+    if (ok) ok = sites_rules_check();
+    return !ok;
+}
+
+static const struct {
+    const char *name;
+    int (*run)(const struct bench_args *a);
+} benches[] = {
+    { "backends", bench_backends },
+    { "link", bench_link },
+    { "deadline", bench_deadline },
+    { "runner", bench_runner },
+    { "batchread", bench_batchread },
+    { "rules", bench_rules },
+    { "control", bench_control },
+    { "metrics", bench_metrics },
+    { "flight", bench_flight },
+    { "store", bench_store },
+    { "zonemap", bench_zonemap },
+    { "kernels", bench_kernels },
+    { "netsh", bench_netsh },
+    { "pipeline", bench_pipeline },
+    { "wheel", bench_wheel },
+    { "pool", bench_pool },
+    { "ingest", bench_ingest },
+    { "align", bench_align },
+    { "import", bench_import },
+    { "sites", bench_sites },
+};
+
+int bench_run(const char *name, const struct bench_args *args)
+{
+    int all = strcmp(name, "all") == 0, found = 0, rc = 0;
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (!all && strcmp(name, benches[i].name) != 0) continue;
+        if (found++) printf("\n");
+        rc |= benches[i].run(args);
+    }
+    if (!found) {
+        fprintf(stderr, "ERROR: Unknown benchmark %s\n", name);
+        return 1;
+    }
+    return rc;
+}
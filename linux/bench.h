@@ -0,0 +1,13 @@
+#ifndef SNR_BENCH_H
+#define SNR_BENCH_H
+
+struct bench_args {
+    const char *ifname;
+    unsigned interval_ms;
+    int iterations;
+};
+
+/* Runs the named benchmark ("all" runs every one); returns an exit code. */
+int bench_run(const char *name, const struct bench_args *args);
+
+#endif
@@ -0,0 +1,278 @@
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#define RECLAIM_INTERVAL_MS 1000
+
+static char *trim(char *p)
+{
+    while (*p == ' ' || *p == '\t') p++;
+    char *e = p + strlen(p);
+    while (e > p && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) *--e = '\0';
+    return p;
+}
+
+static int parse_floats(const char *arg, float *out, int n)
+{
+    char *end;
+    for (int i = 0; i < n; i++) {
+        out[i] = strtof(arg, &end);
+        if (end == arg) return 0;
+        arg = end;
+        if (i + 1 < n && *arg++ != ',') return 0;
+    }
+    return *arg == '\0';
+}
+
+static int parse_key(struct config *c, const char *key, const char *val)
+{
+    char *end;
+    if (strcmp(key, "interval_ms") == 0) {
+        unsigned long v = strtoul(val, &end, 10);
+        if (*end || v == 0 || v > 3600000) return 0;
+        c->interval_ms = (unsigned)v;
+        return 1;
+    }
+    if (strcmp(key, "weights") == 0) return health_parse_weights(val, &c->weights);
+    if (strcmp(key, "alert_below") == 0) {
+        c->alert_below = strtof(val, &end);
+        return *end == '\0';
+    }
+    if (strcmp(key, "proximity") == 0) {
+        float t[3];
+        if (!parse_floats(val, t, 3) || t[0] > t[1] || t[1] > t[2]) return 0;
+        memcpy(c->proximity, t, sizeof(t));
+        return 1;
+    }
+    return 0;
+}
+
+int config_parse(const char *text, const struct config *defaults, struct config *out,
+                 char *err, size_t err_size)
+{
+    *out = *defaults;
+    memset(&out->rules, 0, sizeof(out->rules));
+    out->next = NULL;
+
+    /* Rule lines go to the rule compiler in place, so its line numbers hold. */
+    size_t len = strlen(text);
+    char *rules = malloc(len + 1);
+    if (!rules) {
+        snprintf(err, err_size, "out of memory");
+        return 0;
+    }
+
+    char line[512];
+    int lineno = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        size_t n = strcspn(text + pos, "\n");
+        lineno++;
+        size_t copy = n < sizeof(line) - 1 ? n : sizeof(line) - 1;
+        memcpy(line, text + pos, copy);
+        line[copy] = '\0';
+
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *p = trim(line);
+        int is_rule = strncmp(p, "rule", 4) == 0 && (p[4] == ' ' || p[4] == '\t');
+
+        memcpy(rules + pos, text + pos, n);
+        if (!is_rule) memset(rules + pos, ' ', n);
+        if (pos + n < len) rules[pos + n] = '\n';
+        pos += n + 1;
+
+        if (*p == '\0' || is_rule) continue;
+        char *eq = strchr(p, '=');
+        if (eq) *eq = '\0';
+        if (!eq || !parse_key(out, trim(p), trim(eq + 1))) {
+            snprintf(err, err_size, "line %d: bad setting '%s'", lineno, trim(p));
+            free(rules);
+            return 0;
+        }
+    }
+    rules[len] = '\0';
+
+    int ok = rules_compile(&out->rules, rules, err, err_size);
+    free(rules);
+    if (!ok) rules_free(&out->rules);
+    return ok;
+}
+
+int config_load(const char *path, const struct config *defaults, struct config *out, char *err, size_t err_size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        snprintf(err, err_size, "cannot open %s: %s", path, strerror(errno));
+        return 0;
+    }
+    char *text = NULL;
+    size_t len = 0, cap = 0, n;
+    do {
+        if (len + 4096 + 1 > cap) {
+            char *t = realloc(text, cap = len + 8192);
+            if (!t) break;
+            text = t;
+        }
+        n = fread(text + len, 1, cap - len - 1, fp);
+        len += n;
+    } while (n > 0);
+    fclose(fp);
+    if (!text) {
+        snprintf(err, err_size, "out of memory");
+        return 0;
+    }
+    text[len] = '\0';
+    int ok = config_parse(text, defaults, out, err, err_size);
+    free(text);
+    return ok;
+}
+
+static int load(struct config_watch *w, char *err, size_t err_size)
+{
+    struct config *c = malloc(sizeof(*c));
+    if (!c || !config_load(w->path, w->defaults, c, err, err_size)) {
+        if (!c) snprintf(err, err_size, "out of memory");
+        free(c);
+        return 0;
+    }
+
+    c->generation = ++w->generation;
+    struct config *old = atomic_exchange_explicit(&w->current, c, memory_order_acq_rel);
+    if (old) {
+        old->retired_at = c->generation;
+        old->next = w->retired;
+        w->retired = old;
+    }
+    return 1;
+}
+
+static void free_config(struct config *c)
+{
+    rules_free(&c->rules);
+    free(c);
+}
+
+/* Frees every retired config the sampler has provably moved past. */
+static void reclaim(struct config_watch *w)
+{
+    uint64_t seen = atomic_load_explicit(&w->reader_gen, memory_order_acquire);
+    struct config **pp = &w->retired;
+    while (*pp) {
+        struct config *c = *pp;
+        if (c->retired_at <= seen) {
+            *pp = c->next;
+            free_config(c);
+        } else {
+            pp = &c->next;
+        }
+    }
+}
+
+static void *watch_thread(void *arg)
+{
+    struct config_watch *w = arg;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[3] = {
+        { w->inotify_fd, POLLIN, 0 }, { w->stop_fd, POLLIN, 0 }, { w->reload_fd, POLLIN, 0 },
+    };
+
+    for (;;) {
+        int rc = poll(fds, 3, w->retired ? RECLAIM_INTERVAL_MS : -1);
+        if (rc < 0 && errno != EINTR) break;
+        if (fds[1].revents) break;
+        reclaim(w);
+        if (rc <= 0) continue;
+
+        /* One reparse per batch: a save is often several events. */
+        uint64_t requested = 0;
+        int changed = (fds[2].revents & POLLIN) && read(w->reload_fd, &requested, sizeof(requested)) > 0;
+        ssize_t n = fds[0].revents & POLLIN ? read(w->inotify_fd, buf, sizeof(buf)) : 0;
+        for (char *p = buf; n > 0 && p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len && strcmp(ev->name, w->name) == 0) changed = 1;
+            p += sizeof(*ev) + ev->len;
+        }
+        if (!changed) continue;
+
+        char err[160];
+        if (load(w, err, sizeof(err))) {
+            fprintf(stderr, "\rConfig reloaded: %s (generation %llu)%30s\n", w->path,
+                    (unsigned long long)w->generation, "");
+        } else {
+            fprintf(stderr, "\rConfig not reloaded, keeping the previous one: %s%20s\n", err, "");
+        }
+    }
+    return NULL;
+}
+
+int config_watch_start(struct config_watch *w, const char *path, const struct config *defaults,
+                       char *err, size_t err_size)
+{
+    memset(w, 0, sizeof(*w));
+    if (strlen(path) >= sizeof(w->path)) {
+        snprintf(err, err_size, "path too long");
+        return 0;
+    }
+    strcpy(w->path, path);
+    w->defaults = defaults;
+    w->inotify_fd = w->stop_fd = w->reload_fd = -1;
+    if (!load(w, err, err_size)) return 0;
+
+    char dir[sizeof(w->path)];
+    strcpy(dir, w->path);
+    char *slash = strrchr(dir, '/');
+    w->name = slash ? w->path + (slash - dir) + 1 : w->path;
+    if (slash) {
+        slash[slash == dir] = '\0';
+    } else {
+        strcpy(dir, ".");
+    }
+
+    w->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    w->stop_fd = eventfd(0, EFD_CLOEXEC);
+    w->reload_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (w->inotify_fd < 0 || w->stop_fd < 0 || w->reload_fd < 0 ||
+        inotify_add_watch(w->inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+        pthread_create(&w->thread, NULL, watch_thread, w) != 0) {
+        snprintf(err, err_size, "cannot watch %s: %s", dir, strerror(errno));
+        if (w->inotify_fd >= 0) close(w->inotify_fd);
+        if (w->stop_fd >= 0) close(w->stop_fd);
+        if (w->reload_fd >= 0) close(w->reload_fd);
+        free_config(atomic_load(&w->current));
+        return 0;
+    }
+    return 1;
+}
+
+void config_request_reload(struct config_watch *w)
+{
+    uint64_t one = 1;
+    /* Only fails once the counter saturates, when a reload is pending anyway. */
+    ssize_t rc = write(w->reload_fd, &one, sizeof(one));
+    (void)rc;
+}
+
+void config_watch_stop(struct config_watch *w)
+{
+    uint64_t one = 1;
+    if (write(w->stop_fd, &one, sizeof(one)) == sizeof(one)) pthread_join(w->thread, NULL);
+    close(w->inotify_fd);
+    close(w->stop_fd);
+    close(w->reload_fd);
+
+    while (w->retired) {
+        struct config *c = w->retired;
+        w->retired = c->next;
+        free_config(c);
+    }
+    free_config(atomic_load(&w->current));
+}
@@ -0,0 +1,81 @@
+#ifndef SNR_CONFIG_H
+#define SNR_CONFIG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "../common/health.h"
+#include "../common/rules.h"
+
+/*
+ * Settings that can change while the monitor runs:
+ *
+ *     interval_ms = 500
+ *     weights     = 0.45,0.25,0.2,0.1   # SNR, bitrate, retries, beacon loss
+ *     alert_below = 40                  # health alert; -1 disables
+ *     proximity   = 26,33,40            # SNR thresholds for the status column
+ *     rule weak: p50(snr, 60s) < 20     # any number of rule lines
+ *
+ * Keys missing from the file keep the command-line values.
+ */
+struct config {
+    unsigned interval_ms;
+    struct health_weights weights;
+    float alert_below;
+    float proximity[3];
+    struct rule_set rules;      /* owned by the sampler once published */
+    uint64_t generation;
+    uint64_t retired_at;        /* generation that replaced it */
+    struct config *next;        /* retired list */
+};
+
+/*
+ * Watches the config file's directory with inotify (editors that save by
+ * rename replace the inode) and reparses on its own thread. New configs
+ * are published with one atomic pointer store; the sampler picks them up
+ * with one atomic load per tick and never takes a lock. Old configs are
+ * freed once the sampler has reported reading a newer generation, which
+ * is the quiescent state of this single-reader RCU.
+ */
+struct config_watch {
+    char path[256];
+    const char *name;           /* basename within path */
+    int inotify_fd;
+    int stop_fd;
+    int reload_fd;
+    pthread_t thread;
+    const struct config *defaults;
+    _Atomic(struct config *) current;
+    _Atomic uint64_t reader_gen;
+    uint64_t generation;
+    struct config *retired;
+};
+
+/* Parses text over a copy of defaults (whose rules are ignored). */
+int config_parse(const char *text, const struct config *defaults, struct config *out,
+                 char *err, size_t err_size);
+
+/* config_parse on a file's contents. */
+int config_load(const char *path, const struct config *defaults, struct config *out, char *err, size_t err_size);
+
+/* Loads the file once and starts watching; fails if the first load does. */
+int config_watch_start(struct config_watch *w, const char *path, const struct config *defaults,
+                       char *err, size_t err_size);
+
+/*
+ * Sampler side: the config for this tick. The previous pointer returned
+ * must not be used after calling this again.
+ */
+static inline struct config *config_read(struct config_watch *w)
+{
+    struct config *c = atomic_load_explicit(&w->current, memory_order_acquire);
+    atomic_store_explicit(&w->reader_gen, c->generation, memory_order_release);
+    return c;
+}
+
+/* Asks the watcher to reparse now, as if the file had changed. */
+void config_request_reload(struct config_watch *w);
+void config_watch_stop(struct config_watch *w);
+
+#endif
@@ -0,0 +1,394 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/health.h"
+#include "../common/intern.h"
+#include "control.h"
+
+#define CONTROL_TAG_LISTEN (-1)
+#define CONTROL_TAG_STOP   (-2)
+
+struct out {
+    char *p;
+    size_t len, cap;
+    int overflow;
+};
+
+static void put(struct out *o, const char *fmt, ...)
+{
+    if (o->overflow) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(o->p + o->len, o->cap - o->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= o->cap - o->len) {
+        o->overflow = 1;
+        return;
+    }
+    o->len += (size_t)n;
+}
+
+static void put_hist(struct out *o, const char *name, const struct histogram *h)
+{
+    put(o, "%s_count %llu\n", name, (unsigned long long)h->count);
+    if (!h->count) return;
+    put(o, "%s_mean_us %.1f\n%s_p50_us %.1f\n%s_p90_us %.1f\n%s_p99_us %.1f\n%s_max_us %.1f\n", name,
+        hist_mean(h) / 1e3, name, hist_quantile(h, 0.5) / 1e3, name, hist_quantile(h, 0.9) / 1e3,
+        name, hist_quantile(h, 0.99) / 1e3, name, h->max / 1e3);
+}
+
+static void put_sample(struct out *o, const struct control_snapshot *snap)
+{
+    const struct wifi_sample *s = &snap->sample;
+    put(o, "OK\nticks %llu\n", (unsigned long long)snap->ticks);
+    if (!snap->have_sample) return;
+
+    put(o, "ts_ns %llu\n", (unsigned long long)s->ts_ns);
+    /* The sampler interned these before publishing, so the strings are in place. */
+    if (s->ifname_id) put(o, "interface %s\n", intern_str(&intern_global, s->ifname_id));
+    if (s->fields & FIELD_GAP) {
+        put(o, "gap 1\n");
+        return;
+    }
+    if (s->fields & FIELD_HEALTH) put(o, "health %.1f\nclass %s\n", s->health, health_class(s->health));
+    if (s->fields & FIELD_SSID) put(o, "ssid %s\n", intern_str(&intern_global, s->ssid_id));
+    if (s->fields & FIELD_SIGNAL) put(o, "signal_dbm %d\nsnr_db %.1f\n", s->signal_dbm, sample_snr(s));
+    if (s->fields & FIELD_RX_BITRATE) put(o, "rx_mbps %.1f\n", s->rx_bitrate_kbps / 1000.0);
+    if (s->fields & FIELD_TX_BITRATE) put(o, "tx_mbps %.1f\n", s->tx_bitrate_kbps / 1000.0);
+    if (s->fields & FIELD_TX_RETRIES) put(o, "tx_retries %u\n", s->tx_retries);
+    if (s->fields & FIELD_BEACON_LOSS) put(o, "beacon_loss %u\n", s->beacon_loss);
+    if (s->fields & FIELD_LINK_RATES) {
+        put(o, "link_kbps %.1f\n", (s->rx_bytes_per_s + s->tx_bytes_per_s) / 1e3);
+    }
+}
+
+/* Formats the response to one request line; the snapshot lock is held. */
+static void respond(struct control *c, const char *req, struct out *o)
+{
+    const struct control_snapshot *snap = &c->snap;
+
+    if (strcmp(req, "PING") == 0) {
+        put(o, "OK\n");
+    } else if (strcmp(req, "SAMPLE") == 0) {
+        put_sample(o, snap);
+    } else if (strcmp(req, "HIST") == 0) {
+        put(o, "OK\n");
+        put_hist(o, "latency", &snap->latency);
+        put_hist(o, "deadline", &snap->timeouts);
+    } else if (strcmp(req, "AGGS") == 0) {
+        put(o, "OK\n");
+        for (uint32_t i = 0; i < snap->naggs; i++) {
+            put(o, "%s %g\n", snap->aggs[i].name, snap->aggs[i].value);
+        }
+    } else if (strcmp(req, "RULES") == 0) {
+        put(o, "OK\nconfig_generation %llu\n", (unsigned long long)snap->config_generation);
+        for (uint32_t i = 0; i < snap->nrules; i++) {
+            put(o, "%s %s\n", snap->rules[i].name, snap->rules[i].firing ? "firing" : "ok");
+        }
+    } else if (strcmp(req, "RELOAD") == 0) {
+        if (!c->config) {
+            put(o, "ERR not running with --config\n");
+        } else {
+            config_request_reload(c->config);
+            put(o, "OK\n");
+        }
+    } else if (strcmp(req, "FLUSH") == 0) {
+        atomic_store_explicit(&c->flush_requested, 1, memory_order_relaxed);
+        put(o, "OK\n");
+    } else {
+        put(o, "ERR unknown request\n");
+    }
+    put(o, "\n");
+}
+
+static void drop_client(struct control *c, struct control_client *cl)
+{
+    epoll_ctl(c->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+    close(cl->fd);
+    cl->fd = -1;
+}
+
+static int want_write(struct control *c, struct control_client *cl, int on)
+{
+    if (cl->writing == on) return 1;
+    cl->writing = on;
+    struct epoll_event ev = { .events = on ? EPOLLOUT : EPOLLIN, .data.u64 = (uint64_t)(cl - c->clients) };
+    return epoll_ctl(c->epfd, EPOLL_CTL_MOD, cl->fd, &ev) == 0;
+}
+
+/* Returns 0 if the client must be dropped. */
+static int flush_out(struct control *c, struct control_client *cl)
+{
+    while (cl->out_off < cl->out_len) {
+        ssize_t n = send(cl->fd, cl->out + cl->out_off, cl->out_len - cl->out_off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return want_write(c, cl, 1);
+        if (n <= 0) return 0;
+        cl->out_off += (size_t)n;
+    }
+    cl->out_len = cl->out_off = 0;
+    return 1;
+}
+
+/*
+ * Answers every complete line in the input buffer. Stops early when the
+ * output is still draining, so a client that pipelines faster than it
+ * reads is throttled by its own socket rather than by our memory.
+ */
+static int serve_lines(struct control *c, struct control_client *cl)
+{
+    while (cl->out_len == 0) {
+        char *nl = memchr(cl->in, '\n', cl->in_len);
+        if (!nl) {
+            if (cl->in_len == sizeof(cl->in)) return 0;    /* line too long */
+            return want_write(c, cl, 0);
+        }
+        *nl = '\0';
+        if (nl > cl->in && nl[-1] == '\r') nl[-1] = '\0';
+
+        struct out o = { cl->out, 0, sizeof(cl->out), 0 };
+        pthread_mutex_lock(&c->lock);
+        respond(c, cl->in, &o);
+        pthread_mutex_unlock(&c->lock);
+        if (o.overflow) {
+            o.len = 0;
+            o.overflow = 0;
+            put(&o, "ERR response too large\n\n");
+        }
+        cl->out_len = o.len;
+
+        size_t used = (size_t)(nl - cl->in) + 1;
+        memmove(cl->in, cl->in + used, cl->in_len - used);
+        cl->in_len -= used;
+        if (!flush_out(c, cl)) return 0;
+    }
+    return 1;
+}
+
+static int read_client(struct control *c, struct control_client *cl)
+{
+    for (;;) {
+        if (cl->in_len == sizeof(cl->in)) return serve_lines(c, cl);
+        ssize_t n = recv(cl->fd, cl->in + cl->in_len, sizeof(cl->in) - cl->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return serve_lines(c, cl);
+        if (n <= 0) return 0;
+        cl->in_len += (size_t)n;
+        if (!serve_lines(c, cl)) return 0;
+        if (cl->out_len) return 1;      /* resume reading once drained */
+    }
+}
+
+static void accept_clients(struct control *c)
+{
+    for (;;) {
+        int fd = accept4(c->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        struct control_client *cl = NULL;
+        for (int i = 0; i < CONTROL_MAX_CLIENTS && !cl; i++) {
+            if (c->clients[i].fd < 0) cl = &c->clients[i];
+        }
+        struct epoll_event ev = { .events = EPOLLIN };
+        if (cl) ev.data.u64 = (uint64_t)(cl - c->clients);
+        if (!cl || epoll_ctl(c->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        cl->fd = fd;
+        cl->writing = 0;
+        cl->in_len = cl->out_len = cl->out_off = 0;
+    }
+}
+
+static void *control_thread(void *arg)
+{
+    struct control *c = arg;
+    struct epoll_event evs[16];
+
+    for (;;) {
+        int n = epoll_wait(c->epfd, evs, 16, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) {
+            int64_t tag = (int64_t)evs[i].data.u64;
+            if (tag == CONTROL_TAG_STOP) return NULL;
+            if (tag == CONTROL_TAG_LISTEN) {
+                accept_clients(c);
+                continue;
+            }
+            struct control_client *cl = &c->clients[tag];
+            int ok = !(evs[i].events & (EPOLLERR | EPOLLHUP)) || (evs[i].events & EPOLLIN);
+            if (ok && (evs[i].events & EPOLLOUT)) ok = flush_out(c, cl) && serve_lines(c, cl);
+            if (ok && (evs[i].events & EPOLLIN)) ok = read_client(c, cl);
+            if (!ok) drop_client(c, cl);
+        }
+    }
+    return NULL;
+}
+
+int control_remove_stale(const char *path)
+{
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    struct stat st;
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        errno = ENAMETOOLONG;
+        return 0;
+    }
+    strcpy(sa.sun_path, path);
+    if (lstat(path, &st) < 0) return errno == ENOENT;
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EEXIST;
+        return 0;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return 0;
+    int r = connect(fd, (const struct sockaddr *)&sa, sizeof(sa));
+    int saved = errno;
+    close(fd);
+    if (r == 0) {
+        errno = EADDRINUSE;
+        return 0;
+    }
+    if (saved != ECONNREFUSED) {
+        errno = saved;
+        return 0;
+    }
+    return unlink(path) == 0 || errno == ENOENT;
+}
+
+int control_start(struct control *c, const char *path, struct config_watch *config)
+{
+    memset(c, 0, sizeof(*c));
+    c->listen_fd = c->epfd = c->stop_fd = -1;
+    c->config = config;
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(sa.sun_path)) return 0;
+    strcpy(sa.sun_path, path);
+    strcpy(c->path, path);
+    if (!control_remove_stale(path)) return 0;
+
+    c->clients = malloc(CONTROL_MAX_CLIENTS * sizeof(*c->clients));
+    if (!c->clients) return 0;
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) c->clients[i].fd = -1;
+    pthread_mutex_init(&c->lock, NULL);
+
+    c->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    c->epfd = epoll_create1(EPOLL_CLOEXEC);
+    c->stop_fd = eventfd(0, EFD_CLOEXEC);
+    struct epoll_event lev = { .events = EPOLLIN, .data.u64 = (uint64_t)(int64_t)CONTROL_TAG_LISTEN };
+    struct epoll_event sev = { .events = EPOLLIN, .data.u64 = (uint64_t)(int64_t)CONTROL_TAG_STOP };
+    if (c->listen_fd < 0 || c->epfd < 0 || c->stop_fd < 0 ||
+        bind(c->listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+        listen(c->listen_fd, CONTROL_MAX_CLIENTS) < 0 ||
+        epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->listen_fd, &lev) < 0 ||
+        epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->stop_fd, &sev) < 0 ||
+        pthread_create(&c->thread, NULL, control_thread, c) != 0) {
+        int saved = errno;
+        if (c->listen_fd >= 0) close(c->listen_fd);
+        if (c->epfd >= 0) close(c->epfd);
+        if (c->stop_fd >= 0) close(c->stop_fd);
+        free(c->clients);
+        c->clients = NULL;
+        errno = saved;
+        return 0;
+    }
+    return 1;
+}
+
+void control_stop(struct control *c)
+{
+    if (!c->clients) return;
+    uint64_t one = 1;
+    if (write(c->stop_fd, &one, sizeof(one)) == sizeof(one)) pthread_join(c->thread, NULL);
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (c->clients[i].fd >= 0) close(c->clients[i].fd);
+    }
+    close(c->listen_fd);
+    close(c->epfd);
+    close(c->stop_fd);
+    unlink(c->path);
+    pthread_mutex_destroy(&c->lock);
+    free(c->clients);
+    c->clients = NULL;
+}
+
+int control_publish(struct control *c, const struct wifi_sample *s, const struct histogram *latency,
+                    const struct histogram *timeouts, const struct rule_set *rules,
+                    uint64_t config_generation)
+{
+    if (pthread_mutex_trylock(&c->lock) != 0) {
+        atomic_fetch_add_explicit(&c->skipped, 1, memory_order_relaxed);
+        return 0;
+    }
+    struct control_snapshot *snap = &c->snap;
+    snap->ticks++;
+    if (s) {
+        snap->sample = *s;
+        snap->have_sample = 1;
+    }
+    snap->latency = *latency;
+    snap->timeouts = *timeouts;
+    snap->config_generation = config_generation;
+
+    /* Names only change with the rule set; values change every tick. */
+    if (snap->names_of != rules || snap->names_gen != config_generation) {
+        snap->names_of = rules;
+        snap->names_gen = config_generation;
+        snap->naggs = rules->naggs < CONTROL_MAX_AGGS ? (uint32_t)rules->naggs : CONTROL_MAX_AGGS;
+        snap->nrules = rules->nrules < CONTROL_MAX_RULES ? (uint32_t)rules->nrules : CONTROL_MAX_RULES;
+        for (uint32_t i = 0; i < snap->naggs; i++) {
+            rules_agg_name(rules, i, snap->aggs[i].name, sizeof(snap->aggs[i].name));
+        }
+        for (uint32_t i = 0; i < snap->nrules; i++) {
+            memcpy(snap->rules[i].name, rules->rules[i].name, RULE_NAME_MAX);
+        }
+    }
+    for (uint32_t i = 0; i < snap->naggs; i++) snap->aggs[i].value = rules_agg_value(rules, i);
+    for (uint32_t i = 0; i < snap->nrules; i++) snap->rules[i].firing = rules->rules[i].firing;
+
+    pthread_mutex_unlock(&c->lock);
+    return 1;
+}
+
+int control_query(const char *path, const char *request, char *out, size_t size)
+{
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(sa.sun_path) || size == 0) return -1;
+    strcpy(sa.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    char line[CONTROL_LINE_MAX];
+    int n = snprintf(line, sizeof(line), "%s\n", request);
+    size_t len = 0;
+    int done = 0;
+    if (n > 0 && (size_t)n < sizeof(line) && send(fd, line, (size_t)n, MSG_NOSIGNAL) == n) {
+        while (!done && len + 1 < size) {
+            ssize_t r = recv(fd, out + len, size - 1 - len, 0);
+            if (r <= 0) break;
+            len += (size_t)r;
+            out[len] = '\0';
+            done = len >= 2 && strcmp(out + len - 2, "\n\n") == 0;
+        }
+    }
+    close(fd);
+    if (!done) return -1;
+    len--;
+    out[len] = '\0';
+    return (int)len;
+}
@@ -0,0 +1,106 @@
+#ifndef SNR_CONTROL_H
+#define SNR_CONTROL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/histogram.h"
+#include "../common/rules.h"
+#include "../common/sample.h"
+#include "config.h"
+
+#define CONTROL_MAX_CLIENTS 64
+#define CONTROL_MAX_AGGS 128
+#define CONTROL_MAX_RULES 256
+#define CONTROL_LINE_MAX 256
+#define CONTROL_OUT_MAX 32768
+
+/*
+ * Control socket protocol: one request per line, answered by "OK" or
+ * "ERR <reason>", zero or more "key value" lines, then an empty line.
+ * Requests may be pipelined on one connection.
+ *
+ *     PING              liveness
+ *     SAMPLE            latest sample and its health index
+ *     HIST              backend latency and deadline histograms
+ *     AGGS              current value of every rule window aggregate
+ *     RULES             every rule and whether it is firing
+ *     RELOAD            reparse the --config file now
+ *     FLUSH             flush the sinks on the next tick
+ */
+
+struct control_snapshot {
+    uint64_t ticks;
+    int have_sample;
+    struct wifi_sample sample;
+    struct histogram latency;
+    struct histogram timeouts;
+    uint64_t config_generation;
+    const struct rule_set *names_of;    /* rule set and generation the names */
+    uint64_t names_gen;                 /* below were copied from */
+    uint32_t naggs, nrules;
+    struct { char name[80]; float value; } aggs[CONTROL_MAX_AGGS];
+    struct { char name[RULE_NAME_MAX]; int firing; } rules[CONTROL_MAX_RULES];
+};
+
+struct control_client {
+    int fd;
+    int writing;                /* EPOLLOUT armed instead of EPOLLIN */
+    size_t in_len;
+    size_t out_len, out_off;
+    char in[CONTROL_LINE_MAX];
+    char out[CONTROL_OUT_MAX];
+};
+
+/*
+ * Served by one epoll thread. The sampler publishes with a trylock, so a
+ * slow query can cost it one stale snapshot but never a blocked tick.
+ */
+struct control {
+    char path[108];
+    int listen_fd;
+    int epfd;
+    int stop_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    struct control_snapshot snap;       /* guarded by lock */
+    struct config_watch *config;        /* NULL without --config */
+    _Atomic int flush_requested;
+    _Atomic uint64_t skipped;           /* publishes lost to a busy lock */
+    struct control_client *clients;     /* CONTROL_MAX_CLIENTS, fd -1 when free */
+};
+
+int control_start(struct control *c, const char *path, struct config_watch *config);
+void control_stop(struct control *c);
+
+/*
+ * Sampler side. Copies the tick's state if the snapshot is free and
+ * returns 1; returns 0 without waiting if a request is reading it.
+ */
+int control_publish(struct control *c, const struct wifi_sample *s, const struct histogram *latency,
+                    const struct histogram *timeouts, const struct rule_set *rules,
+                    uint64_t config_generation);
+
+/* Returns and clears a pending FLUSH request. */
+static inline int control_take_flush(struct control *c)
+{
+    return atomic_exchange_explicit(&c->flush_requested, 0, memory_order_relaxed);
+}
+
+/*
+ * Clears the way to bind a Unix socket at path. A socket left by a crashed
+ * run is removed, but only when it is a socket nobody accepts on: a
+ * regular file given by mistake fails with EEXIST and a running instance
+ * with EADDRINUSE. Nothing at path is success.
+ */
+int control_remove_stale(const char *path);
+
+/*
+ * Client side: sends one request and reads its response (without the
+ * terminating empty line) into out. Returns the length, or -1.
+ */
+int control_query(const char *path, const char *request, char *out, size_t size);
+
+#endif
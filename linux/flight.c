@@ -0,0 +1,192 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "flight.h"
+
+#define FLIGHT_MIN_RECORDS 16
+
+_Static_assert(sizeof(struct flight_header) == FLIGHT_RECORD_SIZE, "flight header size");
+_Static_assert(sizeof(struct flight_record) == FLIGHT_RECORD_SIZE, "flight record size");
+
+static int header_matches(const struct flight_header *h, uint32_t capacity)
+{
+    return memcmp(h->magic, FLIGHT_MAGIC, sizeof(FLIGHT_MAGIC)) == 0 &&
+           h->record_size == FLIGHT_RECORD_SIZE && h->capacity == capacity;
+}
+
+static void *sync_thread(void *arg)
+{
+    struct flight *f = arg;
+    struct pollfd pfd = { f->stop_fd, POLLIN, 0 };
+
+    for (;;) {
+        int rc = poll(&pfd, 1, FLIGHT_SYNC_MS);
+        if ((rc < 0 && errno != EINTR) || rc > 0) break;
+        msync(f->header, f->map_len, MS_SYNC);
+    }
+    return NULL;
+}
+
+int flight_open(struct flight *f, const char *path, const char *ifname, unsigned minutes,
+                unsigned interval_ms)
+{
+    memset(f, 0, sizeof(*f));
+    f->stop_fd = -1;
+    uint64_t want = (uint64_t)minutes * 60000u / (interval_ms ? interval_ms : 1);
+    f->capacity = want < FLIGHT_MIN_RECORDS ? FLIGHT_MIN_RECORDS : want > UINT32_MAX / 2 ? UINT32_MAX / 2 : (uint32_t)want;
+    f->map_len = (size_t)(f->capacity + 1) * FLIGHT_RECORD_SIZE;
+
+    f->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (f->fd < 0) return 0;
+
+    struct flight_header old = {0};
+    struct stat st = {0};
+    int recording = fstat(f->fd, &st) == 0 && pread(f->fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+                    header_matches(&old, old.capacity);
+    int reuse = recording && old.capacity == f->capacity && (size_t)st.st_size == f->map_len;
+    if (recording && !reuse) {
+        /* A recording with other geometry is still evidence: set it aside. */
+        char prev[4096];
+        snprintf(prev, sizeof(prev), "%s.prev", path);
+        close(f->fd);
+        if (rename(path, prev) < 0) return 0;
+        f->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (f->fd < 0) return 0;
+    }
+    if (!reuse) {
+        /* Blocks are reserved now so a full disk cannot SIGBUS a later write. */
+        int rc = ftruncate(f->fd, 0) == 0 ? posix_fallocate(f->fd, 0, (off_t)f->map_len) : errno;
+        if (rc != 0) {
+            close(f->fd);
+            errno = rc;
+            return 0;
+        }
+    }
+
+    void *map = mmap(NULL, f->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED) {
+        close(f->fd);
+        return 0;
+    }
+    f->header = map;
+    f->records = (struct flight_record *)((char *)map + FLIGHT_RECORD_SIZE);
+
+    if (reuse) {
+        uint64_t last = 0;
+        for (uint32_t i = 0; i < f->capacity; i++) {
+            uint64_t seq = atomic_load_explicit(&f->records[i].seq, memory_order_relaxed);
+            if (seq > last) last = seq;
+        }
+        f->next_seq = last + 1;
+    } else {
+        struct flight_header h = { .record_size = FLIGHT_RECORD_SIZE, .capacity = f->capacity,
+                                   .interval_ms = interval_ms, .created_ns = wall_ns() };
+        memcpy(h.magic, FLIGHT_MAGIC, sizeof(FLIGHT_MAGIC));
+        snprintf(h.ifname, sizeof(h.ifname), "%s", ifname);
+        memcpy(f->header, &h, sizeof(h));
+        f->next_seq = 1;
+        msync(map, f->map_len, MS_SYNC);
+    }
+
+    f->stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (f->stop_fd < 0 || pthread_create(&f->thread, NULL, sync_thread, f) != 0) {
+        int saved = errno;
+        if (f->stop_fd >= 0) close(f->stop_fd);
+        munmap(map, f->map_len);
+        close(f->fd);
+        errno = saved;
+        return 0;
+    }
+    return 1;
+}
+
+void flight_close(struct flight *f)
+{
+    if (!f->header) return;
+    uint64_t one = 1;
+    if (write(f->stop_fd, &one, sizeof(one)) == sizeof(one)) pthread_join(f->thread, NULL);
+    close(f->stop_fd);
+    msync(f->header, f->map_len, MS_SYNC);
+    munmap(f->header, f->map_len);
+    close(f->fd);
+    f->header = NULL;
+}
+
+int flight_read(const char *path, struct flight_tail *t, char *err, size_t err_size)
+{
+    memset(t, 0, sizeof(*t));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st = {0};
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        snprintf(err, err_size, "%s", strerror(errno));
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    if (pread(fd, &t->header, sizeof(t->header), 0) != (ssize_t)sizeof(t->header) ||
+        !header_matches(&t->header, t->header.capacity) || t->header.capacity == 0 ||
+        (uint64_t)st.st_size != (uint64_t)(t->header.capacity + 1) * FLIGHT_RECORD_SIZE) {
+        snprintf(err, err_size, "not a flight recorder file");
+        close(fd);
+        return 0;
+    }
+
+    uint32_t cap = t->header.capacity;
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    t->records = malloc((size_t)cap * sizeof(*t->records));
+    if (map == MAP_FAILED || !t->records) {
+        snprintf(err, err_size, "%s", strerror(errno));
+        if (map != MAP_FAILED) munmap(map, len);
+        free(t->records);
+        t->records = NULL;
+        return 0;
+    }
+    const struct flight_record *ring = (const struct flight_record *)((const char *)map + FLIGHT_RECORD_SIZE);
+
+    uint64_t last = 0;
+    for (uint32_t i = 0; i < cap; i++) {
+        uint64_t seq = atomic_load_explicit(&ring[i].seq, memory_order_acquire);
+        if (seq) t->valid++;
+        if (seq > last) last = seq;
+    }
+
+    /*
+     * Walk back from the newest record while each slot holds the number
+     * expected there. The second load catches a live writer that reused
+     * the slot during the copy.
+     */
+    size_t n = 0;
+    for (uint64_t seq = last; seq != 0 && n < cap; seq--) {
+        const struct flight_record *r = &ring[seq % cap];
+        struct flight_record *out = &t->records[cap - 1 - n];
+        if (atomic_load_explicit(&r->seq, memory_order_acquire) != seq) break;
+        memcpy(out, r, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&r->seq, memory_order_relaxed) != seq) break;
+        n++;
+    }
+    munmap(map, len);
+
+    memmove(t->records, t->records + (cap - n), n * sizeof(*t->records));
+    t->n = n;
+    t->last_seq = last;
+    t->first_seq = n ? last - n + 1 : 0;
+    return 1;
+}
+
+void flight_tail_free(struct flight_tail *t)
+{
+    free(t->records);
+    t->records = NULL;
+    t->n = 0;
+}
@@ -0,0 +1,94 @@
+#ifndef SNR_FLIGHT_H
+#define SNR_FLIGHT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/sample.h"
+
+#define FLIGHT_MAGIC "SNRFLT1"
+#define FLIGHT_RECORD_SIZE 128
+#define FLIGHT_SYNC_MS 1000
+
+/*
+ * Flight recorder: a fixed-size file, mapped shared, holding the newest
+ * samples in a ring. Each record carries a sequence number that is zeroed
+ * before the payload is copied and stored (release) after it, so after a
+ * crash a record is either complete with its own number or visibly not.
+ * Records are 128 bytes and aligned, so none spans a sector or a page.
+ *
+ * A reader reconstructs the tail from the highest sequence number found
+ * backwards through consecutive numbers in their expected slots. That stops
+ * at the record being written when the process died, and at a page the
+ * kernel had not written back when the machine died, so what it returns is
+ * always a run of records that really were consecutive.
+ */
+struct flight_header {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t capacity;          /* records in the ring */
+    uint32_t interval_ms;       /* sampling interval when the file was created */
+    uint32_t reserved;
+    uint64_t created_ns;        /* wall clock */
+    char ifname[32];
+    uint8_t pad[FLIGHT_RECORD_SIZE - 64];
+};
+
+struct flight_record {
+    _Atomic uint64_t seq;       /* 0 while the record is being written */
+    uint64_t backend_ns;        /* duration of the backend call */
+    int32_t rc;                 /* 1 sample, 0 unavailable, SAMPLE_TIMEOUT */
+    uint32_t reserved;
+    struct wifi_sample sample;
+    uint8_t pad[FLIGHT_RECORD_SIZE - 24 - sizeof(struct wifi_sample)];
+};
+
+struct flight {
+    int fd;
+    int stop_fd;
+    pthread_t thread;           /* msyncs the map so a machine crash loses at most FLIGHT_SYNC_MS */
+    size_t map_len;
+    struct flight_header *header;
+    struct flight_record *records;
+    uint32_t capacity;
+    uint64_t next_seq;
+};
+
+/*
+ * Opens or creates path sized for minutes of samples at interval_ms. An
+ * existing file with the same geometry is continued from its highest
+ * sequence number; anything else is reinitialised.
+ */
+int flight_open(struct flight *f, const char *path, const char *ifname, unsigned minutes,
+                unsigned interval_ms);
+void flight_close(struct flight *f);
+
+/* Sampler side: one memcpy into the mapping, no system call. */
+static inline void flight_write(struct flight *f, const struct wifi_sample *s, uint64_t backend_ns, int rc)
+{
+    uint64_t seq = f->next_seq++;
+    struct flight_record *r = &f->records[seq % f->capacity];
+    atomic_store_explicit(&r->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    r->backend_ns = backend_ns;
+    r->rc = rc;
+    r->sample = *s;
+    atomic_store_explicit(&r->seq, seq, memory_order_release);
+}
+
+/* Post-mortem side. */
+struct flight_tail {
+    struct flight_header header;
+    struct flight_record *records;      /* oldest first, malloc'd */
+    size_t n;
+    size_t valid;                       /* records with any sequence number */
+    uint64_t first_seq, last_seq;
+};
+
+/* Copies the consistent tail out of path; works on a live file too. */
+int flight_read(const char *path, struct flight_tail *t, char *err, size_t err_size);
+void flight_tail_free(struct flight_tail *t);
+
+#endif
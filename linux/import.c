@@ -0,0 +1,504 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/health.h"
+#include "clock.h"
+#include "import.h"
+#include "ingest.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define IMPORT_HAVE_AVX2 1
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+#define NETSH_NOISE_DBM (-95)   /* what poc.c assumes; netsh has no noise reading */
+#define POC_SSID_WIDTH 20
+#define IMPORT_SCORE_BATCH 256  /* rows without a health column, scored together */
+#define IMPORT_MERGE_RING 4096  /* samples per file in flight through the merge */
+#define IMPORT_MERGE_BATCH 1024
+
+/* --- line breaks --- */
+
+/* Eight bytes at a time: a byte is a break when its XOR with '\r' or '\n' is zero. */
+static const char *scan_portable(const char *p, const char *end)
+{
+    const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; end - p >= 8; p += 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        uint64_t cr = w ^ (ones * '\r'), lf = w ^ (ones * '\n');
+        /* Borrows can flag bytes above a real zero, never below: the lowest flag is exact. */
+        uint64_t hit = (((cr - ones) & ~cr) | ((lf - ones) & ~lf)) & highs;
+        if (hit) return p + __builtin_ctzll(hit) / 8;
+    }
+#else
+    (void)ones;
+    (void)highs;
+#endif
+    while (p < end && *p != '\r' && *p != '\n') p++;
+    return p;
+}
+
+#ifdef IMPORT_HAVE_AVX2
+static AVX2 const char *scan_avx2(const char *p, const char *end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r'), lf = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(const void *)p);
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return scan_portable(p, end);
+}
+#endif
+
+import_scan_fn import_scanner(int simd)
+{
+#ifdef IMPORT_HAVE_AVX2
+    if (simd && __builtin_cpu_supports("avx2")) return scan_avx2;
+#endif
+    (void)simd;
+    return scan_portable;
+}
+
+/* --- fields --- */
+
+static int digit(char c)
+{
+    return (unsigned)(c - '0') <= 9;
+}
+
+/* HH:MM:SS at p (8 bytes): seconds into the day, or -1. */
+static int clock_at(const char *p)
+{
+    for (int i = 0; i < 8; i++) {
+        if (i == 2 || i == 5 ? p[i] != ':' : !digit(p[i])) return -1;
+    }
+    int h = (p[0] - '0') * 10 + p[1] - '0', m = (p[3] - '0') * 10 + p[4] - '0', s = (p[6] - '0') * 10 + p[7] - '0';
+    if (h > 23 || m > 59 || s > 60) return -1;
+    return h * 3600 + m * 60 + (s == 60 ? 59 : s);
+}
+
+/* Spaces, an optional sign, digits and at most one decimal that counts: the number in tenths. */
+static const char *tenths(const char *p, const char *end, int *out)
+{
+    if (!p) return NULL;
+    while (p < end && *p == ' ') p++;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    const char *first = p;
+    int v = 0;
+    while (p < end && digit(*p) && v < 10000000) v = v * 10 + (*p++ - '0');
+    if (p == first) return NULL;
+    v *= 10;
+    if (p < end && *p == '.') {
+        p++;
+        if (p < end && digit(*p)) v += *p++ - '0';
+        while (p < end && digit(*p)) p++;
+    }
+    *out = neg ? -v : v;
+    return p;
+}
+
+static const char *lit(const char *p, const char *end, const char *s, size_t n)
+{
+    return p && (size_t)(end - p) >= n && memcmp(p, s, n) == 0 ? p + n : NULL;
+}
+
+#define LIT(p, end, s) lit(p, end, s, sizeof(s) - 1)
+
+/* poc.c's "NNN% (+xx.x dBm) | xx.x dB": signal and SNR in tenths. */
+static const char *netsh_signal(const char *p, const char *end, int *signal, int *snr)
+{
+    int pct;
+    p = LIT(tenths(p, end, &pct), end, "% (");
+    p = LIT(tenths(p, end, signal), end, " dBm) | ");
+    return LIT(tenths(p, end, snr), end, " dB");
+}
+
+/* --- lines --- */
+
+struct parser {
+    struct import_file *f;
+    const char *ssid;           /* the last SSID field, in the mapping */
+    uint32_t ssid_id;
+    int prev_sod;
+    unsigned day;
+    /* Rows to score: indexes into f->s, since add may move them, and their SNR. */
+    size_t pending, row[IMPORT_SCORE_BATCH];
+    float snr[IMPORT_SCORE_BATCH], none[IMPORT_SCORE_BATCH], health[IMPORT_SCORE_BATCH];
+};
+
+/* A zeroed sample at sod on the capture's current day; ts_ns is in seconds from the first day until dated. */
+static struct wifi_sample *add(struct parser *ps, int sod)
+{
+    struct import_file *f = ps->f;
+    if (f->n == f->cap) {
+        size_t cap = f->cap ? f->cap * 2 : 4096;
+        struct wifi_sample *s = realloc(f->s, cap * sizeof(*s));
+        if (!s) return NULL;
+        f->s = s;
+        f->cap = cap;
+    }
+    if (ps->prev_sod >= 0 && sod + IMPORT_ROLLOVER_S < ps->prev_sod) ps->day++;
+    ps->prev_sod = sod;
+    struct wifi_sample *s = &f->s[f->n++];
+    memset(s, 0, sizeof(*s));
+    s->ts_ns = (uint64_t)ps->day * 86400 + (uint64_t)sod;
+    return s;
+}
+
+static void score_pending(struct parser *ps)
+{
+    struct health_columns c = { ps->snr, ps->none, ps->none, ps->none };
+    health_score_batch(&health_default_weights, &c, ps->health, ps->pending);
+    for (size_t i = 0; i < ps->pending; i++) ps->f->s[ps->row[i]].health = ps->health[i];
+    ps->pending = 0;
+}
+
+/* Queues the row just added for health_score_batch; the captures only give its SNR. */
+static void score_later(struct parser *ps, float snr)
+{
+    if (ps->pending == IMPORT_SCORE_BATCH) score_pending(ps);
+    ps->row[ps->pending] = ps->f->n - 1;
+    ps->snr[ps->pending++] = snr;
+}
+
+/* The padded SSID column at p; consecutive rows mostly repeat it, so compare before hashing. */
+static void set_ssid(struct parser *ps, struct wifi_sample *s, const char *p)
+{
+    if (!ps->ssid || memcmp(p, ps->ssid, POC_SSID_WIDTH) != 0) {
+        size_t len = POC_SSID_WIDTH;
+        while (len && p[len - 1] == ' ') len--;
+        int hidden = len == 14 && memcmp(p, "Hidden/Unknown", 14) == 0;
+        ps->ssid = p;
+        ps->ssid_id = len && !hidden ? intern_put(&ps->f->ssids, p, len) : 0;
+    }
+    s->ssid_id = ps->ssid_id;
+    if (s->ssid_id) s->fields |= FIELD_SSID;
+}
+
+/* netsh-derived readings as poc.c turned them into a sample. */
+static void set_netsh(struct wifi_sample *s, int signal)
+{
+    s->fields |= FIELD_SIGNAL | FIELD_NOISE | FIELD_HEALTH;
+    s->signal_dbm = (int8_t)(signal / 10);
+    s->noise_dbm = NETSH_NOISE_DBM;
+}
+
+/* 1 for a sample, 0 for a line in no known layout, -1 when out of memory. */
+static int parse_line(struct parser *ps, const char *line, size_t len)
+{
+    const char *end = line + len, *p;
+    int sod, signal, snr, health, rx, tx, noise;
+    struct wifi_sample *s;
+    if (len < 11 || (sod = clock_at(line)) < 0 || memcmp(line + 8, " | ", 3) != 0) return 0;
+
+    /* poc.c: health, SSID, signal, SNR and rates. */
+    if (len > 43 && memcmp(line + 17, " | ", 3) == 0 && memcmp(line + 40, " | ", 3) == 0 &&
+        tenths(line + 11, line + 17, &health) == line + 17 &&
+        (p = LIT(netsh_signal(line + 43, end, &signal, &snr), end, " | ")) &&
+        (p = LIT(tenths(p, end, &rx), end, "/")) && tenths(p, end, &tx)) {
+        if (!(s = add(ps, sod))) return -1;
+        set_netsh(s, signal);
+        set_ssid(ps, s, line + 20);
+        s->health = health / 10.0f;
+        s->rx_bitrate_kbps = (uint32_t)(rx > 0 ? rx * 100 : 0);
+        s->tx_bitrate_kbps = (uint32_t)(tx > 0 ? tx * 100 : 0);
+        if (s->rx_bitrate_kbps) s->fields |= FIELD_RX_BITRATE;
+        if (s->tx_bitrate_kbps) s->fields |= FIELD_TX_BITRATE;
+        return 1;
+    }
+
+    /* poc.c before the health index: SSID, signal and SNR. */
+    if (len > 34 && memcmp(line + 31, " | ", 3) == 0 && netsh_signal(line + 34, end, &signal, &snr)) {
+        if (!(s = add(ps, sod))) return -1;
+        set_netsh(s, signal);
+        set_ssid(ps, s, line + 11);
+        score_later(ps, snr / 10.0f);
+        return 1;
+    }
+
+    /* poc.c's record of a netsh call that missed its deadline. */
+    if (LIT(line + 8, end, " | GAP: ")) {
+        if (!(s = add(ps, sod))) return -1;
+        s->fields = FIELD_GAP;
+        return 1;
+    }
+
+    /* Poc.py: signal and noise; its SNR column is smoothed, so it is recomputed. */
+    if ((p = LIT(tenths(line + 11, end, &signal), end, " dBm | "))) {
+        if (!(s = add(ps, sod))) return -1;
+        s->fields = FIELD_SIGNAL | FIELD_HEALTH;
+        s->signal_dbm = (int8_t)(signal / 10);
+        if (LIT(tenths(p, end, &noise), end, " dBm")) {
+            s->fields |= FIELD_NOISE;
+            s->noise_dbm = (int8_t)(noise / 10);
+        }
+        score_later(ps, sample_snr(s));
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Turns the day-relative seconds into ts_ns. The last row is the last
+ * time it names at or before the mtime; earlier days count back from it.
+ */
+static void date_samples(struct import_file *f)
+{
+    time_t mtime = (time_t)(f->mtime_ns / 1000000000ull);
+    struct tm m;
+    localtime_r(&mtime, &m);
+    uint64_t last = f->s[f->n - 1].ts_ns, mtime_sod = (uint64_t)(m.tm_hour * 3600 + m.tm_min * 60 + m.tm_sec);
+    struct tm date = { .tm_year = m.tm_year, .tm_mon = m.tm_mon, .tm_mday = m.tm_mday };
+    int64_t first_day = (int64_t)(timegm(&date) / 86400) - (last % 86400 > mtime_sod) - (int64_t)(last / 86400);
+    f->days = (unsigned)(last / 86400) + 1;
+
+    int64_t day = INT64_MIN;
+    time_t midnight = 0;
+    int steady = 1;
+    for (size_t i = 0; i < f->n; i++) {
+        int64_t k = first_day + (int64_t)(f->s[i].ts_ns / 86400);
+        int sod = (int)(f->s[i].ts_ns % 86400);
+        if (k != day) {
+            time_t t = (time_t)(k * 86400);
+            gmtime_r(&t, &date);
+            struct tm start = date, stop = date;
+            start.tm_isdst = stop.tm_isdst = -1;
+            stop.tm_hour = 23;
+            stop.tm_min = stop.tm_sec = 59;
+            midnight = mktime(&start);
+            /* Only a day the clocks change on needs mktime per row. */
+            steady = mktime(&stop) - midnight == 86399;
+            day = k;
+        }
+        time_t at = midnight + sod;
+        if (!steady) {
+            struct tm l = date;
+            l.tm_hour = sod / 3600;
+            l.tm_min = sod / 60 % 60;
+            l.tm_sec = sod % 60;
+            l.tm_isdst = -1;
+            at = mktime(&l);
+        }
+        f->s[i].ts_ns = (uint64_t)at * 1000000000ull;
+    }
+}
+
+void import_parse(struct import_file *f)
+{
+    f->ok = 0;
+    int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) < 0) {
+        snprintf(f->err, sizeof(f->err), "%s", strerror(errno));
+        if (fd >= 0) close(fd);
+        return;
+    }
+    f->mtime_ns = (uint64_t)sb.st_mtim.tv_sec * 1000000000ull + (uint64_t)sb.st_mtim.tv_nsec;
+    f->bytes = (uint64_t)sb.st_size;
+    const char *map = NULL;
+    if (sb.st_size > 0) {
+        void *m = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            snprintf(f->err, sizeof(f->err), "%s", strerror(errno));
+            close(fd);
+            return;
+        }
+        madvise(m, (size_t)sb.st_size, MADV_SEQUENTIAL);
+        map = m;
+    }
+    close(fd);
+
+    import_scan_fn scan = import_scanner(1);
+    struct parser ps = { .f = f, .prev_sod = -1 };
+    for (size_t i = 0; i < IMPORT_SCORE_BATCH; i++) ps.none[i] = -1.0f;
+    int ok = 1;
+    for (const char *p = map, *end = map + f->bytes; ok && p < end;) {
+        const char *brk = scan(p, end);
+        if (brk > p) {
+            f->lines++;
+            int r = parse_line(&ps, p, (size_t)(brk - p));
+            f->skipped += r == 0;
+            ok = r >= 0;
+        }
+        p = brk < end ? brk + 1 : end;
+    }
+    if (ok) score_pending(&ps);
+    if (map) munmap((void *)map, (size_t)sb.st_size);
+    if (!ok) {
+        snprintf(f->err, sizeof(f->err), "out of memory");
+        return;
+    }
+    if (f->n) date_samples(f);
+    f->ok = 1;
+}
+
+void import_file_free(struct import_file *f)
+{
+    free(f->s);
+    intern_free(&f->ssids);
+    f->s = NULL;
+    f->n = f->cap = 0;
+}
+
+/* --- batches --- */
+
+static void parse_task(struct pool_task *t)
+{
+    import_parse(t->arg);
+}
+
+static int older(const void *a, const void *b)
+{
+    const struct import_file *x = a, *y = b;
+    return x->mtime_ns < y->mtime_ns ? -1 : x->mtime_ns > y->mtime_ns;
+}
+
+/* Moves f's SSID IDs from the file's table to intern_global. */
+static void globalise_ssids(struct import_file *f)
+{
+    uint32_t *global = calloc((size_t)f->ssids.count + 1, sizeof(*global));
+    for (size_t i = 0; i < f->n; i++) {
+        struct wifi_sample *s = &f->s[i];
+        if (!(s->fields & FIELD_SSID)) continue;
+        uint32_t id = s->ssid_id;
+        if (global && !global[id]) global[id] = intern_put(&intern_global, intern_str(&f->ssids, id),
+                                                              intern_len(&f->ssids, id));
+        s->ssid_id = global ? global[id] : 0;
+        if (!s->ssid_id) s->fields &= ~FIELD_SSID;
+    }
+    free(global);
+}
+
+static int by_time(const void *a, const void *b)
+{
+    const struct wifi_sample *x = a, *y = b;
+    return x->ts_ns < y->ts_ns ? -1 : x->ts_ns > y->ts_ns;
+}
+
+static void deliver(const struct wifi_sample *s, size_t n, struct sink *k, struct import_stats *st)
+{
+    for (size_t i = 0; i < n; i++) {
+        k->sample(k, &s[i]);
+        if (s[i].ts_ns < st->first_ns) st->first_ns = s[i].ts_ns;
+        if (s[i].ts_ns > st->last_ns) st->last_ns = s[i].ts_ns;
+    }
+}
+
+/*
+ * Passes the samples of a batch's parsed files to k in time order across
+ * the files, so captures that overlap (two consoles, one laptop) reach
+ * the store interleaved rather than one after the other. Each file is a
+ * producer of an ingest merge; a clock set back inside a capture is the
+ * only thing that needs a sort first. Out of memory, the files go whole,
+ * oldest first.
+ */
+static void write_batch(struct import_file *files, size_t n, struct sink *k, struct import_stats *st)
+{
+    struct ingest q;
+    size_t *next = calloc(n, sizeof(*next));
+    struct wifi_sample *out = malloc(IMPORT_MERGE_BATCH * sizeof(*out));
+    int merge = next && out && ingest_init(&q, (unsigned)n, IMPORT_MERGE_RING);
+    size_t open = 0;
+    for (size_t i = 0; i < n; i++) {
+        struct import_file *f = &files[i];
+        if (!f->ok) continue;
+        globalise_ssids(f);
+        if (!merge) {
+            deliver(f->s, f->n, k, st);
+            continue;
+        }
+        size_t j = 1;
+        while (j < f->n && f->s[j - 1].ts_ns <= f->s[j].ts_ns) j++;
+        if (j < f->n) qsort(f->s, f->n, sizeof(*f->s), by_time);
+        open++;
+    }
+    if (merge) {
+        for (size_t i = 0; i < n; i++) {
+            if (!files[i].ok) ingest_close(&q, (unsigned)i);
+        }
+        /* One thread plays every producer: fill each ring, then drain what the watermark lets through. */
+        while (open) {
+            for (size_t i = 0; i < n; i++) {
+                struct import_file *f = &files[i];
+                if (!f->ok || next[i] > f->n) continue;
+                while (next[i] < f->n && ingest_push(&q, (unsigned)i, &f->s[next[i]])) next[i]++;
+                if (next[i] == f->n) {
+                    ingest_close(&q, (unsigned)i);
+                    next[i]++;
+                    open--;
+                }
+            }
+            for (size_t m; (m = ingest_drain(&q, out, IMPORT_MERGE_BATCH)) > 0;) deliver(out, m, k, st);
+        }
+        for (size_t m; (m = ingest_drain(&q, out, IMPORT_MERGE_BATCH)) > 0;) deliver(out, m, k, st);
+        ingest_free(&q);
+    }
+    free(next);
+    free(out);
+}
+
+int import_run(struct pool *p, const char *const *paths, size_t n, struct sink *k,
+               void (*report)(const struct import_file *f, void *ctx), void *ctx, struct import_stats *stats)
+{
+    struct import_stats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    stats->first_ns = UINT64_MAX;
+    uint64_t t0 = mono_ns();
+    struct import_file *files = calloc(n ? n : 1, sizeof(*files));
+    if (!files) return 0;
+
+    /* Oldest capture first, so the store's hourly files are mostly appended in order. */
+    for (size_t i = 0; i < n; i++) {
+        struct stat sb;
+        files[i].path = paths[i];
+        if (stat(paths[i], &sb) == 0) {
+            files[i].mtime_ns = (uint64_t)sb.st_mtim.tv_sec * 1000000000ull + (uint64_t)sb.st_mtim.tv_nsec;
+        }
+    }
+    qsort(files, n, sizeof(*files), older);
+
+    /* A batch per worker keeps at most that many parsed files in memory. */
+    size_t batch = p && p->nworkers ? p->nworkers : 1;
+    for (size_t first = 0; first < n; first += batch) {
+        size_t last = first + batch < n ? first + batch : n;
+        struct pool_group group = {0};
+        for (size_t i = first; i < last; i++) {
+            files[i].task = (struct pool_task){ .fn = parse_task, .arg = &files[i] };
+            if (p) pool_submit(p, &files[i].task, POOL_BACKGROUND, &group);
+            else import_parse(&files[i]);
+        }
+        if (p) pool_wait(p, &group);
+
+        write_batch(&files[first], last - first, k, stats);
+        for (size_t i = first; i < last; i++) {
+            struct import_file *f = &files[i];
+            stats->files++;
+            stats->bytes += f->bytes;
+            stats->lines += f->lines;
+            stats->skipped += f->skipped;
+            if (f->ok) stats->samples += f->n;
+            else stats->failed++;
+            if (report) report(f, ctx);
+            import_file_free(f);
+        }
+        if (k->flush) k->flush(k);
+    }
+    free(files);
+    stats->elapsed_ns = mono_ns() - t0;
+    return stats->failed == 0;
+}
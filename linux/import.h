@@ -0,0 +1,74 @@
+#ifndef SNR_IMPORT_H
+#define SNR_IMPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/intern.h"
+#include "../common/sample.h"
+#include "../common/sink.h"
+#include "pool.h"
+
+/*
+ * Importer for console captures of the older tools, in three layouts:
+ *
+ *     12:00:01 | HomeNet              |  78% (-61.0 dBm) |  34.0 dB | AI
+ *     12:00:01 |   71.4 | HomeNet              |  78% (-61.0 dBm) |  34.0 dB |  144.4/144.4  | FAIR
+ *     12:00:01 | -61 dBm | -95 dBm | 34.0 dB |  80 cm | NORMAL RANGE (0.5-2 m)
+ *
+ * from poc.c before the health index, poc.c, and Poc.py.
+ *
+ * The tools redraw one row with "\r", so a capture is split on both "\r"
+ * and "\n". The file is mapped, the breaks are found 32 bytes at a time
+ * with AVX2 (8 at a time in portable C), and the fields are read at
+ * their fixed offsets by hand. Lines that fit no layout, such as banners
+ * and "Not connected" rows, are counted and skipped. A poc.c GAP row
+ * becomes a FIELD_GAP sample.
+ *
+ * The rows only carry the local time of day. The date comes from the
+ * file: its mtime is taken as the time of the last row, and each time the
+ * clock goes back by more than 12 hours a new day has started. A capture
+ * that was copied without its mtime (cp without -p) lands on the wrong
+ * dates; touch -d fixes that. A laptop asleep for a whole day is invisible.
+ */
+
+#define IMPORT_ROLLOVER_S 43200     /* a step back this large is midnight, a smaller one a clock change */
+
+struct import_file {
+    const char *path;
+    struct pool_task task;
+    int ok;
+    char err[160];
+    uint64_t mtime_ns;
+    struct wifi_sample *s;      /* SSID IDs are in ssids until import_run writes them */
+    size_t n, cap;
+    struct intern ssids;
+    uint64_t bytes, lines, skipped;
+    unsigned days;              /* calendar days the capture spans */
+};
+
+struct import_stats {
+    unsigned files, failed;
+    uint64_t bytes, lines, samples, skipped;
+    uint64_t first_ns, last_ns; /* of all samples written */
+    uint64_t elapsed_ns;
+};
+
+/* Parses f->path into f->s; sets f->ok, or f->err. Any thread may parse its own import_file. */
+void import_parse(struct import_file *f);
+void import_file_free(struct import_file *f);
+
+/*
+ * Parses paths on p's background lane, a batch of files per worker at a
+ * time, and writes each batch's samples to k merged in time order. p may be
+ * NULL to parse on the calling thread. report, if not NULL, is called for
+ * each file after its samples were written. Returns 0 if any file failed.
+ */
+int import_run(struct pool *p, const char *const *paths, size_t n, struct sink *k,
+               void (*report)(const struct import_file *f, void *ctx), void *ctx, struct import_stats *stats);
+
+/* The line-break scanner: the widest the CPU has, or the portable one. Returns end if there is none. */
+typedef const char *(*import_scan_fn)(const char *p, const char *end);
+import_scan_fn import_scanner(int simd);
+
+#endif
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ingest.h"
+
+int ingest_init(struct ingest *q, unsigned producers, size_t capacity)
+{
+    memset(q, 0, sizeof(*q));
+    size_t cap = 2;
+    while (cap < capacity) cap *= 2;
+    void *mem = NULL;
+    if (posix_memalign(&mem, 64, producers * sizeof(struct ingest_ring)) != 0) return 0;
+    memset(mem, 0, producers * sizeof(struct ingest_ring));
+    q->rings = mem;
+    q->producers = producers;
+    q->mask = cap - 1;
+    q->heap = malloc(producers * sizeof(*q->heap));
+    if (!q->heap) {
+        ingest_free(q);
+        return 0;
+    }
+    for (unsigned p = 0; p < producers; p++) {
+        if (!(q->rings[p].slots = malloc(cap * sizeof(struct wifi_sample)))) {
+            ingest_free(q);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void ingest_free(struct ingest *q)
+{
+    for (unsigned p = 0; q->rings && p < q->producers; p++) free(q->rings[p].slots);
+    free(q->rings);
+    free(q->heap);
+    memset(q, 0, sizeof(*q));
+}
+
+int ingest_push(struct ingest *q, unsigned p, const struct wifi_sample *s)
+{
+    struct ingest_ring *r = &q->rings[p];
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail - r->head_cache > q->mask) {
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (tail - r->head_cache > q->mask) {
+            r->refused++;
+            return 0;
+        }
+    }
+    r->slots[tail & q->mask] = *s;
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    /* After the tail: progress seen by the consumer implies the sample is too. */
+    atomic_store_explicit(&r->progress, s->ts_ns, memory_order_release);
+    return 1;
+}
+
+void ingest_idle(struct ingest *q, unsigned p, uint64_t ts_ns)
+{
+    struct ingest_ring *r = &q->rings[p];
+    if (ts_ns > atomic_load_explicit(&r->progress, memory_order_relaxed)) {
+        atomic_store_explicit(&r->progress, ts_ns, memory_order_release);
+    }
+}
+
+void ingest_close(struct ingest *q, unsigned p)
+{
+    atomic_store_explicit(&q->rings[p].progress, UINT64_MAX, memory_order_release);
+}
+
+/* ts_ns of ring r's oldest undelivered sample if it is at most bound, else UINT64_MAX. */
+static uint64_t head_ts(struct ingest *q, struct ingest_ring *r, uint64_t head, uint64_t bound)
+{
+    if (head == r->tail_cache) {
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head == r->tail_cache) return UINT64_MAX;
+    }
+    uint64_t ts = r->slots[head & q->mask].ts_ns;
+    return ts <= bound ? ts : UINT64_MAX;
+}
+
+static void sift_down(struct ingest_head *h, size_t n, size_t i)
+{
+    struct ingest_head x = h[i];
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && h[c + 1].ts < h[c].ts) c++;
+        if (x.ts <= h[c].ts) break;
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = x;
+}
+
+static size_t drain(struct ingest *q, struct wifi_sample *out, size_t max, int watermark)
+{
+    /* The bound is read before the tails, so every sample up to it is visible. */
+    uint64_t bound = UINT64_MAX;
+    for (unsigned p = 0; watermark && p < q->producers; p++) {
+        uint64_t progress = atomic_load_explicit(&q->rings[p].progress, memory_order_acquire);
+        if (progress < bound) bound = progress;
+    }
+
+    struct ingest_head *h = q->heap;
+    size_t n = 0;
+    for (unsigned p = 0; p < q->producers; p++) {
+        struct ingest_ring *r = &q->rings[p];
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        uint64_t ts = head_ts(q, r, head, bound);
+        if (ts != UINT64_MAX) h[n++] = (struct ingest_head){ ts, head, p };
+    }
+    for (size_t i = n / 2; i-- > 0;) sift_down(h, n, i);
+
+    size_t got = 0;
+    while (got < max && n) {
+        struct ingest_ring *r = &q->rings[h[0].ring];
+        /* Take the top ring's run up to the next oldest head in one go. */
+        uint64_t limit = n > 1 ? h[1].ts : UINT64_MAX;
+        if (n > 2 && h[2].ts < limit) limit = h[2].ts;
+        uint64_t head = h[0].head, ts;
+        for (;;) {
+            out[got++] = r->slots[head++ & q->mask];
+            ts = head_ts(q, r, head, bound);
+            if (got == max || ts == UINT64_MAX || ts > limit) break;
+        }
+        atomic_store_explicit(&r->head, head, memory_order_release);
+        if (ts == UINT64_MAX) {
+            h[0] = h[--n];
+        } else {
+            h[0].ts = ts;
+            h[0].head = head;
+        }
+        sift_down(h, n, 0);
+    }
+    return got;
+}
+
+size_t ingest_drain(struct ingest *q, struct wifi_sample *out, size_t max)
+{
+    return drain(q, out, max, 1);
+}
+
+size_t ingest_flush(struct ingest *q, struct wifi_sample *out, size_t max)
+{
+    return drain(q, out, max, 0);
+}
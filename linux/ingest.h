@@ -0,0 +1,74 @@
+#ifndef SNR_INGEST_H
+#define SNR_INGEST_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/sample.h"
+
+/*
+ * Many producers (interface workers) to one consumer (the aggregator in
+ * front of the store and the sinks), delivered in timestamp order.
+ *
+ * Each producer has its own bounded single-producer ring, so producers
+ * never touch the same cache line. A push is a copy and a release store.
+ * The consumer merges the ring heads by ts_ns with a heap.
+ *
+ * Order across producers needs a watermark. Each producer publishes its
+ * progress: the ts_ns of its last push, or a promise made with
+ * ingest_idle that nothing older will follow. ingest_drain delivers
+ * samples only up to the lowest progress of the producers still open.
+ * A sample delivered later can therefore never be older than one already
+ * delivered. A producer's own samples must have non-decreasing ts_ns. A
+ * producer with nothing to say holds the merge back until it calls
+ * ingest_idle or ingest_close.
+ *
+ * A full ring refuses the push. The producer decides whether to drop the
+ * sample or retry, and the ring counts the refusal.
+ */
+
+struct ingest_ring {
+    _Alignas(64) _Atomic uint64_t tail;     /* producer: next slot written */
+    _Atomic uint64_t progress;  /* UINT64_MAX once closed */
+    uint64_t head_cache;        /* producer's last view of head */
+    uint64_t refused;
+    _Alignas(64) _Atomic uint64_t head;     /* consumer: next slot read */
+    uint64_t tail_cache;        /* consumer's last view of tail */
+    struct wifi_sample *slots;
+};
+
+/* A ring in the consumer's merge heap, keyed by the ts_ns of its oldest sample. */
+struct ingest_head {
+    uint64_t ts;
+    uint64_t head;
+    uint32_t ring;
+};
+
+struct ingest {
+    unsigned producers;
+    size_t mask;                /* ring capacity - 1 */
+    struct ingest_ring *rings;
+    struct ingest_head *heap;   /* consumer scratch */
+};
+
+/* capacity is per producer, rounded up to a power of two. Returns 0 if out of memory. */
+int ingest_init(struct ingest *q, unsigned producers, size_t capacity);
+void ingest_free(struct ingest *q);
+
+/* Producer p only. 0 when p's ring is full. */
+int ingest_push(struct ingest *q, unsigned p, const struct wifi_sample *s);
+
+/* Producer p promises no sample older than ts_ns, letting the merge move past it. */
+void ingest_idle(struct ingest *q, unsigned p, uint64_t ts_ns);
+
+/* Producer p is done; what it pushed is still delivered. */
+void ingest_close(struct ingest *q, unsigned p);
+
+/* Consumer: up to max samples, oldest first, none past the watermark. Returns how many. */
+size_t ingest_drain(struct ingest *q, struct wifi_sample *out, size_t max);
+
+/* Consumer, at shutdown: like ingest_drain, ignoring the watermark. */
+size_t ingest_flush(struct ingest *q, struct wifi_sample *out, size_t max);
+
+#endif
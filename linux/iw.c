@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/intern.h"
+#include "backend.h"
+#include "subproc.h"
+
+#define IW_OUTPUT 4096
+
+#define IW_MAX_ARGS 8
+
+struct iw_priv {
+    char cmd[128];
+    char *argv[IW_MAX_ARGS];
+    unsigned deadline_ms;
+    char output[IW_OUTPUT];
+};
+
+/* Splits cmd in place on spaces; commands here never need quoting. */
+static void split_command(struct iw_priv *iw)
+{
+    int argc = 0;
+    char *save, *tok = strtok_r(iw->cmd, " ", &save);
+    while (tok && argc < IW_MAX_ARGS - 1) {
+        iw->argv[argc++] = tok;
+        tok = strtok_r(NULL, " ", &save);
+    }
+    iw->argv[argc] = NULL;
+}
+
+static int read_command(struct iw_priv *iw)
+{
+    int rc = run_command(iw->argv, iw->output, sizeof(iw->output), iw->deadline_ms);
+    if (rc == RUN_TIMEOUT) return SAMPLE_TIMEOUT;
+    return rc == 1 && iw->output[0] != '\0';
+}
+
+static int parse_mac(const char *p, uint8_t mac[6])
+{
+    unsigned v[6];
+    if (sscanf(p, "%x:%x:%x:%x:%x:%x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) return 0;
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)v[i];
+    return 1;
+}
+
+static uint32_t parse_rate_kbps(const char *p)
+{
+    return (uint32_t)(strtod(p, NULL) * 1000.0 + 0.5);
+}
+
+/* Interns the SSID running from p to the first of stop; an empty one stays unknown. */
+static void parse_ssid(const char *p, const char *stop, struct wifi_sample *s)
+{
+    size_t len = strcspn(p, stop);
+    if (len && (s->ssid_id = intern_put(&intern_global, p, len))) s->fields |= FIELD_SSID;
+}
+
+/* Parses `iw dev <if> link` output; "Not connected." yields no signal. */
+int parse_iw_link(const char *out, struct wifi_sample *s)
+{
+    const char *p;
+
+    if ((p = strstr(out, "Connected to ")) && parse_mac(p + 13, s->bssid)) {
+        s->fields |= FIELD_BSSID;
+    }
+    if ((p = strstr(out, "\tSSID: "))) parse_ssid(p + 7, "\n", s);
+    if ((p = strstr(out, "signal:"))) {
+        s->signal_dbm = (int8_t)strtol(p + 7, NULL, 10);
+        s->fields |= FIELD_SIGNAL;
+    }
+    if ((p = strstr(out, "rx bitrate:"))) {
+        s->rx_bitrate_kbps = parse_rate_kbps(p + 11);
+        s->fields |= FIELD_RX_BITRATE;
+    }
+    if ((p = strstr(out, "tx bitrate:"))) {
+        s->tx_bitrate_kbps = parse_rate_kbps(p + 11);
+        s->fields |= FIELD_TX_BITRATE;
+    }
+    return (s->fields & FIELD_SIGNAL) != 0;
+}
+
+/* Parses `iwconfig <if>` output from wireless-tools. */
+int parse_iwconfig(const char *out, struct wifi_sample *s)
+{
+    const char *p;
+
+    if ((p = strstr(out, "Access Point: ")) && parse_mac(p + 14, s->bssid)) {
+        s->fields |= FIELD_BSSID;
+    }
+    if ((p = strstr(out, "ESSID:\""))) parse_ssid(p + 7, "\"", s);
+    if ((p = strstr(out, "Signal level="))) {
+        s->signal_dbm = (int8_t)strtol(p + 13, NULL, 10);
+        s->fields |= FIELD_SIGNAL;
+    }
+    if ((p = strstr(out, "Noise level="))) {
+        s->noise_dbm = (int8_t)strtol(p + 12, NULL, 10);
+        s->fields |= FIELD_NOISE;
+    }
+    if ((p = strstr(out, "Bit Rate="))) {
+        s->rx_bitrate_kbps = parse_rate_kbps(p + 9);
+        s->fields |= FIELD_RX_BITRATE;
+    }
+    return (s->fields & FIELD_SIGNAL) != 0;
+}
+
+void iw_set_command(struct backend *b, const char *cmd)
+{
+    struct iw_priv *iw = b->priv;
+    snprintf(iw->cmd, sizeof(iw->cmd), "%s", cmd);
+    split_command(iw);
+}
+
+static int iw_open(struct backend *b, const char *ifname)
+{
+    struct iw_priv *iw = malloc(sizeof(*iw));
+    if (!iw) return 0;
+    snprintf(iw->cmd, sizeof(iw->cmd), "iw dev %s link", ifname);
+    split_command(iw);
+    iw->deadline_ms = backend_deadline_ms(b);
+    b->priv = iw;
+    return 1;
+}
+
+static int iw_sample(struct backend *b, struct wifi_sample *s)
+{
+    struct iw_priv *iw = b->priv;
+    int rc = read_command(iw);
+    if (rc != 1) return rc;
+    return parse_iw_link(iw->output, s);
+}
+
+static int iwconfig_open(struct backend *b, const char *ifname)
+{
+    if (!iw_open(b, ifname)) return 0;
+    struct iw_priv *iw = b->priv;
+    snprintf(iw->cmd, sizeof(iw->cmd), "iwconfig %s", ifname);
+    split_command(iw);
+    return 1;
+}
+
+static int iwconfig_sample(struct backend *b, struct wifi_sample *s)
+{
+    struct iw_priv *iw = b->priv;
+    int rc = read_command(iw);
+    if (rc != 1) return rc;
+    return parse_iwconfig(iw->output, s);
+}
+
+static void iw_close(struct backend *b)
+{
+    free(b->priv);
+    b->priv = NULL;
+}
+
+#define IW_MAX_LINKS 16
+#define IW_LINK_OUTPUT 2048
+
+static void link_done(struct run_job *job, void *ctx)
+{
+    struct wifi_sample *s = job->arg;
+    int *ok = ctx;
+
+    if (job->result == RUN_TIMEOUT) s->fields = FIELD_GAP;
+    else if (job->result == 1 && parse_iw_link(job->out, s)) (*ok)++;
+}
+
+int iw_link_all(struct runner *r, const char *const *ifnames, int n, struct wifi_sample *out,
+                unsigned deadline_ms)
+{
+    struct run_job jobs[IW_MAX_LINKS];
+    char *argv[IW_MAX_LINKS][5];
+    char outputs[IW_MAX_LINKS][IW_LINK_OUTPUT];
+    int ok = 0;
+
+    if (n > IW_MAX_LINKS) n = IW_MAX_LINKS;
+    for (int i = 0; i < n; i++) {
+        argv[i][0] = "iw";
+        argv[i][1] = "dev";
+        argv[i][2] = (char *)ifnames[i];
+        argv[i][3] = "link";
+        argv[i][4] = NULL;
+        jobs[i] = (struct run_job){ .argv = argv[i], .out = outputs[i], .size = IW_LINK_OUTPUT,
+                                    .arg = &out[i] };
+        out[i].ifname_id = intern_put(&intern_global, ifnames[i], strlen(ifnames[i]));
+    }
+    runner_run(r, jobs, n, deadline_ms ? deadline_ms : BACKEND_DEADLINE_MS, link_done, &ok);
+    return ok;
+}
+
+const struct backend iw_backend = {
+    .name = "iw",
+    .fields = FIELD_SIGNAL | FIELD_RX_BITRATE | FIELD_TX_BITRATE | FIELD_BSSID,
+    .open = iw_open,
+    .sample = iw_sample,
+    .close = iw_close,
+};
+
+const struct backend iwconfig_backend = {
+    .name = "iwconfig",
+    .fields = FIELD_SIGNAL | FIELD_NOISE | FIELD_RX_BITRATE | FIELD_BSSID,
+    .open = iwconfig_open,
+    .sample = iwconfig_sample,
+    .close = iw_close,
+};
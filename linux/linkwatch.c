@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/if.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+
+#include "clock.h"
+#include "linkwatch.h"
+#include "nl80211.h"
+#include "nlattr.h"
+
+static enum link_state read_operstate(const char *ifname)
+{
+    char path[64], state[16] = {0};
+    snprintf(path, sizeof(path), "/sys/class/net/%s/operstate", ifname);
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) return LINK_UNKNOWN;
+    if (!fgets(state, sizeof(state), fp)) state[0] = '\0';
+    fclose(fp);
+
+    if (strncmp(state, "up", 2) == 0) return LINK_UP;
+    if (state[0] == '\0' || strncmp(state, "unknown", 7) == 0) return LINK_UNKNOWN;
+    return LINK_DOWN;
+}
+
+static int open_netlink(int protocol, uint32_t groups)
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+    if (fd < 0) return -1;
+
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = groups };
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int linkwatch_attach(struct linkwatch *w, int rt_fd, int genl_fd, uint32_t ifindex,
+                     uint16_t nl80211_family, enum link_state initial)
+{
+    w->rt_fd = rt_fd;
+    w->genl_fd = genl_fd;
+    w->ifindex = ifindex;
+    w->nl80211_family = nl80211_family;
+    w->state = initial;
+    return rt_fd >= 0 || genl_fd >= 0;
+}
+
+int linkwatch_open(struct linkwatch *w, const char *ifname)
+{
+    uint32_t ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) return 0;
+
+    int rt_fd = open_netlink(NETLINK_ROUTE, RTMGRP_LINK);
+    int genl_fd = open_netlink(NETLINK_GENERIC, 0);
+    uint16_t family = 0;
+    uint32_t group = 0;
+
+    /* The mlme group is optional: rtnetlink alone still sees carrier loss. */
+    if (genl_fd >= 0 &&
+        (!nl80211_lookup(genl_fd, 1, w->buf, sizeof(w->buf), &family, &group) || group == 0 ||
+         setsockopt(genl_fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group)) < 0)) {
+        close(genl_fd);
+        genl_fd = -1;
+    }
+    return linkwatch_attach(w, rt_fd, genl_fd, ifindex, family, read_operstate(ifname));
+}
+
+void linkwatch_close(struct linkwatch *w)
+{
+    if (w->rt_fd >= 0) close(w->rt_fd);
+    if (w->genl_fd >= 0) close(w->genl_fd);
+    w->rt_fd = w->genl_fd = -1;
+}
+
+static enum link_state parse_rtnetlink(const struct linkwatch *w, const struct nlmsghdr *n)
+{
+    if (n->nlmsg_type != RTM_NEWLINK && n->nlmsg_type != RTM_DELLINK) return LINK_UNKNOWN;
+    if (n->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))) return LINK_UNKNOWN;
+
+    const struct ifinfomsg *ifi = NLMSG_DATA(n);
+    if ((uint32_t)ifi->ifi_index != w->ifindex) return LINK_UNKNOWN;
+    if (n->nlmsg_type == RTM_DELLINK) return LINK_DOWN;
+
+    int running = (ifi->ifi_flags & IFF_RUNNING) != 0;
+    const struct nlattr *a;
+    int rem;
+    nla_for_each(a, IFLA_RTA(ifi), IFLA_PAYLOAD(n), rem) {
+        if (nla_type(a) == IFLA_OPERSTATE) {
+            uint8_t oper = nla_u8(a);
+            running = running && (oper == IF_OPER_UP || oper == IF_OPER_UNKNOWN);
+        }
+    }
+    return running ? LINK_UP : LINK_DOWN;
+}
+
+static enum link_state parse_mlme(const struct linkwatch *w, const struct nlmsghdr *n)
+{
+    if (n->nlmsg_type != w->nl80211_family) return LINK_UNKNOWN;
+
+    const struct genlmsghdr *g = NLMSG_DATA(n);
+    if (g->cmd != NL80211_CMD_CONNECT && g->cmd != NL80211_CMD_DISCONNECT) return LINK_UNKNOWN;
+
+    uint32_t ifindex = 0;
+    uint16_t status = 0;
+    const struct nlattr *a;
+    int rem;
+    nla_for_each(a, genlmsg_attrs(n), genlmsg_attrlen(n), rem) {
+        if (nla_type(a) == NL80211_ATTR_IFINDEX) ifindex = nla_u32(a);
+        else if (nla_type(a) == NL80211_ATTR_STATUS_CODE) status = nla_u16(a);
+    }
+    if (ifindex != w->ifindex) return LINK_UNKNOWN;
+    if (g->cmd == NL80211_CMD_DISCONNECT || status != 0) return LINK_DOWN;
+    return LINK_UP;
+}
+
+/* Drains one readable socket; returns the last state it reported. */
+static enum link_state drain(struct linkwatch *w, int fd, int source)
+{
+    enum link_state last = LINK_UNKNOWN;
+
+    for (;;) {
+        ssize_t len = recv(fd, w->buf, sizeof(w->buf), MSG_DONTWAIT);
+        if (len < 0 && errno == EINTR) continue;
+        if (len < 0 && errno == ENOBUFS) {
+            /* Overrun: events were lost, so trust only a fresh sample. */
+            last = LINK_UNKNOWN;
+            continue;
+        }
+        if (len <= 0) break;
+
+        const struct nlmsghdr *n;
+        for (n = (const struct nlmsghdr *)w->buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+            enum link_state s = source == LINK_SRC_RTNETLINK ? parse_rtnetlink(w, n)
+                                                             : parse_mlme(w, n);
+            if (s != LINK_UNKNOWN) last = s;
+        }
+    }
+    return last;
+}
+
+int linkwatch_wait(struct linkwatch *w, int timeout_ms, struct link_event *ev)
+{
+    uint64_t deadline = timeout_ms < 0 ? 0 : mono_ns() + (uint64_t)timeout_ms * 1000000ull;
+
+    for (;;) {
+        struct pollfd pfd[2] = {
+            { .fd = w->rt_fd, .events = POLLIN },
+            { .fd = w->genl_fd, .events = POLLIN },
+        };
+        int wait_ms = -1;
+        if (deadline) {
+            uint64_t now = mono_ns();
+            if (now >= deadline) return 0;
+            wait_ms = (int)((deadline - now + 999999) / 1000000);
+        }
+
+        int r = poll(pfd, 2, wait_ms);
+        if (r <= 0) return 0;
+
+        for (int i = 0; i < 2; i++) {
+            if (!(pfd[i].revents & POLLIN)) continue;
+            int source = i == 0 ? LINK_SRC_RTNETLINK : LINK_SRC_NL80211;
+            enum link_state s = drain(w, pfd[i].fd, source);
+            if (s == LINK_UNKNOWN || s == w->state) continue;
+
+            w->state = s;
+            ev->ts_ns = mono_ns();
+            ev->state = s;
+            ev->source = source;
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SNR_LINKWATCH_H
+#define SNR_LINKWATCH_H
+
+#include <stdint.h>
+
+enum link_state {
+    LINK_UNKNOWN = 0,
+    LINK_UP,
+    LINK_DOWN,
+};
+
+#define LINK_SRC_RTNETLINK 1
+#define LINK_SRC_NL80211   2
+
+struct link_event {
+    uint64_t ts_ns;     /* CLOCK_MONOTONIC when the notification was read */
+    enum link_state state;
+    int source;         /* LINK_SRC_* */
+};
+
+/*
+ * Push-based link state: rtnetlink RTMGRP_LINK notifications (IFF_RUNNING
+ * and operstate) plus nl80211 "mlme" CONNECT/DISCONNECT events, so the
+ * sampler hears about a disconnect as it happens instead of on its next
+ * poll.
+ */
+struct linkwatch {
+    int rt_fd;
+    int genl_fd;
+    uint32_t ifindex;
+    uint16_t nl80211_family;
+    enum link_state state;
+    uint8_t buf[8192] __attribute__((aligned(4)));
+};
+
+int linkwatch_open(struct linkwatch *w, const char *ifname);
+
+/* Uses already connected fds, e.g. socketpairs fed by nlmock_send_*. */
+int linkwatch_attach(struct linkwatch *w, int rt_fd, int genl_fd, uint32_t ifindex,
+                     uint16_t nl80211_family, enum link_state initial);
+
+/*
+ * Waits up to timeout_ms (-1: forever) for a state transition. Returns 1
+ * and fills ev when the state changed, 0 on timeout or interruption.
+ */
+int linkwatch_wait(struct linkwatch *w, int timeout_ms, struct link_event *ev);
+void linkwatch_close(struct linkwatch *w);
+
+#endif
@@ -0,0 +1,441 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/health.h"
+#include "clock.h"
+#include "control.h"
+#include "metrics.h"
+
+#define METRICS_TAG_LISTEN (-1)
+#define METRICS_TAG_STOP   (-2)
+
+static const char not_found[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n\r\nnot found\n";
+
+static const double latency_le[] = { 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2, 0.1, 0.5, 1, 5 };
+
+static const char *const classes[] = { "GOOD", "FAIR", "DEGRADED", "POOR" };
+
+/*
+ * The body is described once, by walk(): in build mode it appends text and
+ * records where each value field starts, in render mode the same sequence
+ * of calls patches those fields in order.
+ */
+struct walker {
+    struct metrics *m;
+    int build;
+    char *body;
+    size_t len, cap;
+    int slot;
+    const char *labels;         /* interface="..." */
+};
+
+static void text(struct walker *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void text(struct walker *w, const char *fmt, ...)
+{
+    if (!w->build || w->len >= w->cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(w->body + w->len, w->cap - w->len, fmt, ap);
+    va_end(ap);
+    w->len = n < 0 ? w->cap : w->len + (size_t)n;
+}
+
+static void family(struct walker *w, const char *name, const char *type, const char *help)
+{
+    text(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void patch(char *field, double v)
+{
+    char tmp[32];
+    int n;
+    if (isnan(v)) n = snprintf(tmp, sizeof(tmp), "NaN");
+    else if (isinf(v)) n = snprintf(tmp, sizeof(tmp), v > 0 ? "+Inf" : "-Inf");
+    else if (v == floor(v) && fabs(v) < 1e15) n = snprintf(tmp, sizeof(tmp), "%.0f", v);
+    else n = snprintf(tmp, sizeof(tmp), "%.9g", v);
+    if (n < 0 || n > METRICS_VALUE_WIDTH) n = snprintf(tmp, sizeof(tmp), "NaN");
+
+    memset(field, ' ', METRICS_VALUE_WIDTH);
+    memcpy(field + METRICS_VALUE_WIDTH - n, tmp, (size_t)n);
+}
+
+/* name{labels[,extra]} <field>\n */
+static void value(struct walker *w, const char *name, const char *extra, double v)
+{
+    if (w->build) {
+        text(w, "%s{%s%s%s} ", name, w->labels, extra ? "," : "", extra ? extra : "");
+        if (w->slot < METRICS_MAX_SLOTS && w->len + METRICS_VALUE_WIDTH + 1 < w->cap) {
+            w->m->slots[w->slot] = (uint32_t)w->len;
+            memset(w->body + w->len, ' ', METRICS_VALUE_WIDTH);
+            w->len += METRICS_VALUE_WIDTH;
+        }
+        text(w, "\n");
+    } else if (w->slot < w->m->nslots) {
+        patch(w->m->response + w->m->slots[w->slot], v);
+    }
+    w->slot++;
+}
+
+static void histogram(struct walker *w, const char *name, const char *help, const struct histogram *h)
+{
+    char bucket[96], le[32];
+    family(w, name, "histogram", help);
+    snprintf(bucket, sizeof(bucket), "%s_bucket", name);
+
+    /* Log-linear buckets fold into the fixed bounds to within 12.5%. */
+    uint64_t cum = 0;
+    unsigned b = 0;
+    for (size_t i = 0; i < sizeof(latency_le) / sizeof(latency_le[0]); i++) {
+        unsigned last = hist_bucket((uint64_t)(latency_le[i] * 1e9));
+        for (; b <= last && b < HIST_BUCKETS; b++) cum += h->buckets[b];
+        snprintf(le, sizeof(le), "le=\"%g\"", latency_le[i]);
+        value(w, bucket, le, (double)cum);
+    }
+    value(w, bucket, "le=\"+Inf\"", (double)h->count);
+
+    snprintf(bucket, sizeof(bucket), "%s_sum", name);
+    value(w, bucket, NULL, h->sum / 1e9);
+    snprintf(bucket, sizeof(bucket), "%s_count", name);
+    value(w, bucket, NULL, (double)h->count);
+}
+
+static void walk(struct walker *w)
+{
+    const struct metrics_values *v = &w->m->values;
+    const struct wifi_sample *s = &v->sample;
+    int live = v->have_sample && !(s->fields & FIELD_GAP);
+    uint32_t f = live ? s->fields : 0;
+
+    family(w, "wifi_signal_dbm", "gauge", "Received signal strength of the last sample.");
+    value(w, "wifi_signal_dbm", NULL, f & FIELD_SIGNAL ? s->signal_dbm : NAN);
+    family(w, "wifi_snr_db", "gauge", "Signal-to-noise ratio of the last sample.");
+    value(w, "wifi_snr_db", NULL, f & FIELD_SIGNAL ? sample_snr(s) : NAN);
+    family(w, "wifi_link_health", "gauge", "Composite link-health index, 0-100.");
+    value(w, "wifi_link_health", NULL, f & FIELD_HEALTH ? s->health : NAN);
+
+    family(w, "wifi_link_health_class", "gauge", "1 for the current health class.");
+    const char *cls = f & FIELD_HEALTH ? health_class(s->health) : NULL;
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        char label[32];
+        snprintf(label, sizeof(label), "class=\"%s\"", classes[i]);
+        value(w, "wifi_link_health_class", label, cls && strcmp(cls, classes[i]) == 0);
+    }
+
+    family(w, "wifi_rx_bitrate_mbps", "gauge", "Negotiated receive bitrate.");
+    value(w, "wifi_rx_bitrate_mbps", NULL, f & FIELD_RX_BITRATE ? s->rx_bitrate_kbps / 1000.0 : NAN);
+    family(w, "wifi_tx_bitrate_mbps", "gauge", "Negotiated transmit bitrate.");
+    value(w, "wifi_tx_bitrate_mbps", NULL, f & FIELD_TX_BITRATE ? s->tx_bitrate_kbps / 1000.0 : NAN);
+    family(w, "wifi_tx_retries_total", "counter", "Transmit retries reported by the driver.");
+    value(w, "wifi_tx_retries_total", NULL, f & FIELD_TX_RETRIES ? s->tx_retries : NAN);
+    family(w, "wifi_beacon_loss_total", "counter", "Beacon losses reported by the driver.");
+    value(w, "wifi_beacon_loss_total", NULL, f & FIELD_BEACON_LOSS ? s->beacon_loss : NAN);
+    family(w, "wifi_link_bytes_per_second", "gauge", "Interface throughput from sysfs counters.");
+    value(w, "wifi_link_bytes_per_second", "direction=\"rx\"", f & FIELD_LINK_RATES ? s->rx_bytes_per_s : NAN);
+    value(w, "wifi_link_bytes_per_second", "direction=\"tx\"", f & FIELD_LINK_RATES ? s->tx_bytes_per_s : NAN);
+
+    histogram(w, "snrmon_backend_latency_seconds", "Backend sample call latency.", &v->latency);
+    histogram(w, "snrmon_deadline_wait_seconds", "Time spent on calls abandoned at the deadline.",
+              &v->timeouts);
+    family(w, "snrmon_scrapes_total", "counter", "Metrics scrapes served.");
+    value(w, "snrmon_scrapes_total", NULL, (double)w->m->scrapes);
+    family(w, "snrmon_render_seconds", "gauge", "Time the previous scrape spent patching values.");
+    value(w, "snrmon_render_seconds", NULL, w->m->render_ns / 1e9);
+    family(w, "snrmon_publish_skipped_total", "counter", "Ticks not published because a scrape was reading.");
+    value(w, "snrmon_publish_skipped_total", NULL, (double)atomic_load(&w->m->skipped));
+}
+
+static int build(struct metrics *m, const char *ifname)
+{
+    static char body[METRICS_RESPONSE_MAX];
+    char labels[96];
+    snprintf(labels, sizeof(labels), "interface=\"%.64s\"", ifname);
+    struct walker w = { .m = m, .build = 1, .body = body, .cap = sizeof(body), .labels = labels };
+    walk(&w);
+    if (w.len >= w.cap || w.slot > METRICS_MAX_SLOTS) return 0;
+
+    int head = snprintf(m->response, sizeof(m->response),
+                        "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: %zu\r\n\r\n", w.len);
+    if (head < 0 || (size_t)head + w.len > sizeof(m->response)) return 0;
+    memcpy(m->response + head, body, w.len);
+    m->response_len = (size_t)head + w.len;
+    m->nslots = w.slot;
+    for (int i = 0; i < m->nslots; i++) m->slots[i] += (uint32_t)head;
+    return 1;
+}
+
+void metrics_render(struct metrics *m)
+{
+    uint64_t t0 = mono_ns();
+    struct walker w = { .m = m };
+    m->scrapes++;
+    walk(&w);
+    m->render_ns = mono_ns() - t0;
+}
+
+static void drop(struct metrics *m, struct metrics_conn *c)
+{
+    epoll_ctl(m->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static int arm(struct metrics *m, struct metrics_conn *c, uint32_t events)
+{
+    struct epoll_event ev = { .events = events, .data.u64 = (uint64_t)(c - m->conns) };
+    return epoll_ctl(m->epfd, EPOLL_CTL_MOD, c->fd, &ev) == 0;
+}
+
+/* Sends what is left of c->out; returns 0 to drop the connection. */
+static int send_rest(struct metrics *m, struct metrics_conn *c)
+{
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return arm(m, c, EPOLLOUT);
+        if (n <= 0) return 0;
+        c->out_off += (size_t)n;
+    }
+    c->out_off = c->out_len = 0;
+    return !c->close_after && arm(m, c, EPOLLIN);
+}
+
+/*
+ * Sends straight from the shared response; only a partial send copies the
+ * remainder aside, so later scrapes cannot tear it.
+ */
+static int respond(struct metrics *m, struct metrics_conn *c, const char *data, size_t len)
+{
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = send(c->fd, data + off, len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) return 0;
+        off += (size_t)n;
+    }
+    if (off == len) return !c->close_after;
+    memcpy(c->out, data + off, len - off);
+    c->out_off = 0;
+    c->out_len = len - off;
+    return arm(m, c, EPOLLOUT);
+}
+
+/* Handles every complete request in c->in; returns 0 to drop. */
+static int serve(struct metrics *m, struct metrics_conn *c)
+{
+    while (c->out_len == 0) {
+        c->in[c->in_len] = '\0';
+        char *end = strstr(c->in, "\r\n\r\n");
+        if (!end) return c->in_len < sizeof(c->in) - 1;
+        *end = '\0';
+
+        c->close_after = strncmp(c->in, "GET ", 4) != 0 || strstr(c->in, " HTTP/1.0") != NULL ||
+                         strcasestr(c->in, "\r\nConnection: close") != NULL;
+        int ok;
+        if (strncmp(c->in, "GET /metrics ", 13) == 0) {
+            pthread_mutex_lock(&m->lock);
+            metrics_render(m);
+            ok = respond(m, c, m->response, m->response_len);
+            pthread_mutex_unlock(&m->lock);
+        } else {
+            ok = respond(m, c, not_found, sizeof(not_found) - 1);
+        }
+
+        size_t used = (size_t)(end - c->in) + 4;
+        memmove(c->in, c->in + used, c->in_len - used);
+        c->in_len -= used;
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+static int read_conn(struct metrics *m, struct metrics_conn *c)
+{
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (n <= 0) return 0;
+        c->in_len += (size_t)n;
+        if (!serve(m, c)) return 0;
+        if (c->out_len) return 1;
+    }
+}
+
+static void accept_conns(struct metrics *m)
+{
+    for (;;) {
+        int fd = accept4(m->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        struct metrics_conn *c = NULL;
+        for (int i = 0; i < METRICS_MAX_CLIENTS && !c; i++) {
+            if (m->conns[i].fd < 0) c = &m->conns[i];
+        }
+        struct epoll_event ev = { .events = EPOLLIN };
+        if (c) ev.data.u64 = (uint64_t)(c - m->conns);
+        if (!c || epoll_ctl(m->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->in_len = c->out_off = c->out_len = 0;
+        c->close_after = 0;
+    }
+}
+
+static void *metrics_thread(void *arg)
+{
+    struct metrics *m = arg;
+    struct epoll_event evs[16];
+
+    for (;;) {
+        int n = epoll_wait(m->epfd, evs, 16, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) {
+            int64_t tag = (int64_t)evs[i].data.u64;
+            if (tag == METRICS_TAG_STOP) return NULL;
+            if (tag == METRICS_TAG_LISTEN) {
+                accept_conns(m);
+                continue;
+            }
+            struct metrics_conn *c = &m->conns[tag];
+            int ok = !(evs[i].events & (EPOLLERR | EPOLLHUP)) || (evs[i].events & EPOLLIN);
+            if (ok && (evs[i].events & EPOLLOUT)) ok = send_rest(m, c) && (c->out_len || serve(m, c));
+            if (ok && (evs[i].events & EPOLLIN)) ok = read_conn(m, c);
+            if (!ok) drop(m, c);
+        }
+    }
+    return NULL;
+}
+
+static int listen_on(struct metrics *m, const char *addr)
+{
+    if (strncmp(addr, "unix:", 5) == 0) {
+        struct sockaddr_un sa = { .sun_family = AF_UNIX };
+        if (strlen(addr + 5) >= sizeof(sa.sun_path)) return -1;
+        strcpy(sa.sun_path, addr + 5);
+        if (!control_remove_stale(sa.sun_path)) return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0) {
+            /* Ours from here on: metrics_stop removes it. */
+            strcpy(m->unix_path, sa.sun_path);
+            return fd;
+        }
+        int saved = errno;
+        if (fd >= 0) close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    /* Loopback unless a host is given explicitly. */
+    char host[64] = "127.0.0.1";
+    const char *colon = strrchr(addr, ':');
+    const char *port = colon ? colon + 1 : addr;
+    if (colon) {
+        size_t n = (size_t)(colon - addr);
+        if (n == 0 || n >= sizeof(host)) return -1;
+        memcpy(host, addr, n);
+        host[n] = '\0';
+        if (strcmp(host, "localhost") == 0) strcpy(host, "127.0.0.1");
+    }
+    char *end;
+    unsigned long p = strtoul(port, &end, 10);
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons((uint16_t)p) };
+    if (*end || p > 65535 || inet_pton(AF_INET, host, &sa.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+        bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0) {
+        return fd;
+    }
+    if (fd >= 0) close(fd);
+    return -1;
+}
+
+int metrics_start(struct metrics *m, const char *addr, const char *ifname)
+{
+    memset(m, 0, sizeof(*m));
+    m->epfd = m->stop_fd = -1;
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) m->conns[i].fd = -1;
+    pthread_mutex_init(&m->lock, NULL);
+    if (!build(m, ifname)) return 0;
+
+    m->listen_fd = listen_on(m, addr);
+    m->epfd = epoll_create1(EPOLL_CLOEXEC);
+    m->stop_fd = eventfd(0, EFD_CLOEXEC);
+    struct epoll_event lev = { .events = EPOLLIN, .data.u64 = (uint64_t)(int64_t)METRICS_TAG_LISTEN };
+    struct epoll_event sev = { .events = EPOLLIN, .data.u64 = (uint64_t)(int64_t)METRICS_TAG_STOP };
+    if (m->listen_fd < 0 || m->epfd < 0 || m->stop_fd < 0 ||
+        listen(m->listen_fd, METRICS_MAX_CLIENTS) < 0 ||
+        epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->listen_fd, &lev) < 0 ||
+        epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->stop_fd, &sev) < 0 ||
+        pthread_create(&m->thread, NULL, metrics_thread, m) != 0) {
+        int saved = errno;
+        if (m->listen_fd >= 0) close(m->listen_fd);
+        if (m->epfd >= 0) close(m->epfd);
+        if (m->stop_fd >= 0) close(m->stop_fd);
+        m->stop_fd = -1;
+        if (m->unix_path[0]) unlink(m->unix_path);
+        m->unix_path[0] = '\0';
+        errno = saved;
+        return 0;
+    }
+    return 1;
+}
+
+void metrics_stop(struct metrics *m)
+{
+    if (m->stop_fd < 0) return;
+    uint64_t one = 1;
+    if (write(m->stop_fd, &one, sizeof(one)) == sizeof(one)) pthread_join(m->thread, NULL);
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (m->conns[i].fd >= 0) close(m->conns[i].fd);
+    }
+    close(m->listen_fd);
+    close(m->epfd);
+    close(m->stop_fd);
+    m->stop_fd = -1;
+    if (m->unix_path[0]) unlink(m->unix_path);
+    pthread_mutex_destroy(&m->lock);
+}
+
+int metrics_port(const struct metrics *m)
+{
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+    if (getsockname(m->listen_fd, (struct sockaddr *)&sa, &len) < 0 || sa.sin_family != AF_INET) return 0;
+    return ntohs(sa.sin_port);
+}
+
+int metrics_publish(struct metrics *m, const struct wifi_sample *s, const struct histogram *latency,
+                    const struct histogram *timeouts)
+{
+    if (pthread_mutex_trylock(&m->lock) != 0) {
+        atomic_fetch_add_explicit(&m->skipped, 1, memory_order_relaxed);
+        return 0;
+    }
+    if (s) {
+        m->values.sample = *s;
+        m->values.have_sample = 1;
+    }
+    m->values.latency = *latency;
+    m->values.timeouts = *timeouts;
+    pthread_mutex_unlock(&m->lock);
+    return 1;
+}
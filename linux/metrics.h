@@ -0,0 +1,72 @@
+#ifndef SNR_METRICS_H
+#define SNR_METRICS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "../common/histogram.h"
+#include "../common/sample.h"
+
+#define METRICS_MAX_CLIENTS 16
+#define METRICS_MAX_SLOTS 96
+#define METRICS_RESPONSE_MAX 16384
+#define METRICS_VALUE_WIDTH 20
+
+struct metrics_values {
+    int have_sample;
+    struct wifi_sample sample;
+    struct histogram latency;
+    struct histogram timeouts;
+};
+
+struct metrics_conn {
+    int fd;
+    size_t in_len;
+    size_t out_off, out_len;    /* progress through the response being sent */
+    int close_after;
+    char in[2048];
+    char out[METRICS_RESPONSE_MAX];     /* only used when a send is partial */
+};
+
+/*
+ * GET /metrics on localhost or a Unix socket, in Prometheus text format
+ * 0.0.4. The whole HTTP response, headers included, is rendered once at
+ * start with every value in a fixed-width, right-aligned field; the
+ * format allows any run of blanks before a value, so a scrape only
+ * rewrites those fields and Content-Length never changes. No allocation
+ * after start.
+ */
+struct metrics {
+    int listen_fd;
+    int epfd;
+    int stop_fd;
+    char unix_path[108];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    struct metrics_values values;       /* guarded by lock */
+    uint64_t scrapes;
+    uint64_t render_ns;                 /* last render, exported as a gauge */
+    char response[METRICS_RESPONSE_MAX];
+    size_t response_len;
+    uint32_t slots[METRICS_MAX_SLOTS];  /* offsets of the value fields */
+    int nslots;
+    struct metrics_conn conns[METRICS_MAX_CLIENTS];
+    _Atomic uint64_t skipped;
+};
+
+/* addr: "PORT", "HOST:PORT" or "unix:PATH"; PORT 0 picks a free one. */
+int metrics_start(struct metrics *m, const char *addr, const char *ifname);
+void metrics_stop(struct metrics *m);
+
+/* Bound TCP port, e.g. after asking for port 0; 0 for a Unix socket. */
+int metrics_port(const struct metrics *m);
+
+/* Sampler side: never blocks; returns 0 if a scrape held the values. */
+int metrics_publish(struct metrics *m, const struct wifi_sample *s, const struct histogram *latency,
+                    const struct histogram *timeouts);
+
+/* Patches the response in place; the lock must be held. Exposed for the bench. */
+void metrics_render(struct metrics *m);
+
+#endif
@@ -0,0 +1,87 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "netstats.h"
+
+static const char *const counter_names[NETSTAT_COUNTERS] = {
+    "rx_bytes", "tx_bytes", "rx_packets", "tx_packets", "rx_errors", "tx_errors",
+};
+
+int netstats_open(struct netstats *ns, const char *ifname, int want_uring)
+{
+    char path[128];
+
+    ns->have_last = 0;
+    for (int i = 0; i < NETSTAT_COUNTERS; i++) ns->fds[i] = -1;
+    for (int i = 0; i < NETSTAT_COUNTERS; i++) {
+        snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", ifname, counter_names[i]);
+        ns->fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+        if (ns->fds[i] < 0) {
+            netstats_close(ns);
+            return 0;
+        }
+    }
+    if (!batch_init(&ns->br, NETSTAT_COUNTERS, 32, want_uring)) {
+        netstats_close(ns);
+        return 0;
+    }
+    return 1;
+}
+
+void netstats_close(struct netstats *ns)
+{
+    for (int i = 0; i < NETSTAT_COUNTERS; i++) {
+        if (ns->fds[i] >= 0) close(ns->fds[i]);
+        ns->fds[i] = -1;
+    }
+    batch_close(&ns->br);
+}
+
+int counter_delta(uint64_t prev, uint64_t cur, uint64_t *delta)
+{
+    if (cur >= prev) {
+        *delta = cur - prev;
+        return 1;
+    }
+    if (prev <= UINT32_MAX) {
+        *delta = cur + (UINT32_MAX - prev) + 1;
+        return 1;
+    }
+    return 0;
+}
+
+int netstats_read(struct netstats *ns, uint64_t mono_now_ns, struct wifi_sample *s)
+{
+    int lens[NETSTAT_COUNTERS];
+    uint64_t cur[NETSTAT_COUNTERS];
+
+    if (batch_read(&ns->br, ns->fds, NETSTAT_COUNTERS, lens) != NETSTAT_COUNTERS) return 0;
+    for (int i = 0; i < NETSTAT_COUNTERS; i++) {
+        cur[i] = strtoull(batch_slot(&ns->br, (unsigned)i), NULL, 10);
+    }
+
+    int primed = ns->have_last && mono_now_ns > ns->last_ns;
+    double secs = primed ? (mono_now_ns - ns->last_ns) / 1e9 : 0;
+    float rate[NETSTAT_COUNTERS];
+    for (int i = 0; i < NETSTAT_COUNTERS && primed; i++) {
+        uint64_t d;
+        if (!counter_delta(ns->last[i], cur[i], &d)) primed = 0;
+        else rate[i] = (float)(d / secs);
+    }
+
+    for (int i = 0; i < NETSTAT_COUNTERS; i++) ns->last[i] = cur[i];
+    ns->last_ns = mono_now_ns;
+    ns->have_last = 1;
+    if (!primed) return 0;
+
+    s->rx_bytes_per_s = rate[0];
+    s->tx_bytes_per_s = rate[1];
+    s->rx_packets_per_s = rate[2];
+    s->tx_packets_per_s = rate[3];
+    s->rx_errors_per_s = rate[4];
+    s->tx_errors_per_s = rate[5];
+    s->fields |= FIELD_LINK_RATES;
+    return 1;
+}
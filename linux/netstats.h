@@ -0,0 +1,36 @@
+#ifndef SNR_NETSTATS_H
+#define SNR_NETSTATS_H
+
+#include <stdint.h>
+#include "../common/sample.h"
+#include "batchread.h"
+
+#define NETSTAT_COUNTERS 6
+
+/*
+ * rx/tx byte, packet and error counters from /sys/class/net/<if>/statistics,
+ * read through one batch_reader per tick and turned into per-second rates.
+ */
+struct netstats {
+    int fds[NETSTAT_COUNTERS];
+    struct batch_reader br;
+    uint64_t last[NETSTAT_COUNTERS];
+    uint64_t last_ns;
+    int have_last;
+};
+
+int netstats_open(struct netstats *ns, const char *ifname, int want_uring);
+void netstats_close(struct netstats *ns);
+
+/*
+ * Reads the counters at mono_now_ns and fills the *_per_s columns of s.
+ * The first call only primes the baseline and returns 0. A counter that
+ * went backwards is treated as a 32-bit wrap when both readings fit in 32
+ * bits, otherwise as a reset, and that tick's rates are skipped.
+ */
+int netstats_read(struct netstats *ns, uint64_t mono_now_ns, struct wifi_sample *s);
+
+/* Delta between two counter readings; returns 0 if the counter was reset. */
+int counter_delta(uint64_t prev, uint64_t cur, uint64_t *delta);
+
+#endif
@@ -0,0 +1,398 @@
+#include <errno.h>
+#include <net/if.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <linux/nl80211.h>
+
+#include "clock.h"
+#include "nl80211.h"
+#include "nlattr.h"
+
+static void set_rcvtimeo(int fd, uint64_t ns)
+{
+    struct timeval tv = { (time_t)(ns / 1000000000ull), (suseconds_t)(ns % 1000000000ull / 1000) };
+    if (tv.tv_sec == 0 && tv.tv_usec == 0) tv.tv_usec = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+void nl80211_set_timeout(struct nl80211 *nl, unsigned timeout_ms)
+{
+    nl->timeout_ms = timeout_ms;
+    set_rcvtimeo(nl->fd, (uint64_t)timeout_ms * 1000000ull);
+}
+
+/*
+ * The first recv of a request runs under the socket timeout set once at
+ * open. Later recvs in the same dump shrink it to whatever is left of the
+ * deadline, so a trickling reply cannot stretch one sample past it.
+ */
+static int nl_recv(struct nl80211 *nl, ssize_t *len, uint64_t deadline, int first)
+{
+    for (;;) {
+        if (!first) {
+            uint64_t now = mono_ns();
+            if (now >= deadline) return SAMPLE_TIMEOUT;
+            set_rcvtimeo(nl->fd, deadline - now);
+        }
+        *len = recv(nl->fd, nl->buf, sizeof(nl->buf), 0);
+        if (*len >= 0) return *len > 0;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return SAMPLE_TIMEOUT;
+        if (errno != EINTR) return 0;
+        first = 0;
+    }
+}
+
+static uint32_t find_group(const struct nlattr *groups, const char *name)
+{
+    const struct nlattr *g, *a;
+    int rem, grem;
+
+    nla_for_each(g, nla_data(groups), nla_len(groups), rem) {
+        const char *gname = NULL;
+        uint32_t id = 0;
+        nla_for_each(a, nla_data(g), nla_len(g), grem) {
+            if (nla_type(a) == CTRL_ATTR_MCAST_GRP_NAME) gname = nla_data(a);
+            else if (nla_type(a) == CTRL_ATTR_MCAST_GRP_ID) id = nla_u32(a);
+        }
+        if (gname && strcmp(gname, name) == 0) return id;
+    }
+    return 0;
+}
+
+int nl80211_lookup(int fd, uint32_t seq, void *buf, size_t size,
+                   uint16_t *family, uint32_t *mlme_group)
+{
+    struct nlmsghdr *n = genlmsg_init(buf, GENL_ID_CTRL, NLM_F_REQUEST, seq, CTRL_CMD_GETFAMILY);
+    if (!nla_put(n, size, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME, sizeof(NL80211_GENL_NAME))) {
+        return 0;
+    }
+    if (send(fd, n, n->nlmsg_len, 0) < 0) return 0;
+
+    ssize_t len;
+    do {
+        len = recv(fd, buf, size, 0);
+    } while (len < 0 && errno == EINTR);
+    if (len <= 0) return 0;
+
+    *family = 0;
+    if (mlme_group) *mlme_group = 0;
+    for (n = buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+        if (n->nlmsg_seq != seq) continue;
+        if (n->nlmsg_type == NLMSG_ERROR) return 0;
+        if (n->nlmsg_type != GENL_ID_CTRL) continue;
+
+        struct nlattr *a;
+        int rem;
+        nla_for_each(a, genlmsg_attrs(n), genlmsg_attrlen(n), rem) {
+            if (nla_type(a) == CTRL_ATTR_FAMILY_ID) {
+                *family = nla_u16(a);
+            } else if (nla_type(a) == CTRL_ATTR_MCAST_GROUPS && mlme_group) {
+                *mlme_group = find_group(a, NL80211_MULTICAST_GROUP_MLME);
+            }
+        }
+    }
+    return *family != 0;
+}
+
+static void build_station_request(struct nl80211 *nl)
+{
+    struct nlmsghdr *n = genlmsg_init(nl->req, nl->family, NLM_F_REQUEST | NLM_F_DUMP,
+                                      0, NL80211_CMD_GET_STATION);
+    nla_put(n, sizeof(nl->req), NL80211_ATTR_IFINDEX, &nl->ifindex, sizeof(nl->ifindex));
+}
+
+int nl80211_attach(struct nl80211 *nl, int fd, uint32_t ifindex)
+{
+    nl->fd = fd;
+    nl->ifindex = ifindex;
+    nl->family = 0;
+    nl->record = NULL;
+    nl->seq = 0;
+    nl80211_set_timeout(nl, BACKEND_DEADLINE_MS);
+    if (!nl80211_lookup(fd, ++nl->seq, nl->buf, sizeof(nl->buf), &nl->family, NULL)) return 0;
+    build_station_request(nl);
+    return 1;
+}
+
+int nl80211_open(struct nl80211 *nl, const char *ifname)
+{
+    unsigned ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) return 0;
+
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd < 0) return 0;
+
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+    int one = 1;
+    setsockopt(fd, SOL_NETLINK, NETLINK_EXT_ACK, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || !nl80211_attach(nl, fd, ifindex)) {
+        close(fd);
+        nl->fd = -1;
+        return 0;
+    }
+    return 1;
+}
+
+void nl80211_close(struct nl80211 *nl)
+{
+    if (nl->fd >= 0) close(nl->fd);
+    nl->fd = -1;
+}
+
+static uint32_t parse_bitrate_kbps(const struct nlattr *rate)
+{
+    const struct nlattr *a;
+    int rem;
+    uint32_t legacy = 0;
+
+    nla_for_each(a, nla_data(rate), nla_len(rate), rem) {
+        if (nla_type(a) == NL80211_RATE_INFO_BITRATE32) return nla_u32(a) * 100;
+        if (nla_type(a) == NL80211_RATE_INFO_BITRATE) legacy = nla_u16(a) * 100u;
+    }
+    return legacy;
+}
+
+int nl80211_parse_station(const void *attrs, int len, struct wifi_sample *s)
+{
+    const struct nlattr *a, *info = NULL;
+    int rem;
+
+    nla_for_each(a, attrs, len, rem) {
+        if (nla_type(a) == NL80211_ATTR_MAC && nla_len(a) == 6) {
+            memcpy(s->bssid, nla_data(a), 6);
+            s->fields |= FIELD_BSSID;
+        } else if (nla_type(a) == NL80211_ATTR_STA_INFO) {
+            info = a;
+        }
+    }
+    if (!info) return 0;
+
+    nla_for_each(a, nla_data(info), nla_len(info), rem) {
+        switch (nla_type(a)) {
+        case NL80211_STA_INFO_SIGNAL:
+            s->signal_dbm = (int8_t)nla_u8(a);
+            s->fields |= FIELD_SIGNAL;
+            break;
+        case NL80211_STA_INFO_SIGNAL_AVG:
+            s->signal_avg_dbm = (int8_t)nla_u8(a);
+            s->fields |= FIELD_SIGNAL_AVG;
+            break;
+        case NL80211_STA_INFO_CHAIN_SIGNAL: {
+            const struct nlattr *c;
+            int crem;
+            s->chains = 0;
+            nla_for_each(c, nla_data(a), nla_len(a), crem) {
+                if (s->chains < MAX_CHAINS) s->chain_signal_dbm[s->chains++] = (int8_t)nla_u8(c);
+            }
+            s->fields |= FIELD_CHAIN_SIGNAL;
+            break;
+        }
+        case NL80211_STA_INFO_RX_BITRATE:
+            s->rx_bitrate_kbps = parse_bitrate_kbps(a);
+            s->fields |= FIELD_RX_BITRATE;
+            break;
+        case NL80211_STA_INFO_TX_BITRATE:
+            s->tx_bitrate_kbps = parse_bitrate_kbps(a);
+            s->fields |= FIELD_TX_BITRATE;
+            break;
+        case NL80211_STA_INFO_TX_PACKETS:
+            s->tx_packets = nla_u32(a);
+            s->fields |= FIELD_TX_PACKETS;
+            break;
+        case NL80211_STA_INFO_TX_RETRIES:
+            s->tx_retries = nla_u32(a);
+            s->fields |= FIELD_TX_RETRIES;
+            break;
+        case NL80211_STA_INFO_TX_FAILED:
+            s->tx_failed = nla_u32(a);
+            s->fields |= FIELD_TX_FAILED;
+            break;
+        case NL80211_STA_INFO_BEACON_LOSS:
+            s->beacon_loss = nla_u32(a);
+            s->fields |= FIELD_BEACON_LOSS;
+            break;
+        }
+    }
+    return (s->fields & FIELD_SIGNAL) != 0;
+}
+
+static void record_station(FILE *fp, const void *attrs, int len)
+{
+    uint32_t n = (uint32_t)len;
+    fwrite(&n, sizeof(n), 1, fp);
+    fwrite(attrs, 1, n, fp);
+}
+
+/* Consumes one recv worth of dump; returns 1 at NLMSG_DONE, -1 on error, 0 for more. */
+static int station_reply(struct nl80211 *nl, ssize_t len, struct wifi_sample *s, int *found)
+{
+    struct nlmsghdr *n;
+    for (n = (struct nlmsghdr *)nl->buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+        if (n->nlmsg_seq != nl->seq) continue;
+        if (n->nlmsg_type == NLMSG_DONE) return 1;
+        if (n->nlmsg_type == NLMSG_ERROR) {
+            const struct nlmsgerr *e = NLMSG_DATA(n);
+            if (e->error != 0) return -1;
+            continue;
+        }
+        if (n->nlmsg_type != nl->family || *found) continue;
+
+        /* A managed interface has exactly one station: its AP. */
+        *found = nl80211_parse_station(genlmsg_attrs(n), genlmsg_attrlen(n), s);
+        if (*found && nl->record) record_station(nl->record, genlmsg_attrs(n), genlmsg_attrlen(n));
+    }
+    return 0;
+}
+
+int nl80211_get_station(struct nl80211 *nl, struct wifi_sample *s)
+{
+    struct nlmsghdr *req = (struct nlmsghdr *)nl->req;
+    uint64_t deadline = mono_ns() + (uint64_t)nl->timeout_ms * 1000000ull;
+    req->nlmsg_seq = ++nl->seq;
+    if (send(nl->fd, req, req->nlmsg_len, 0) < 0) return 0;
+
+    int found = 0, rc, first;
+    for (first = 1;; first = 0) {
+        ssize_t len;
+        rc = nl_recv(nl, &len, deadline, first);
+        if (rc != 1) break;
+
+        int done = station_reply(nl, len, s, &found);
+        if (done != 0) {
+            rc = done > 0 ? found : 0;
+            break;
+        }
+    }
+    /* Later recvs shrank the socket timeout; put it back for the next sample. */
+    if (!first) set_rcvtimeo(nl->fd, (uint64_t)nl->timeout_ms * 1000000ull);
+    return rc;
+}
+
+/* Consumes one recv worth of scan dump; like station_reply. */
+static int scan_reply(struct nl80211 *nl, ssize_t len, struct site_ap *out, size_t max, size_t *n)
+{
+    struct nlmsghdr *m;
+    for (m = (struct nlmsghdr *)nl->buf; NLMSG_OK(m, len); m = NLMSG_NEXT(m, len)) {
+        if (m->nlmsg_seq != nl->seq) continue;
+        if (m->nlmsg_type == NLMSG_DONE) return 1;
+        if (m->nlmsg_type == NLMSG_ERROR) {
+            const struct nlmsgerr *e = NLMSG_DATA(m);
+            if (e->error != 0) return -1;
+            continue;
+        }
+        if (m->nlmsg_type != nl->family || *n == max) continue;
+
+        const struct nlattr *a, *b;
+        int rem, brem;
+        nla_for_each(a, genlmsg_attrs(m), genlmsg_attrlen(m), rem) {
+            if (nla_type(a) != NL80211_ATTR_BSS) continue;
+            struct site_ap ap = { .signal_dbm = INT8_MIN };
+            int have_bssid = 0;
+            nla_for_each(b, nla_data(a), nla_len(a), brem) {
+                if (nla_type(b) == NL80211_BSS_BSSID && nla_len(b) == 6) {
+                    memcpy(ap.bssid, nla_data(b), 6);
+                    have_bssid = 1;
+                } else if (nla_type(b) == NL80211_BSS_SIGNAL_MBM) {
+                    int32_t mbm = (int32_t)nla_u32(b);
+                    ap.signal_dbm = (int8_t)(mbm / 100 < -127 ? -127 : mbm / 100 > 0 ? 0 : mbm / 100);
+                } else if (nla_type(b) == NL80211_BSS_SIGNAL_UNSPEC && ap.signal_dbm == INT8_MIN) {
+                    /* 0..100 from drivers without dBm: spread over -100..-50 like the netsh percentage. */
+                    ap.signal_dbm = (int8_t)(nla_u8(b) / 2 - 100);
+                }
+            }
+            if (have_bssid) out[(*n)++] = ap;
+        }
+    }
+    return 0;
+}
+
+int nl80211_get_scan(struct nl80211 *nl, struct site_ap *out, size_t max)
+{
+    uint8_t req[NL_REQ_SIZE] __attribute__((aligned(4)));
+    uint64_t deadline = mono_ns() + (uint64_t)nl->timeout_ms * 1000000ull;
+    struct nlmsghdr *n = genlmsg_init(req, nl->family, NLM_F_REQUEST | NLM_F_DUMP, ++nl->seq,
+                                      NL80211_CMD_GET_SCAN);
+    nla_put(n, sizeof(req), NL80211_ATTR_IFINDEX, &nl->ifindex, sizeof(nl->ifindex));
+    if (send(nl->fd, n, n->nlmsg_len, 0) < 0) return -1;
+
+    size_t got = 0;
+    int rc, first;
+    for (first = 1;; first = 0) {
+        ssize_t len;
+        rc = nl_recv(nl, &len, deadline, first);
+        if (rc != 1) {
+            rc = -1;
+            break;
+        }
+        int done = scan_reply(nl, len, out, max, &got);
+        if (done != 0) {
+            rc = done > 0 ? (int)got : -1;
+            break;
+        }
+    }
+    if (!first) set_rcvtimeo(nl->fd, (uint64_t)nl->timeout_ms * 1000000ull);
+    return rc;
+}
+
+static int backend_open(struct backend *b, const char *ifname)
+{
+    struct nl80211 *nl = malloc(sizeof(*nl));
+    if (!nl) return 0;
+    if (!nl80211_open(nl, ifname)) {
+        free(nl);
+        return 0;
+    }
+    nl80211_set_timeout(nl, backend_deadline_ms(b));
+    b->priv = nl;
+    return 1;
+}
+
+static int backend_sample(struct backend *b, struct wifi_sample *s)
+{
+    return nl80211_get_station(b->priv, s);
+}
+
+static void backend_close(struct backend *b)
+{
+    if (!b->priv) return;
+    nl80211_close(b->priv);
+    free(b->priv);
+    b->priv = NULL;
+}
+
+int nl80211_backend_attach(struct backend *b, int fd, uint32_t ifindex)
+{
+    struct nl80211 *nl = malloc(sizeof(*nl));
+    if (!nl) return 0;
+    if (!nl80211_attach(nl, fd, ifindex)) {
+        free(nl);
+        return 0;
+    }
+    nl80211_set_timeout(nl, backend_deadline_ms(b));
+    b->priv = nl;
+    return 1;
+}
+
+void nl80211_backend_record(struct backend *b, FILE *fp)
+{
+    if (b->priv) ((struct nl80211 *)b->priv)->record = fp;
+}
+
+int nl80211_backend_scan(struct backend *b, struct site_ap *out, size_t max)
+{
+    if (b->open != nl80211_backend.open || !b->priv) return -1;
+    return nl80211_get_scan(b->priv, out, max);
+}
+
+const struct backend nl80211_backend = {
+    .name = "nl80211",
+    .fields = FIELD_SIGNAL | FIELD_SIGNAL_AVG | FIELD_CHAIN_SIGNAL | FIELD_RX_BITRATE |
+              FIELD_TX_BITRATE | FIELD_TX_PACKETS | FIELD_TX_RETRIES | FIELD_TX_FAILED |
+              FIELD_BEACON_LOSS | FIELD_BSSID,
+    .open = backend_open,
+    .sample = backend_sample,
+    .close = backend_close,
+};
@@ -0,0 +1,59 @@
+#ifndef SNR_NL80211_H
+#define SNR_NL80211_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../common/sample.h"
+#include "../common/site.h"
+#include "backend.h"
+
+#define NL_REQ_SIZE 128
+#define NL_BUF_SIZE 16384
+
+/*
+ * One generic netlink socket plus preallocated request/response buffers.
+ * The GET_STATION dump request is built once; only the sequence number
+ * changes between samples.
+ */
+struct nl80211 {
+    int fd;
+    uint16_t family;
+    uint32_t seq;
+    uint32_t ifindex;
+    unsigned timeout_ms;    /* SO_RCVTIMEO; a sample never outlives it */
+    FILE *record;   /* optional: raw station attribute sets for nlmock */
+    uint8_t req[NL_REQ_SIZE] __attribute__((aligned(4)));
+    uint8_t buf[NL_BUF_SIZE] __attribute__((aligned(4)));
+};
+
+int nl80211_open(struct nl80211 *nl, const char *ifname);
+int nl80211_attach(struct nl80211 *nl, int fd, uint32_t ifindex);
+void nl80211_set_timeout(struct nl80211 *nl, unsigned timeout_ms);
+/* Returns 1, 0, or SAMPLE_TIMEOUT when the reply missed timeout_ms. */
+int nl80211_get_station(struct nl80211 *nl, struct wifi_sample *s);
+void nl80211_close(struct nl80211 *nl);
+
+/*
+ * The access points in the kernel's scan cache (a GET_SCAN dump), as
+ * fresh as the last scan wpa_supplicant or NetworkManager ran: starting
+ * one needs CAP_NET_ADMIN. Returns how many were put in out, or -1.
+ */
+int nl80211_get_scan(struct nl80211 *nl, struct site_ap *out, size_t max);
+
+/*
+ * Resolves the nl80211 family id (and optionally the "mlme" multicast
+ * group) over fd, using buf for both the request and the reply.
+ */
+int nl80211_lookup(int fd, uint32_t seq, void *buf, size_t size,
+                   uint16_t *family, uint32_t *mlme_group);
+
+/* Parses one station's attribute set (payload after the genl header). */
+int nl80211_parse_station(const void *attrs, int len, struct wifi_sample *s);
+
+/* Binds the nl80211 backend to an already connected fd, e.g. from nlmock. */
+int nl80211_backend_attach(struct backend *b, int fd, uint32_t ifindex);
+void nl80211_backend_record(struct backend *b, FILE *fp);
+/* nl80211_get_scan on b; -1 when b is another backend. */
+int nl80211_backend_scan(struct backend *b, struct site_ap *out, size_t max);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SNR_NLATTR_H
+#define SNR_NLATTR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+
+/* Minimal netlink attribute helpers shared by the nl80211 backend and mock. */
+
+#define nla_for_each(a, head, len, rem)                                     \
+    for ((a) = (struct nlattr *)(head), (rem) = (int)(len);                 \
+         (rem) >= NLA_HDRLEN && (a)->nla_len >= NLA_HDRLEN &&               \
+         (int)(a)->nla_len <= (rem);                                        \
+         (rem) -= NLA_ALIGN((a)->nla_len),                                  \
+         (a) = (struct nlattr *)((char *)(a) + NLA_ALIGN((a)->nla_len)))
+
+static inline int nla_type(const struct nlattr *a)
+{
+    return a->nla_type & NLA_TYPE_MASK;
+}
+
+static inline void *nla_data(const struct nlattr *a)
+{
+    return (char *)a + NLA_HDRLEN;
+}
+
+static inline int nla_len(const struct nlattr *a)
+{
+    return a->nla_len - NLA_HDRLEN;
+}
+
+static inline uint8_t nla_u8(const struct nlattr *a)
+{
+    return *(const uint8_t *)nla_data(a);
+}
+
+static inline uint16_t nla_u16(const struct nlattr *a)
+{
+    uint16_t v;
+    memcpy(&v, nla_data(a), sizeof(v));
+    return v;
+}
+
+static inline uint32_t nla_u32(const struct nlattr *a)
+{
+    uint32_t v;
+    memcpy(&v, nla_data(a), sizeof(v));
+    return v;
+}
+
+/* Appends an attribute to the message; returns NULL if cap would overflow. */
+static inline struct nlattr *nla_put(struct nlmsghdr *n, size_t cap, int type,
+                                     const void *data, size_t len)
+{
+    size_t off = NLMSG_ALIGN(n->nlmsg_len);
+    if (off + NLA_HDRLEN + NLA_ALIGN(len) > cap) return NULL;
+
+    struct nlattr *a = (struct nlattr *)((char *)n + off);
+    a->nla_type = (uint16_t)type;
+    a->nla_len = (uint16_t)(NLA_HDRLEN + len);
+    if (len) memcpy(nla_data(a), data, len);
+    memset((char *)nla_data(a) + len, 0, NLA_ALIGN(len) - len);
+    n->nlmsg_len = (uint32_t)(off + NLA_HDRLEN + NLA_ALIGN(len));
+    return a;
+}
+
+static inline struct nlattr *nla_nest_start(struct nlmsghdr *n, size_t cap, int type)
+{
+    return nla_put(n, cap, type | NLA_F_NESTED, NULL, 0);
+}
+
+static inline void nla_nest_end(struct nlmsghdr *n, struct nlattr *nest)
+{
+    nest->nla_len = (uint16_t)((char *)n + n->nlmsg_len - (char *)nest);
+}
+
+static inline void *genlmsg_attrs(const struct nlmsghdr *n)
+{
+    return (char *)NLMSG_DATA(n) + GENL_HDRLEN;
+}
+
+static inline int genlmsg_attrlen(const struct nlmsghdr *n)
+{
+    return (int)n->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN;
+}
+
+static inline struct nlmsghdr *genlmsg_init(void *buf, uint16_t type, uint16_t flags,
+                                            uint32_t seq, uint8_t cmd)
+{
+    struct nlmsghdr *n = buf;
+    memset(n, 0, NLMSG_HDRLEN + GENL_HDRLEN);
+    n->nlmsg_len = NLMSG_HDRLEN + GENL_HDRLEN;
+    n->nlmsg_type = type;
+    n->nlmsg_flags = flags;
+    n->nlmsg_seq = seq;
+    struct genlmsghdr *g = NLMSG_DATA(n);
+    g->cmd = cmd;
+    g->version = 1;
+    return n;
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include <errno.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/if.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+
+#include "nlattr.h"
+#include "nlmock.h"
+
+#define SYNTH_SETS 64
+#define SYNTH_APS 24
+#define MOCK_BUF 8192
+
+static int load_sets(struct nlmock *m, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+
+    size_t cap = 0;
+    uint32_t n;
+    while (fread(&n, sizeof(n), 1, fp) == 1) {
+        if (n > MOCK_BUF / 2) break;
+        if (m->sets_len + sizeof(n) + n > cap) {
+            cap = cap ? cap * 2 : 4096;
+            while (cap < m->sets_len + sizeof(n) + n) cap *= 2;
+            uint8_t *p = realloc(m->sets, cap);
+            if (!p) break;
+            m->sets = p;
+        }
+        memcpy(m->sets + m->sets_len, &n, sizeof(n));
+        if (fread(m->sets + m->sets_len + sizeof(n), 1, n, fp) != n) break;
+        m->sets_len += sizeof(n) + n;
+    }
+    fclose(fp);
+    return m->sets_len > 0;
+}
+
+static void put_rate(struct nlmsghdr *n, size_t cap, int type, uint32_t kbps)
+{
+    struct nlattr *nest = nla_nest_start(n, cap, type);
+    uint32_t units = kbps / 100;
+    nla_put(n, cap, NL80211_RATE_INFO_BITRATE32, &units, sizeof(units));
+    nla_nest_end(n, nest);
+}
+
+/* A slow walk between -48 and -75 dBm with growing retry counters. */
+static int synth_sets(struct nlmock *m)
+{
+    static const uint8_t bssid[6] = { 0x02, 0x00, 0x5e, 0x10, 0x20, 0x30 };
+    uint8_t msg[512] __attribute__((aligned(4)));
+    uint32_t packets = 0, retries = 0, failed = 0, beacon_loss = 0;
+
+    m->sets = malloc(SYNTH_SETS * (sizeof(msg) + sizeof(uint32_t)));
+    if (!m->sets) return 0;
+
+    for (int i = 0; i < SYNTH_SETS; i++) {
+        struct nlmsghdr *n = genlmsg_init(msg, NLMOCK_FAMILY, 0, 0, NL80211_CMD_NEW_STATION);
+        int8_t sig = (int8_t)(-48 - (i < SYNTH_SETS / 2 ? i : SYNTH_SETS - i) * 27 / (SYNTH_SETS / 2));
+        int8_t avg = (int8_t)(sig + 1);
+        packets += 40;
+        retries += (uint32_t)(i % 7);
+        failed += (i % 13) == 0;
+        beacon_loss += (i % 29) == 0;
+
+        nla_put(n, sizeof(msg), NL80211_ATTR_MAC, bssid, sizeof(bssid));
+        struct nlattr *info = nla_nest_start(n, sizeof(msg), NL80211_ATTR_STA_INFO);
+        nla_put(n, sizeof(msg), NL80211_STA_INFO_SIGNAL, &sig, 1);
+        nla_put(n, sizeof(msg), NL80211_STA_INFO_SIGNAL_AVG, &avg, 1);
+
+        struct nlattr *chains = nla_nest_start(n, sizeof(msg), NL80211_STA_INFO_CHAIN_SIGNAL);
+        int8_t c0 = (int8_t)(sig - 1), c1 = (int8_t)(sig - 4);
+        nla_put(n, sizeof(msg), 0, &c0, 1);
+        nla_put(n, sizeof(msg), 1, &c1, 1);
+        nla_nest_end(n, chains);
+
+        uint32_t rate = (uint32_t)(866700 - (-48 - sig) * 25000);
+        put_rate(n, sizeof(msg), NL80211_STA_INFO_RX_BITRATE, rate);
+        put_rate(n, sizeof(msg), NL80211_STA_INFO_TX_BITRATE, rate - 100000);
+        nla_put(n, sizeof(msg), NL80211_STA_INFO_TX_PACKETS, &packets, sizeof(packets));
+        nla_put(n, sizeof(msg), NL80211_STA_INFO_TX_RETRIES, &retries, sizeof(retries));
+        nla_put(n, sizeof(msg), NL80211_STA_INFO_TX_FAILED, &failed, sizeof(failed));
+        nla_put(n, sizeof(msg), NL80211_STA_INFO_BEACON_LOSS, &beacon_loss, sizeof(beacon_loss));
+        nla_nest_end(n, info);
+
+        uint32_t len = (uint32_t)genlmsg_attrlen(n);
+        memcpy(m->sets + m->sets_len, &len, sizeof(len));
+        memcpy(m->sets + m->sets_len + sizeof(len), genlmsg_attrs(n), len);
+        m->sets_len += sizeof(len) + len;
+    }
+    return 1;
+}
+
+static size_t reply_family(const struct nlmsghdr *req, uint8_t *out)
+{
+    uint16_t id = NLMOCK_FAMILY;
+    struct nlmsghdr *n = genlmsg_init(out, GENL_ID_CTRL, 0, req->nlmsg_seq, CTRL_CMD_NEWFAMILY);
+    nla_put(n, MOCK_BUF, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME, sizeof(NL80211_GENL_NAME));
+    nla_put(n, MOCK_BUF, CTRL_ATTR_FAMILY_ID, &id, sizeof(id));
+
+    uint32_t group = NLMOCK_MLME_GROUP;
+    struct nlattr *groups = nla_nest_start(n, MOCK_BUF, CTRL_ATTR_MCAST_GROUPS);
+    struct nlattr *g = nla_nest_start(n, MOCK_BUF, 1);
+    nla_put(n, MOCK_BUF, CTRL_ATTR_MCAST_GRP_NAME, NL80211_MULTICAST_GROUP_MLME,
+            sizeof(NL80211_MULTICAST_GROUP_MLME));
+    nla_put(n, MOCK_BUF, CTRL_ATTR_MCAST_GRP_ID, &group, sizeof(group));
+    nla_nest_end(n, g);
+    nla_nest_end(n, groups);
+    return n->nlmsg_len;
+}
+
+static size_t reply_station(struct nlmock *m, const struct nlmsghdr *req, uint8_t *out)
+{
+    uint32_t len;
+    memcpy(&len, m->sets + m->pos, sizeof(len));
+
+    struct nlmsghdr *n = genlmsg_init(out, NLMOCK_FAMILY, NLM_F_MULTI, req->nlmsg_seq,
+                                      NL80211_CMD_NEW_STATION);
+    memcpy(genlmsg_attrs(n), m->sets + m->pos + sizeof(len), len);
+    n->nlmsg_len += len;
+    m->pos += sizeof(len) + len;
+    if (m->pos >= m->sets_len) m->pos = 0;
+
+    struct nlmsghdr *done = (struct nlmsghdr *)(out + NLMSG_ALIGN(n->nlmsg_len));
+    memset(done, 0, NLMSG_HDRLEN + sizeof(int));
+    done->nlmsg_len = NLMSG_LENGTH(sizeof(int));
+    done->nlmsg_type = NLMSG_DONE;
+    done->nlmsg_flags = NLM_F_MULTI;
+    done->nlmsg_seq = req->nlmsg_seq;
+    return NLMSG_ALIGN(n->nlmsg_len) + done->nlmsg_len;
+}
+
+/* One office: the station's AP and its neighbours, each a message, then DONE. */
+static size_t reply_scan(const struct nlmsghdr *req, uint8_t *out)
+{
+    size_t off = 0;
+    for (int i = 0; i < SYNTH_APS; i++) {
+        uint8_t bssid[6] = { 0x02, 0x00, 0x5e, 0x10, 0x20, (uint8_t)(0x30 + i) };
+        int32_t mbm = (-48 - i * 2) * 100;
+        struct nlmsghdr *n = genlmsg_init(out + off, NLMOCK_FAMILY, NLM_F_MULTI, req->nlmsg_seq,
+                                          NL80211_CMD_NEW_SCAN_RESULTS);
+        struct nlattr *bss = nla_nest_start(n, MOCK_BUF - off, NL80211_ATTR_BSS);
+        nla_put(n, MOCK_BUF - off, NL80211_BSS_BSSID, bssid, sizeof(bssid));
+        nla_put(n, MOCK_BUF - off, NL80211_BSS_SIGNAL_MBM, &mbm, sizeof(mbm));
+        nla_nest_end(n, bss);
+        off += NLMSG_ALIGN(n->nlmsg_len);
+    }
+
+    struct nlmsghdr *done = (struct nlmsghdr *)(out + off);
+    memset(done, 0, NLMSG_HDRLEN + sizeof(int));
+    done->nlmsg_len = NLMSG_LENGTH(sizeof(int));
+    done->nlmsg_type = NLMSG_DONE;
+    done->nlmsg_flags = NLM_F_MULTI;
+    done->nlmsg_seq = req->nlmsg_seq;
+    return off + done->nlmsg_len;
+}
+
+static size_t reply_error(const struct nlmsghdr *req, uint8_t *out, int error)
+{
+    struct nlmsghdr *n = (struct nlmsghdr *)out;
+    n->nlmsg_len = NLMSG_LENGTH(sizeof(struct nlmsgerr));
+    n->nlmsg_type = NLMSG_ERROR;
+    n->nlmsg_flags = 0;
+    n->nlmsg_seq = req->nlmsg_seq;
+    n->nlmsg_pid = 0;
+    struct nlmsgerr *e = NLMSG_DATA(n);
+    e->error = error;
+    e->msg = *req;
+    return n->nlmsg_len;
+}
+
+static void *responder(void *arg)
+{
+    struct nlmock *m = arg;
+    uint8_t in[MOCK_BUF] __attribute__((aligned(4)));
+    uint8_t out[MOCK_BUF] __attribute__((aligned(4)));
+    unsigned stations = 0;
+
+    for (;;) {
+        ssize_t len = recv(m->fd, in, sizeof(in), 0);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) break;
+
+        const struct nlmsghdr *req = (const struct nlmsghdr *)in;
+        if (!NLMSG_OK(req, len)) continue;
+
+        const struct genlmsghdr *g = NLMSG_DATA(req);
+        size_t n;
+        if (req->nlmsg_type == GENL_ID_CTRL && g->cmd == CTRL_CMD_GETFAMILY) {
+            n = reply_family(req, out);
+        } else if (req->nlmsg_type == NLMOCK_FAMILY && g->cmd == NL80211_CMD_GET_STATION) {
+            /* Models a wedged driver: the request is swallowed. */
+            if (m->stall_every && ++stations % m->stall_every == 0) continue;
+            n = reply_station(m, req, out);
+        } else if (req->nlmsg_type == NLMOCK_FAMILY && g->cmd == NL80211_CMD_GET_SCAN) {
+            n = reply_scan(req, out);
+        } else {
+            n = reply_error(req, out, -EOPNOTSUPP);
+        }
+        if (send(m->fd, out, n, MSG_NOSIGNAL) < 0) break;
+        m->replies++;
+    }
+    return NULL;
+}
+
+int nlmock_start(struct nlmock *m, const char *path, int *client_fd)
+{
+    int sv[2];
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+
+    if (path ? !load_sets(m, path) : !synth_sets(m)) {
+        free(m->sets);
+        m->sets = NULL;
+        return 0;
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        free(m->sets);
+        m->sets = NULL;
+        return 0;
+    }
+    m->fd = sv[1];
+    if (pthread_create(&m->thread, NULL, responder, m) != 0) {
+        close(sv[0]);
+        close(sv[1]);
+        free(m->sets);
+        m->sets = NULL;
+        return 0;
+    }
+    *client_fd = sv[0];
+    return 1;
+}
+
+void nlmock_stop(struct nlmock *m)
+{
+    if (m->fd < 0) return;
+    shutdown(m->fd, SHUT_RDWR);
+    pthread_join(m->thread, NULL);
+    close(m->fd);
+    m->fd = -1;
+    free(m->sets);
+    m->sets = NULL;
+}
+
+int nlmock_send_link(int fd, uint32_t ifindex, int up)
+{
+    uint8_t buf[256] __attribute__((aligned(4)));
+    struct nlmsghdr *n = (struct nlmsghdr *)buf;
+    memset(buf, 0, sizeof(buf));
+    n->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    n->nlmsg_type = RTM_NEWLINK;
+
+    struct ifinfomsg *ifi = NLMSG_DATA(n);
+    ifi->ifi_family = AF_UNSPEC;
+    ifi->ifi_index = (int)ifindex;
+    ifi->ifi_flags = IFF_UP | (up ? IFF_RUNNING | IFF_LOWER_UP : 0);
+    ifi->ifi_change = IFF_RUNNING;
+
+    uint8_t oper = up ? IF_OPER_UP : IF_OPER_DORMANT;
+    nla_put(n, sizeof(buf), IFLA_OPERSTATE, &oper, sizeof(oper));
+    return send(fd, buf, n->nlmsg_len, MSG_NOSIGNAL) > 0;
+}
+
+int nlmock_send_mlme(int fd, uint32_t ifindex, int connected)
+{
+    uint8_t buf[256] __attribute__((aligned(4)));
+    struct nlmsghdr *n = genlmsg_init(buf, NLMOCK_FAMILY, 0, 0,
+                                      connected ? NL80211_CMD_CONNECT : NL80211_CMD_DISCONNECT);
+    nla_put(n, sizeof(buf), NL80211_ATTR_IFINDEX, &ifindex, sizeof(ifindex));
+    if (connected) {
+        uint16_t status = 0;
+        nla_put(n, sizeof(buf), NL80211_ATTR_STATUS_CODE, &status, sizeof(status));
+    }
+    return send(fd, buf, n->nlmsg_len, MSG_NOSIGNAL) > 0;
+}
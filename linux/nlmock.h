@@ -0,0 +1,38 @@
+#ifndef SNR_NLMOCK_H
+#define SNR_NLMOCK_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NLMOCK_FAMILY 0x1c
+#define NLMOCK_MLME_GROUP 5
+
+/*
+ * In-process stand-in for the kernel side of nl80211. It answers the
+ * family lookup and GET_STATION dumps on one end of a SEQPACKET socketpair,
+ * replaying station attribute sets recorded with `snrmon --record`, or a
+ * synthetic walk when no recording is given. GET_SCAN dumps list the same
+ * office of 24 access points every time.
+ */
+struct nlmock {
+    int fd;
+    pthread_t thread;
+    uint8_t *sets;      /* [u32 len][attrs] records back to back */
+    size_t sets_len;
+    size_t pos;
+    unsigned replies;
+    _Atomic unsigned stall_every;   /* leave every Nth station dump unanswered */
+};
+
+int nlmock_start(struct nlmock *m, const char *path, int *client_fd);
+void nlmock_stop(struct nlmock *m);
+
+/*
+ * Mock event source for linkwatch: write an RTM_NEWLINK notification or an
+ * nl80211 CONNECT/DISCONNECT multicast event to one end of a socketpair.
+ */
+int nlmock_send_link(int fd, uint32_t ifindex, int up);
+int nlmock_send_mlme(int fd, uint32_t ifindex, int connected);
+
+#endif
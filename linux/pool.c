@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define DEQUE_MASK (POOL_DEQUE_SIZE - 1)
+
+static _Thread_local struct pool_worker *self;
+
+/* --- Chase-Lev deque: the owner pushes and pops at the bottom, thieves take the top --- */
+
+static int deque_push(struct pool_deque *d, struct pool_task *t)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - top >= POOL_DEQUE_SIZE) return 0;
+    atomic_store_explicit(&d->buf[b & DEQUE_MASK], t, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+static struct pool_task *deque_pop(struct pool_deque *d)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (top > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    struct pool_task *t = atomic_load_explicit(&d->buf[b & DEQUE_MASK], memory_order_relaxed);
+    if (top == b) {
+        /* The last task: race the thieves for it. */
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &top, top + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            t = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return t;
+}
+
+static struct pool_task *deque_steal(struct pool_deque *d)
+{
+    int64_t top = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (top >= b) return NULL;
+    struct pool_task *t = atomic_load_explicit(&d->buf[top & DEQUE_MASK], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return t;
+}
+
+static int deque_empty(struct pool_deque *d)
+{
+    int64_t top = atomic_load_explicit(&d->top, memory_order_acquire);
+    return top >= atomic_load_explicit(&d->bottom, memory_order_acquire);
+}
+
+/* --- scheduling --- */
+
+static struct pool_task *inject_pop(struct pool *p, int lane)
+{
+    if (!atomic_load_explicit(&p->injected[lane], memory_order_acquire)) return NULL;
+    pthread_mutex_lock(&p->lock);
+    struct pool_task *t = p->inject_head[lane];
+    if (t) {
+        p->inject_head[lane] = t->next;
+        if (!t->next) p->inject_tail[lane] = NULL;
+        atomic_fetch_sub(&p->injected[lane], 1);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return t;
+}
+
+static uint32_t next_rng(uint32_t *r)
+{
+    *r ^= *r << 13;
+    *r ^= *r >> 17;
+    *r ^= *r << 5;
+    return *r;
+}
+
+/* Own deque, then the injection list, then the other workers from a random one on. */
+static struct pool_task *take(struct pool *p, struct pool_worker *w, int lane)
+{
+    struct pool_task *t = deque_pop(&w->deque[lane]);
+    if (t || (t = inject_pop(p, lane))) return t;
+    unsigned n = p->nworkers, start = next_rng(&w->rng) % n;
+    for (unsigned i = 0; i < n; i++) {
+        struct pool_worker *v = &p->workers[(start + i) % n];
+        if (v == w) continue;
+        if ((t = deque_steal(&v->deque[lane])) != NULL) {
+            w->stolen++;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static struct pool_task *next_task(struct pool *p, struct pool_worker *w)
+{
+    int first = w->streak >= POOL_STARVE_LIMIT ? POOL_BACKGROUND : POOL_REALTIME;
+    for (int k = 0; k < POOL_LANES; k++) {
+        int lane = k ? POOL_LANES - 1 - first : first;
+        struct pool_task *t = take(p, w, lane);
+        if (t) {
+            w->streak = lane == POOL_REALTIME ? w->streak + 1 : 0;
+            w->ran[lane]++;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void run_task(struct pool *p, struct pool_task *t)
+{
+    struct pool_group *g = t->group;
+    t->fn(t);
+    if (g && atomic_fetch_sub(&g->pending, 1) == 1 && atomic_load(&p->waiters)) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->done_cv);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static int any_work(struct pool *p)
+{
+    for (int lane = 0; lane < POOL_LANES; lane++) {
+        if (atomic_load(&p->injected[lane])) return 1;
+        for (unsigned i = 0; i < p->nworkers; i++) {
+            if (!deque_empty(&p->workers[i].deque[lane])) return 1;
+        }
+    }
+    return 0;
+}
+
+/* The index-th CPU this process may run on. */
+static void pin(unsigned index)
+{
+    cpu_set_t allowed, one;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) return;
+    unsigned k = index % (unsigned)CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || k--) continue;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+        return;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    struct pool_worker *w = arg;
+    struct pool *p = w->pool;
+    self = w;
+    while (!atomic_load(&p->stop)) {
+        struct pool_task *t = NULL;
+        for (int spin = 0; !t && spin < POOL_SPINS; spin++) {
+            if ((t = next_task(p, w)) == NULL) sched_yield();
+        }
+        if (t) {
+            run_task(p, t);
+            continue;
+        }
+        /* Sleep. A submitter that missed our sleepers count is one whose work any_work sees. */
+        pthread_mutex_lock(&p->lock);
+        atomic_fetch_add(&p->sleepers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!atomic_load(&p->stop) && !any_work(p)) pthread_cond_wait(&p->work_cv, &p->lock);
+        atomic_fetch_sub(&p->sleepers, 1);
+        pthread_mutex_unlock(&p->lock);
+    }
+    self = NULL;
+    return NULL;
+}
+
+static void *pinned_main(void *arg)
+{
+    struct pool_worker *w = arg;
+    pin(w->index);
+    return worker_main(w);
+}
+
+int pool_init(struct pool *p, unsigned n, unsigned flags)
+{
+    memset(p, 0, sizeof(*p));
+    if (n == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    if (n > POOL_MAX_WORKERS) n = POOL_MAX_WORKERS;
+
+    void *mem;
+    if (posix_memalign(&mem, 64, n * sizeof(struct pool_worker)) != 0) return 0;
+    memset(mem, 0, n * sizeof(struct pool_worker));
+    p->workers = mem;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_cv, NULL);
+    pthread_cond_init(&p->done_cv, NULL);
+
+    /* Workers steal from all n from the start; a deque not yet in use is simply empty. */
+    p->nworkers = n;
+    for (unsigned i = 0; i < n; i++) {
+        struct pool_worker *w = &p->workers[i];
+        w->pool = p;
+        w->index = i;
+        w->rng = 0x9e3779b9u * (i + 1);
+    }
+    for (; p->started < n; p->started++) {
+        struct pool_worker *w = &p->workers[p->started];
+        if (pthread_create(&w->thread, NULL, flags & POOL_PIN ? pinned_main : worker_main, w) != 0) {
+            pool_destroy(p);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void pool_destroy(struct pool *p)
+{
+    if (!p->workers) return;
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->stop, 1);
+    pthread_cond_broadcast(&p->work_cv);
+    pthread_mutex_unlock(&p->lock);
+    for (unsigned i = 0; i < p->started; i++) pthread_join(p->workers[i].thread, NULL);
+    pthread_cond_destroy(&p->work_cv);
+    pthread_cond_destroy(&p->done_cv);
+    pthread_mutex_destroy(&p->lock);
+    free(p->workers);
+    p->workers = NULL;
+    p->nworkers = p->started = 0;
+}
+
+void pool_submit(struct pool *p, struct pool_task *t, int lane, struct pool_group *g)
+{
+    t->lane = lane;
+    t->group = g;
+    t->next = NULL;
+    if (g) atomic_fetch_add(&g->pending, 1);
+
+    if (self && self->pool == p) {
+        /* A full deque means plenty queued already: run this one now. */
+        if (!deque_push(&self->deque[lane], t)) {
+            run_task(p, t);
+            return;
+        }
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!atomic_load_explicit(&p->sleepers, memory_order_relaxed)) return;
+        pthread_mutex_lock(&p->lock);
+    } else {
+        pthread_mutex_lock(&p->lock);
+        if (p->inject_tail[lane]) p->inject_tail[lane]->next = t;
+        else p->inject_head[lane] = t;
+        p->inject_tail[lane] = t;
+        atomic_fetch_add(&p->injected[lane], 1);
+    }
+    if (atomic_load(&p->sleepers)) pthread_cond_signal(&p->work_cv);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_wait(struct pool *p, struct pool_group *g)
+{
+    if (self && self->pool == p) {
+        while (atomic_load(&g->pending)) {
+            struct pool_task *t = next_task(p, self);
+            if (t) run_task(p, t);
+            else sched_yield();
+        }
+        return;
+    }
+    atomic_fetch_add(&p->waiters, 1);
+    pthread_mutex_lock(&p->lock);
+    while (atomic_load(&g->pending)) pthread_cond_wait(&p->done_cv, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+    atomic_fetch_sub(&p->waiters, 1);
+}
+
+int pool_worker_index(void)
+{
+    return self ? (int)self->index : -1;
+}
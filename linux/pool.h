@@ -0,0 +1,101 @@
+#ifndef SNR_POOL_H
+#define SNR_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Work-stealing thread pool shared by the subsystems that need threads
+ * for CPU or I/O work.
+ *
+ * Each worker has a Chase-Lev deque per lane. A task submitted from a
+ * worker goes to the bottom of that worker's deque, and the worker pops
+ * from the bottom again. A task submitted from any other thread goes to
+ * the lane's shared injection list. A worker with nothing of its own
+ * takes from the injection list, then steals from the top of other
+ * workers' deques. The deques use the C11 formulation of Le et al.
+ * (PPoPP 2013). They have a fixed size; a push that finds its deque full
+ * runs the task inline, which is also what a fork-join caller wants.
+ *
+ * There are two lanes. A worker looks for realtime work first. After
+ * POOL_STARVE_LIMIT realtime tasks in a row it looks for background work
+ * first once, so a realtime flood slows compaction but cannot stop it.
+ * A lane does not preempt a task that is running: keep tasks short.
+ *
+ * Tasks are caller-owned and intrusive, like timers, so submitting
+ * allocates nothing. A group counts a batch's unfinished tasks.
+ */
+
+#define POOL_DEQUE_SIZE 4096    /* per worker and lane; a power of two */
+#define POOL_STARVE_LIMIT 16
+#define POOL_MAX_WORKERS 64
+#define POOL_SPINS 64           /* empty scans before a worker sleeps */
+
+enum pool_lane {
+    POOL_REALTIME,              /* sampling and anything on its deadline */
+    POOL_BACKGROUND,            /* compaction, analysis */
+    POOL_LANES
+};
+
+/* pool_init flags */
+#define POOL_PIN 1              /* pin worker i to online CPU i mod ncpus */
+
+struct pool_group {
+    atomic_size_t pending;      /* zero-initialised: an empty group */
+};
+
+struct pool_task {
+    void (*fn)(struct pool_task *t);    /* may free or resubmit t */
+    void *arg;
+    struct pool_task *next;     /* on an injection list */
+    struct pool_group *group;
+    int lane;
+};
+
+struct pool_deque {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic(struct pool_task *) buf[POOL_DEQUE_SIZE];
+};
+
+struct pool_worker {
+    struct pool *pool;
+    pthread_t thread;
+    unsigned index;
+    uint32_t rng;               /* victim choice */
+    unsigned streak;            /* realtime tasks run in a row */
+    uint64_t ran[POOL_LANES];   /* tasks run, for fairness checks */
+    uint64_t stolen;
+    struct pool_deque deque[POOL_LANES];
+};
+
+struct pool {
+    unsigned nworkers;
+    unsigned started;           /* threads running; only pool_init and pool_destroy use it */
+    struct pool_worker *workers;
+    pthread_mutex_t lock;       /* injection lists, and sleep and wake */
+    pthread_cond_t work_cv, done_cv;
+    struct pool_task *inject_head[POOL_LANES], *inject_tail[POOL_LANES];
+    atomic_size_t injected[POOL_LANES];
+    atomic_uint sleepers, waiters;
+    atomic_int stop;
+};
+
+/* Starts n workers, or one per online CPU if n is 0. Returns 0 on failure. */
+int pool_init(struct pool *p, unsigned n, unsigned flags);
+
+/* Stops the workers after the tasks they are running; tasks still queued never run. */
+void pool_destroy(struct pool *p);
+
+/* Queues t on lane; g may be NULL. From a worker, t goes on that worker's deque. */
+void pool_submit(struct pool *p, struct pool_task *t, int lane, struct pool_group *g);
+
+/* Returns when every task in g has finished. A worker runs other tasks meanwhile; any other thread sleeps. */
+void pool_wait(struct pool *p, struct pool_group *g);
+
+/* The calling worker's index, or -1 on a thread outside the pool. */
+int pool_worker_index(void);
+
+#endif
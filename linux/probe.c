@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "probe.h"
+
+static const struct backend *const candidates[] = {
+    &nl80211_backend,
+    &procfs_backend,
+    &iw_backend,
+    &iwconfig_backend,
+};
+
+#define NUM_CANDIDATES (sizeof(candidates) / sizeof(candidates[0]))
+
+static void build_key(struct probe *p)
+{
+    struct utsname u;
+    char link[256], path[96];
+    const char *driver = "none";
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/driver", p->ifname);
+    ssize_t n = readlink(path, link, sizeof(link) - 1);
+    if (n > 0) {
+        link[n] = '\0';
+        const char *slash = strrchr(link, '/');
+        driver = slash ? slash + 1 : link;
+    }
+    if (uname(&u) != 0) strcpy(u.release, "unknown");
+    /* The needed fields are part of the key: a choice made for fewer does not stand for more. */
+    snprintf(p->key, sizeof(p->key), "%.64s|%.64s|%.32s|%x", u.release, driver, p->ifname, p->needed);
+}
+
+const struct backend *backend_by_name(const char *name)
+{
+    for (size_t i = 0; i < NUM_CANDIDATES; i++) {
+        if (strcmp(candidates[i]->name, name) == 0) return candidates[i];
+    }
+    return NULL;
+}
+
+static int load_cache(struct probe *p)
+{
+    FILE *fp = fopen(p->cache_path, "r");
+    if (!fp) return 0;
+
+    char line[320], name[32];
+    unsigned long long cost;
+    size_t klen = strlen(p->key);
+    int ok = 0;
+    while (!ok && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, p->key, klen) != 0 || line[klen] != ' ') continue;
+        if (sscanf(line + klen, " %31s %llu", name, &cost) != 2) continue;
+
+        const struct backend *b = backend_by_name(name);
+        if (!b) continue;
+        p->backend = *b;
+        p->backend.deadline_ms = p->deadline_ms;
+        if (p->backend.open(&p->backend, p->ifname)) {
+            p->cost_ns = cost;
+            ok = 1;
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+/* Rewrites the cache with this key's line replaced, via rename. */
+static void store_cache(const struct probe *p)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", p->cache_path);
+
+    FILE *out = fopen(tmp, "w");
+    if (!out) return;
+
+    FILE *in = fopen(p->cache_path, "r");
+    size_t klen = strlen(p->key);
+    if (in) {
+        char line[320];
+        while (fgets(line, sizeof(line), in)) {
+            if (strncmp(line, p->key, klen) == 0 && line[klen] == ' ') continue;
+            fputs(line, out);
+        }
+        fclose(in);
+    }
+    fprintf(out, "%s %s %llu\n", p->key, p->backend.name, (unsigned long long)p->cost_ns);
+    if (fclose(out) == 0) rename(tmp, p->cache_path);
+    else unlink(tmp);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Times one candidate; returns the fields it supplied, 0 if it never worked. */
+static unsigned measure(struct backend *b, const char *ifname, uint64_t *cost_ns)
+{
+    uint64_t ns[PROBE_SAMPLES];
+    unsigned fields = 0;
+    int ok = 0;
+
+    if (!b->open(b, ifname)) return 0;
+    for (int i = 0; i < PROBE_SAMPLES; i++) {
+        struct wifi_sample s = {0};
+        uint64_t t0 = mono_ns();
+        if (b->sample(b, &s) == 1) {
+            fields |= s.fields;
+            ok++;
+        }
+        ns[i] = mono_ns() - t0;
+        /* A backend that fails outright is not worth four more execs. */
+        if (!ok) break;
+    }
+    if (!ok) {
+        b->close(b);
+        return 0;
+    }
+    qsort(ns, PROBE_SAMPLES, sizeof(ns[0]), cmp_u64);
+    *cost_ns = ns[PROBE_SAMPLES / 2];
+    return fields;
+}
+
+int probe_select(struct probe *p, int use_cache)
+{
+    if (!p->key[0]) build_key(p);
+    p->failures = 0;
+    p->cached = 0;
+
+    if (use_cache && p->cache_path && load_cache(p)) {
+        p->cached = 1;
+        return 1;
+    }
+
+    int best = -1, best_full = 0;
+    uint64_t best_cost = 0;
+    for (size_t i = 0; i < NUM_CANDIDATES; i++) {
+        struct backend b = *candidates[i];
+        b.deadline_ms = p->deadline_ms;
+        uint64_t cost;
+        unsigned fields = measure(&b, p->ifname, &cost);
+        if (!fields) continue;
+        b.close(&b);
+
+        /* Prefer backends with every needed field, then the cheapest. */
+        int full = (fields & p->needed) == p->needed;
+        if (best < 0 || full > best_full || (full == best_full && cost < best_cost)) {
+            best = (int)i;
+            best_full = full;
+            best_cost = cost;
+        }
+    }
+    if (best < 0) return 0;
+
+    p->backend = *candidates[best];
+    p->backend.deadline_ms = p->deadline_ms;
+    if (!p->backend.open(&p->backend, p->ifname)) return 0;
+    p->cost_ns = best_cost;
+    if (p->cache_path) store_cache(p);
+    return 1;
+}
+
+int probe_sample(struct probe *p, struct wifi_sample *s)
+{
+    int rc = p->backend.sample ? p->backend.sample(&p->backend, s) : 0;
+    if (rc == 1) {
+        p->failures = 0;
+        return 1;
+    }
+    if (++p->failures >= PROBE_FAILURES && !p->fixed) {
+        if (p->backend.close) p->backend.close(&p->backend);
+        p->backend = (struct backend){0};
+        probe_select(p, 0);
+    }
+    return rc;
+}
+
+void probe_close(struct probe *p)
+{
+    if (p->backend.close) p->backend.close(&p->backend);
+}
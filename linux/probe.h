@@ -0,0 +1,35 @@
+#ifndef SNR_PROBE_H
+#define SNR_PROBE_H
+
+#include <stdint.h>
+#include "backend.h"
+
+#define PROBE_SAMPLES 5
+#define PROBE_FAILURES 5
+
+/*
+ * Picks the cheapest backend that supplies the needed fields by timing
+ * each candidate once, then sticks with it. The decision can be cached on
+ * disk keyed by kernel release, driver and interface; it is only revisited
+ * after PROBE_FAILURES consecutive failed samples.
+ */
+struct probe {
+    const char *ifname;
+    unsigned needed;        /* FIELD_* bits the caller requires */
+    const char *cache_path; /* NULL keeps the decision in memory only */
+    unsigned deadline_ms;   /* per-call deadline handed to every backend */
+    char key[192];
+    struct backend backend; /* the selected backend, open */
+    uint64_t cost_ns;       /* median sample cost measured while probing */
+    int cached;             /* 1 if the decision came from cache_path */
+    int fixed;              /* backend chosen by the user: never re-probe */
+    int failures;
+};
+
+const struct backend *backend_by_name(const char *name);
+int probe_select(struct probe *p, int use_cache);
+/* Returns 1, 0, or SAMPLE_TIMEOUT; timeouts count as failures too. */
+int probe_sample(struct probe *p, struct wifi_sample *s);
+void probe_close(struct probe *p);
+
+#endif
@@ -0,0 +1,88 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "backend.h"
+
+struct procfs_priv {
+    int fd;
+    char ifname[32];
+    char buf[4096];
+};
+
+/*
+ * Parses the /proc/net/wireless row for ifname. Level and noise are dBm
+ * on any driver that still reports them; -256 marks a missing value.
+ */
+int parse_proc_wireless(const char *text, const char *ifname, struct wifi_sample *s)
+{
+    size_t n = strlen(ifname);
+    const char *line = text;
+
+    while (line && *line) {
+        const char *p = line;
+        while (*p == ' ') p++;
+        if (strncmp(p, ifname, n) == 0 && p[n] == ':') {
+            char *end;
+            p += n + 1;
+            strtol(p, &end, 16);            /* status */
+            strtod(end, &end);              /* link quality */
+            double level = strtod(end, &end);
+            double noise = strtod(end, &end);
+            if (level > -256 && level < 0) {
+                s->signal_dbm = (int8_t)level;
+                s->fields |= FIELD_SIGNAL;
+            }
+            if (noise > -256 && noise < 0) {
+                s->noise_dbm = (int8_t)noise;
+                s->fields |= FIELD_NOISE;
+            }
+            return (s->fields & FIELD_SIGNAL) != 0;
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    return 0;
+}
+
+static int procfs_open(struct backend *b, const char *ifname)
+{
+    struct procfs_priv *pf = malloc(sizeof(*pf));
+    if (!pf) return 0;
+    pf->fd = open("/proc/net/wireless", O_RDONLY | O_CLOEXEC);
+    if (pf->fd < 0) {
+        free(pf);
+        return 0;
+    }
+    strncpy(pf->ifname, ifname, sizeof(pf->ifname) - 1);
+    pf->ifname[sizeof(pf->ifname) - 1] = '\0';
+    b->priv = pf;
+    return 1;
+}
+
+static int procfs_sample(struct backend *b, struct wifi_sample *s)
+{
+    struct procfs_priv *pf = b->priv;
+    ssize_t n = pread(pf->fd, pf->buf, sizeof(pf->buf) - 1, 0);
+    if (n <= 0) return 0;
+    pf->buf[n] = '\0';
+    return parse_proc_wireless(pf->buf, pf->ifname, s);
+}
+
+static void procfs_close(struct backend *b)
+{
+    struct procfs_priv *pf = b->priv;
+    if (!pf) return;
+    close(pf->fd);
+    free(pf);
+    b->priv = NULL;
+}
+
+const struct backend procfs_backend = {
+    .name = "procfs",
+    .fields = FIELD_SIGNAL | FIELD_NOISE,
+    .open = procfs_open,
+    .sample = procfs_sample,
+    .close = procfs_close,
+};
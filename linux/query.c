@@ -0,0 +1,230 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "query.h"
+
+static int parse_mac(const char *s, uint8_t mac[6])
+{
+    unsigned b[6];
+    char tail;
+    if (sscanf(s, "%2x:%2x:%2x:%2x:%2x:%2x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &tail) != 6) return 0;
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)b[i];
+    return 1;
+}
+
+/* YYYY-MM-DD[THH:MM[:SS]] in UTC, or Unix seconds. */
+static int parse_time(const char *s, uint64_t *ns)
+{
+    struct tm tm = {0};
+    char *end;
+    unsigned long long secs = strtoull(s, &end, 10);
+    if (*end == '\0' && end != s) {
+        *ns = secs * 1000000000ull;
+        return 1;
+    }
+    end = strptime(s, "%Y-%m-%d", &tm);
+    if (end && *end == 'T') {
+        char *t = strptime(end + 1, "%H:%M:%S", &tm);
+        end = t ? t : strptime(end + 1, "%H:%M", &tm);
+    }
+    if (!end || *end) return 0;
+    time_t t = timegm(&tm);
+    if (t < 0) return 0;
+    *ns = (uint64_t)t * 1000000000ull;
+    return 1;
+}
+
+/* Narrows the closed range [*lo, *hi] by "op value" over integers. */
+static int narrow(const char *op, long v, int *lo, int *hi)
+{
+    if (strcmp(op, "<") == 0) v--;
+    if (strcmp(op, ">") == 0) v++;
+    if (v < INT8_MIN) v = INT8_MIN - 1;
+    if (v > INT8_MAX) v = INT8_MAX + 1;
+    if (op[0] == '<' && v < *hi) *hi = (int)v;
+    else if (op[0] == '>' && v > *lo) *lo = (int)v;
+    else if (op[0] == '=') {
+        if (v > *lo) *lo = (int)v;
+        if (v < *hi) *hi = (int)v;
+    }
+    return 1;
+}
+
+int query_parse(const char *text, struct query *q, char *err, size_t err_size)
+{
+    memset(q, 0, sizeof(*q));
+    store_prune_all(&q->prune, 0, UINT64_MAX);
+    q->kern = kernel_best();
+    char *copy = strdup(text), *save = NULL;
+    if (!copy) {
+        snprintf(err, err_size, "out of memory");
+        return 0;
+    }
+
+    int ok = 1;
+    for (char *tok = strtok_r(copy, " \t,", &save); ok && tok; tok = strtok_r(NULL, " \t,", &save)) {
+        size_t name_len = strcspn(tok, "<>=");
+        const char *rest = tok + name_len;
+        char op[3] = {0};
+        size_t op_len = strspn(rest, "<>=");
+        if (name_len == 0 || op_len == 0 || op_len > 2) {
+            snprintf(err, err_size, "bad term \"%s\"", tok);
+            ok = 0;
+            break;
+        }
+        memcpy(op, rest, op_len);
+        const char *value = rest + op_len;
+        tok[name_len] = '\0';
+        int is_eq = strcmp(op, "=") == 0 || strcmp(op, "==") == 0;
+        int is_cmp = is_eq || strcmp(op, "<") == 0 || strcmp(op, "<=") == 0 || strcmp(op, ">") == 0 ||
+                     strcmp(op, ">=") == 0;
+        char *end;
+        long v = strtol(value, &end, 10);
+
+        if (strcmp(tok, "bssid") == 0 && is_eq) {
+            ok = parse_mac(value, q->prune.bssid);
+            q->prune.has_bssid = 1;
+        } else if ((strcmp(tok, "snr") == 0 || strcmp(tok, "signal") == 0) && is_cmp && *value && !*end) {
+            int snr = tok[1] == 'n';
+            ok = narrow(is_eq ? "=" : op, v, snr ? &q->prune.snr_lo : &q->prune.signal_lo,
+                        snr ? &q->prune.snr_hi : &q->prune.signal_hi);
+        } else if (strcmp(tok, "iface") == 0 && is_eq) {
+            ok = *value && strlen(value) < sizeof(q->iface);
+            if (ok) strcpy(q->iface, value);
+            q->ifname_id = UINT32_MAX;
+        } else if ((strcmp(tok, "from") == 0 || strcmp(tok, "to") == 0) && is_eq) {
+            ok = parse_time(value, tok[0] == 'f' ? &q->prune.from_ns : &q->prune.to_ns);
+        } else {
+            snprintf(err, err_size, "unknown term \"%s%s%s\"", tok, op, value);
+            ok = 0;
+            break;
+        }
+        if (!ok) snprintf(err, err_size, "bad value in \"%s%s%s\"", tok, op, value);
+    }
+    free(copy);
+    return ok;
+}
+
+void query_bind(struct query *q, const struct store_view *v)
+{
+    if (!q->iface[0]) return;
+    uint32_t id = intern_find(&v->strings, q->iface, strlen(q->iface));
+    q->ifname_id = id ? id : UINT32_MAX;
+}
+
+int query_match(const struct query *q, const struct wifi_sample *s)
+{
+    const struct store_prune *p = &q->prune;
+    if (s->ts_ns < p->from_ns || s->ts_ns >= p->to_ns || (s->fields & FIELD_GAP)) return 0;
+    if (q->iface[0] && s->ifname_id != q->ifname_id) return 0;
+    if (p->has_bssid && (!(s->fields & FIELD_BSSID) || memcmp(s->bssid, p->bssid, 6) != 0)) return 0;
+    int any_signal = p->signal_lo > INT8_MIN || p->signal_hi < INT8_MAX;
+    int any_snr = p->snr_lo > INT8_MIN || p->snr_hi < INT8_MAX;
+    if (!any_signal && !any_snr) return 1;
+    if (!(s->fields & FIELD_SIGNAL)) return 0;
+    int snr = (int)sample_snr(s);
+    return s->signal_dbm >= p->signal_lo && s->signal_dbm <= p->signal_hi && snr >= p->snr_lo && snr <= p->snr_hi;
+}
+
+void query_mask(const struct query *q, const struct block_columns *c, uint64_t *mask)
+{
+    const struct store_prune *p = &q->prune;
+    const struct kernel_ops *k = q->kern;
+    int any_signal = p->signal_lo > INT8_MIN || p->signal_hi < INT8_MAX;
+    int any_snr = p->snr_lo > INT8_MIN || p->snr_hi < INT8_MAX;
+    uint32_t need = (p->has_bssid ? FIELD_BSSID : 0) | (any_signal || any_snr ? FIELD_SIGNAL : 0);
+
+    kernel_mask_all(mask, c->n);
+    k->range_u64(c->ts_ns, c->n, p->from_ns, p->to_ns, mask);
+    k->bits_u32(c->fields, c->n, need, FIELD_GAP, mask);
+    if (p->has_bssid) k->eq_u64(c->bssid, c->n, block_pack_bssid(p->bssid), mask);
+    if (any_signal) k->range_i8(c->signal_dbm, c->n, p->signal_lo, p->signal_hi, mask);
+    if (any_snr) k->range_i8(c->snr_db, c->n, p->snr_lo, p->snr_hi, mask);
+    for (size_t i = 0; q->iface[0] && i < c->n; i++) {
+        if (c->ifname_id[i] != q->ifname_id) mask[i / 64] &= ~(1ull << (i % 64));
+    }
+}
+
+struct query_filter {
+    const struct query *q;
+    store_sample_fn fn;
+    void *ctx;
+    struct block_columns cols;
+    uint64_t mask[KERNEL_MASK_WORDS(BLOCK_MAX_SAMPLES)];
+    uint32_t rows[BLOCK_MAX_SAMPLES + KERNEL_SLACK];
+    struct wifi_sample out[BLOCK_MAX_SAMPLES];
+};
+
+/* Raw batches arrive as samples: filter their columns, then gather the rows that match. */
+static int filter_batch(void *arg, const struct wifi_sample *s, size_t n)
+{
+    struct query_filter *f = arg;
+    block_columns_from_samples(s, n, &f->cols);
+    query_mask(f->q, &f->cols, f->mask);
+    size_t k = f->q->kern->select(f->mask, n, f->rows);
+    for (size_t i = 0; i < k; i++) f->out[i] = s[f->rows[i]];
+    return k ? f->fn(f->ctx, f->out, k) : 1;
+}
+
+int query_run(const struct store_view *v, const struct query *q, store_sample_fn fn, void *ctx,
+              struct store_scan_stats *stats)
+{
+    struct query_filter *f = malloc(sizeof(*f));
+    if (!f) return 0;
+    f->q = q;
+    f->fn = fn;
+    f->ctx = ctx;
+    int ok = store_scan_pruned(v, &q->prune, filter_batch, f, stats);
+    free(f);
+    return ok;
+}
+
+struct query_summarizer {
+    const struct query *q;
+    struct query_summary *out;
+    uint64_t mask[KERNEL_MASK_WORDS(BLOCK_MAX_SAMPLES)];
+    uint64_t sub[KERNEL_MASK_WORDS(BLOCK_MAX_SAMPLES)];
+};
+
+static int summarize_block(void *arg, const struct block_columns *c)
+{
+    struct query_summarizer *z = arg;
+    const struct kernel_ops *k = z->q->kern;
+    struct query_summary *out = z->out;
+    size_t words = KERNEL_MASK_WORDS(c->n);
+
+    query_mask(z->q, c, z->mask);
+    size_t matches = kernel_count(z->mask, c->n);
+    if (!matches) return 1;
+    out->matches += matches;
+
+    memcpy(z->sub, z->mask, words * sizeof(*z->sub));
+    k->bits_u32(c->fields, c->n, FIELD_SIGNAL, 0, z->sub);
+    k->agg_i8(c->signal_dbm, z->sub, c->n, &out->signal);
+    k->agg_i8(c->snr_db, z->sub, c->n, &out->snr);
+    k->hist_i8(c->snr_db, z->sub, c->n, 0, QUERY_SNR_BUCKETS, out->snr_hist);
+
+    memcpy(z->sub, z->mask, words * sizeof(*z->sub));
+    k->bits_u32(c->fields, c->n, FIELD_HEALTH, 0, z->sub);
+    k->agg_f32(c->health, z->sub, c->n, &out->health);
+    return 1;
+}
+
+int query_summarize(const struct store_view *v, const struct query *q, struct query_summary *out,
+                    struct store_scan_stats *stats)
+{
+    memset(out, 0, sizeof(*out));
+    kernel_agg_init(&out->signal);
+    kernel_agg_init(&out->snr);
+    kernel_agg_init(&out->health);
+    struct query_summarizer *z = malloc(sizeof(*z));
+    if (!z) return 0;
+    z->q = q;
+    z->out = out;
+    int ok = store_scan_columns(v, &q->prune, summarize_block, z, stats);
+    free(z);
+    return ok;
+}
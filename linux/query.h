@@ -0,0 +1,59 @@
+#ifndef SNR_QUERY_H
+#define SNR_QUERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/kernel.h"
+#include "../common/sample.h"
+#include "store.h"
+
+/*
+ * Store queries: a conjunction of terms separated by spaces,
+ *
+ *     bssid=02:00:5e:10:20:31 snr<15 signal>=-70 from=2024-10-04 to=2024-10-05T12:00
+ *
+ * snr and signal take < <= > >= =, bssid and iface take =, from and to
+ * take a UTC date, date and time, or Unix seconds. Every term but iface
+ * maps onto the store's zone maps, so blocks that cannot match are never
+ * decoded. iface is a store's string ID, so it needs query_bind. The blocks
+ * that are decoded are filtered a column at a time with the kernels of
+ * common/kernel.h.
+ */
+
+#define QUERY_SNR_BUCKETS 64    /* 1 dB each from 0 dB; the last one also counts anything higher */
+
+struct query {
+    struct store_prune prune;
+    const struct kernel_ops *kern;      /* kernel_best() unless changed after parsing */
+    char iface[32];             /* "" for any interface */
+    uint32_t ifname_id;         /* iface in the bound store; UINT32_MAX matches nothing */
+};
+
+/* Aggregates over the matching samples; signal and SNR cover those with a signal reading. */
+struct query_summary {
+    uint64_t matches;
+    struct kernel_agg signal, snr, health;
+    uint64_t snr_hist[QUERY_SNR_BUCKETS];
+};
+
+int query_parse(const char *text, struct query *q, char *err, size_t err_size);
+
+/* Resolves iface against v's strings; a query without iface needs no binding. */
+void query_bind(struct query *q, const struct store_view *v);
+
+/* The per-sample form of the same conjunction. */
+int query_match(const struct query *q, const struct wifi_sample *s);
+
+/* The conjunction over c->n rows; mask has KERNEL_MASK_WORDS(c->n) words. */
+void query_mask(const struct query *q, const struct block_columns *c, uint64_t *mask);
+
+/* Calls fn with batches of matching samples; stats may be NULL. */
+int query_run(const struct store_view *v, const struct query *q, store_sample_fn fn, void *ctx,
+              struct store_scan_stats *stats);
+
+/* Aggregates without building a single sample: only the query columns are decoded. */
+int query_summarize(const struct store_view *v, const struct query *q, struct query_summary *out,
+                    struct store_scan_stats *stats);
+
+#endif
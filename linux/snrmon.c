@@ -0,0 +1,1123 @@
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <net/if.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/correlate.h"
+#include "../common/health.h"
+#include "../common/histogram.h"
+#include "../common/intern.h"
+#include "../common/pipeline.h"
+#include "../common/rules.h"
+#include "../common/sink.h"
+#include "../common/site.h"
+#include "../common/wheel.h"
+#include "align.h"
+#include "backend.h"
+#include "bench.h"
+#include "clock.h"
+#include "config.h"
+#include "control.h"
+#include "flight.h"
+#include "import.h"
+#include "linkwatch.h"
+#include "metrics.h"
+#include "nl80211.h"
+#include "netstats.h"
+#include "nlmock.h"
+#include "pool.h"
+#include "probe.h"
+#include "query.h"
+#include "store.h"
+
+#define DEFAULT_INTERFACE "wlan0"
+#define SAMPLING_INTERVAL_MS 500
+#define SMOOTHING_FACTOR 0.7f
+#define FLIGHT_MINUTES 10
+#define SITE_SCAN_INTERVAL_MS 30000
+
+static volatile sig_atomic_t running = 1;
+static int console = 1;     /* 0 in --daemon mode: no TTY, sinks only */
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static const char *classify(float snr, const float thresholds[3])
+{
+    if (snr < thresholds[0]) return "VERY CLOSE (<50 cm)";
+    if (snr < thresholds[1]) return "NORMAL RANGE (0.5-2 m)";
+    if (snr < thresholds[2]) return "MOVING AWAY (2-4 m)";
+    return "FAR AWAY (>4 m)";
+}
+
+static void sleep_ms(unsigned ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && running) {}
+}
+
+static void set_flag(struct timer *t, uint64_t now)
+{
+    (void)now;
+    *(int *)t->arg = 1;
+}
+
+static void kick_compactor(struct timer *t, uint64_t now)
+{
+    (void)now;
+    store_kick_compactor(t->arg);
+}
+
+static void format_time(uint64_t ts_ns, char *out, size_t size)
+{
+    time_t now = (time_t)(ts_ns / 1000000000ull);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(out, size, "%H:%M:%S", &tm_info);
+}
+
+static void print_sample(const struct wifi_sample *s, float smoothed, const float proximity[3])
+{
+    if (!console) return;
+    char time_str[10];
+    format_time(s->ts_ns, time_str, sizeof(time_str));
+
+    char rx[12] = "N/A", tx[12] = "N/A", retries[12] = "N/A", link[16] = "N/A";
+    if (s->fields & FIELD_RX_BITRATE) snprintf(rx, sizeof(rx), "%.1f", s->rx_bitrate_kbps / 1000.0);
+    if (s->fields & FIELD_TX_BITRATE) snprintf(tx, sizeof(tx), "%.1f", s->tx_bitrate_kbps / 1000.0);
+    if (s->fields & FIELD_TX_RETRIES) snprintf(retries, sizeof(retries), "%u", s->tx_retries);
+    if (s->fields & FIELD_LINK_RATES) {
+        snprintf(link, sizeof(link), "%.1f", (s->rx_bytes_per_s + s->tx_bytes_per_s) / 1e3);
+    }
+
+    printf("\r%-8s | %6.1f | %-8s | %4d dBm | %5.1f dB | %7s | %7s | %7s | %9s | %-22s", time_str,
+           s->health, health_class(s->health), s->signal_dbm, smoothed, rx, tx, retries, link,
+           classify(smoothed, proximity));
+    fflush(stdout);
+}
+
+static void print_latency_summary(const struct histogram *lat, const struct histogram *timeouts)
+{
+    printf("Backend latency: %llu calls, mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           (unsigned long long)lat->count, hist_mean(lat) / 1e3, hist_quantile(lat, 0.5) / 1e3,
+           hist_quantile(lat, 0.99) / 1e3, lat->max / 1e3);
+    if (timeouts->count) {
+        printf("Deadline expired: %llu gaps, waited p50 %.1f ms, max %.1f ms\n",
+               (unsigned long long)timeouts->count, hist_quantile(timeouts, 0.5) / 1e6,
+               timeouts->max / 1e6);
+    }
+}
+
+/* Once per backend: say which health inputs it cannot supply rather than score on fewer in silence. */
+static void check_health_inputs(const struct backend *b, const char **checked)
+{
+    if (!b->name || *checked == b->name) return;
+    *checked = b->name;
+    unsigned missing = HEALTH_FIELDS & ~b->fields;
+    if (!missing) return;
+    char list[64] = "";
+    if (missing & (FIELD_RX_BITRATE | FIELD_TX_BITRATE)) strcat(list, ", bitrates");
+    if (missing & (FIELD_TX_RETRIES | FIELD_TX_PACKETS)) strcat(list, ", retries");
+    if (missing & FIELD_BEACON_LOSS) strcat(list, ", beacon loss");
+    if (missing & FIELD_SIGNAL) strcat(list, ", signal");
+    fprintf(stderr, "%sWARNING: The %s backend has no %s; the health index is scored without them\n",
+            console ? "\r" : "", b->name, list + 2);
+}
+
+static void print_transition(const struct link_event *ev, struct rule_set *rules)
+{
+    /* Rule windows run on the samples' wall clock; ev->ts_ns is monotonic. */
+    rules_event(rules, wall_ns(), ev->state == LINK_UP ? RULE_EV_CONNECT : RULE_EV_DISCONNECT);
+    if (!console) return;
+    if (ev->state == LINK_UP) {
+        printf("\n[+] Connected! Starting live monitoring...\n\n");
+    } else {
+        printf("\n[-] Disconnected. Waiting for Wi-Fi connection...\n\n");
+    }
+}
+
+/*
+ * --sites DIR: every scan picks the site from DIR/library and applies
+ * DIR/NAME.conf, config syntax over the command line, as its calibration.
+ * A NAME.conf without rule lines keeps the --rules rules.
+ * What the link did while there is folded into the site's baseline when
+ * the monitor leaves it.
+ */
+struct sites {
+    const char *dir;
+    char path[256];
+    const char *enroll;         /* --enroll-site: the next scan is this site */
+    struct site_lib lib;
+    long current;               /* -1: no known site, command-line settings */
+    struct config cfg;
+    int have_cfg;
+    struct rule_set *cmdline_rules;     /* --rules, lent to cfg while borrowed */
+    int borrowed;
+    uint64_t switches;
+    double snr, signal, health;
+    uint64_t samples;
+};
+
+static void site_note(const char *fmt, ...)
+{
+    char msg[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    if (console) printf("\r%-110s\n", msg);
+    else fprintf(stderr, "snrmon: %s\n", msg);
+}
+
+static int sites_open(struct sites *st, const char *dir, const char *enroll, struct rule_set *cmdline_rules)
+{
+    char err[320];
+    memset(st, 0, sizeof(*st));
+    st->dir = dir;
+    st->cmdline_rules = cmdline_rules;
+    st->enroll = enroll;
+    st->current = -1;
+    snprintf(st->path, sizeof(st->path), "%s/library", dir);
+    if (!site_lib_load(&st->lib, st->path, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s\n", err);
+        return 0;
+    }
+    return 1;
+}
+
+/* Folds the visit into the current site's baseline and saves the library. */
+static void sites_leave(struct sites *st)
+{
+    char err[320];
+    if (st->current >= 0 && st->samples) {
+        double n = (double)st->samples;
+        struct site_baseline visit = { (float)(st->snr / n), (float)(st->signal / n), (float)(st->health / n),
+                                       st->samples };
+        site_baseline_merge(&st->lib.sites[st->current].base, &visit);
+        if (!site_lib_save(&st->lib, st->path, err, sizeof(err))) site_note("WARNING: %s", err);
+    }
+    st->snr = st->signal = st->health = 0;
+    st->samples = 0;
+}
+
+/* Frees the site's config, handing borrowed --rules back first. */
+static void sites_drop_cfg(struct sites *st)
+{
+    if (!st->have_cfg) return;
+    if (st->borrowed) {
+        *st->cmdline_rules = st->cfg.rules;
+        memset(&st->cfg.rules, 0, sizeof(st->cfg.rules));
+        st->borrowed = 0;
+    }
+    rules_free(&st->cfg.rules);
+    st->have_cfg = 0;
+}
+
+static void sites_enter(struct sites *st, long i, float score, const struct config *base)
+{
+    char path[320], err[160];
+    sites_drop_cfg(st);
+    st->current = i;
+    if (i < 0) {
+        site_note("Unknown site (best match %.2f): command-line settings", score);
+        return;
+    }
+    const struct site *s = &st->lib.sites[i];
+    snprintf(path, sizeof(path), "%s/%s.conf", st->dir, s->name);
+    if (access(path, F_OK) == 0) {
+        if (config_load(path, base, &st->cfg, err, sizeof(err))) {
+            st->cfg.generation = ++st->switches;
+            st->have_cfg = 1;
+            /* A file without rule lines keeps --rules, windows and all: they move here and back on leaving. */
+            if (!st->cfg.rules.nrules && st->cmdline_rules->nrules) {
+                rules_free(&st->cfg.rules);
+                st->cfg.rules = *st->cmdline_rules;
+                memset(st->cmdline_rules, 0, sizeof(*st->cmdline_rules));
+                st->borrowed = 1;
+            }
+        } else {
+            site_note("WARNING: %s: %s", path, err);
+        }
+    }
+    if (s->base.samples) {
+        site_note("Site %s (match %.2f%s): baseline SNR %.1f dB, signal %.0f dBm, health %.0f", s->name, score,
+                  st->have_cfg ? ", calibrated" : "", s->base.snr_db, s->base.signal_dbm, s->base.health);
+    } else {
+        site_note("Site %s (match %.2f%s): no baseline yet", s->name, score, st->have_cfg ? ", calibrated" : "");
+    }
+}
+
+/* Fingerprints the scan cache and switches site if it matches another one. */
+static void sites_scan(struct sites *st, struct backend *b, const struct config *base)
+{
+    static struct site_ap aps[SITE_MAX_APS];
+    char err[320];
+    int n = nl80211_backend_scan(b, aps, SITE_MAX_APS);
+    if (n <= 0) return;     /* nothing cached, e.g. just after resume: stay put */
+
+    struct site_fp fp;
+    site_fingerprint(aps, (size_t)n, &fp);
+    float score = 1;
+    long i;
+    if (st->enroll) {
+        if (!fp.aps) return;
+        if ((i = site_lib_put(&st->lib, st->enroll, &fp)) < 0) {
+            site_note("WARNING: Could not enroll %s: out of memory", st->enroll);
+            return;
+        }
+        if (!site_lib_save(&st->lib, st->path, err, sizeof(err))) site_note("WARNING: %s", err);
+        else site_note("Enrolled site %s from %u access points", st->enroll, fp.aps);
+        st->enroll = NULL;
+    } else {
+        i = site_lib_match(&st->lib, &fp, &score);
+    }
+    if (i == st->current) return;
+    sites_leave(st);
+    sites_enter(st, i, score, base);
+}
+
+static void sites_sample(struct sites *st, const struct wifi_sample *s)
+{
+    if (st->current < 0) return;
+    st->snr += sample_snr(s);
+    st->signal += s->signal_dbm;
+    st->health += s->health;
+    st->samples++;
+}
+
+static void sites_close(struct sites *st)
+{
+    if (console && st->current >= 0 && st->samples && st->lib.sites[st->current].base.samples) {
+        const struct site *s = &st->lib.sites[st->current];
+        double n = (double)st->samples;
+        printf("Site %s: SNR %.1f dB (baseline %.1f), signal %.0f dBm (%.0f), health %.0f (%.0f)\n", s->name,
+               st->snr / n, s->base.snr_db, st->signal / n, s->base.signal_dbm, st->health / n, s->base.health);
+    }
+    sites_leave(st);
+    sites_drop_cfg(st);
+    site_lib_free(&st->lib);
+}
+
+/*
+ * The monitor's ends of the sample pipeline (common/pipeline.h): the
+ * source hands over the sample just probed, and the sink feeds the site,
+ * the sinks, the health alert, the rules and the console.
+ */
+struct monitor_tick {
+    struct wifi_sample *s;      /* the probed sample; the sink writes the scored one back */
+    int pending;
+    struct sites *sites;        /* NULL without --sites */
+    struct sink_set *sinks;
+    struct config *cfg;
+    struct link_correlation *corr;
+    float smoothed;
+    int have_smoothed;
+};
+
+static inline int monitor_source(void *arg, struct wifi_sample *s)
+{
+    struct monitor_tick *m = arg;
+    if (!m->pending) return 0;
+    m->pending = 0;
+    *s = *m->s;
+    return 1;
+}
+
+static inline void monitor_sink(void *arg, const struct wifi_sample *s, int cls, int edge)
+{
+    struct monitor_tick *m = arg;
+    (void)cls;
+    *m->s = *s;
+    if (m->sites) sites_sample(m->sites, s);
+    sinks_sample(m->sinks, s);
+    if (edge) health_alert_emit(s, edge > 0, m->sinks);
+    rules_sample(&m->cfg->rules, s, m->sinks);
+    float snr = sample_snr(s);
+    m->smoothed = m->have_smoothed ? SMOOTHING_FACTOR * m->smoothed + (1 - SMOOTHING_FACTOR) * snr : snr;
+    m->have_smoothed = 1;
+    correlation_add(m->corr, s, snr);
+    print_sample(s, m->smoothed, m->cfg->proximity);
+}
+
+/* Every sample the backend returns is scored, whatever fields it has. */
+PIPELINE_DEFINE(monitor_pipeline, *p->cfg, monitor_source, pipeline_filter_required, pipeline_features_health,
+                pipeline_classify_health, monitor_sink)
+
+static void default_control_path(char *out, size_t size)
+{
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    snprintf(out, size, "%s/snrmon.sock", dir && *dir ? dir : "/tmp");
+}
+
+/* --query: one request against a running monitor's control socket. */
+static int query(const char *path, const char *request)
+{
+    char out[CONTROL_OUT_MAX];
+    int n = control_query(path, request, out, sizeof(out));
+    if (n < 0) {
+        fprintf(stderr, "ERROR: No response from %s\n", path);
+        return 1;
+    }
+    fputs(out, stdout);
+    return strncmp(out, "OK", 2) == 0 ? 0 : 1;
+}
+
+/* --flight-dump: the consistent tail of a flight recorder file, oldest first. */
+static int flight_dump(const char *path)
+{
+    struct flight_tail t;
+    char err[128];
+    if (!flight_read(path, &t, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", path, err);
+        return 1;
+    }
+    printf("# %s: %u records of %u ms, %zu consistent (seq %llu-%llu), %zu written\n", t.header.ifname,
+           t.header.capacity, t.header.interval_ms, t.n, (unsigned long long)t.first_seq,
+           (unsigned long long)t.last_seq, t.valid);
+    printf("seq,time,result,backend_us,signal_dbm,snr_db,health,rx_mbps,tx_mbps,tx_retries,beacon_loss\n");
+    for (size_t i = 0; i < t.n; i++) {
+        const struct flight_record *r = &t.records[i];
+        const struct wifi_sample *s = &r->sample;
+        char time_str[10];
+        format_time(s->ts_ns, time_str, sizeof(time_str));
+        const char *result = r->rc == 1 ? "ok" : r->rc == SAMPLE_TIMEOUT ? "gap" : "unavailable";
+        printf("%llu,%s.%03u,%s,%.1f,", (unsigned long long)r->seq, time_str,
+               (unsigned)(s->ts_ns / 1000000u % 1000u), result, r->backend_ns / 1e3);
+        if (r->rc == 1 && (s->fields & FIELD_SIGNAL)) printf("%d,%.0f,", s->signal_dbm, sample_snr(s));
+        else printf(",,");
+        if (s->fields & FIELD_HEALTH) printf("%.1f", s->health);
+        printf(",");
+        if (s->fields & FIELD_RX_BITRATE) printf("%.1f", s->rx_bitrate_kbps / 1000.0);
+        printf(",");
+        if (s->fields & FIELD_TX_BITRATE) printf("%.1f", s->tx_bitrate_kbps / 1000.0);
+        printf(",");
+        if (s->fields & FIELD_TX_RETRIES) printf("%u", s->tx_retries);
+        printf(",");
+        if (s->fields & FIELD_BEACON_LOSS) printf("%u", s->beacon_loss);
+        printf("\n");
+    }
+    flight_tail_free(&t);
+    return 0;
+}
+
+/* --store-info: what the current manifest generation holds. */
+static int store_dump_info(const char *dir)
+{
+    struct store_view v;
+    char err[128];
+    if (!store_view_open(&v, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", dir, err);
+        return 1;
+    }
+    store_info(&v, stdout);
+    store_view_close(&v);
+    return 0;
+}
+
+struct match_printer {
+    struct store_view *v;
+    uint64_t count;
+};
+
+static int print_matches(void *ctx, const struct wifi_sample *s, size_t n)
+{
+    struct match_printer *m = ctx;
+    for (size_t i = 0; i < n; i++) {
+        time_t t = (time_t)(s[i].ts_ns / 1000000000ull);
+        struct tm tm;
+        char when[24];
+        gmtime_r(&t, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        const uint8_t *b = s[i].bssid;
+        printf("%s,%02x:%02x:%02x:%02x:%02x:%02x,%d,%.0f,%.1f,%.1f,%.1f,%u,%u,", when, b[0], b[1], b[2], b[3],
+               b[4], b[5], s[i].signal_dbm, sample_snr(&s[i]), s[i].health, s[i].rx_bitrate_kbps / 1000.0,
+               s[i].tx_bitrate_kbps / 1000.0, s[i].tx_retries, s[i].beacon_loss);
+        if (s[i].fields & FIELD_SSID) csv_string(stdout, store_view_string(m->v, s[i].ssid_id));
+        putchar(',');
+        csv_string(stdout, store_view_string(m->v, s[i].ifname_id));
+        putchar('\n');
+    }
+    m->count += n;
+    return 1;
+}
+
+static void print_agg(const char *name, const struct kernel_agg *a)
+{
+    if (a->count) {
+        printf("%-12s %8.1f %8.1f %8.1f  (%llu samples)\n", name, a->min, a->sum / a->count, a->max,
+               (unsigned long long)a->count);
+    } else {
+        printf("%-12s %8s %8s %8s\n", name, "-", "-", "-");
+    }
+}
+
+/* --summary: aggregates of the matches, and the SNR histogram folded into 5 dB rows. */
+static void print_summary(const struct query_summary *z)
+{
+    printf("%llu matches\n\n", (unsigned long long)z->matches);
+    printf("%-12s %8s %8s %8s\n", "", "min", "avg", "max");
+    print_agg("signal_dbm", &z->signal);
+    print_agg("snr_db", &z->snr);
+    print_agg("health", &z->health);
+    printf("\nsnr_db   samples\n");
+    for (int lo = 0; lo < QUERY_SNR_BUCKETS; lo += 5) {
+        uint64_t n = 0;
+        for (int b = lo; b < lo + 5 && b < QUERY_SNR_BUCKETS; b++) n += z->snr_hist[b];
+        if (lo + 5 >= QUERY_SNR_BUCKETS) printf("%2d+     %8llu\n", lo, (unsigned long long)n);
+        else printf("%2d-%-2d   %8llu\n", lo, lo + 4, (unsigned long long)n);
+    }
+}
+
+/* --scan: matching samples as CSV, or their --summary, and how much of the store was skipped. */
+static int store_query(const char *dir, const char *where, int summary)
+{
+    struct query q;
+    struct store_view v;
+    struct store_scan_stats stats;
+    char err[128];
+    if (!query_parse(where, &q, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: --where: %s\n", err);
+        return 1;
+    }
+    if (!store_view_open(&v, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", dir, err);
+        return 1;
+    }
+    query_bind(&q, &v);
+    uint64_t matches = 0;
+    int ok;
+    if (summary) {
+        struct query_summary z;
+        ok = query_summarize(&v, &q, &z, &stats);
+        if (ok) print_summary(&z);
+        matches = z.matches;
+    } else {
+        struct match_printer m = { &v, 0 };
+        printf("time,bssid,signal_dbm,snr_db,health,rx_mbps,tx_mbps,tx_retries,beacon_loss,ssid,interface\n");
+        ok = query_run(&v, &q, print_matches, &m, &stats);
+        matches = m.count;
+    }
+    store_view_close(&v);
+    uint64_t skipped = stats.skipped_time + stats.skipped_zone + stats.skipped_bloom;
+    fprintf(stderr, "%llu matches; %llu of %llu blocks skipped (time %llu, zone map %llu, bloom %llu), "
+            "%llu raw samples scanned\n", (unsigned long long)matches, (unsigned long long)skipped,
+            (unsigned long long)stats.blocks, (unsigned long long)stats.skipped_time,
+            (unsigned long long)stats.skipped_zone, (unsigned long long)stats.skipped_bloom,
+            (unsigned long long)stats.raw_samples);
+    return !ok;
+}
+
+static void print_import(const struct import_file *f, void *ctx)
+{
+    (void)ctx;
+    if (!f->ok) {
+        fprintf(stderr, "ERROR: %s: %s\n", f->path, f->err);
+        return;
+    }
+    fprintf(stderr, "%s: %zu samples over %u days, %llu of %llu lines skipped\n", f->path, f->n, f->days,
+            (unsigned long long)f->skipped, (unsigned long long)f->lines);
+}
+
+/* --import: console captures of poc.c and Poc.py into the store's hourly files. */
+static int import_logs(const char *dir, char *const *paths, size_t n, unsigned workers, unsigned flags,
+                       unsigned retain_raw)
+{
+    static struct pool pool;
+    struct store st;
+    struct sink k;
+    struct import_stats stats;
+    char err[128];
+    if (!store_open(&st, dir, err, sizeof(err))) {
+        fprintf(stderr, "ERROR: Could not open store %s: %s\n", dir, err);
+        return 1;
+    }
+    int have_pool = pool_init(&pool, workers, flags);
+    sink_store(&k, &st);
+    int ok = import_run(have_pool ? &pool : NULL, (const char *const *)paths, n, &k, print_import, NULL, &stats);
+    k.close(&k);
+    store_close(&st);
+    if (have_pool) pool_destroy(&pool);
+
+    double secs = stats.elapsed_ns / 1e9;
+    fprintf(stderr, "%u files, %llu samples, %.1f MB in %.2f s (%.0f MB/s)\n", stats.files,
+            (unsigned long long)stats.samples, stats.bytes / 1e6, secs, secs > 0 ? stats.bytes / 1e6 / secs : 0);
+    if (stats.samples && retain_raw && stats.first_ns + (uint64_t)retain_raw * STORE_DAY_NS < wall_ns()) {
+        fprintf(stderr, "WARNING: Samples older than %u days go at the next compaction; raise --retain-raw "
+                "to keep them\n", retain_raw);
+    }
+    return !ok;
+}
+
+static int print_row(void *ctx, uint64_t ts_ns, const double *values, size_t n)
+{
+    uint64_t *rows = ctx;
+    time_t t = (time_t)(ts_ns / 1000000000ull);
+    struct tm tm;
+    char when[24];
+    gmtime_r(&t, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm);
+    printf("%s.%03uZ", when, (unsigned)(ts_ns / 1000000 % 1000));
+    for (size_t i = 0; i < n; i++) {
+        if (isnan(values[i])) printf(",");
+        else printf(",%.2f", values[i]);
+    }
+    putchar('\n');
+    (*rows)++;
+    return 1;
+}
+
+/* --scan with --align: the series side by side on one grid, as CSV with a column per series. */
+static int store_align(const char *dir, const char *where, const char **series, size_t n, struct align *a)
+{
+    char err[256];
+    for (size_t i = 0; i < n; i++) {
+        if (!align_add(a, dir, where, series[i], err, sizeof(err))) {
+            fprintf(stderr, "ERROR: --align %s: %s\n", series[i], err);
+            align_free(a);
+            return 1;
+        }
+    }
+    printf("time");
+    for (size_t i = 0; i < a->n; i++) {
+        putchar(',');
+        csv_string(stdout, a->series[i]->label);
+    }
+    putchar('\n');
+    uint64_t rows = 0;
+    int ok = align_run(a, print_row, &rows);
+    if (!ok) fprintf(stderr, "ERROR: %s: read failed\n", dir);
+    fprintf(stderr, "%llu rows from %llu samples in %zu series\n", (unsigned long long)rows,
+            (unsigned long long)a->samples, a->n);
+    align_free(a);
+    return !ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-i IFACE] [-b auto|nl80211|procfs|iw|iwconfig] [-n COUNT]\n"
+            "          [-t INTERVAL_MS] [--deadline MS] [--probe-cache FILE]\n"
+            "          [--mock[=RECORDING]] [--mock-stall N] [--record FILE]\n"
+            "          [--weights SNR,RATE,RETRY,BEACON] [--log FILE] [--alert-below SCORE]\n"
+            "          [--rules FILE | --config FILE] [--daemon] [--control SOCKET]\n"
+            "          [--metrics [HOST:]PORT|unix:PATH] [--flight FILE] [--flight-minutes N]\n"
+            "          [--store DIR] [--retain-raw DAYS] [--workers N] [--pin-workers]\n"
+            "          [--sites DIR [--enroll-site NAME]] [--bench[=NAME]]\n"
+            "       %s [--control SOCKET] --query PING|SAMPLE|HIST|AGGS|RULES|RELOAD|FLUSH\n"
+            "       %s --flight-dump FILE\n"
+            "       %s --store DIR [--workers N] --import CAPTURE...\n"
+            "       %s --store-info DIR\n"
+            "       %s --scan DIR [--where \"bssid=MAC snr<15 from=2024-10-04 ...\"] [--summary]\n"
+            "       %s --scan DIR [--where TERMS] --align \"iface=wlan0\" --align \"iface=wlan1 [store=DIR]\" ...\n"
+            "          [--step MS] [--fill last|linear] [--column snr|signal|health] [--max-gap MS]\n",
+            argv0, argv0, argv0, argv0, argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        { "interface", required_argument, NULL, 'i' },
+        { "backend", required_argument, NULL, 'b' },
+        { "count", required_argument, NULL, 'n' },
+        { "interval", required_argument, NULL, 't' },
+        { "mock", optional_argument, NULL, 'm' },
+        { "record", required_argument, NULL, 'r' },
+        { "probe-cache", required_argument, NULL, 'P' },
+        { "deadline", required_argument, NULL, 'd' },
+        { "mock-stall", required_argument, NULL, 'S' },
+        { "bench", optional_argument, NULL, 'B' },
+        { "weights", required_argument, NULL, 'w' },
+        { "log", required_argument, NULL, 'l' },
+        { "alert-below", required_argument, NULL, 'a' },
+        { "rules", required_argument, NULL, 'R' },
+        { "config", required_argument, NULL, 'C' },
+        { "daemon", no_argument, NULL, 'D' },
+        { "control", required_argument, NULL, 'c' },
+        { "query", required_argument, NULL, 'Q' },
+        { "metrics", required_argument, NULL, 'M' },
+        { "flight", required_argument, NULL, 'F' },
+        { "flight-minutes", required_argument, NULL, 'T' },
+        { "flight-dump", required_argument, NULL, 'U' },
+        { "store", required_argument, NULL, 's' },
+        { "retain-raw", required_argument, NULL, 'K' },
+        { "store-info", required_argument, NULL, 'I' },
+        { "scan", required_argument, NULL, 'N' },
+        { "where", required_argument, NULL, 'W' },
+        { "summary", no_argument, NULL, 'Y' },
+        { "workers", required_argument, NULL, 'j' },
+        { "pin-workers", no_argument, NULL, 'p' },
+        { "align", required_argument, NULL, 'A' },
+        { "step", required_argument, NULL, 'g' },
+        { "fill", required_argument, NULL, 'f' },
+        { "column", required_argument, NULL, 'v' },
+        { "max-gap", required_argument, NULL, 'x' },
+        { "import", no_argument, NULL, 'L' },
+        { "sites", required_argument, NULL, 'Z' },
+        { "enroll-site", required_argument, NULL, 'E' },
+        { NULL, 0, NULL, 0 },
+    };
+    const char *ifname = DEFAULT_INTERFACE;
+    const char *backend_name = "auto";
+    const char *cache_path = NULL;
+    const char *mock_path = NULL;
+    const char *record_path = NULL;
+    const char *log_path = NULL;
+    const char *rules_path = NULL;
+    const char *config_path = NULL;
+    const char *control_path = NULL;
+    const char *request = NULL;
+    const char *metrics_addr = NULL;
+    const char *flight_path = NULL;
+    const char *dump_path = NULL;
+    unsigned flight_minutes = FLIGHT_MINUTES;
+    const char *store_dir = NULL;
+    const char *info_dir = NULL;
+    const char *scan_dir = NULL;
+    const char *sites_dir = NULL;
+    const char *enroll = NULL;
+    const char *where = "";
+    int summary = 0, import = 0;
+    const char *series[ALIGN_MAX_SERIES];
+    size_t nseries = 0;
+    struct align align;
+    align_init(&align, 0, ALIGN_LAST, ALIGN_SNR);
+    unsigned retain_raw = STORE_RETAIN_RAW_DAYS;
+    unsigned workers = 0, pool_flags = 0;
+    char control_buf[108];
+    struct config base = {
+        .interval_ms = SAMPLING_INTERVAL_MS, .weights = health_default_weights, .alert_below = -1,
+        .proximity = { 26, 33, 40 },
+    };
+    unsigned deadline_ms = BACKEND_DEADLINE_MS;
+    unsigned mock_stall = 0;
+    long count = 0;
+    const char *bench = NULL;
+    int use_mock = 0, c;
+
+    while ((c = getopt_long(argc, argv, "i:b:n:t:", opts, NULL)) != -1) {
+        switch (c) {
+        case 'i': ifname = optarg; break;
+        case 'b': backend_name = optarg; break;
+        case 'n': count = strtol(optarg, NULL, 10); break;
+        case 't': base.interval_ms = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'm': use_mock = 1; mock_path = optarg; break;
+        case 'r': record_path = optarg; break;
+        case 'P': cache_path = optarg; break;
+        case 'd': deadline_ms = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'S': mock_stall = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'B': bench = optarg ? optarg : "all"; break;
+        case 'w':
+            if (!health_parse_weights(optarg, &base.weights)) {
+                fprintf(stderr, "ERROR: Bad --weights %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'l': log_path = optarg; break;
+        case 'a': base.alert_below = strtof(optarg, NULL); break;
+        case 'R': rules_path = optarg; break;
+        case 'C': config_path = optarg; break;
+        case 'D': console = 0; break;
+        case 'c': control_path = optarg; break;
+        case 'Q': request = optarg; break;
+        case 'M': metrics_addr = optarg; break;
+        case 'F': flight_path = optarg; break;
+        case 'T': flight_minutes = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'U': dump_path = optarg; break;
+        case 's': store_dir = optarg; break;
+        case 'K': retain_raw = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'I': info_dir = optarg; break;
+        case 'N': scan_dir = optarg; break;
+        case 'W': where = optarg; break;
+        case 'Y': summary = 1; break;
+        case 'j': workers = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'p': pool_flags |= POOL_PIN; break;
+        case 'A':
+            if (nseries == ALIGN_MAX_SERIES) {
+                fprintf(stderr, "ERROR: At most %d --align series\n", ALIGN_MAX_SERIES);
+                return 1;
+            }
+            series[nseries++] = optarg;
+            break;
+        case 'L': import = 1; break;
+        case 'Z': sites_dir = optarg; break;
+        case 'E': enroll = optarg; break;
+        case 'g': align.step_ns = strtoull(optarg, NULL, 10) * 1000000ull; break;
+        case 'x': align.max_gap_ns = strtoull(optarg, NULL, 10) * 1000000ull; break;
+        case 'f':
+            if (!align_parse_fill(optarg, &align.fill)) {
+                fprintf(stderr, "ERROR: Bad --fill %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'v':
+            if (!align_parse_column(optarg, &align.column)) {
+                fprintf(stderr, "ERROR: Bad --column %s\n", optarg);
+                return 1;
+            }
+            break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (bench) {
+        struct bench_args args = { ifname, base.interval_ms, 0 };
+        return bench_run(bench, &args);
+    }
+
+    if (!control_path && (request || !console)) {
+        default_control_path(control_buf, sizeof(control_buf));
+        control_path = control_buf;
+    }
+    if (request) return query(control_path, request);
+    if (dump_path) return flight_dump(dump_path);
+    if (info_dir) return store_dump_info(info_dir);
+    if (import) {
+        if (!store_dir || optind == argc) {
+            fprintf(stderr, "ERROR: --import needs --store DIR and one or more captures\n");
+            return 1;
+        }
+        return import_logs(store_dir, argv + optind, (size_t)(argc - optind), workers, pool_flags, retain_raw);
+    }
+    if (scan_dir && nseries) return store_align(scan_dir, where, series, nseries, &align);
+    if (scan_dir) return store_query(scan_dir, where, summary);
+
+    /* The command line is the config unless a watched file takes over. */
+    char cfg_err[160];
+    struct config_watch watch;
+    if (rules_path && config_path) {
+        fprintf(stderr, "ERROR: Put rules in the --config file instead of --rules\n");
+        return 1;
+    }
+    if (sites_dir && config_path) {
+        fprintf(stderr, "ERROR: Put per-site settings in DIR/NAME.conf instead of --config\n");
+        return 1;
+    }
+    if (enroll && (!sites_dir || !site_name_ok(enroll))) {
+        fprintf(stderr, "ERROR: --enroll-site needs --sites DIR and a name of letters, digits, '.', '_', '-'\n");
+        return 1;
+    }
+    if (rules_path && !rules_load(&base.rules, rules_path, cfg_err, sizeof(cfg_err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", rules_path, cfg_err);
+        return 1;
+    }
+    if (config_path && !config_watch_start(&watch, config_path, &base, cfg_err, sizeof(cfg_err))) {
+        fprintf(stderr, "ERROR: %s: %s\n", config_path, cfg_err);
+        return 1;
+    }
+
+    struct probe probe = {
+        .ifname = ifname, .needed = HEALTH_FIELDS, .cache_path = cache_path, .deadline_ms = deadline_ms,
+    };
+    struct backend *b = &probe.backend;
+    int auto_backend = strcmp(backend_name, "auto") == 0;
+    /* The scan cache is read over the nl80211 backend's socket, so --sites pins it: no probing, no re-probe. */
+    if (sites_dir && !auto_backend && strcmp(backend_name, "nl80211") != 0) {
+        fprintf(stderr, "ERROR: --sites needs the nl80211 backend, not %s\n", backend_name);
+        return 1;
+    }
+    if (!auto_backend || use_mock || sites_dir) {
+        const struct backend *named = backend_by_name(use_mock || sites_dir ? "nl80211" : backend_name);
+        if (!named) {
+            fprintf(stderr, "ERROR: Unknown backend %s\n", backend_name);
+            return 1;
+        }
+        *b = *named;
+        b->deadline_ms = deadline_ms;
+        probe.fixed = 1;
+    }
+
+    struct nlmock mock = { .fd = -1 };
+    int opened;
+    if (use_mock) {
+        int fd;
+        if (!nlmock_start(&mock, mock_path, &fd)) {
+            fprintf(stderr, "ERROR: Could not read mock recording %s\n", mock_path);
+            return 1;
+        }
+        mock.stall_every = mock_stall;
+        opened = nl80211_backend_attach(b, fd, 1);
+    } else if (if_nametoindex(ifname) == 0) {
+        fprintf(stderr, "ERROR: Interface %s not found!\n", ifname);
+        return 1;
+    } else if (probe.fixed) {
+        opened = b->open(b, ifname);
+    } else {
+        opened = probe_select(&probe, 1);
+    }
+    if (!opened && sites_dir) {
+        fprintf(stderr, "ERROR: --sites needs the nl80211 backend, which could not be opened on %s\n", ifname);
+        nlmock_stop(&mock);
+        return 1;
+    }
+    if (!opened) {
+        fprintf(stderr, "ERROR: Could not open %s backend on %s\n", backend_name, ifname);
+        nlmock_stop(&mock);
+        return 1;
+    }
+
+    FILE *record = NULL;
+    if (record_path && b->open == nl80211_backend.open) {
+        record = fopen(record_path, "wb");
+        nl80211_backend_record(b, record);
+    }
+
+    struct sites sites = { .current = -1 };
+    int have_sites = sites_dir != NULL;
+    if (have_sites && !sites_open(&sites, sites_dir, enroll, &base.rules)) {
+        probe_close(&probe);
+        nlmock_stop(&mock);
+        return 1;
+    }
+
+    struct sink_set sinks = {0};
+    struct sink k;
+    if (log_path) {
+        if (!sink_csv_open(&k, log_path)) {
+            fprintf(stderr, "ERROR: Could not open log %s\n", log_path);
+            probe_close(&probe);
+            nlmock_stop(&mock);
+            return 1;
+        }
+        sinks_add(&sinks, &k);
+    }
+    if (console) {
+        sink_alert_stream(&k, stdout);
+        sinks_add(&sinks, &k);
+    }
+    /* Background work shares one pool; only the store has any so far. */
+    static struct pool pool;
+    int have_pool = 0;
+    struct store store;
+    int have_store = store_dir != NULL;
+    if (have_store) {
+        char err[128];
+        if (!store_open(&store, store_dir, err, sizeof(err))) {
+            fprintf(stderr, "ERROR: Could not open store %s: %s\n", store_dir, err);
+            sinks_close(&sinks);
+            probe_close(&probe);
+            nlmock_stop(&mock);
+            return 1;
+        }
+        store.retain_raw_days = retain_raw;
+        sink_store(&k, &store);
+        sinks_add(&sinks, &k);
+        have_pool = pool_init(&pool, workers, pool_flags);
+        if (have_pool) store_start_compactor(&store, &pool);
+        else fprintf(stderr, "WARNING: Store compactor not started\n");
+    }
+
+    struct control ctl;
+    struct config_watch *watched = config_path ? &watch : NULL;
+    int have_control = control_path != NULL;
+    if (have_control && !control_start(&ctl, control_path, watched)) {
+        fprintf(stderr, "ERROR: Could not listen on %s: %s\n", control_path, strerror(errno));
+        sinks_close(&sinks);
+        if (have_store) store_close(&store);
+        probe_close(&probe);
+        nlmock_stop(&mock);
+        return 1;
+    }
+
+    /* Large (a prebuilt response plus per-connection buffers): not on the stack. */
+    static struct metrics met;
+    int have_metrics = metrics_addr != NULL;
+    if (have_metrics && !metrics_start(&met, metrics_addr, ifname)) {
+        fprintf(stderr, "ERROR: Could not serve metrics on %s: %s\n", metrics_addr, strerror(errno));
+        if (have_control) control_stop(&ctl);
+        sinks_close(&sinks);
+        if (have_store) store_close(&store);
+        probe_close(&probe);
+        nlmock_stop(&mock);
+        return 1;
+    }
+
+    struct flight flight;
+    int have_flight = flight_path != NULL;
+    if (have_flight && !flight_open(&flight, flight_path, ifname, flight_minutes, base.interval_ms)) {
+        fprintf(stderr, "ERROR: Could not map flight recorder %s: %s\n", flight_path, strerror(errno));
+        if (have_metrics) metrics_stop(&met);
+        if (have_control) control_stop(&ctl);
+        sinks_close(&sinks);
+        if (have_store) store_close(&store);
+        probe_close(&probe);
+        nlmock_stop(&mock);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    if (console) {
+        printf("Wi-Fi Link Health and Proximity Detection (%s", b->name);
+        if (!probe.fixed) {
+            printf(", %s, %.1f us/sample", probe.cached ? "cached" : "probed", probe.cost_ns / 1e3);
+        }
+        printf(")\n");
+        printf("==================================================\n");
+        printf("%-8s | %6s | %-8s | %8s | %8s | %7s | %7s | %7s | %9s | %-22s\n", "Time", "Health",
+               "Class", "Signal", "SNR", "RX Mb/s", "TX Mb/s", "Retries", "Link kB/s", "Proximity");
+        printf("-------------------------------------------------------------------------------------------------------------------\n");
+    } else {
+        fprintf(stderr, "snrmon: sampling %s with %s, control socket %s\n", ifname, b->name, control_path);
+    }
+
+    struct linkwatch lw;
+    int have_lw = !use_mock && linkwatch_open(&lw, ifname);
+    struct link_event ev;
+
+    struct netstats stats;
+    int have_stats = !use_mock && netstats_open(&stats, ifname, 1);
+    struct link_correlation corr = {0};
+    struct pipeline_config pipeline_cfg = PIPELINE_DEFAULT_CONFIG;
+    pipeline_cfg.require = 0;
+    struct monitor_tick mt = { .sites = have_sites ? &sites : NULL, .sinks = &sinks, .corr = &corr };
+    struct pipeline pipe = { .cfg = &pipeline_cfg, .source = &mt, .sink = &mt };
+    const char *health_checked = NULL;
+
+    struct histogram lat, timeouts;
+    hist_reset(&lat);
+    hist_reset(&timeouts);
+
+    long taken = 0;
+    uint32_t ifname_id = intern_put(&intern_global, ifname, strlen(ifname));
+
+    /* Periodic work runs off one timer wheel in ms of the monotonic clock. */
+    struct wheel wheel;
+    int tick_due = 0;
+    struct timer tick = { .period = base.interval_ms ? base.interval_ms : 1, .fn = set_flag, .arg = &tick_due };
+    wheel_init(&wheel, mono_ms());
+    wheel_add(&wheel, &tick, wheel.now + tick.period);
+    struct timer compact = { .period = STORE_COMPACT_INTERVAL_MS, .fn = kick_compactor, .arg = &store };
+    if (have_store) wheel_add(&wheel, &compact, wheel.now + compact.period);
+    int scan_due = 0;
+    struct timer scan = { .period = SITE_SCAN_INTERVAL_MS, .fn = set_flag, .arg = &scan_due };
+    if (have_sites) {
+        sites_scan(&sites, b, &base);
+        wheel_add(&wheel, &scan, wheel.now + scan.period);
+    }
+    while (running && (count == 0 || taken < count)) {
+        /* One acquire load per tick; reloads land here without a lock. */
+        if (scan_due) {
+            scan_due = 0;
+            sites_scan(&sites, b, &base);
+        }
+        struct config *cfg = config_path ? config_read(&watch) : sites.have_cfg ? &sites.cfg : &base;
+        pipeline_cfg.weights = cfg->weights;
+        pipeline_cfg.alert_below = cfg->alert_below;
+        mt.cfg = cfg;
+        if (cfg->interval_ms && tick.period != cfg->interval_ms) {
+            tick.period = cfg->interval_ms;
+            wheel_add(&wheel, &tick, mono_ms() + tick.period);
+        }
+
+        if (have_lw && lw.state == LINK_DOWN) {
+            if (console) {
+                printf("\r%-8s | Not connected%85s", "", "");
+                fflush(stdout);
+            }
+            /*
+             * Sampling pauses until rtnetlink or nl80211 reports the link
+             * back; compaction and site scans keep their timers.
+             */
+            wheel_cancel(&wheel, &tick);
+            while (running && lw.state == LINK_DOWN && !scan_due) {
+                uint64_t now = mono_ms(), next = wheel_next(&wheel);
+                int wait = next == UINT64_MAX ? -1 : next > now ? (int)(next - now) : 0;
+                if (linkwatch_wait(&lw, wait, &ev)) print_transition(&ev, &cfg->rules);
+                wheel_advance(&wheel, mono_ms());
+            }
+            wheel_add(&wheel, &tick, mono_ms() + tick.period);
+            continue;
+        }
+
+        struct wifi_sample s = {0};
+        s.ts_ns = wall_ns();
+        s.ifname_id = ifname_id;
+        uint64_t t0 = mono_ns();
+        int rc = probe_sample(&probe, &s);
+        uint64_t elapsed = mono_ns() - t0;
+        check_health_inputs(b, &health_checked);
+        hist_record(&lat, elapsed);
+        /* Same tick as the radio sample, so rates line up with its SNR. */
+        if (have_stats) netstats_read(&stats, t0, &s);
+
+        if (rc == SAMPLE_TIMEOUT) {
+            /* An explicit gap, not a silent stall: the backend was abandoned. */
+            char time_str[10];
+            format_time(s.ts_ns, time_str, sizeof(time_str));
+            s.fields = FIELD_GAP;
+            hist_record(&timeouts, elapsed);
+            sinks_sample(&sinks, &s);
+            rules_sample(&cfg->rules, &s, &sinks);
+            if (console) {
+                printf("\r%-8s | GAP: backend missed its %u ms deadline%65s\n", time_str, deadline_ms, "");
+                fflush(stdout);
+            }
+        } else if (rc != 1) {
+            if (console) {
+                printf("\r%-8s | NO SIGNAL / UNAVAILABLE%75s", "", "");
+                fflush(stdout);
+            }
+        } else {
+            mt.s = &s;
+            mt.pending = 1;
+            monitor_pipeline(&pipe, 1);
+        }
+        if (have_flight) flight_write(&flight, &s, elapsed, rc);
+        /* The console flushes every tick; a daemon batches until asked to. */
+        if (console || (have_control && control_take_flush(&ctl))) sinks_flush(&sinks);
+        if (have_control) {
+            control_publish(&ctl, rc == 1 || rc == SAMPLE_TIMEOUT ? &s : NULL, &lat, &timeouts,
+                            &cfg->rules, cfg->generation);
+        }
+        if (have_metrics) metrics_publish(&met, rc == 1 || rc == SAMPLE_TIMEOUT ? &s : NULL, &lat, &timeouts);
+        if (count != 0 && ++taken >= count) break;
+
+        /*
+         * Sleep until the wheel's next timer. The tick is fixed-rate, so
+         * time spent in the backend does not stretch the interval.
+         */
+        tick_due = 0;
+        while (running && !tick_due && !(have_lw && lw.state == LINK_DOWN)) {
+            uint64_t now = mono_ms(), next = wheel_next(&wheel);
+            unsigned wait = next > now ? (unsigned)(next - now) : 0;
+            if (!have_lw) {
+                sleep_ms(wait);
+            } else if (linkwatch_wait(&lw, (int)wait, &ev)) {
+                print_transition(&ev, &cfg->rules);
+            }
+            wheel_advance(&wheel, mono_ms());
+        }
+    }
+    if (console) {
+        printf("\nMonitoring stopped.\n");
+        print_latency_summary(&lat, &timeouts);
+        correlation_report(&corr, stdout);
+    }
+    if (have_sites) sites_close(&sites);
+    if (have_flight) flight_close(&flight);
+    if (have_metrics) metrics_stop(&met);
+    if (have_control) control_stop(&ctl);
+    sinks_close(&sinks);
+    if (have_store) store_close(&store);
+    if (have_pool) pool_destroy(&pool);
+    rules_free(&base.rules);
+    if (config_path) config_watch_stop(&watch);
+
+    if (have_stats) netstats_close(&stats);
+    if (have_lw) linkwatch_close(&lw);
+    probe_close(&probe);
+    nlmock_stop(&mock);
+    if (record) fclose(record);
+    return 0;
+}
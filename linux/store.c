@@ -0,0 +1,1286 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/block.h"
+#include "clock.h"
+#include "store.h"
+
+#define STORE_VIEW_RETRIES 8
+#define STORE_READ_CHUNK 4096           /* samples per raw-file read */
+
+/* From linux/ioprio.h, which is not always installed. */
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+static const char *const kind_names[] = { "raw", "day", "rollup" };
+
+/* --- names and paths --- */
+
+static void utc(uint64_t ns, struct tm *tm)
+{
+    time_t t = (time_t)(ns / 1000000000ull);
+    gmtime_r(&t, tm);
+}
+
+static void raw_name(uint64_t hour_ns, char *out, size_t size)
+{
+    struct tm tm;
+    utc(hour_ns, &tm);
+    snprintf(out, size, "raw-%04d%02d%02d%02d.snr", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour);
+}
+
+static void day_name(int kind, uint64_t day_ns, uint64_t gen, char *out, size_t size)
+{
+    struct tm tm;
+    utc(day_ns, &tm);
+    snprintf(out, size, "%s-%04d%02d%02d-g%llu.%s", kind_names[kind], tm.tm_year + 1900, tm.tm_mon + 1,
+             tm.tm_mday, (unsigned long long)gen, kind == STORE_DAY ? "snb" : "sru");
+}
+
+static void join(const char *dir, const char *name, char *out, size_t size)
+{
+    snprintf(out, size, "%s/%s", dir, name);
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int read_at(int fd, void *buf, size_t len, uint64_t off)
+{
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return 1;
+}
+
+/*
+ * Record size and whole-record count of a raw file. Files from before the
+ * intern IDs have shorter records; a file cut short of its header is empty.
+ */
+static int raw_records(int fd, size_t *rec, size_t *n)
+{
+    struct stat sb;
+    struct store_file_header h;
+    *rec = sizeof(struct wifi_sample);
+    *n = 0;
+    if (fstat(fd, &sb) < 0) return 0;
+    if ((size_t)sb.st_size < sizeof(h)) return 1;
+    if (!read_at(fd, &h, sizeof(h), 0) || memcmp(h.magic, STORE_RAW_MAGIC, sizeof(STORE_RAW_MAGIC)) != 0 ||
+        h.record_size < STORE_RAW_RECORD_V1 || h.record_size > sizeof(struct wifi_sample)) {
+        return 0;
+    }
+    *rec = h.record_size;
+    *n = ((size_t)sb.st_size - sizeof(h)) / *rec;
+    return 1;
+}
+
+/* Reads records [first, first + n) into out, widening short ones in place with zeroed IDs. */
+static int read_raw_records(int fd, size_t rec, size_t first, size_t n, struct wifi_sample *out)
+{
+    if (!read_at(fd, out, n * rec, sizeof(struct store_file_header) + first * rec)) return 0;
+    for (size_t i = n; rec < sizeof(*out) && i-- > 0;) {
+        memmove(&out[i], (const char *)out + i * rec, rec);
+        memset((char *)&out[i] + rec, 0, sizeof(*out) - rec);
+    }
+    return 1;
+}
+
+static void sync_dir(const char *dir)
+{
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+/* --- manifest --- */
+
+static int manifest_add(struct store_manifest *m, int kind, uint64_t start_ns, const char *name)
+{
+    if (m->n == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        struct store_file *files = realloc(m->files, cap * sizeof(*files));
+        if (!files) return 0;
+        m->files = files;
+        m->cap = cap;
+    }
+    size_t i = m->n;
+    while (i > 0 && (m->files[i - 1].start_ns > start_ns ||
+                     (m->files[i - 1].start_ns == start_ns && m->files[i - 1].kind > kind))) {
+        m->files[i] = m->files[i - 1];
+        i--;
+    }
+    m->files[i] = (struct store_file){ .kind = kind, .start_ns = start_ns };
+    snprintf(m->files[i].name, sizeof(m->files[i].name), "%s", name);
+    m->n++;
+    return 1;
+}
+
+static int manifest_find(const struct store_manifest *m, const char *name)
+{
+    for (size_t i = 0; i < m->n; i++) {
+        if (strcmp(m->files[i].name, name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static void manifest_remove(struct store_manifest *m, const char *name)
+{
+    int i = manifest_find(m, name);
+    if (i < 0) return;
+    memmove(&m->files[i], &m->files[i + 1], (m->n - (size_t)i - 1) * sizeof(m->files[0]));
+    m->n--;
+}
+
+static void manifest_free(struct store_manifest *m)
+{
+    free(m->files);
+    memset(m, 0, sizeof(*m));
+}
+
+static int manifest_copy(struct store_manifest *dst, const struct store_manifest *src)
+{
+    memset(dst, 0, sizeof(*dst));
+    dst->generation = src->generation;
+    for (size_t i = 0; i < src->n; i++) {
+        if (!manifest_add(dst, src->files[i].kind, src->files[i].start_ns, src->files[i].name)) {
+            manifest_free(dst);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Returns 1 on success, 0 if missing (errno ENOENT) or malformed. */
+static int manifest_read(const char *dir, struct store_manifest *m)
+{
+    char path[256], line[128], kind[16], name[64];
+    unsigned long long start, gen = 0;
+    memset(m, 0, sizeof(*m));
+    join(dir, STORE_MANIFEST, path, sizeof(path));
+    FILE *fp = fopen(path, "re");
+    if (!fp) return 0;
+
+    int ok = fgets(line, sizeof(line), fp) && strcmp(line, "snrmon-store 1\n") == 0 &&
+             fgets(line, sizeof(line), fp) && sscanf(line, "generation %llu", &gen) == 1;
+    m->generation = gen;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        int k = -1;
+        if (sscanf(line, "%15s %llu %63s", kind, &start, name) != 3) ok = 0;
+        for (int i = 0; ok && i < 3; i++) {
+            if (strcmp(kind, kind_names[i]) == 0) k = i;
+        }
+        ok = ok && k >= 0 && !strchr(name, '/') && manifest_add(m, k, start, name);
+    }
+    fclose(fp);
+    if (!ok) {
+        manifest_free(m);
+        errno = EINVAL;
+    }
+    return ok;
+}
+
+/* Written aside, synced, then renamed over the old one: readers see either. */
+static int manifest_write(const char *dir, const struct store_manifest *m)
+{
+    char path[256], tmp[256];
+    join(dir, STORE_MANIFEST, path, sizeof(path));
+    join(dir, STORE_MANIFEST ".tmp", tmp, sizeof(tmp));
+    FILE *fp = fopen(tmp, "we");
+    if (!fp) return 0;
+    fprintf(fp, "snrmon-store 1\ngeneration %llu\n", (unsigned long long)m->generation);
+    for (size_t i = 0; i < m->n; i++) {
+        fprintf(fp, "%s %llu %s\n", kind_names[m->files[i].kind], (unsigned long long)m->files[i].start_ns,
+                m->files[i].name);
+    }
+    int ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok && rename(tmp, path) == 0;
+    if (ok) sync_dir(dir);
+    else unlink(tmp);
+    return ok;
+}
+
+/* --- strings --- */
+
+/*
+ * Adds the STRINGS entries past the t->count already in t. Returns the
+ * offset after the last whole entry: 0 if there is no file or it was cut
+ * short of its header, -1 if it is not a strings file.
+ */
+static long strings_load(const char *dir, struct intern *t)
+{
+    char path[256], buf[INTERN_MAX_LEN];
+    struct store_file_header h;
+    join(dir, STORE_STRINGS, path, sizeof(path));
+    FILE *fp = fopen(path, "re");
+    if (!fp) return errno == ENOENT ? 0 : -1;
+    long end = 0;
+    if (fread(&h, sizeof(h), 1, fp) == 1) {
+        end = memcmp(h.magic, STORE_STRINGS_MAGIC, sizeof(STORE_STRINGS_MAGIC)) == 0 ? (long)sizeof(h) : -1;
+        uint32_t id = 0;
+        int len;
+        while (end > 0 && (len = getc(fp)) != EOF && fread(buf, 1, (size_t)len, fp) == (size_t)len) {
+            if (++id > t->count && intern_put(t, buf, (size_t)len) != id) break;
+            end = ftell(fp);
+        }
+    }
+    fclose(fp);
+    return end;
+}
+
+/* Opens STRINGS for appending, cutting any entry torn by a crash. */
+static int strings_open(struct store *st)
+{
+    char path[256];
+    long end = strings_load(st->dir, &st->strings);
+    if (end < 0) {
+        errno = EINVAL;
+        return 0;
+    }
+    join(st->dir, STORE_STRINGS, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return 0;
+    if (ftruncate(fd, end) < 0) {
+        close(fd);
+        return 0;
+    }
+    if (end == 0) {
+        struct store_file_header h = { 0 };
+        memcpy(h.magic, STORE_STRINGS_MAGIC, sizeof(STORE_STRINGS_MAGIC));
+        if (!write_all(fd, &h, sizeof(h)) || fsync(fd) < 0) {
+            close(fd);
+            return 0;
+        }
+        sync_dir(st->dir);
+    }
+    st->strings_fd = fd;
+    return 1;
+}
+
+/*
+ * The store's ID for intern_global's id. A string new to the store is
+ * appended and synced before the sample that names it is written, so
+ * every ID on disk resolves. If an append fails, strings are dropped
+ * from then on rather than risk IDs that point at the wrong one.
+ */
+static uint32_t store_string(struct store *st, uint32_t id)
+{
+    if (!id || st->strings_fd < 0) return 0;
+    if (id < st->xlate_n && st->xlate[id]) return st->xlate[id];
+    const char *s = intern_str(&intern_global, id);
+    size_t len = intern_len(&intern_global, id);
+    if (!s) return 0;
+    uint32_t local = intern_find(&st->strings, s, len);
+    if (!local) {
+        uint8_t entry[1 + INTERN_MAX_LEN];
+        entry[0] = (uint8_t)len;
+        memcpy(entry + 1, s, len);
+        if (!write_all(st->strings_fd, entry, len + 1) || fdatasync(st->strings_fd) < 0 ||
+            !(local = intern_put(&st->strings, s, len))) {
+            close(st->strings_fd);
+            st->strings_fd = -1;
+            return 0;
+        }
+    }
+    if (id >= st->xlate_n) {
+        size_t n = st->xlate_n ? st->xlate_n : 64;
+        while (n <= id) n *= 2;
+        uint32_t *x = realloc(st->xlate, n * sizeof(*x));
+        if (!x) return local;
+        memset(x + st->xlate_n, 0, (n - st->xlate_n) * sizeof(*x));
+        st->xlate = x;
+        st->xlate_n = n;
+    }
+    st->xlate[id] = local;
+    return local;
+}
+
+/* --- writer --- */
+
+int store_open(struct store *st, const char *dir, char *err, size_t err_size)
+{
+    memset(st, 0, sizeof(*st));
+    st->strings_fd = -1;
+    st->retain_raw_days = STORE_RETAIN_RAW_DAYS;
+    st->throttle_bps = STORE_THROTTLE_BPS;
+    if (strlen(dir) >= sizeof(st->dir)) {
+        snprintf(err, err_size, "path too long");
+        return 0;
+    }
+    strcpy(st->dir, dir);
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        snprintf(err, err_size, "%s", strerror(errno));
+        return 0;
+    }
+    /* Two writers would each append and compact from their own manifest. */
+    char path[256];
+    join(dir, STORE_LOCK, path, sizeof(path));
+    st->lock_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (st->lock_fd < 0 || flock(st->lock_fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno == EWOULDBLOCK) snprintf(err, err_size, "in use by another process");
+        else snprintf(err, err_size, "%s: %s", STORE_LOCK, strerror(errno));
+        if (st->lock_fd >= 0) close(st->lock_fd);
+        return 0;
+    }
+    if (!manifest_read(dir, &st->manifest)) {
+        if (errno != ENOENT || !manifest_write(dir, &st->manifest)) {
+            if (errno == EINVAL) snprintf(err, err_size, "bad %s", STORE_MANIFEST);
+            else snprintf(err, err_size, "%s", strerror(errno));
+            close(st->lock_fd);
+            return 0;
+        }
+    }
+    if (!strings_open(st)) {
+        if (errno == EINVAL) snprintf(err, err_size, "bad %s", STORE_STRINGS);
+        else snprintf(err, err_size, "%s", strerror(errno));
+        manifest_free(&st->manifest);
+        intern_free(&st->strings);
+        close(st->lock_fd);
+        return 0;
+    }
+    pthread_mutex_init(&st->lock, NULL);
+    return 1;
+}
+
+/*
+ * Rewrites an hour written before the intern IDs with full records, aside
+ * and then renamed over it, so appends can carry on. Takes over fd and
+ * returns the new file's, or -1.
+ */
+static int raw_widen(int fd, const char *path, uint64_t hour_ns, size_t rec, size_t n)
+{
+    char tmp[264];
+    struct store_file_header h = { .record_size = sizeof(struct wifi_sample), .start_ns = hour_ns };
+    memcpy(h.magic, STORE_RAW_MAGIC, sizeof(STORE_RAW_MAGIC));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    struct wifi_sample *s = malloc((n ? n : 1) * sizeof(*s));
+    int out = -1;
+    if (s && read_raw_records(fd, rec, 0, n, s)) {
+        out = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    }
+    close(fd);
+    int ok = out >= 0 && write_all(out, &h, sizeof(h)) && write_all(out, s, n * sizeof(*s)) && fsync(out) == 0 &&
+             rename(tmp, path) == 0;
+    free(s);
+    if (!ok) {
+        if (out >= 0) close(out);
+        unlink(tmp);
+        return -1;
+    }
+    return out;
+}
+
+/* Opens the hour's file for appending, cutting any record torn by a crash. */
+static void raw_roll(struct store *st, uint64_t hour_ns)
+{
+    char name[48], path[256];
+    if (st->raw) fclose(st->raw);
+    st->raw = NULL;
+    raw_name(hour_ns, name, sizeof(name));
+    join(st->dir, name, path, sizeof(path));
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    struct stat sb;
+    size_t old_rec, old_n;
+    if (fd < 0 || fstat(fd, &sb) < 0) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+    const off_t hdr = sizeof(struct store_file_header), rec = sizeof(struct wifi_sample);
+    if (sb.st_size < hdr) {
+        struct store_file_header h = { .record_size = (uint32_t)rec, .start_ns = hour_ns };
+        memcpy(h.magic, STORE_RAW_MAGIC, sizeof(STORE_RAW_MAGIC));
+        if (ftruncate(fd, 0) < 0 || !write_all(fd, &h, sizeof(h))) {
+            close(fd);
+            return;
+        }
+    } else if (!raw_records(fd, &old_rec, &old_n)) {
+        close(fd);
+        return;
+    } else if (old_rec != (size_t)rec) {
+        if ((fd = raw_widen(fd, path, hour_ns, old_rec, old_n)) < 0) return;
+    } else if ((sb.st_size - hdr) % rec != 0 && ftruncate(fd, sb.st_size - (sb.st_size - hdr) % rec) < 0) {
+        close(fd);
+        return;
+    }
+    st->raw = fdopen(fd, "a");
+    if (!st->raw) {
+        close(fd);
+        return;
+    }
+
+    pthread_mutex_lock(&st->lock);
+    st->raw_hour_ns = hour_ns;
+    if (manifest_find(&st->manifest, name) < 0 && manifest_add(&st->manifest, STORE_RAW, hour_ns, name)) {
+        st->manifest.generation++;
+        manifest_write(st->dir, &st->manifest);
+    }
+    pthread_mutex_unlock(&st->lock);
+}
+
+static void store_sample(struct sink *k, const struct wifi_sample *s)
+{
+    struct store *st = k->priv;
+    uint64_t hour = s->ts_ns / STORE_HOUR_NS * STORE_HOUR_NS;
+    if (!st->raw || hour != st->raw_hour_ns) raw_roll(st, hour);
+    if (!st->raw) return;
+    struct wifi_sample rec = *s;
+    rec.ssid_id = store_string(st, s->ssid_id);
+    rec.ifname_id = store_string(st, s->ifname_id);
+    fwrite(&rec, sizeof(rec), 1, st->raw);
+}
+
+static void store_flush(struct sink *k)
+{
+    struct store *st = k->priv;
+    if (st->raw) fflush(st->raw);
+}
+
+static void store_sink_close(struct sink *k)
+{
+    struct store *st = k->priv;
+    if (st->raw) fclose(st->raw);
+    st->raw = NULL;
+}
+
+void sink_store(struct sink *k, struct store *st)
+{
+    *k = (struct sink){
+        .name = "store", .sample = store_sample, .flush = store_flush, .close = store_sink_close, .priv = st,
+    };
+}
+
+/* --- compaction --- */
+
+struct throttle {
+    uint64_t bps;
+    uint64_t start_ns;
+    uint64_t bytes;
+};
+
+/* Sleeps off any lead over the byte budget. */
+static void throttle(struct throttle *t, size_t bytes)
+{
+    t->bytes += bytes;
+    if (!t->bps) return;
+    uint64_t due = t->bytes * 1000000000ull / t->bps, elapsed = mono_ns() - t->start_ns;
+    if (due > elapsed) {
+        struct timespec ts = { (time_t)((due - elapsed) / 1000000000ull), (long)((due - elapsed) % 1000000000ull) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+struct sample_vec {
+    struct wifi_sample *s;
+    size_t n, cap;
+};
+
+static struct wifi_sample *vec_reserve(struct sample_vec *v, size_t more)
+{
+    if (v->n + more > v->cap) {
+        size_t cap = v->cap ? v->cap : 4096;
+        while (cap < v->n + more) cap *= 2;
+        struct wifi_sample *s = realloc(v->s, cap * sizeof(*s));
+        if (!s) return NULL;
+        v->s = s;
+        v->cap = cap;
+    }
+    return v->s + v->n;
+}
+
+static int read_raw(int fd, struct sample_vec *v, struct throttle *t)
+{
+    size_t rec, n;
+    if (!raw_records(fd, &rec, &n)) return 0;
+    for (size_t done = 0; done < n;) {
+        size_t chunk = n - done < STORE_READ_CHUNK ? n - done : STORE_READ_CHUNK;
+        struct wifi_sample *dst = vec_reserve(v, chunk);
+        if (!dst || !read_raw_records(fd, rec, done, chunk, dst)) return 0;
+        v->n += chunk;
+        done += chunk;
+        if (t) throttle(t, chunk * rec);
+    }
+    return 1;
+}
+
+/* Index entry of SNRDAY1 files, before zone maps. */
+struct store_block_ref_v1 {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t count;
+    uint64_t ts_min, ts_max;
+};
+
+/* Reads the block index of a day file; the caller frees *refs. */
+static int read_index(int fd, struct store_block_ref **refs, uint32_t *nblocks)
+{
+    struct stat sb;
+    struct store_day_footer f;
+    *refs = NULL;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(struct store_file_header) + sizeof(f) ||
+        !read_at(fd, &f, sizeof(f), (uint64_t)sb.st_size - sizeof(f))) {
+        return 0;
+    }
+    int v1 = memcmp(f.magic, STORE_DAY_MAGIC_V1, sizeof(STORE_DAY_MAGIC_V1)) == 0;
+    size_t ref_size = v1 ? sizeof(struct store_block_ref_v1) : sizeof(**refs);
+    if ((!v1 && memcmp(f.magic, STORE_DAY_MAGIC, sizeof(STORE_DAY_MAGIC)) != 0) ||
+        f.index_offset + (uint64_t)f.nblocks * ref_size + sizeof(f) != (uint64_t)sb.st_size) {
+        return 0;
+    }
+    *refs = malloc((f.nblocks ? f.nblocks : 1) * sizeof(**refs));
+    if (!*refs || !read_at(fd, *refs, f.nblocks * ref_size, f.index_offset)) {
+        free(*refs);
+        *refs = NULL;
+        return 0;
+    }
+    /* Widen in place, last entry first, with zone maps that rule nothing out. */
+    for (uint32_t b = f.nblocks; v1 && b-- > 0;) {
+        struct store_block_ref_v1 old;
+        memcpy(&old, (const char *)*refs + b * ref_size, sizeof(old));
+        (*refs)[b] = (struct store_block_ref){ .offset = old.offset, .length = old.length, .count = old.count };
+        block_zone_unknown(&(*refs)[b].zone, old.ts_min, old.ts_max);
+    }
+    *nblocks = f.nblocks;
+    return 1;
+}
+
+static int read_block(int fd, const struct store_block_ref *r, uint8_t *buf, struct wifi_sample *out)
+{
+    return r->count <= BLOCK_MAX_SAMPLES && r->length <= block_bound(BLOCK_MAX_SAMPLES) &&
+           read_at(fd, buf, r->length, r->offset) &&
+           block_decode(buf, r->length, out, BLOCK_MAX_SAMPLES) == (long)r->count;
+}
+
+static int read_block_columns(int fd, const struct store_block_ref *r, uint8_t *buf, struct block_columns *out)
+{
+    return r->count <= BLOCK_MAX_SAMPLES && r->length <= block_bound(BLOCK_MAX_SAMPLES) &&
+           read_at(fd, buf, r->length, r->offset) && block_decode_columns(buf, r->length, out) == (long)r->count;
+}
+
+static int read_day(int fd, struct sample_vec *v, struct throttle *t)
+{
+    struct store_block_ref *refs;
+    uint32_t nblocks;
+    if (!read_index(fd, &refs, &nblocks)) return 0;
+    uint8_t *buf = malloc(block_bound(BLOCK_MAX_SAMPLES));
+    int ok = buf != NULL;
+    for (uint32_t b = 0; ok && b < nblocks; b++) {
+        struct wifi_sample *dst = vec_reserve(v, BLOCK_MAX_SAMPLES);
+        ok = dst && read_block(fd, &refs[b], buf, dst);
+        if (ok) v->n += refs[b].count;
+        if (ok && t) throttle(t, refs[b].length);
+    }
+    free(buf);
+    free(refs);
+    return ok;
+}
+
+static int write_day(const char *path, uint64_t day_ns, const struct wifi_sample *s, size_t n,
+                     struct throttle *t, uint64_t *written)
+{
+    size_t nblocks = (n + BLOCK_MAX_SAMPLES - 1) / BLOCK_MAX_SAMPLES;
+    struct store_block_ref *refs = calloc(nblocks ? nblocks : 1, sizeof(*refs));
+    uint8_t *buf = malloc(block_bound(BLOCK_MAX_SAMPLES));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    struct store_file_header h = { .start_ns = day_ns };
+    memcpy(h.magic, STORE_DAY_MAGIC, sizeof(STORE_DAY_MAGIC));
+    int ok = refs && buf && fd >= 0 && write_all(fd, &h, sizeof(h));
+
+    uint64_t off = sizeof(h);
+    for (size_t b = 0; ok && b < nblocks; b++) {
+        size_t first = b * BLOCK_MAX_SAMPLES, count = n - first < BLOCK_MAX_SAMPLES ? n - first : BLOCK_MAX_SAMPLES;
+        size_t len = block_encode(s + first, count, buf);
+        refs[b] = (struct store_block_ref){ .offset = off, .length = (uint32_t)len, .count = (uint32_t)count };
+        block_zone_build(s + first, count, &refs[b].zone);
+        ok = write_all(fd, buf, len);
+        off += len;
+        if (t) throttle(t, len);
+    }
+
+    struct store_day_footer f = { .index_offset = off, .nblocks = (uint32_t)nblocks };
+    memcpy(f.magic, STORE_DAY_MAGIC, sizeof(STORE_DAY_MAGIC));
+    ok = ok && write_all(fd, refs, nblocks * sizeof(*refs)) && write_all(fd, &f, sizeof(f)) && fsync(fd) == 0;
+    *written += off + nblocks * sizeof(*refs) + sizeof(f);
+    if (fd >= 0) close(fd);
+    free(buf);
+    free(refs);
+    return ok;
+}
+
+static void rollup_finish(struct store_rollup *r, double snr_sum, double signal_sum, double health_sum,
+                          double rx_sum, double tx_sum, unsigned radio, unsigned healthy)
+{
+    r->snr_avg = radio ? (float)(snr_sum / radio) : NAN;
+    r->signal_avg = radio ? (float)(signal_sum / radio) : NAN;
+    r->health_avg = healthy ? (float)(health_sum / healthy) : NAN;
+    r->rx_mbps = radio ? (float)(rx_sum / radio) : NAN;
+    r->tx_mbps = radio ? (float)(tx_sum / radio) : NAN;
+}
+
+/* One record per minute that has samples; s is sorted by time. */
+static int write_rollups(const char *path, uint64_t day_ns, const struct wifi_sample *s, size_t n,
+                         struct throttle *t, uint64_t *written)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    struct store_file_header h = { .record_size = sizeof(struct store_rollup), .start_ns = day_ns };
+    memcpy(h.magic, STORE_ROLLUP_MAGIC, sizeof(STORE_ROLLUP_MAGIC));
+    int ok = fd >= 0 && write_all(fd, &h, sizeof(h));
+    *written += sizeof(h);
+
+    for (size_t i = 0; ok && i < n;) {
+        struct store_rollup r = { .minute_ns = s[i].ts_ns / STORE_MINUTE_NS * STORE_MINUTE_NS,
+                                  .snr_min = NAN, .snr_max = NAN, .health_min = NAN };
+        double snr_sum = 0, signal_sum = 0, health_sum = 0, rx_sum = 0, tx_sum = 0;
+        unsigned radio = 0, healthy = 0;
+        for (; i < n && s[i].ts_ns < r.minute_ns + STORE_MINUTE_NS; i++) {
+            const struct wifi_sample *x = &s[i];
+            r.samples++;
+            if (x->fields & FIELD_GAP) {
+                r.gaps++;
+                continue;
+            }
+            if (x->fields & FIELD_SIGNAL) {
+                float snr = sample_snr(x);
+                r.snr_min = radio && r.snr_min <= snr ? r.snr_min : snr;
+                r.snr_max = radio && r.snr_max >= snr ? r.snr_max : snr;
+                snr_sum += snr;
+                signal_sum += x->signal_dbm;
+                rx_sum += x->rx_bitrate_kbps / 1000.0;
+                tx_sum += x->tx_bitrate_kbps / 1000.0;
+                radio++;
+            }
+            if (x->fields & FIELD_HEALTH) {
+                r.health_min = healthy && r.health_min <= x->health ? r.health_min : x->health;
+                health_sum += x->health;
+                healthy++;
+            }
+            if (x->fields & FIELD_TX_RETRIES) r.tx_retries = x->tx_retries;
+            if (x->fields & FIELD_BEACON_LOSS) r.beacon_loss = x->beacon_loss;
+        }
+        rollup_finish(&r, snr_sum, signal_sum, health_sum, rx_sum, tx_sum, radio, healthy);
+        ok = write_all(fd, &r, sizeof(r));
+        *written += sizeof(r);
+        if (t) throttle(t, sizeof(r));
+    }
+    ok = ok && fsync(fd) == 0;
+    if (fd >= 0) close(fd);
+    return ok;
+}
+
+static int cmp_ts(const void *a, const void *b)
+{
+    uint64_t x = ((const struct wifi_sample *)a)->ts_ns, y = ((const struct wifi_sample *)b)->ts_ns;
+    return (x > y) - (x < y);
+}
+
+/* Day and rollup files left behind by a compaction that died before its manifest swap. */
+static void sweep_orphans(const char *dir, const struct store_manifest *m)
+{
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if ((strncmp(e->d_name, "day-", 4) == 0 || strncmp(e->d_name, "rollup-", 7) == 0) &&
+            manifest_find(m, e->d_name) < 0) {
+            unlinkat(dirfd(d), e->d_name, 0);
+        }
+    }
+    closedir(d);
+}
+
+struct name_list {
+    char (*names)[48];
+    size_t n, cap;
+};
+
+static int names_add(struct name_list *l, const char *name)
+{
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 32;
+        char (*names)[48] = realloc(l->names, cap * sizeof(*names));
+        if (!names) return 0;
+        l->names = names;
+        l->cap = cap;
+    }
+    snprintf(l->names[l->n++], sizeof(l->names[0]), "%s", name);
+    return 1;
+}
+
+/* Merges every hourly file (and an older day file) of one finished day. */
+static int compact_day(struct store *st, const struct store_manifest *snap, uint64_t day_ns, uint64_t gen,
+                       uint64_t today_ns, struct throttle *t, struct store_manifest *added,
+                       struct name_list *removed, struct store_compact_stats *stats)
+{
+    struct sample_vec v = {0};
+    char path[256], name[48];
+    int ok = 1;
+    for (size_t i = 0; ok && i < snap->n; i++) {
+        const struct store_file *f = &snap->files[i];
+        if (f->kind == STORE_ROLLUP || f->start_ns / STORE_DAY_NS * STORE_DAY_NS != day_ns) continue;
+        join(st->dir, f->name, path, sizeof(path));
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        ok = fd >= 0 && (f->kind == STORE_RAW ? read_raw(fd, &v, t) : read_day(fd, &v, t));
+        if (fd >= 0) close(fd);
+    }
+    for (size_t i = 0; ok && i < snap->n; i++) {
+        const struct store_file *f = &snap->files[i];
+        if (f->start_ns / STORE_DAY_NS * STORE_DAY_NS == day_ns) ok = names_add(removed, f->name);
+    }
+    if (ok) qsort(v.s, v.n, sizeof(*v.s), cmp_ts);
+
+    /* Past raw retention already: only the rollups are kept. */
+    int keep_raw = !st->retain_raw_days || day_ns + (uint64_t)st->retain_raw_days * STORE_DAY_NS > today_ns;
+    if (ok && keep_raw && v.n) {
+        day_name(STORE_DAY, day_ns, gen, name, sizeof(name));
+        join(st->dir, name, path, sizeof(path));
+        ok = write_day(path, day_ns, v.s, v.n, t, &stats->bytes_written) &&
+             manifest_add(added, STORE_DAY, day_ns, name);
+    }
+    if (ok && v.n) {
+        day_name(STORE_ROLLUP, day_ns, gen, name, sizeof(name));
+        join(st->dir, name, path, sizeof(path));
+        ok = write_rollups(path, day_ns, v.s, v.n, t, &stats->bytes_written) &&
+             manifest_add(added, STORE_ROLLUP, day_ns, name);
+    }
+    stats->samples += v.n;
+    free(v.s);
+    return ok;
+}
+
+int store_compact(struct store *st, uint64_t now_ns, struct store_compact_stats *stats)
+{
+    struct store_compact_stats local = {0};
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    uint64_t t0 = mono_ns();
+    struct throttle t = { st->throttle_bps, t0, 0 };
+
+    struct store_manifest snap;
+    pthread_mutex_lock(&st->lock);
+    int ok = manifest_copy(&snap, &st->manifest);
+    uint64_t writing_day = st->raw ? st->raw_hour_ns / STORE_DAY_NS * STORE_DAY_NS : UINT64_MAX;
+    pthread_mutex_unlock(&st->lock);
+    if (!ok) return 0;
+    sweep_orphans(st->dir, &snap);
+
+    uint64_t today = now_ns / STORE_DAY_NS * STORE_DAY_NS, gen = snap.generation + 1;
+    struct store_manifest added = {0};
+    struct name_list removed = {0};
+    uint64_t last_day = UINT64_MAX;
+    for (size_t i = 0; ok && i < snap.n; i++) {
+        const struct store_file *f = &snap.files[i];
+        uint64_t day = f->start_ns / STORE_DAY_NS * STORE_DAY_NS;
+        if (f->kind != STORE_RAW || day >= today || day == writing_day || day == last_day) continue;
+        last_day = day;
+        ok = compact_day(st, &snap, day, gen, today, &t, &added, &removed, stats);
+        stats->days_compacted += ok;
+    }
+
+    /* Retention over what is already compacted. */
+    for (size_t i = 0; ok && i < snap.n; i++) {
+        const struct store_file *f = &snap.files[i];
+        uint64_t keep = f->kind == STORE_DAY ? st->retain_raw_days : f->kind == STORE_ROLLUP ? st->retain_rollup_days : 0;
+        if (!keep || f->start_ns + keep * STORE_DAY_NS > today || manifest_find(&added, f->name) >= 0) continue;
+        int already = 0;
+        for (size_t j = 0; j < removed.n && !already; j++) already = strcmp(removed.names[j], f->name) == 0;
+        if (already) continue;
+        ok = names_add(&removed, f->name);
+        stats->days_expired += f->kind == STORE_DAY;
+    }
+
+    if (ok && (added.n || removed.n)) {
+        pthread_mutex_lock(&st->lock);
+        for (size_t i = 0; i < removed.n; i++) manifest_remove(&st->manifest, removed.names[i]);
+        for (size_t i = 0; ok && i < added.n; i++) {
+            ok = manifest_add(&st->manifest, added.files[i].kind, added.files[i].start_ns, added.files[i].name);
+        }
+        st->manifest.generation = gen > st->manifest.generation ? gen : st->manifest.generation + 1;
+        ok = ok && manifest_write(st->dir, &st->manifest);
+        pthread_mutex_unlock(&st->lock);
+
+        /* Only now is nothing in the published manifest pointing at them. */
+        char path[256];
+        for (size_t i = 0; ok && i < removed.n; i++) {
+            join(st->dir, removed.names[i], path, sizeof(path));
+            unlink(path);
+        }
+    }
+    stats->bytes_read = t.bytes - stats->bytes_written;
+    stats->elapsed_ns = mono_ns() - t0;
+    pthread_mutex_lock(&st->lock);
+    st->last = *stats;
+    pthread_mutex_unlock(&st->lock);
+
+    manifest_free(&snap);
+    manifest_free(&added);
+    free(removed.names);
+    return ok;
+}
+
+/*
+ * The calling thread's CPU nice value and I/O priority: set to idle, or
+ * restored. The worker is shared, so it is only demoted when it can be
+ * promoted again: raising priority back needs CAP_SYS_NICE or an
+ * RLIMIT_NICE that allows it, which an unprivileged run usually lacks.
+ * Without them the pass keeps the worker's priority and relies on its
+ * throttle.
+ */
+struct idle_prio {
+    int nice;
+    long ioprio;
+    int nice_set, ioprio_set;
+};
+
+#define CAP_SYS_NICE_BIT 23
+
+static int can_raise_nice(int nice)
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NICE, &rl) == 0 && (rl.rlim_cur == RLIM_INFINITY || 20 - nice <= (long)rl.rlim_cur)) {
+        return 1;
+    }
+    FILE *f = fopen("/proc/thread-self/status", "r");
+    if (!f) return 0;
+    char line[128];
+    unsigned long long caps = 0;
+    while (fgets(line, sizeof(line), f) && sscanf(line, "CapEff: %llx", &caps) != 1) {}
+    fclose(f);
+    return (caps >> CAP_SYS_NICE_BIT) & 1;
+}
+
+static void prio_idle(struct idle_prio *saved)
+{
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    memset(saved, 0, sizeof(*saved));
+    errno = 0;
+    saved->nice = getpriority(PRIO_PROCESS, (id_t)tid);
+    if (!errno && can_raise_nice(saved->nice)) {
+        saved->nice_set = setpriority(PRIO_PROCESS, (id_t)tid, 19) == 0;
+    }
+    /* Leaving the idle I/O class for best effort or none needs no privilege. */
+    saved->ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, tid);
+    if (saved->ioprio >= 0) {
+        saved->ioprio_set = syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid,
+                                    IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == 0;
+    }
+}
+
+/* Returns 0, with the worker still demoted, if the kernel refused. */
+static int prio_restore(const struct idle_prio *saved)
+{
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    int ok = 1;
+    if (saved->nice_set) ok &= setpriority(PRIO_PROCESS, (id_t)tid, saved->nice) == 0;
+    if (saved->ioprio_set) ok &= syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, saved->ioprio) == 0;
+    return ok;
+}
+
+static void compact_task(struct pool_task *t)
+{
+    struct store *st = t->arg;
+    struct store_compact_stats stats;
+    struct idle_prio saved;
+
+    /* Background work: idle CPU and I/O class on this worker, where it can be undone, until the pass ends. */
+    prio_idle(&saved);
+    if (!store_compact(st, wall_ns(), &stats)) {
+        fprintf(stderr, "\rStore compaction failed in %s: %s%20s\n", st->dir, strerror(errno), "");
+    } else if (stats.days_compacted || stats.days_expired) {
+        fprintf(stderr, "\rStore compacted: %u days, %u expired (%.1f MB in %.1f s)%20s\n", stats.days_compacted,
+                stats.days_expired, (stats.bytes_read + stats.bytes_written) / 1e6, stats.elapsed_ns / 1e9, "");
+    }
+    if (!prio_restore(&saved)) {
+        fprintf(stderr, "\rCould not restore a pool worker's priority after compaction: %s%20s\n", strerror(errno), "");
+    }
+    atomic_store(&st->compact_queued, 0);
+}
+
+void store_start_compactor(struct store *st, struct pool *pool)
+{
+    st->pool = pool;
+    store_kick_compactor(st);
+}
+
+void store_kick_compactor(struct store *st)
+{
+    if (!st->pool || atomic_exchange(&st->compact_queued, 1)) return;
+    st->compact_task = (struct pool_task){ .fn = compact_task, .arg = st };
+    pool_submit(st->pool, &st->compact_task, POOL_BACKGROUND, &st->compacting);
+}
+
+void store_close(struct store *st)
+{
+    if (st->pool) pool_wait(st->pool, &st->compacting);
+    st->pool = NULL;
+    if (st->raw) fclose(st->raw);
+    st->raw = NULL;
+    if (st->strings_fd >= 0) close(st->strings_fd);
+    st->strings_fd = -1;
+    intern_free(&st->strings);
+    free(st->xlate);
+    st->xlate = NULL;
+    st->xlate_n = 0;
+    manifest_free(&st->manifest);
+    pthread_mutex_destroy(&st->lock);
+    close(st->lock_fd);
+}
+
+/* --- readers --- */
+
+int store_view_open(struct store_view *v, const char *dir, char *err, size_t err_size)
+{
+    memset(v, 0, sizeof(*v));
+    snprintf(v->dir, sizeof(v->dir), "%s", dir);
+    for (int attempt = 0; attempt < STORE_VIEW_RETRIES; attempt++) {
+        if (!manifest_read(dir, &v->manifest)) {
+            if (errno == EINVAL) snprintf(err, err_size, "bad %s", STORE_MANIFEST);
+            else snprintf(err, err_size, "%s", strerror(errno));
+            return 0;
+        }
+        v->fds = malloc((v->manifest.n ? v->manifest.n : 1) * sizeof(*v->fds));
+        if (!v->fds) {
+            manifest_free(&v->manifest);
+            snprintf(err, err_size, "out of memory");
+            return 0;
+        }
+        size_t opened = 0;
+        for (; opened < v->manifest.n; opened++) {
+            char path[256];
+            join(dir, v->manifest.files[opened].name, path, sizeof(path));
+            if ((v->fds[opened] = open(path, O_RDONLY | O_CLOEXEC)) < 0) break;
+        }
+        if (opened == v->manifest.n) {
+            strings_load(dir, &v->strings);
+            return 1;
+        }
+
+        /* A compaction swapped the manifest under us: take the new one. */
+        int saved = errno;
+        while (opened > 0) close(v->fds[--opened]);
+        free(v->fds);
+        manifest_free(&v->manifest);
+        if (saved != ENOENT) {
+            snprintf(err, err_size, "%s", strerror(saved));
+            return 0;
+        }
+    }
+    snprintf(err, err_size, "manifest kept changing");
+    return 0;
+}
+
+void store_view_close(struct store_view *v)
+{
+    for (size_t i = 0; i < v->manifest.n; i++) close(v->fds[i]);
+    free(v->fds);
+    manifest_free(&v->manifest);
+    intern_free(&v->strings);
+}
+
+const char *store_view_string(struct store_view *v, uint32_t id)
+{
+    /* Strings are synced before the samples that use them: a miss means the writer added some since. */
+    if (id > v->strings.count) strings_load(v->dir, &v->strings);
+    return intern_str(&v->strings, id);
+}
+
+/*
+ * Passes the samples of s[0..n) that fall in [from, to), compacted into
+ * tmp when needed. [lo, hi] bounds every timestamp in s: a block's zone,
+ * or for a raw chunk, whose appends follow a wall clock that can step
+ * back, its scanned minimum and maximum.
+ */
+static int emit(const struct wifi_sample *s, size_t n, uint64_t lo, uint64_t hi, uint64_t from, uint64_t to,
+                struct wifi_sample *tmp, store_sample_fn fn, void *ctx)
+{
+    if (n && lo >= from && hi < to) return fn(ctx, s, n);
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i].ts_ns >= from && s[i].ts_ns < to) tmp[k++] = s[i];
+    }
+    return k ? fn(ctx, tmp, k) : 1;
+}
+
+void store_prune_all(struct store_prune *p, uint64_t from_ns, uint64_t to_ns)
+{
+    *p = (struct store_prune){ .from_ns = from_ns, .to_ns = to_ns, .signal_lo = INT8_MIN, .signal_hi = INT8_MAX,
+                               .snr_lo = INT8_MIN, .snr_hi = INT8_MAX };
+}
+
+/* Which zone-map test, if any, rules the block out. */
+static uint64_t *prune_block(const struct store_prune *p, const struct block_zone *z, struct store_scan_stats *st)
+{
+    if (z->ts_max < p->from_ns || z->ts_min >= p->to_ns) return &st->skipped_time;
+    int any_signal = p->signal_lo > INT8_MIN || p->signal_hi < INT8_MAX;
+    int any_snr = p->snr_lo > INT8_MIN || p->snr_hi < INT8_MAX;
+    if ((any_signal && (z->signal_max < p->signal_lo || z->signal_min > p->signal_hi)) ||
+        (any_snr && (z->snr_max < p->snr_lo || z->snr_min > p->snr_hi))) {
+        return &st->skipped_zone;
+    }
+    if (p->has_bssid && !block_zone_may_have_bssid(z, p->bssid)) return &st->skipped_bloom;
+    return NULL;
+}
+
+/* The scan behind both store_scan_pruned and store_scan_columns; exactly one of fn and cfn is set. */
+static int scan(const struct store_view *v, const struct store_prune *p, store_sample_fn fn, void *ctx,
+                struct store_scan_stats *stats)
+{
+    struct store_scan_stats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    uint64_t from_ns = p->from_ns, to_ns = p->to_ns;
+    struct wifi_sample *buf = malloc(2 * BLOCK_MAX_SAMPLES * sizeof(*buf));
+    uint8_t *raw = malloc(block_bound(BLOCK_MAX_SAMPLES));
+    int ok = buf && raw, more = 1;
+
+    for (size_t i = 0; ok && more && i < v->manifest.n; i++) {
+        const struct store_file *f = &v->manifest.files[i];
+        uint64_t span = f->kind == STORE_RAW ? STORE_HOUR_NS : STORE_DAY_NS;
+        if (f->kind == STORE_ROLLUP || f->start_ns + span <= from_ns || f->start_ns >= to_ns) continue;
+        int fd = v->fds[i];
+
+        if (f->kind == STORE_RAW) {
+            size_t rec, n;
+            ok = raw_records(fd, &rec, &n);
+            for (size_t done = 0; ok && more && done < n;) {
+                size_t chunk = n - done < BLOCK_MAX_SAMPLES ? n - done : BLOCK_MAX_SAMPLES;
+                ok = read_raw_records(fd, rec, done, chunk, buf);
+                uint64_t lo = UINT64_MAX, hi = 0;
+                for (size_t j = 0; ok && j < chunk; j++) {
+                    if (buf[j].ts_ns < lo) lo = buf[j].ts_ns;
+                    if (buf[j].ts_ns > hi) hi = buf[j].ts_ns;
+                }
+                if (ok) more = emit(buf, chunk, lo, hi, from_ns, to_ns, buf + BLOCK_MAX_SAMPLES, fn, ctx);
+                done += chunk;
+            }
+            stats->raw_samples += n;
+            continue;
+        }
+
+        struct store_block_ref *refs;
+        uint32_t nblocks;
+        ok = read_index(fd, &refs, &nblocks);
+        for (uint32_t b = 0; ok && more && b < nblocks; b++) {
+            /* Only blocks the zone map cannot rule out leave the disk. */
+            uint64_t *skipped = prune_block(p, &refs[b].zone, stats);
+            stats->blocks++;
+            if (skipped) {
+                (*skipped)++;
+                continue;
+            }
+            stats->decoded++;
+            ok = read_block(fd, &refs[b], raw, buf);
+            if (ok) {
+                more = emit(buf, refs[b].count, refs[b].zone.ts_min, refs[b].zone.ts_max, from_ns, to_ns,
+                            buf + BLOCK_MAX_SAMPLES, fn, ctx);
+            }
+        }
+        free(refs);
+    }
+    free(buf);
+    free(raw);
+    return ok;
+}
+
+int store_scan_pruned(const struct store_view *v, const struct store_prune *p, store_sample_fn fn, void *ctx,
+                      struct store_scan_stats *stats)
+{
+    return scan(v, p, fn, ctx, stats);
+}
+
+int store_cursor_open(struct store_cursor *c, const struct store_view *v, const struct store_prune *p)
+{
+    memset(c, 0, sizeof(*c));
+    c->v = v;
+    c->prune = *p;
+    c->fd = -1;
+    c->raw = malloc(block_bound(BLOCK_MAX_SAMPLES));
+    c->samples = malloc(BLOCK_MAX_SAMPLES * sizeof(*c->samples));
+    c->cols = malloc(sizeof(*c->cols));
+    if (!c->raw || !c->samples || !c->cols) {
+        store_cursor_close(c);
+        return 0;
+    }
+    return 1;
+}
+
+void store_cursor_close(struct store_cursor *c)
+{
+    free(c->refs);
+    free(c->raw);
+    free(c->samples);
+    free(c->cols);
+    c->refs = NULL;
+    c->raw = NULL;
+    c->samples = NULL;
+    c->cols = NULL;
+}
+
+/* Moves to the next data file that overlaps the time range and reads its index or record count. */
+static int cursor_next_file(struct store_cursor *c)
+{
+    const struct store_view *v = c->v;
+    free(c->refs);
+    c->refs = NULL;
+    c->nblocks = c->block = 0;
+    c->raw_n = c->raw_done = 0;
+    for (; c->file < v->manifest.n; c->file++) {
+        const struct store_file *f = &v->manifest.files[c->file];
+        uint64_t span = f->kind == STORE_RAW ? STORE_HOUR_NS : STORE_DAY_NS;
+        if (f->kind == STORE_ROLLUP || f->start_ns + span <= c->prune.from_ns || f->start_ns >= c->prune.to_ns) {
+            continue;
+        }
+        c->fd = v->fds[c->file++];
+        c->in_raw = f->kind == STORE_RAW;
+        if (c->in_raw ? !raw_records(c->fd, &c->raw_rec, &c->raw_n) : !read_index(c->fd, &c->refs, &c->nblocks)) {
+            return -1;
+        }
+        c->stats.raw_samples += c->raw_n;
+        return 1;
+    }
+    c->fd = -1;
+    return 0;
+}
+
+const struct block_columns *store_cursor_next(struct store_cursor *c)
+{
+    while (!c->failed && c->cols) {
+        if (c->fd >= 0 && c->in_raw && c->raw_done < c->raw_n) {
+            size_t left = c->raw_n - c->raw_done, chunk = left < BLOCK_MAX_SAMPLES ? left : BLOCK_MAX_SAMPLES;
+            c->failed = !read_raw_records(c->fd, c->raw_rec, c->raw_done, chunk, c->samples);
+            if (c->failed) break;
+            c->raw_done += chunk;
+            block_columns_from_samples(c->samples, chunk, c->cols);
+            return c->cols;
+        }
+        while (c->fd >= 0 && !c->in_raw && c->block < c->nblocks) {
+            /* Only blocks the zone map cannot rule out leave the disk. */
+            const struct store_block_ref *r = &c->refs[c->block++];
+            uint64_t *skipped = prune_block(&c->prune, &r->zone, &c->stats);
+            c->stats.blocks++;
+            if (skipped) {
+                (*skipped)++;
+                continue;
+            }
+            c->stats.decoded++;
+            c->failed = !read_block_columns(c->fd, r, c->raw, c->cols);
+            return c->failed ? NULL : c->cols;
+        }
+        int next = cursor_next_file(c);
+        if (next <= 0) {
+            c->failed = next < 0;
+            break;
+        }
+    }
+    return NULL;
+}
+
+int store_scan_columns(const struct store_view *v, const struct store_prune *p, store_column_fn fn, void *ctx,
+                       struct store_scan_stats *stats)
+{
+    struct store_cursor c;
+    if (!store_cursor_open(&c, v, p)) return 0;
+    const struct block_columns *cols;
+    while ((cols = store_cursor_next(&c)) != NULL && fn(ctx, cols)) {
+    }
+    int ok = !c.failed;
+    if (stats) *stats = c.stats;
+    store_cursor_close(&c);
+    return ok;
+}
+
+int store_scan(const struct store_view *v, uint64_t from_ns, uint64_t to_ns, store_sample_fn fn, void *ctx)
+{
+    struct store_prune p;
+    store_prune_all(&p, from_ns, to_ns);
+    return store_scan_pruned(v, &p, fn, ctx, NULL);
+}
+
+int store_scan_rollups(const struct store_view *v, uint64_t from_ns, uint64_t to_ns, store_rollup_fn fn,
+                       void *ctx)
+{
+    struct store_rollup buf[256];
+    int ok = 1, more = 1;
+    for (size_t i = 0; ok && more && i < v->manifest.n; i++) {
+        const struct store_file *f = &v->manifest.files[i];
+        if (f->kind != STORE_ROLLUP || f->start_ns + STORE_DAY_NS <= from_ns || f->start_ns >= to_ns) continue;
+        struct stat sb;
+        ok = fstat(v->fds[i], &sb) == 0;
+        size_t n = ok && (size_t)sb.st_size > sizeof(struct store_file_header)
+                       ? ((size_t)sb.st_size - sizeof(struct store_file_header)) / sizeof(buf[0])
+                       : 0;
+        for (size_t done = 0; ok && more && done < n;) {
+            size_t chunk = n - done < 256 ? n - done : 256, k = 0;
+            ok = read_at(v->fds[i], buf, chunk * sizeof(buf[0]),
+                         sizeof(struct store_file_header) + done * sizeof(buf[0]));
+            for (size_t j = 0; ok && j < chunk; j++) {
+                if (buf[j].minute_ns >= from_ns && buf[j].minute_ns < to_ns) buf[k++] = buf[j];
+            }
+            if (ok && k) more = fn(ctx, buf, k);
+            done += chunk;
+        }
+    }
+    return ok;
+}
+
+void store_info(const struct store_view *v, FILE *out)
+{
+    uint64_t samples[3] = {0}, bytes[3] = {0};
+    fprintf(out, "generation %llu, %zu files, %u strings\n", (unsigned long long)v->manifest.generation,
+            v->manifest.n, v->strings.count);
+    fprintf(out, "%-6s | %-28s | %10s | %12s | %10s\n", "Kind", "File", "Records", "Bytes", "Bytes/rec");
+    for (size_t i = 0; i < v->manifest.n; i++) {
+        const struct store_file *f = &v->manifest.files[i];
+        struct stat sb;
+        uint64_t n = 0;
+        if (fstat(v->fds[i], &sb) < 0) continue;
+        if (f->kind == STORE_DAY) {
+            struct store_block_ref *refs;
+            uint32_t nblocks;
+            if (read_index(v->fds[i], &refs, &nblocks)) {
+                for (uint32_t b = 0; b < nblocks; b++) n += refs[b].count;
+                free(refs);
+            }
+        } else if (f->kind == STORE_RAW) {
+            size_t rec, records;
+            if (raw_records(v->fds[i], &rec, &records)) n = records;
+        } else if ((size_t)sb.st_size > sizeof(struct store_file_header)) {
+            n = ((uint64_t)sb.st_size - sizeof(struct store_file_header)) / sizeof(struct store_rollup);
+        }
+        samples[f->kind] += n;
+        bytes[f->kind] += (uint64_t)sb.st_size;
+        fprintf(out, "%-6s | %-28s | %10llu | %12llu | %10.1f\n", kind_names[f->kind], f->name,
+                (unsigned long long)n, (unsigned long long)sb.st_size, n ? (double)sb.st_size / n : 0.0);
+    }
+    for (int k = 0; k < 3; k++) {
+        fprintf(out, "total %-6s %10llu records in %12llu bytes\n", kind_names[k], (unsigned long long)samples[k],
+                (unsigned long long)bytes[k]);
+    }
+}
@@ -0,0 +1,254 @@
+#ifndef SNR_STORE_H
+#define SNR_STORE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../common/block.h"
+#include "../common/intern.h"
+#include "../common/sample.h"
+#include "../common/sink.h"
+#include "pool.h"
+
+/*
+ * On-disk sample store, one directory per host:
+ *
+ *     raw-YYYYMMDDHH.snr        samples as written, one file per UTC hour
+ *     day-YYYYMMDD-gN.snb       a finished day in column-compressed blocks,
+ *                               with a block index and zone maps in the footer
+ *     rollup-YYYYMMDD-gN.sru    per-minute rollups of that day
+ *     MANIFEST                  the files that make up the store
+ *     STRINGS                   SSIDs and interface names the samples refer
+ *                               to by ID, in ID order; only ever appended
+ *
+ * The sampler appends through a sink. Compaction passes run as background
+ * tasks on the shared pool. A pass merges the hourly files of finished
+ * days into a day file and a rollup file, and drops day files past the
+ * raw retention while keeping their rollups. It runs at idle I/O priority,
+ * at idle CPU priority when the process may undo that on the shared
+ * worker, and throttles its own reads and writes.
+ *
+ * Every change is published by writing a new MANIFEST and renaming it
+ * over the old one. Files are unlinked only after the manifest that drops
+ * them is in place. A reader opens every file its manifest lists. If one
+ * has vanished, it rereads the manifest, so it always sees one generation
+ * whole.
+ */
+
+#define STORE_MANIFEST "MANIFEST"
+#define STORE_STRINGS "STRINGS"
+#define STORE_LOCK "LOCK"            /* flocked by the one writer */
+#define STORE_RAW_MAGIC "SNRRAW1"
+#define STORE_RAW_RECORD_V1 offsetof(struct wifi_sample, ssid_id)     /* before intern IDs, still readable */
+#define STORE_STRINGS_MAGIC "SNRSTR1"
+#define STORE_DAY_MAGIC "SNRDAY2"
+#define STORE_DAY_MAGIC_V1 "SNRDAY1"     /* time-only index, still readable */
+#define STORE_ROLLUP_MAGIC "SNRRUP1"
+#define STORE_RETAIN_RAW_DAYS 30
+#define STORE_COMPACT_INTERVAL_MS (10 * 60 * 1000)
+#define STORE_THROTTLE_BPS (4u << 20)   /* compactor reads plus writes */
+
+#define STORE_HOUR_NS (3600ull * 1000000000ull)
+#define STORE_DAY_NS (24 * STORE_HOUR_NS)
+#define STORE_MINUTE_NS (60ull * 1000000000ull)
+
+enum store_kind {
+    STORE_RAW,
+    STORE_DAY,
+    STORE_ROLLUP,
+};
+
+struct store_file {
+    int kind;
+    uint64_t start_ns;          /* UTC hour (raw) or day it covers */
+    char name[48];
+};
+
+struct store_manifest {
+    uint64_t generation;
+    struct store_file *files;   /* sorted by start_ns, then kind */
+    size_t n, cap;
+};
+
+/* 32-byte header shared by every store file. */
+struct store_file_header {
+    char magic[8];
+    uint32_t record_size;       /* raw and rollup records; 0 for day files */
+    uint32_t reserved;
+    uint64_t start_ns;
+    uint64_t reserved2;
+};
+
+/* Day file footer: the block index starts at index_offset. */
+struct store_block_ref {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t count;
+    struct block_zone zone;
+};
+
+struct store_day_footer {
+    uint64_t index_offset;
+    uint32_t nblocks;
+    uint32_t reserved;
+    char magic[8];
+};
+
+struct store_rollup {
+    uint64_t minute_ns;
+    uint32_t samples;           /* including gaps */
+    uint32_t gaps;
+    float snr_min, snr_avg, snr_max;
+    float signal_avg;
+    float health_min, health_avg;
+    float rx_mbps, tx_mbps;     /* mean negotiated bitrates */
+    uint32_t tx_retries;        /* counter values at the end of the minute */
+    uint32_t beacon_loss;
+};
+
+struct store_compact_stats {
+    unsigned days_compacted;
+    unsigned days_expired;
+    uint64_t samples;
+    uint64_t bytes_read, bytes_written;
+    uint64_t elapsed_ns;
+};
+
+struct store {
+    char dir[200];
+    pthread_mutex_t lock;       /* manifest and raw_hour_ns */
+    struct store_manifest manifest;
+    FILE *raw;                  /* hourly file being appended */
+    uint64_t raw_hour_ns;
+    unsigned retain_raw_days;   /* day files older than this are dropped */
+    unsigned retain_rollup_days;        /* 0 keeps rollups forever */
+    uint64_t throttle_bps;      /* 0 for no throttling */
+    struct pool *pool;          /* runs compaction passes; NULL before store_start_compactor */
+    struct pool_task compact_task;
+    struct pool_group compacting;
+    atomic_int compact_queued;  /* a pass is queued or running */
+    struct store_compact_stats last;    /* last compaction, guarded by lock */
+    struct intern strings;      /* what STRINGS holds; IDs in the files are these */
+    int strings_fd;             /* -1 once an append failed: IDs are stored as 0 */
+    uint32_t *xlate;            /* intern_global ID to strings ID, 0 if not yet looked up */
+    size_t xlate_n;
+    int lock_fd;                /* holds the flock on STORE_LOCK */
+};
+
+/*
+ * Opens dir as its one writer, creating it if needed. Fails with "in use
+ * by another process" while a monitor or an import holds it; readers
+ * (store_view_open) take no lock.
+ */
+int store_open(struct store *st, const char *dir, char *err, size_t err_size);
+void store_close(struct store *st);
+
+/*
+ * Compacts on pool's background lane from now on, starting with a pass
+ * now. store_close waits for a pass that is running.
+ */
+void store_start_compactor(struct store *st, struct pool *pool);
+
+/* Queues a pass unless one is queued or running already; call every STORE_COMPACT_INTERVAL_MS. */
+void store_kick_compactor(struct store *st);
+
+/* One compaction pass as of now_ns (wall clock); what the pool task runs. */
+int store_compact(struct store *st, uint64_t now_ns, struct store_compact_stats *stats);
+
+/* Appends samples to the hourly raw files. Does not own the store. */
+void sink_store(struct sink *k, struct store *st);
+
+/* Reader side: one consistent generation with every file held open. */
+struct store_view {
+    char dir[200];
+    struct store_manifest manifest;
+    int *fds;
+    struct intern strings;
+};
+
+int store_view_open(struct store_view *v, const char *dir, char *err, size_t err_size);
+void store_view_close(struct store_view *v);
+
+/* The string behind an SSID or interface ID read from the store; NULL for 0. */
+const char *store_view_string(struct store_view *v, uint32_t id);
+
+/*
+ * What a scan can rule out per block without decoding it. Ranges are
+ * closed; a bounded signal or SNR range also excludes samples without a
+ * signal reading.
+ */
+struct store_prune {
+    uint64_t from_ns, to_ns;    /* [from_ns, to_ns) */
+    int has_bssid;
+    uint8_t bssid[6];
+    int signal_lo, signal_hi;   /* dBm */
+    int snr_lo, snr_hi;         /* dB */
+};
+
+struct store_scan_stats {
+    uint64_t blocks;            /* blocks in the files the scan touched */
+    uint64_t skipped_time;
+    uint64_t skipped_zone;      /* signal or SNR range outside the block's */
+    uint64_t skipped_bloom;     /* BSSID not in the block's filter */
+    uint64_t decoded;
+    uint64_t raw_samples;       /* read from hourly files, which have no index */
+};
+
+/* Everything in [from_ns, to_ns). */
+void store_prune_all(struct store_prune *p, uint64_t from_ns, uint64_t to_ns);
+
+/* Called with batches of samples in [from_ns, to_ns); return 0 to stop. */
+typedef int (*store_sample_fn)(void *ctx, const struct wifi_sample *s, size_t n);
+typedef int (*store_rollup_fn)(void *ctx, const struct store_rollup *r, size_t n);
+
+int store_scan(const struct store_view *v, uint64_t from_ns, uint64_t to_ns, store_sample_fn fn, void *ctx);
+
+/*
+ * As store_scan, but skips day-file blocks whose zone map rules out p.
+ * The batches still hold every sample of a block that was read, so the
+ * caller applies its own per-sample filter. stats may be NULL.
+ */
+int store_scan_pruned(const struct store_view *v, const struct store_prune *p, store_sample_fn fn, void *ctx,
+                      struct store_scan_stats *stats);
+/*
+ * As store_scan_pruned, but hands over the query columns of each block or
+ * raw chunk read, whole: the caller also applies the time range.
+ */
+typedef int (*store_column_fn)(void *ctx, const struct block_columns *c);
+
+int store_scan_columns(const struct store_view *v, const struct store_prune *p, store_column_fn fn, void *ctx,
+                       struct store_scan_stats *stats);
+/*
+ * The pull form of store_scan_columns: store_cursor_next returns the next
+ * block or raw chunk, whole, in the order the files cover time, and NULL
+ * at the end or when a read failed. Several cursors can then advance in
+ * step, as a merge join does. The columns stay valid until the next call.
+ */
+struct store_cursor {
+    const struct store_view *v;
+    struct store_prune prune;
+    struct store_scan_stats stats;
+    int failed;
+    size_t file;                /* next manifest entry to look at */
+    int fd, in_raw;             /* file being read, -1 before the first and after the last */
+    size_t raw_rec, raw_n, raw_done;
+    struct store_block_ref *refs;
+    uint32_t nblocks, block;
+    uint8_t *raw;
+    struct wifi_sample *samples;
+    struct block_columns *cols;
+};
+
+int store_cursor_open(struct store_cursor *c, const struct store_view *v, const struct store_prune *p);
+const struct block_columns *store_cursor_next(struct store_cursor *c);
+void store_cursor_close(struct store_cursor *c);
+
+int store_scan_rollups(const struct store_view *v, uint64_t from_ns, uint64_t to_ns, store_rollup_fn fn,
+                       void *ctx);
+
+/* Counts and sizes per file, for --store-info. */
+void store_info(const struct store_view *v, FILE *out);
+
+#endif
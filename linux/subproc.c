@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "subproc.h"
+
+extern char **environ;
+
+static int remaining_ms(uint64_t deadline)
+{
+    uint64_t now = mono_ns();
+    return now >= deadline ? 0 : (int)((deadline - now + 999999) / 1000000);
+}
+
+static int spawn(char *const argv[], int out_fd, pid_t *pid)
+{
+    posix_spawn_file_actions_t fa;
+    if (posix_spawn_file_actions_init(&fa) != 0) return 0;
+    posix_spawn_file_actions_adddup2(&fa, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    int rc = posix_spawnp(pid, argv[0], &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    return rc == 0;
+}
+
+/* Reaps pid, waiting until the deadline (pidfd if available) before killing it. */
+static int reap(pid_t pid, uint64_t deadline, int *status)
+{
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+
+    for (;;) {
+        pid_t r = waitpid(pid, status, WNOHANG);
+        if (r == pid) break;
+        if (r < 0 && errno != EINTR) break;
+
+        int wait_ms = remaining_ms(deadline);
+        if (wait_ms == 0) {
+            kill(pid, SIGKILL);
+            while (waitpid(pid, status, 0) < 0 && errno == EINTR) {}
+            if (pidfd >= 0) close(pidfd);
+            return 0;
+        }
+        if (pidfd >= 0) {
+            struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+            poll(&pfd, 1, wait_ms);
+        } else {
+            usleep(1000);
+        }
+    }
+    if (pidfd >= 0) close(pidfd);
+    return 1;
+}
+
+int run_command(char *const argv[], char *out, size_t size, unsigned timeout_ms)
+{
+    uint64_t deadline = mono_ns() + (uint64_t)timeout_ms * 1000000ull;
+    int fds[2];
+    pid_t pid;
+
+    out[0] = '\0';
+    if (pipe2(fds, O_CLOEXEC) < 0) return 0;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    if (!spawn(argv, fds[1], &pid)) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    close(fds[1]);
+
+    size_t total = 0;
+    char discard[512];
+    int timed_out = 0, truncated = 0;
+    for (;;) {
+        char *dst = total + 1 < size ? out + total : discard;
+        size_t room = total + 1 < size ? size - 1 - total : sizeof(discard);
+        ssize_t n = read(fds[0], dst, room);
+        if (n > 0) {
+            if (dst != discard) total += (size_t)n;
+            else truncated = 1;
+            continue;
+        }
+        if (n == 0) break;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN) break;
+
+        int wait_ms = remaining_ms(deadline);
+        struct pollfd pfd = { .fd = fds[0], .events = POLLIN };
+        if (wait_ms == 0 || poll(&pfd, 1, wait_ms) == 0) {
+            timed_out = 1;
+            break;
+        }
+    }
+    close(fds[0]);
+    out[total] = '\0';
+
+    int status = 0;
+    if (timed_out) {
+        kill(pid, SIGKILL);
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        return RUN_TIMEOUT;
+    }
+    if (!reap(pid, deadline, &status)) return RUN_TIMEOUT;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 0;
+    return truncated ? RUN_TRUNCATED : 1;
+}
+
+int runner_init(struct runner *r)
+{
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return r->epfd >= 0;
+}
+
+void runner_close(struct runner *r)
+{
+    if (r->epfd >= 0) close(r->epfd);
+    r->epfd = -1;
+}
+
+#define TAG_PIDFD 1u
+
+static void job_finish(struct run_job *job, int result, uint64_t start, run_done_fn done, void *ctx)
+{
+    job->result = result;
+    job->out[job->len] = '\0';
+    job->elapsed_ns = mono_ns() - start;
+    job->pid = 0;
+    if (done) done(job, ctx);
+}
+
+static int job_start(struct runner *r, struct run_job *job, uint32_t index)
+{
+    int fds[2];
+
+    job->len = 0;
+    job->truncated = 0;
+    job->fd = job->pidfd = -1;
+    job->out[0] = '\0';
+    if (pipe2(fds, O_CLOEXEC) < 0) return 0;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    if (!spawn(job->argv, fds[1], &job->pid)) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    close(fds[1]);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)index << 1 };
+    job->fd = fds[0];
+    epoll_ctl(r->epfd, EPOLL_CTL_ADD, job->fd, &ev);
+    return 1;
+}
+
+/* Drains the pipe; returns 1 once it hit EOF. */
+static int job_read(struct run_job *job)
+{
+    char discard[4096];
+
+    for (;;) {
+        char *dst = job->len + 1 < job->size ? job->out + job->len : discard;
+        size_t room = job->len + 1 < job->size ? job->size - 1 - job->len : sizeof(discard);
+        ssize_t n = read(job->fd, dst, room);
+        if (n > 0) {
+            if (dst != discard) job->len += (size_t)n;
+            else job->truncated = 1;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        return n == 0 || errno != EAGAIN;
+    }
+}
+
+/* Returns 1 if the child was reaped; otherwise arms its pidfd in epoll. */
+static int job_reap(struct runner *r, struct run_job *job, uint32_t index, int *status)
+{
+    if (waitpid(job->pid, status, WNOHANG) == job->pid) return 1;
+    if (job->pidfd < 0) {
+        job->pidfd = (int)syscall(SYS_pidfd_open, job->pid, 0);
+        if (job->pidfd < 0) return 0;
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = ((uint64_t)index << 1) | TAG_PIDFD };
+        epoll_ctl(r->epfd, EPOLL_CTL_ADD, job->pidfd, &ev);
+    }
+    return 0;
+}
+
+static void job_release(struct runner *r, struct run_job *job)
+{
+    if (job->fd >= 0) {
+        epoll_ctl(r->epfd, EPOLL_CTL_DEL, job->fd, NULL);
+        close(job->fd);
+        job->fd = -1;
+    }
+    if (job->pidfd >= 0) {
+        epoll_ctl(r->epfd, EPOLL_CTL_DEL, job->pidfd, NULL);
+        close(job->pidfd);
+        job->pidfd = -1;
+    }
+}
+
+int runner_run(struct runner *r, struct run_job *jobs, int n, unsigned timeout_ms,
+               run_done_fn done, void *ctx)
+{
+    uint64_t start = mono_ns();
+    uint64_t deadline = start + (uint64_t)timeout_ms * 1000000ull;
+    int active = 0, ok = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (job_start(r, &jobs[i], (uint32_t)i)) {
+            active++;
+        } else {
+            job_finish(&jobs[i], 0, start, done, ctx);
+        }
+    }
+
+    struct epoll_event evs[32];
+    while (active > 0) {
+        int wait_ms = remaining_ms(deadline);
+        if (wait_ms == 0) break;
+
+        int ready = epoll_wait(r->epfd, evs, 32, wait_ms);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) break;
+
+        for (int e = 0; e < ready; e++) {
+            uint32_t index = (uint32_t)(evs[e].data.u64 >> 1);
+            struct run_job *job = &jobs[index];
+            if (job->pid == 0) continue;
+
+            if (!(evs[e].data.u64 & TAG_PIDFD) && job->fd >= 0) {
+                if (!job_read(job)) continue;
+                epoll_ctl(r->epfd, EPOLL_CTL_DEL, job->fd, NULL);
+                close(job->fd);
+                job->fd = -1;
+            }
+            if (job->fd >= 0) continue;
+
+            /* Output complete; the job is done once the child is reaped. */
+            int status = 0;
+            if (!job_reap(r, job, index, &status)) {
+                if (job->pidfd >= 0) continue;
+                while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR) {}
+            }
+            job_release(r, job);
+            int result = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if (result && job->truncated) result = RUN_TRUNCATED;
+            ok += result == 1;
+            active--;
+            job_finish(job, result, start, done, ctx);
+        }
+    }
+
+    for (int i = 0; i < n && active > 0; i++) {
+        struct run_job *job = &jobs[i];
+        if (job->pid == 0) continue;
+        kill(job->pid, SIGKILL);
+        while (waitpid(job->pid, NULL, 0) < 0 && errno == EINTR) {}
+        job_release(r, job);
+        active--;
+        job_finish(job, RUN_TIMEOUT, start, done, ctx);
+    }
+    return ok;
+}
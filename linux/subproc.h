@@ -0,0 +1,60 @@
+#ifndef SNR_SUBPROC_H
+#define SNR_SUBPROC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define RUN_TIMEOUT (-1)
+#define RUN_TRUNCATED (-2)
+
+/*
+ * Runs argv (PATH lookup, no shell) with stdout captured into out and
+ * stderr discarded. The pipe is read non-blocking under poll, and the
+ * child is SIGKILLed once timeout_ms has elapsed. Returns 1 if it exited
+ * with status 0, 0 on failure, RUN_TIMEOUT if it was killed. out is
+ * always NUL-terminated; output beyond size - 1 bytes is drained and
+ * dropped, and a command that exited with status 0 but did not fit
+ * returns RUN_TRUNCATED rather than 1.
+ */
+int run_command(char *const argv[], char *out, size_t size, unsigned timeout_ms);
+
+/*
+ * One command for runner_run. The caller fills argv, out/size and arg;
+ * result, len and elapsed_ns are set when the job completes.
+ */
+struct run_job {
+    char *const *argv;
+    char *out;
+    size_t size;
+    void *arg;
+    int result;             /* 1, 0, RUN_TIMEOUT or RUN_TRUNCATED, as for run_command */
+    size_t len;
+    int truncated;          /* output beyond size - 1 bytes was dropped */
+    uint64_t elapsed_ns;
+    pid_t pid;
+    int fd;
+    int pidfd;
+};
+
+typedef void (*run_done_fn)(struct run_job *job, void *ctx);
+
+/* One epoll instance reused across ticks. */
+struct runner {
+    int epfd;
+};
+
+int runner_init(struct runner *r);
+void runner_close(struct runner *r);
+
+/*
+ * Spawns all n jobs at once and reads every pipe through a single epoll
+ * loop. done is called for each job as soon as it has exited and its
+ * output is complete, so parsing overlaps with the slower commands.
+ * Jobs still running at timeout_ms are killed and reported as
+ * RUN_TIMEOUT. Returns the number of jobs whose result is 1.
+ */
+int runner_run(struct runner *r, struct run_job *jobs, int n, unsigned timeout_ms,
+               run_done_fn done, void *ctx);
+
+#endif
@@ -3,11 +3,19 @@
 #include <string.h>
 #include <windows.h>
 #include <time.h>
-#include <ctype.h>
+
+#include "../common/health.h"
+#include "../common/intern.h"
+#include "../common/netsh.h"
+#include "../common/sink.h"
 
 #define MAX_BUFFER 8192
 #define MAX_SSID_LENGTH 64
 #define REFRESH_INTERVAL_MS 1100
+#define NETSH_TIMEOUT_MS 3000
+#define NETSH_TIMEOUT (-1)
+#define NETSH_NOISE_DBM (-95)
+#define HEALTH_ALERT_BELOW 40.0f
 
 void safe_strcpy(char *dest, size_t dest_size, const char *src) {
     if (dest && src && dest_size > 0) {
@@ -15,69 +23,113 @@ void safe_strcpy(char *dest, size_t dest_size, const char *src) {
     }
 }
 
-int run_netsh(char *output, size_t output_size) {
-    FILE *fp = _popen("netsh wlan show interfaces", "r");
-    if (!fp) return 0;
-
-    output[0] = '\0';
-    char line[512];
-    size_t total = 0;
-
-    while (fgets(line, sizeof(line), fp)) {
-        if (total + strlen(line) >= output_size - 1) break;
-        strcat_s(output, output_size, line);
-        total += strlen(line);
+struct pipe_reader {
+    HANDLE pipe;
+    char *output;
+    size_t size;
+    size_t total;
+};
+
+DWORD WINAPI read_pipe(LPVOID arg) {
+    struct pipe_reader *r = arg;
+    char discard[512];
+    DWORD n;
+
+    for (;;) {
+        size_t room = r->size - 1 - r->total;
+        char *dst = room ? r->output + r->total : discard;
+        DWORD want = room ? (DWORD)(room < 4096 ? room : 4096) : sizeof(discard);
+        if (!ReadFile(r->pipe, dst, want, &n, NULL) || n == 0) break;
+        if (room) r->total += n;
     }
-
-    _pclose(fp);
-    return 1;
+    r->output[r->total] = '\0';
+    return 0;
 }
 
-int extract_value(const char *output, const char *field, char *result, size_t result_size) {
-    if (!output || !field || !result || result_size == 0) return 0;
-
-    const char *p = strstr(output, field);
-    if (!p) return 0;
-
-    p = strchr(p, ':');
-    if (!p) return 0;
-    p++;
-
-    while (*p == ' ' || *p == '\t') p++;
-    if (*p == '\0' || *p == '\r' || *p == '\n') return 0;
+/*
+ * netsh runs without a console of ours, so it writes in the OEM code page
+ * (850, 866, 932, ...), not the 65001 main selects. The parser's tables
+ * are UTF-8: convert through UTF-16, cutting at a whole character if the
+ * result does not fit.
+ */
+void oem_to_utf8(char *output, size_t output_size) {
+    static WCHAR wide[MAX_BUFFER];
+    static char utf8[MAX_BUFFER * 3];
+    int n = MultiByteToWideChar(CP_OEMCP, 0, output, -1, wide, MAX_BUFFER);
+    if (n <= 0) return;
+    int len = WideCharToMultiByte(CP_UTF8, 0, wide, n, utf8, (int)sizeof(utf8), NULL, NULL);
+    if (len <= 0) return;
+    size_t copy = (size_t)len - 1;
+    if (copy >= output_size) {
+        copy = output_size - 1;
+        while (copy > 0 && ((unsigned char)utf8[copy] & 0xC0) == 0x80) copy--;
+    }
+    memcpy(output, utf8, copy);
+    output[copy] = '\0';
+}
 
-    const char *end = p;
-    while (*end && *end != '\r' && *end != '\n') end++;
+/*
+ * Runs netsh with stdout on a pipe drained by a reader thread and kills it
+ * if it has not exited within NETSH_TIMEOUT_MS; driver resets can wedge it.
+ * The output is handed back in UTF-8.
+ * Returns 1 on success, 0 if it could not run, NETSH_TIMEOUT if killed.
+ */
+int run_netsh(char *output, size_t output_size) {
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    HANDLE rd, wr;
 
-    size_t len = end - p;
-    if (len >= result_size) len = result_size - 1;
+    output[0] = '\0';
+    if (!CreatePipe(&rd, &wr, &sa, 0)) return 0;
+    SetHandleInformation(rd, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOA si;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdOutput = wr;
+    si.hStdError = wr;
+
+    PROCESS_INFORMATION pi;
+    char cmd[] = "netsh wlan show interfaces";
+    BOOL started = CreateProcessA(NULL, cmd, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+    CloseHandle(wr);
+    if (!started) {
+        CloseHandle(rd);
+        return 0;
+    }
 
-    strncpy_s(result, result_size, p, len);
-    result[len] = '\0';
+    struct pipe_reader reader = { rd, output, output_size, 0 };
+    HANDLE thread = CreateThread(NULL, 0, read_pipe, &reader, 0, NULL);
 
-    char *e = result + len - 1;
-    while (e >= result && (*e == ' ' || *e == '\t' || *e == '\r' || *e == '\n')) {
-        *e = '\0';
-        e--;
+    int result = thread ? 1 : 0;
+    if (!thread || WaitForSingleObject(pi.hProcess, NETSH_TIMEOUT_MS) == WAIT_TIMEOUT) {
+        TerminateProcess(pi.hProcess, 1);
+        if (thread) result = NETSH_TIMEOUT;
+    }
+    if (thread) {
+        /* The write end dies with netsh; only a leaked handle could keep ReadFile waiting. */
+        if (WaitForSingleObject(thread, 1000) == WAIT_TIMEOUT) {
+            CancelSynchronousIo(thread);
+            WaitForSingleObject(thread, INFINITE);
+        }
+        CloseHandle(thread);
     }
 
-    return 1;
+    CloseHandle(rd);
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+    oem_to_utf8(output, output_size);
+    return result;
 }
 
-int has_wifi_capability() {
-    FILE *fp = _popen("netsh wlan show drivers", "r");
-    if (!fp) return 0;
-
-    char buffer[512];
-    int found = 0;
-    while (fgets(buffer, sizeof(buffer), fp)) {
-        if (strstr(buffer, "Radio types supported") || strstr(buffer, "802.11")) {
-            found = 1;
-            break;
-        }
-    }
-    _pclose(fp);
-    return found;
+/*
+ * Decides Wi-Fi capability from the same "show interfaces" output the
+ * sampler already fetched, instead of spawning "netsh wlan show drivers".
+ * With no adapter (or wlansvc stopped) netsh prints a single message and
+ * no "Name : value" rows, in every locale.
+ */
+int has_wifi_interface(const char *output) {
+    return output && strstr(output, " : ") != NULL;
 }
 
 int main(void) {
@@ -85,31 +137,59 @@ int main(void) {
     system("chcp 65001 >nul");
     system("cls");
 
-    printf("=== Wi-Fi Proximity Monitor - Live SNR Feed ===\n");
+    printf("=== Wi-Fi Link Health Monitor - Live Feed ===\n");
     printf("Black Hat MEA 2025 - Educational Use Only\n");
     printf("================================================\n\n");
 
-    if (!has_wifi_capability()) {
+    char output[MAX_BUFFER] = {0};
+
+    if (!netsh_init()) {
+        printf("ERROR: Out of memory.\n");
+        return 1;
+    }
+    if (run_netsh(output, sizeof(output)) != 1 || !has_wifi_interface(output)) {
         printf("ERROR: No Wi-Fi adapter detected or Wi-Fi is disabled.\n");
         printf("Please enable your Wi-Fi adapter and try again.\n");
         system("pause");
         return 1;
     }
 
-    printf("Time     | SSID                  | Signal       | Est. SNR | Status\n");
-    printf("---------------------------------------------------------------------\n");
+    printf("Time     | Health | SSID                 | Signal            | Est. SNR | RX/TX Mb/s    | Status\n");
+    printf("------------------------------------------------------------------------------------------------\n");
+
+    /* netsh has no retry or beacon counters, so those weights drop out. */
+    struct sink_set sinks = {0};
+    struct sink alerts;
+    sink_alert_stream(&alerts, stdout);
+    sinks_add(&sinks, &alerts);
+    struct health_alert health_alert = { HEALTH_ALERT_BELOW, HEALTH_HYSTERESIS, 0 };
 
-    char output[MAX_BUFFER] = {0};
     char ssid[MAX_SSID_LENGTH] = {0};
-    char signal_str[16] = {0};
-    char state_str[32] = {0};
+    char display_ssid[21] = {0};
+    uint32_t ssid_id = 0, shown_ssid_id = 0;
     int was_connected = 0;
     int errors = 0;
+    int have_output = 1;
 
     while (1) {
-        if (!run_netsh(output, sizeof(output))) {
+        time_t now = time(NULL);
+        struct tm tm_info;
+        localtime_s(&tm_info, &now);
+        char time_str[10];
+        strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
+
+        /* The startup capability check already produced the first sample. */
+        int query = have_output ? 1 : run_netsh(output, sizeof(output));
+        have_output = 0;
+        if (query != 1) {
             errors++;
-            printf("\rQuery failed (%d)...", errors);
+            if (query == NETSH_TIMEOUT) {
+                /* Record the gap explicitly instead of stalling the feed. */
+                printf("\r%-8s | GAP: netsh killed after %d ms (%d)%30s\n",
+                       time_str, NETSH_TIMEOUT_MS, errors, "");
+            } else {
+                printf("\rQuery failed (%d)...", errors);
+            }
             fflush(stdout);
             if (errors > 10) {
                 printf("\nToo many errors. Exiting.\n");
@@ -120,18 +200,10 @@ int main(void) {
         }
         errors = 0;
 
-        time_t now = time(NULL);
-        struct tm tm_info;
-        localtime_s(&tm_info, &now);
-        char time_str[10];
-        strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
-
-        int is_connected = 0;
-        state_str[0] = '\0';
-        if (extract_value(output, "State", state_str, sizeof(state_str))) {
-            for (char *c = state_str; *c; c++) *c = tolower(*c);
-            if (strstr(state_str, "connected")) is_connected = 1;
-        }
+        /* Labels and State values in any supported display language. */
+        struct netsh_info info;
+        netsh_parse(output, &info);
+        int is_connected = info.state == NETSH_STATE_CONNECTED;
 
         if (is_connected != was_connected) {
             if (is_connected) {
@@ -143,48 +215,71 @@ int main(void) {
         }
 
         if (!is_connected) {
-            printf("\r%-8s | %-20s | %-12s | %-8s | Not connected", time_str, "", "", "");
+            printf("\r%-8s | %6s | %-20s | %-17s | %-8s | %-13s | Not connected", time_str, "", "", "", "", "");
             fflush(stdout);
             Sleep(REFRESH_INTERVAL_MS);
             continue;
         }
 
-        ssid[0] = '\0';
-        if (!extract_value(output, "SSID", ssid, sizeof(ssid)) || strlen(ssid) == 0) {
+        ssid_id = 0;
+        if (info.value[NETSH_SSID] && info.len[NETSH_SSID] < sizeof(ssid)) {
+            memcpy(ssid, info.value[NETSH_SSID], info.len[NETSH_SSID]);
+            ssid[info.len[NETSH_SSID]] = '\0';
+            ssid_id = intern_put(&intern_global, ssid, strlen(ssid));
+        } else {
             safe_strcpy(ssid, sizeof(ssid), "Hidden/Unknown");
         }
 
-        signal_str[0] = '\0';
-        if (!extract_value(output, "Signal", signal_str, sizeof(signal_str))) {
-            strcpy_s(signal_str, sizeof(signal_str), "0%");
-        }
-
-        int signal_pct = 0;
-        if (sscanf_s(signal_str, "%d%%", &signal_pct) != 1) {
-            signal_pct = 0;
-        }
+        int signal_pct = netsh_signal_pct(&info);
+        if (signal_pct < 0) signal_pct = 0;
 
         float signal_dbm = (signal_pct / 2.0f) - 100.0f;
         if (signal_pct >= 100) signal_dbm = -30.0f;
         if (signal_pct <= 0) signal_dbm = -100.0f;
 
-        float snr = signal_dbm - (-95.0f);  
+        struct wifi_sample sample = {0};
+        sample.ts_ns = (uint64_t)now * 1000000000ull;
+        sample.fields = FIELD_SIGNAL | FIELD_NOISE;
+        sample.signal_dbm = (int)signal_dbm;
+        sample.noise_dbm = NETSH_NOISE_DBM;
+        sample.ssid_id = ssid_id;
+        if (ssid_id) sample.fields |= FIELD_SSID;
+        unsigned b[6];
+        if (info.value[NETSH_BSSID] && sscanf_s(info.value[NETSH_BSSID], "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2],
+                                                &b[3], &b[4], &b[5]) == 6) {
+            for (int i = 0; i < 6; i++) sample.bssid[i] = (uint8_t)b[i];
+            sample.fields |= FIELD_BSSID;
+        }
+        sample.rx_bitrate_kbps = netsh_rate_kbps(&info, NETSH_RX_RATE);
+        sample.tx_bitrate_kbps = netsh_rate_kbps(&info, NETSH_TX_RATE);
+        if (sample.rx_bitrate_kbps) sample.fields |= FIELD_RX_BITRATE;
+        if (sample.tx_bitrate_kbps) sample.fields |= FIELD_TX_BITRATE;
+
+        float snr = signal_dbm - NETSH_NOISE_DBM;
+        float rate = -1.0f;
+        if (sample.rx_bitrate_kbps && sample.tx_bitrate_kbps) {
+            rate = (sample.rx_bitrate_kbps + sample.tx_bitrate_kbps) / 2000.0f;
+        } else if (sample.rx_bitrate_kbps || sample.tx_bitrate_kbps) {
+            rate = (sample.rx_bitrate_kbps + sample.tx_bitrate_kbps) / 1000.0f;
+        }
+        sample.health = health_score(&health_default_weights, snr, rate, -1.0f, -1.0f);
+        sample.fields |= FIELD_HEALTH;
 
-        const char *status;
-        if (snr >= 40) status = "AI";
-        else if (snr >= 38) status = "AI";
-        else if (snr >= 35) status = "AI";
-        else if (snr >= 32) status = "AI";
-        else status = "AI";
+        health_alert_check(&health_alert, &sample, &sinks);
 
-        char display_ssid[21] = {0};
-        strncpy_s(display_ssid, sizeof(display_ssid), ssid, 20);
-        if (strlen(ssid) > 20) {
-            strcpy_s(display_ssid + 17, 4, "...");
+        /* The SSID rarely changes: only rebuild its column when the ID does. */
+        if (!ssid_id || ssid_id != shown_ssid_id) {
+            strncpy_s(display_ssid, sizeof(display_ssid), ssid, 20);
+            if (strlen(ssid) > 20) {
+                strcpy_s(display_ssid + 17, 4, "...");
+            }
+            shown_ssid_id = ssid_id;
         }
 
-        printf("\r%-8s | %-20s | %3d%% (%+5.1f dBm) | %5.1f dB | %s     ",
-               time_str, display_ssid, signal_pct, signal_dbm, snr, status);
+        printf("\r%-8s | %6.1f | %-20s | %3d%% (%+5.1f dBm) | %5.1f dB | %6.1f/%-6.1f | %-8s",
+               time_str, sample.health, display_ssid, signal_pct, signal_dbm, snr,
+               sample.rx_bitrate_kbps / 1000.0, sample.tx_bitrate_kbps / 1000.0,
+               health_class(sample.health));
         fflush(stdout);
 
         Sleep(REFRESH_INTERVAL_MS);